@@ -21,9 +21,27 @@ THE SOFTWARE.
 
 */
 #include <string.h>
+#include <errno.h>
+
+#ifdef WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <dirent.h>
+#endif /* WIN32 */
 
 #include "pdb.h"
 #include "tpi.h"
+#include "dbi.h"
+#include "publics.h"
+#include "pool.h"
+#include "export.h"
+#include "layout.h"
+#include "nameindex.h"
+#include "typediff.h"
+#include "search.h"
+#include "serve.h"
 
 char* g_pdbFile = NULL; // The full path and file name of the pdb file we are operating on
 bool g_dumpStream = false; // Do we want to dump a stream?
@@ -31,6 +49,23 @@ uint16_t g_dumpStreamId = (uint16_t)-1; // The stream id to dump if dump is true
 bool g_dumpType = false; // Do we want to dump a type?
 bool g_dumpAllTypes = false;
 char* g_type = NULL;
+bool g_printStats = false; // Print the library's counters when done?
+char* g_traceFile = NULL; // Where to write a Chrome trace of the library's phases
+FILE* g_trace = NULL;
+PDB_LOCK* g_traceLock = NULL; // Events come from every worker thread
+bool g_traceFirstEvent = true;
+bool g_serve = false; // Keep the pdbs open and answer queries
+char* g_socketPath = NULL; // Unix domain socket to serve on (stdin/stdout if NULL)
+uint32_t g_threads = 0; // Worker threads, 0 for one per processor
+char* g_extractDir = NULL; // Write every stream to its own file here
+char* g_exportFile = NULL; // Export all types here ("-" for stdout)
+PDB_EXPORT_FORMAT g_exportFormat = PDB_EXPORT_NDJSON;
+bool g_diffTypes = false; // Compare the types of two pdbs
+char* g_findPattern = NULL; // List the udts matching this glob
+char* g_searchName = NULL; // Find the pdbs defining or exporting this name
+char* g_cacheDir = NULL; // Where --search keeps its filters (next to each pdb if NULL)
+char** g_pdbFiles = NULL;
+int g_pdbFileCount = 0;
 
 
 #ifdef _MSC_VER
@@ -41,47 +76,749 @@ char* g_type = NULL;
 static void PrintHelp()
 {
 	fprintf(stderr, "Usage: pdbp [options] [pdb file]\n");
+	fprintf(stderr, "       pdbp --serve [--socket path] [--threads n] [pdb file] ...\n");
+	fprintf(stderr, "       pdbp --diff-types [old pdb file] [new pdb file]\n");
+	fprintf(stderr, "       pdbp --search [name] [--cache dir] [--threads n] [dir or pdb file] ...\n");
 	fprintf(stderr, "Options:\n\n");
 	fprintf(stderr, "\t-d [stream_num] or --dump-stream [stream_num]\t\tDump the data in the stream to stdout.\n");
 	fprintf(stderr, "\t dt [type name} or --dump-type [type name]\t\tDump type information to stdout.\n");
+	fprintf(stderr, "\t--find-types [pattern]\t\t\t\t\tList the structs, unions and enums matching a * and ? pattern.\n");
+	fprintf(stderr, "\t\t\t\t\t\t\t\tThe name index is kept next to the pdb as [pdb file].nidx.\n");
+	fprintf(stderr, "\t--export-types [file]\t\t\t\t\tExport every type record to file (- for stdout).\n");
+	fprintf(stderr, "\t--export-format [ndjson|binary]\t\t\t\tFormat for --export-types (default: ndjson).\n");
+	fprintf(stderr, "\t--diff-types\t\t\t\t\t\tList the structs, unions and enums that differ between two pdbs.\n");
+	fprintf(stderr, "\t--extract-all [dir]\t\t\t\t\tWrite every stream to its own file in dir, in parallel.\n");
+	fprintf(stderr, "\t--stats\t\t\t\t\t\t\tPrint I/O and parse counters to stderr when done.\n");
+	fprintf(stderr, "\t--trace [file]\t\t\t\t\t\tWrite a Chrome trace (chrome://tracing) of the library's phases.\n");
+	fprintf(stderr, "\t--serve\t\t\t\t\t\t\tAnswer addr/rva/sym/type queries, one per line, on stdin or a socket.\n");
+	fprintf(stderr, "\t--socket [path]\t\t\t\t\t\tServe on a unix domain socket instead of stdin/stdout.\n");
+	fprintf(stderr, "\t--search [name]\t\t\t\t\t\tList the pdbs under the directories that define a type or public by that name.\n");
+	fprintf(stderr, "\t--cache [dir]\t\t\t\t\t\tKeep --search's name filters in dir instead of next to each pdb.\n");
+	fprintf(stderr, "\t--threads [n]\t\t\t\t\t\tWorker threads for --serve, --search and --extract-all (default: one per processor).\n");
 }
 
 
 static bool ParseCommandLine(int argc, char** argv)
 {
-	if (argc < 2)
-		return false;
-
-	if (argc == 2)
-	{
-		g_pdbFile = argv[1];
-		return true;
-	}
+	int i;
 
-	if (argc == 4)
+	// Options come first, then the pdb file(s)
+	for (i = 1; (i < argc) && (argv[i][0] == '-'); i++)
 	{
-		if ((strcasecmp(argv[1], "-d") == 0)
-			|| (strcasecmp(argv[1], "--dump-stream") == 0))
+		if ((strcasecmp(argv[i], "-d") == 0)
+			|| (strcasecmp(argv[i], "--dump-stream") == 0))
 		{
+			if (i + 1 >= argc)
+				return false;
+
 			g_dumpStream = true;
-			g_dumpStreamId = (uint16_t)atoi(argv[2]);
+			g_dumpStreamId = (uint16_t)atoi(argv[++i]);
 		}
-		else if ((strcasecmp(argv[1], "-dt") == 0)
-			|| (strcasecmp(argv[1], "--dump-type") == 0))
+		else if ((strcasecmp(argv[i], "-dt") == 0)
+			|| (strcasecmp(argv[i], "--dump-type") == 0))
 		{
+			if (i + 1 >= argc)
+				return false;
+
 			g_dumpType = true;
+			i++;
 
-			if (strcasecmp(argv[2], "all") == 0)
+			if (strcasecmp(argv[i], "all") == 0)
 				g_dumpAllTypes = true;
 			else
-				g_type = argv[2];
+				g_type = argv[i];
+		}
+		else if (strcasecmp(argv[i], "--find-types") == 0)
+		{
+			if (i + 1 >= argc)
+				return false;
+
+			g_findPattern = argv[++i];
+		}
+		else if (strcasecmp(argv[i], "--export-types") == 0)
+		{
+			if (i + 1 >= argc)
+				return false;
+
+			g_exportFile = argv[++i];
+		}
+		else if (strcasecmp(argv[i], "--export-format") == 0)
+		{
+			if (i + 1 >= argc)
+				return false;
+
+			i++;
+
+			if (strcasecmp(argv[i], "ndjson") == 0)
+				g_exportFormat = PDB_EXPORT_NDJSON;
+			else if (strcasecmp(argv[i], "binary") == 0)
+				g_exportFormat = PDB_EXPORT_BINARY;
+			else
+				return false;
+		}
+		else if (strcasecmp(argv[i], "--diff-types") == 0)
+		{
+			g_diffTypes = true;
+		}
+		else if (strcasecmp(argv[i], "--extract-all") == 0)
+		{
+			if (i + 1 >= argc)
+				return false;
+
+			g_extractDir = argv[++i];
+		}
+		else if (strcasecmp(argv[i], "--stats") == 0)
+		{
+			g_printStats = true;
+		}
+		else if (strcasecmp(argv[i], "--trace") == 0)
+		{
+			if (i + 1 >= argc)
+				return false;
+
+			g_traceFile = argv[++i];
+		}
+		else if (strcasecmp(argv[i], "--serve") == 0)
+		{
+			g_serve = true;
+		}
+		else if (strcasecmp(argv[i], "--socket") == 0)
+		{
+			if (i + 1 >= argc)
+				return false;
+
+			g_socketPath = argv[++i];
+		}
+		else if (strcasecmp(argv[i], "--search") == 0)
+		{
+			if (i + 1 >= argc)
+				return false;
+
+			g_searchName = argv[++i];
+		}
+		else if (strcasecmp(argv[i], "--cache") == 0)
+		{
+			if (i + 1 >= argc)
+				return false;
+
+			g_cacheDir = argv[++i];
+		}
+		else if (strcasecmp(argv[i], "--threads") == 0)
+		{
+			if (i + 1 >= argc)
+				return false;
+
+			g_threads = (uint32_t)atoi(argv[++i]);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	g_pdbFiles = &argv[i];
+	g_pdbFileCount = argc - i;
+
+	// The server and search take any number of pdbs, a diff two, everything
+	// else exactly one
+	if (g_serve || g_searchName)
+		return (g_pdbFileCount > 0);
+
+	if (g_diffTypes)
+		return (g_pdbFileCount == 2);
+
+	if (g_pdbFileCount != 1)
+		return false;
+
+	g_pdbFile = argv[i];
+
+	return true;
+}
+
+
+typedef struct EXTRACT_ITEM
+{
+	PDB_STREAM* stream;
+	char* path;
+	bool result;
+} EXTRACT_ITEM;
+
+
+static void ExtractStream(void* ctxt)
+{
+	EXTRACT_ITEM* item = (EXTRACT_ITEM*)ctxt;
+	FILE* out = fopen(item->path, "wb");
+
+	if (!out)
+	{
+		fprintf(stderr, "Failed to create %s: %s\n", item->path, strerror(errno));
+		return;
+	}
+
+	item->result = PdbStreamCopy(item->stream, out);
+
+	if (fclose(out))
+		item->result = false;
+
+	if (!item->result)
+		fprintf(stderr, "Failed to extract %s.\n", item->path);
+}
+
+
+static bool ExtractAll(PDB_FILE* pdb)
+{
+	uint16_t streamCount = PdbGetStreamCount(pdb);
+	EXTRACT_ITEM* items;
+	PDB_POOL* pool;
+	uint16_t i;
+	bool result = true;
+
+#ifdef WIN32
+	if (_mkdir(g_extractDir) && (errno != EEXIST))
+#else
+	if (mkdir(g_extractDir, 0777) && (errno != EEXIST))
+#endif /* WIN32 */
+	{
+		fprintf(stderr, "Failed to create %s: %s\n", g_extractDir, strerror(errno));
+		return false;
+	}
+
+	items = (EXTRACT_ITEM*)calloc(streamCount, sizeof(EXTRACT_ITEM));
+	pool = PdbPoolCreate(g_threads);
+
+	if (!items || !pool)
+	{
+		free(items);
+		if (pool)
+			PdbPoolDestroy(pool);
+		fprintf(stderr, "Out of memory.\n");
+		return false;
+	}
+
+	// Opening a stream goes through the shared root stream, so that part is
+	// serial.  The copies only use positioned reads and can all run at once.
+	for (i = 0; i < streamCount; i++)
+	{
+		items[i].stream = PdbStreamOpen(pdb, i);
+		items[i].result = false;
+
+		// Deleted streams have nothing to extract
+		if (!items[i].stream)
+		{
+			items[i].result = true;
+			continue;
 		}
-		g_pdbFile = argv[3];
 
+		// Room for the separator, the name and the largest stream number
+		items[i].path = (char*)malloc(strlen(g_extractDir) + 32);
+		if (!items[i].path)
+		{
+			PdbStreamClose(items[i].stream);
+			items[i].stream = NULL;
+			continue;
+		}
+
+		sprintf(items[i].path, "%s/stream%u.bin", g_extractDir, (unsigned)i);
+
+		if (!PdbPoolSubmit(pool, ExtractStream, &items[i]))
+			ExtractStream(&items[i]);
+	}
+
+	PdbPoolWait(pool);
+	PdbPoolDestroy(pool);
+
+	for (i = 0; i < streamCount; i++)
+	{
+		if (!items[i].result)
+			result = false;
+
+		if (items[i].stream)
+			PdbStreamClose(items[i].stream);
+
+		free(items[i].path);
+	}
+
+	free(items);
+
+	return result;
+}
+
+
+static bool PrintMatch(void* ctxt, const char* name, uint32_t typeId)
+{
+	(void)ctxt;
+
+	printf("%x %s\n", typeId, name);
+
+	return true;
+}
+
+
+static bool FindTypes(PDB_FILE* pdb)
+{
+	PDB_TYPES* types = PdbTypesOpen(pdb);
+	PDB_NAME_INDEX* index;
+	char* indexPath;
+	uint32_t matches;
+
+	if (!types)
+	{
+		fprintf(stderr, "Failed to open pdb types.\n");
+		return false;
+	}
+
+	indexPath = (char*)malloc(strlen(g_pdbFile) + sizeof(".nidx"));
+	if (!indexPath)
+	{
+		PdbTypesClose(types);
+		return false;
+	}
+
+	sprintf(indexPath, "%s.nidx", g_pdbFile);
+
+	index = PdbNameIndexOpen(types, indexPath);
+	free(indexPath);
+
+	if (!index)
+	{
+		fprintf(stderr, "Failed to index type names.\n");
+		PdbTypesClose(types);
+		return false;
+	}
+
+	matches = PdbNameIndexFindGlob(index, g_findPattern, PrintMatch, NULL);
+	fprintf(stderr, "%u of %u names match.\n", matches, PdbNameIndexGetCount(index));
+
+	PdbNameIndexClose(index);
+	PdbTypesClose(types);
+
+	return true;
+}
+
+
+static bool ExportTypes(PDB_FILE* pdb)
+{
+	PDB_TYPES* types = PdbTypesOpen(pdb);
+	FILE* out;
+	bool result;
+
+	if (!types)
+	{
+		fprintf(stderr, "Failed to open pdb types.\n");
+		return false;
+	}
+
+	if (strcmp(g_exportFile, "-") == 0)
+		out = stdout;
+	else
+		out = fopen(g_exportFile, "wb");
+
+	if (!out)
+	{
+		fprintf(stderr, "Failed to create %s: %s\n", g_exportFile, strerror(errno));
+		PdbTypesClose(types);
+		return false;
+	}
+
+	result = PdbTypesExport(types, g_exportFormat, out);
+
+	if ((out != stdout) && fclose(out))
+		result = false;
+
+	if (!result)
+		fprintf(stderr, "Failed to export types.\n");
+
+	PdbTypesClose(types);
+
+	return result;
+}
+
+
+typedef struct DIFF_COUNTS
+{
+	uint32_t added;
+	uint32_t removed;
+	uint32_t changed;
+} DIFF_COUNTS;
+
+
+static const char* UdtKind(PDB_LEAF_TYPES leaf)
+{
+	switch (leaf)
+	{
+	case LEAF_TYPE_CLASS:
+		return "class";
+	case LEAF_TYPE_INTERFACE:
+		return "interface";
+	case LEAF_TYPE_UNION:
+		return "union";
+	case LEAF_TYPE_ENUM:
+		return "enum";
+	default:
+		return "struct";
+	}
+}
+
+
+static bool PrintTypeDiff(void* ctxt, const PDB_TYPE_DIFF* diff)
+{
+	DIFF_COUNTS* counts = (DIFF_COUNTS*)ctxt;
+	uint32_t i;
+
+	switch (diff->change)
+	{
+	case PDB_TYPE_ADDED:
+		counts->added++;
+		printf("+ %s %s size=0x%llx\n", UdtKind(diff->leaf), diff->name, (unsigned long long)diff->newSize);
+		return true;
+	case PDB_TYPE_REMOVED:
+		counts->removed++;
+		printf("- %s %s size=0x%llx\n", UdtKind(diff->leaf), diff->name, (unsigned long long)diff->oldSize);
+		return true;
+	default:
+		break;
+	}
+
+	counts->changed++;
+
+	if (diff->oldSize != diff->newSize)
+		printf("~ %s %s size=0x%llx -> 0x%llx\n", UdtKind(diff->leaf), diff->name,
+			(unsigned long long)diff->oldSize, (unsigned long long)diff->newSize);
+	else
+		printf("~ %s %s size=0x%llx\n", UdtKind(diff->leaf), diff->name, (unsigned long long)diff->newSize);
+
+	for (i = 0; i < diff->memberCount; i++)
+	{
+		const PDB_MEMBER_DIFF* member = &diff->members[i];
+
+		if (member->change == PDB_TYPE_ADDED)
+			printf("\t+ +0x%llx %s size=0x%llx\n", (unsigned long long)member->newOffset, member->name,
+				(unsigned long long)member->newSize);
+		else if (member->change == PDB_TYPE_REMOVED)
+			printf("\t- +0x%llx %s size=0x%llx\n", (unsigned long long)member->oldOffset, member->name,
+				(unsigned long long)member->oldSize);
+		else
+			printf("\t~ +0x%llx -> +0x%llx %s size=0x%llx -> 0x%llx%s\n", (unsigned long long)member->oldOffset,
+				(unsigned long long)member->newOffset, member->name, (unsigned long long)member->oldSize,
+				(unsigned long long)member->newSize, member->typeChanged ? " (type changed)" : "");
+	}
+
+	return true;
+}
+
+
+static int DiffTypes(const char* oldFile, const char* newFile)
+{
+	PDB_FILE* oldPdb = PdbOpen(oldFile);
+	PDB_FILE* newPdb = PdbOpen(newFile);
+	PDB_TYPES* oldTypes = oldPdb ? PdbTypesOpen(oldPdb) : NULL;
+	PDB_TYPES* newTypes = newPdb ? PdbTypesOpen(newPdb) : NULL;
+	DIFF_COUNTS counts;
+	int result = 0;
+
+	memset(&counts, 0, sizeof(counts));
+
+	if (!oldTypes || !newTypes)
+	{
+		fprintf(stderr, "Failed to open the types of %s\n", oldTypes ? newFile : oldFile);
+		result = 2;
+	}
+	else if (!PdbTypesDiff(oldTypes, newTypes, PrintTypeDiff, &counts))
+	{
+		fprintf(stderr, "Failed to compare types.\n");
+		result = 10;
+	}
+	else
+	{
+		fprintf(stderr, "%u added, %u removed, %u changed\n", counts.added, counts.removed, counts.changed);
+	}
+
+	if (newTypes)
+		PdbTypesClose(newTypes);
+	if (oldTypes)
+		PdbTypesClose(oldTypes);
+	if (newPdb)
+		PdbClose(newPdb);
+	if (oldPdb)
+		PdbClose(oldPdb);
+
+	return result;
+}
+
+
+typedef struct PATH_LIST
+{
+	char** paths;
+	uint32_t count;
+	uint32_t capacity;
+} PATH_LIST;
+
+
+static bool AddPath(PATH_LIST* list, const char* path)
+{
+	if (list->count == list->capacity)
+	{
+		uint32_t capacity = list->capacity ? (list->capacity * 2) : 256;
+		char** paths = (char**)realloc(list->paths, capacity * sizeof(char*));
+
+		if (!paths)
+			return false;
+
+		list->paths = paths;
+		list->capacity = capacity;
+	}
+
+	list->paths[list->count] = (char*)malloc(strlen(path) + 1);
+	if (!list->paths[list->count])
+		return false;
+
+	strcpy(list->paths[list->count++], path);
+
+	return true;
+}
+
+
+static bool IsPdbName(const char* name)
+{
+	size_t len = strlen(name);
+
+	return (len > 4) && (strcasecmp(name + len - 4, ".pdb") == 0);
+}
+
+
+static bool IsDirectory(const char* path)
+{
+#ifdef WIN32
+	DWORD attributes = GetFileAttributesA(path);
+
+	return (attributes != INVALID_FILE_ATTRIBUTES) && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat info;
+
+	return (stat(path, &info) == 0) && S_ISDIR(info.st_mode);
+#endif /* WIN32 */
+}
+
+
+// Every .pdb file under dir.  Symbol stores keep foo.pdb/[GUID][age]/foo.pdb,
+// so directories are checked for before the name is.
+static bool CollectPdbs(PATH_LIST* list, const char* dir)
+{
+	bool result = true;
+#ifdef WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find;
+	char* pattern = (char*)malloc(strlen(dir) + 3);
+
+	if (!pattern)
+		return false;
+
+	sprintf(pattern, "%s/*", dir);
+	find = FindFirstFileA(pattern, &data);
+	free(pattern);
+
+	if (find == INVALID_HANDLE_VALUE)
+		return true;
+
+	do
+	{
+		const char* name = data.cFileName;
+#else
+	DIR* handle = opendir(dir);
+	struct dirent* entry;
+
+	if (!handle)
 		return true;
+
+	while (result && ((entry = readdir(handle)) != NULL))
+	{
+		const char* name = entry->d_name;
+#endif /* WIN32 */
+		char* path;
+
+		if ((strcmp(name, ".") == 0) || (strcmp(name, "..") == 0))
+			continue;
+
+		path = (char*)malloc(strlen(dir) + strlen(name) + 2);
+		if (!path)
+		{
+			result = false;
+			break;
+		}
+
+		sprintf(path, "%s/%s", dir, name);
+
+		if (IsDirectory(path))
+			result = CollectPdbs(list, path);
+		else if (IsPdbName(name))
+			result = AddPath(list, path);
+
+		free(path);
+#ifdef WIN32
+	} while (result && FindNextFileA(find, &data));
+
+	FindClose(find);
+#else
+	}
+
+	closedir(handle);
+#endif /* WIN32 */
+
+	return result;
+}
+
+
+static void PrintSearchMatch(void* ctxt, const char* path, uint32_t found)
+{
+	(void)ctxt;
+
+	printf("%s%s%s\n", path, (found & PDB_SEARCH_TYPES) ? " type" : "",
+		(found & PDB_SEARCH_PUBLICS) ? " public" : "");
+}
+
+
+static int Search()
+{
+	PATH_LIST list;
+	PDB_SEARCH_STATS stats;
+	int result = 0;
+	int i;
+	uint32_t j;
+
+	memset(&list, 0, sizeof(list));
+
+	for (i = 0; i < g_pdbFileCount; i++)
+	{
+		bool added = IsDirectory(g_pdbFiles[i]) ? CollectPdbs(&list, g_pdbFiles[i])
+			: AddPath(&list, g_pdbFiles[i]);
+
+		if (!added)
+		{
+			fprintf(stderr, "Out of memory.\n");
+			result = 12;
+			goto DONE;
+		}
+	}
+
+	if (!PdbSearch((const char* const*)list.paths, list.count, g_searchName, PDB_SEARCH_ALL, g_cacheDir,
+		g_threads, PrintSearchMatch, NULL, &stats))
+	{
+		fprintf(stderr, "Failed to search.\n");
+		result = 12;
+		goto DONE;
+	}
+
+	fprintf(stderr, "%u of %u pdbs match, %u ruled out by their filters alone (%u filters built, %u failed to open)\n",
+		stats.matched, stats.files, stats.rejected, stats.built, stats.failed);
+
+DONE:
+	for (j = 0; j < list.count; j++)
+		free(list.paths[j]);
+	free(list.paths);
+
+	return result;
+}
+
+
+static void PrintStats(PDB_FILE* pdb)
+{
+	PDB_STATS stats;
+
+	PdbGetStats(pdb, &stats);
+
+	// One key=value per line so it is easy to scrape
+	fprintf(stderr, "stats.reads=%llu\n", (unsigned long long)stats.reads);
+	fprintf(stderr, "stats.seeks=%llu\n", (unsigned long long)stats.seeks);
+	fprintf(stderr, "stats.bytes_read=%llu\n", (unsigned long long)stats.bytesRead);
+	fprintf(stderr, "stats.page_crossings=%llu\n", (unsigned long long)stats.pageCrossings);
+	fprintf(stderr, "stats.cache_hits=%llu\n", (unsigned long long)stats.cacheHits);
+	fprintf(stderr, "stats.cache_misses=%llu\n", (unsigned long long)stats.cacheMisses);
+	fprintf(stderr, "stats.time_open_ns=%llu\n", (unsigned long long)stats.time[PDB_SUBSYSTEM_OPEN]);
+	fprintf(stderr, "stats.time_directory_ns=%llu\n", (unsigned long long)stats.time[PDB_SUBSYSTEM_DIRECTORY]);
+	fprintf(stderr, "stats.time_tpi_ns=%llu\n", (unsigned long long)stats.time[PDB_SUBSYSTEM_TPI]);
+	fprintf(stderr, "stats.time_dbi_ns=%llu\n", (unsigned long long)stats.time[PDB_SUBSYSTEM_DBI]);
+}
+
+
+static void TraceEvent(void* ctxt, const PDB_TRACE_RECORD* record)
+{
+	FILE* out = (FILE*)ctxt;
+
+	PdbLockAcquire(g_traceLock);
+
+	// Events that race TraceStop are dropped
+	if (!g_trace)
+	{
+		PdbLockRelease(g_traceLock);
+		return;
+	}
+
+	// Trace event format wants microseconds
+	if (!g_traceFirstEvent)
+		fputs(",\n", out);
+	g_traceFirstEvent = false;
+
+	switch (record->event)
+	{
+	case PDB_TRACE_BEGIN:
+	case PDB_TRACE_END:
+		fprintf(out, "{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"arg\":%llu}}",
+			record->name, (record->event == PDB_TRACE_BEGIN) ? "B" : "E",
+			record->timestamp / 1000.0, record->thread, (unsigned long long)record->arg);
+		break;
+	case PDB_TRACE_IO:
+		fprintf(out, "{\"name\":\"%s\",\"cat\":\"io\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"bytes\":%llu}}",
+			record->name, record->timestamp / 1000.0, record->duration / 1000.0, record->thread,
+			(unsigned long long)record->arg);
+		break;
+	}
+
+	PdbLockRelease(g_traceLock);
+}
+
+
+static void TraceStop()
+{
+	if (!g_trace)
+		return;
+
+	PdbSetTraceHook(NULL, NULL);
+
+	PdbLockAcquire(g_traceLock);
+	fputs("\n]}\n", g_trace);
+	fclose(g_trace);
+	g_trace = NULL;
+	PdbLockRelease(g_traceLock);
+
+	PdbLockDestroy(g_traceLock);
+	g_traceLock = NULL;
+}
+
+
+static bool TraceStart()
+{
+	g_traceLock = PdbLockCreate();
+
+	if (!g_traceLock)
+		return false;
+
+	g_trace = fopen(g_traceFile, "w");
+
+	if (!g_trace)
+	{
+		fprintf(stderr, "Failed to open trace file %s.\n", g_traceFile);
+		PdbLockDestroy(g_traceLock);
+		g_traceLock = NULL;
+		return false;
 	}
 
-	return false;
+	fputs("{\"traceEvents\":[\n", g_trace);
+	PdbSetTraceHook(TraceEvent, g_trace);
+
+	// Close off the JSON however main exits
+	atexit(TraceStop);
+
+	return true;
 }
 
 
@@ -95,6 +832,18 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
+	if (g_traceFile && !TraceStart())
+		return 7;
+
+	if (g_serve)
+		return Serve(g_pdbFiles, g_pdbFileCount, g_socketPath, g_threads);
+
+	if (g_diffTypes)
+		return DiffTypes(g_pdbFiles[0], g_pdbFiles[1]);
+
+	if (g_searchName)
+		return Search();
+
 	pdb = PdbOpen(g_pdbFile);
 
 	if (!pdb)
@@ -108,9 +857,6 @@ int main(int argc, char** argv)
 
 	if (g_dumpStream)
 	{
-		uint8_t buff[512];
-		uint32_t chunkSize;
-		uint32_t bytesRemaining;
 		PDB_STREAM* stream = PdbStreamOpen(pdb, g_dumpStreamId);
 
 		if (!stream)
@@ -120,33 +866,21 @@ int main(int argc, char** argv)
 			return 3;
 		}
 
-		bytesRemaining = PdbStreamGetSize(stream);
-
-		while (bytesRemaining)
+		if (!PdbStreamCopy(stream, stdout))
 		{
-			if (bytesRemaining > 512)
-				chunkSize = 512;
-			else
-				chunkSize = bytesRemaining;
-
-			if (!PdbStreamRead(stream, buff, chunkSize))
-			{
-				PdbStreamClose(stream);
-				PdbClose(pdb);
-				fprintf(stderr, "Failed to read stream.\n");
-				return 4;
-			}
+			PdbStreamClose(stream);
+			PdbClose(pdb);
+			fprintf(stderr, "Failed to copy stream to stdout.\n");
+			return 4;
+		}
 
-			if (fwrite(buff, 1, chunkSize, stdout) != chunkSize)
-			{
-				PdbStreamClose(stream);
-				PdbClose(pdb);
-				fprintf(stderr, "Failed to write to stdout.\n");
-				return 5;
-			}
+		PdbStreamClose(stream);
+	}
 
-			bytesRemaining -= chunkSize;
-		}
+	if (g_extractDir && !ExtractAll(pdb))
+	{
+		PdbClose(pdb);
+		return 8;
 	}
 
 	if (g_dumpType)
@@ -169,6 +903,21 @@ int main(int argc, char** argv)
 		PdbTypesClose(types);
 	}
 
+	if (g_findPattern && !FindTypes(pdb))
+	{
+		PdbClose(pdb);
+		return 11;
+	}
+
+	if (g_exportFile && !ExportTypes(pdb))
+	{
+		PdbClose(pdb);
+		return 9;
+	}
+
+	if (g_printStats)
+		PrintStats(pdb);
+
 	PdbClose(pdb);
 
 	return 0;
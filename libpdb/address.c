@@ -0,0 +1,417 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "dbi.h"
+#include "address.h"
+#include "internal.h"
+
+
+#define PDB_SECTION_HEADER_SIZE 40
+#define PDB_OMAP_ENTRY_SIZE 8
+
+
+// One direction of OMAP.  Kept as two arrays so the search only touches
+// the keys.
+typedef struct PDB_OMAP
+{
+	uint32_t* from; // Sorted
+	uint32_t* to; // 0 where the range was dropped
+	uint32_t count;
+} PDB_OMAP;
+
+typedef struct PDB_SECTIONS
+{
+	PDB_SECTION_HEADER* headers; // In section number order
+	uint32_t* starts; // Sorted virtual addresses
+	uint16_t* numbers; // Section number of each start
+	uint16_t count;
+} PDB_SECTIONS;
+
+struct PDB_ADDRESS_MAP
+{
+	PDB_SECTIONS image;
+	PDB_SECTIONS original; // Only loaded with OMAP
+	PDB_SECTIONS* symbols; // The sections pdb addresses are relative to
+	PDB_OMAP toSource;
+	PDB_OMAP fromSource;
+	bool omap;
+};
+
+
+// PdbUpperBound for keys that only go up, starting from the previous answer.
+// Gallop forward to bracket the answer, then search just the bracket.
+static uint32_t UpperBoundFrom(const uint32_t* keys, uint32_t count, uint32_t key, uint32_t pos)
+{
+	uint32_t step = 1;
+	uint32_t low;
+	uint32_t high;
+
+	while ((pos + step <= count) && (keys[pos + step - 1] <= key))
+		step *= 2;
+
+	low = pos + (step / 2);
+	high = pos + step - 1;
+	if (high > count)
+		high = count;
+
+	return low + PdbUpperBound(keys + low, high - low, key);
+}
+
+
+static uint32_t OmapEntry(const PDB_OMAP* omap, uint32_t entry, uint32_t rva)
+{
+	if ((entry == 0) || (omap->to[entry - 1] == 0))
+		return 0;
+
+	return omap->to[entry - 1] + (rva - omap->from[entry - 1]);
+}
+
+
+static uint32_t OmapTranslate(const PDB_OMAP* omap, uint32_t rva)
+{
+	return OmapEntry(omap, PdbUpperBound(omap->from, omap->count, rva), rva);
+}
+
+
+static bool SectionEntry(const PDB_SECTIONS* sections, uint32_t entry, uint32_t rva,
+	uint16_t* section, uint32_t* offset)
+{
+	const PDB_SECTION_HEADER* header;
+	uint32_t size;
+
+	if (entry == 0)
+		return false;
+
+	header = &sections->headers[sections->numbers[entry - 1] - 1];
+	size = (header->virtualSize > header->rawSize) ? header->virtualSize : header->rawSize;
+
+	if (rva - header->virtualAddress >= size)
+		return false;
+
+	*section = sections->numbers[entry - 1];
+	*offset = rva - header->virtualAddress;
+
+	return true;
+}
+
+
+static bool LoadOmap(PDB_FILE* pdb, uint16_t streamId, PDB_OMAP* omap)
+{
+	PDB_STREAM* stream;
+	uint8_t* buff;
+	uint32_t size;
+	uint32_t i;
+	bool result = false;
+
+	omap->count = 0;
+
+	if (streamId == PDB_STREAM_NONE)
+		return false;
+
+	stream = PdbStreamOpen(pdb, streamId);
+	if (!stream)
+		return false;
+
+	size = PdbStreamGetSize(stream);
+	omap->count = size / PDB_OMAP_ENTRY_SIZE;
+
+	buff = (uint8_t*)malloc(size ? size : 1);
+	omap->from = (uint32_t*)PdbAlignedAlloc(sizeof(uint32_t) * omap->count);
+	omap->to = (uint32_t*)PdbAlignedAlloc(sizeof(uint32_t) * omap->count);
+
+	if (!buff || !omap->from || !omap->to)
+		goto DONE;
+
+	PdbStreamSetAccess(stream, PDB_ACCESS_ONCE);
+
+	if (!PdbStreamRead(stream, buff, size))
+		goto DONE;
+
+	for (i = 0; i < omap->count; i++)
+	{
+		memcpy(&omap->from[i], buff + (i * PDB_OMAP_ENTRY_SIZE), 4);
+		memcpy(&omap->to[i], buff + (i * PDB_OMAP_ENTRY_SIZE) + 4, 4);
+
+		// The searches depend on the order
+		if ((i > 0) && (omap->from[i] < omap->from[i - 1]))
+			goto DONE;
+	}
+
+	result = true;
+
+DONE:
+	PdbStreamEndAccess(stream);
+	PdbStreamClose(stream);
+	free(buff);
+
+	if (!result)
+	{
+		PdbAlignedFree(omap->from);
+		PdbAlignedFree(omap->to);
+		omap->from = NULL;
+		omap->to = NULL;
+		omap->count = 0;
+	}
+
+	return result;
+}
+
+
+static void FreeSections(PDB_SECTIONS* sections)
+{
+	free(sections->headers);
+	PdbAlignedFree(sections->starts);
+	free(sections->numbers);
+	memset(sections, 0, sizeof(PDB_SECTIONS));
+}
+
+
+static bool LoadSections(PDB_FILE* pdb, uint16_t streamId, PDB_SECTIONS* sections)
+{
+	PDB_STREAM* stream;
+	uint8_t* buff = NULL;
+	uint32_t size;
+	uint32_t i;
+	bool result = false;
+
+	memset(sections, 0, sizeof(PDB_SECTIONS));
+
+	if (streamId == PDB_STREAM_NONE)
+		return false;
+
+	stream = PdbStreamOpen(pdb, streamId);
+	if (!stream)
+		return false;
+
+	size = PdbStreamGetSize(stream);
+
+	// Section numbers are 16 bits
+	if ((size == 0) || (size / PDB_SECTION_HEADER_SIZE > 0xffff))
+		goto DONE;
+
+	sections->count = (uint16_t)(size / PDB_SECTION_HEADER_SIZE);
+	buff = (uint8_t*)malloc(size);
+	sections->headers = (PDB_SECTION_HEADER*)calloc(sections->count, sizeof(PDB_SECTION_HEADER));
+	sections->starts = (uint32_t*)PdbAlignedAlloc(sizeof(uint32_t) * sections->count);
+	sections->numbers = (uint16_t*)malloc(sizeof(uint16_t) * sections->count);
+
+	if (!buff || !sections->headers || !sections->starts || !sections->numbers)
+		goto DONE;
+
+	if (!PdbStreamRead(stream, buff, size))
+		goto DONE;
+
+	for (i = 0; i < sections->count; i++)
+	{
+		const uint8_t* raw = buff + (i * PDB_SECTION_HEADER_SIZE);
+		PDB_SECTION_HEADER* header = &sections->headers[i];
+		uint32_t j;
+
+		memcpy(header->name, raw, 8);
+		memcpy(&header->virtualSize, raw + 8, 4);
+		memcpy(&header->virtualAddress, raw + 12, 4);
+		memcpy(&header->rawSize, raw + 16, 4);
+		memcpy(&header->characteristics, raw + 36, 4);
+
+		// Insertion sort by address, there are only a handful and they
+		// are nearly always in order already
+		for (j = i; (j > 0) && (sections->starts[j - 1] > header->virtualAddress); j--)
+		{
+			sections->starts[j] = sections->starts[j - 1];
+			sections->numbers[j] = sections->numbers[j - 1];
+		}
+
+		sections->starts[j] = header->virtualAddress;
+		sections->numbers[j] = (uint16_t)(i + 1);
+	}
+
+	result = true;
+
+DONE:
+	PdbStreamClose(stream);
+	free(buff);
+
+	if (!result)
+		FreeSections(sections);
+
+	return result;
+}
+
+
+PDB_ADDRESS_MAP* PdbAddressMapOpen(PDB_DBI* dbi)
+{
+	PDB_FILE* pdb = PdbDbiGetPdb(dbi);
+	PDB_ADDRESS_MAP* map = (PDB_ADDRESS_MAP*)calloc(1, sizeof(PDB_ADDRESS_MAP));
+
+	if (!map)
+		return NULL;
+
+	if (!LoadSections(pdb, PdbDbiGetDebugStream(dbi, PDB_DEBUG_SECTION_HEADERS), &map->image))
+	{
+		free(map);
+		return NULL;
+	}
+
+	map->symbols = &map->image;
+
+	// Both directions are written together, don't trust just one of them
+	if (LoadOmap(pdb, PdbDbiGetDebugStream(dbi, PDB_DEBUG_OMAP_TO_SRC), &map->toSource)
+		&& LoadOmap(pdb, PdbDbiGetDebugStream(dbi, PDB_DEBUG_OMAP_FROM_SRC), &map->fromSource))
+	{
+		map->omap = true;
+
+		if (LoadSections(pdb, PdbDbiGetDebugStream(dbi, PDB_DEBUG_SECTION_HEADERS_ORIG), &map->original))
+			map->symbols = &map->original;
+	}
+	else
+	{
+		PdbAlignedFree(map->toSource.from);
+		PdbAlignedFree(map->toSource.to);
+		memset(&map->toSource, 0, sizeof(PDB_OMAP));
+	}
+
+	return map;
+}
+
+
+void PdbAddressMapClose(PDB_ADDRESS_MAP* map)
+{
+	FreeSections(&map->image);
+	FreeSections(&map->original);
+	PdbAlignedFree(map->toSource.from);
+	PdbAlignedFree(map->toSource.to);
+	PdbAlignedFree(map->fromSource.from);
+	PdbAlignedFree(map->fromSource.to);
+	free(map);
+}
+
+
+bool PdbAddressMapHasOmap(PDB_ADDRESS_MAP* map)
+{
+	return map->omap;
+}
+
+
+uint16_t PdbAddressMapGetSectionCount(PDB_ADDRESS_MAP* map)
+{
+	return map->image.count;
+}
+
+
+bool PdbAddressMapGetSection(PDB_ADDRESS_MAP* map, uint16_t section, PDB_SECTION_HEADER* header)
+{
+	if ((section == 0) || (section > map->image.count))
+		return false;
+
+	*header = map->image.headers[section - 1];
+
+	return true;
+}
+
+
+uint32_t PdbAddressMapToPdbRva(PDB_ADDRESS_MAP* map, uint32_t imageRva)
+{
+	return map->omap ? OmapTranslate(&map->toSource, imageRva) : imageRva;
+}
+
+
+uint32_t PdbAddressMapToImageRva(PDB_ADDRESS_MAP* map, uint32_t pdbRva)
+{
+	return map->omap ? OmapTranslate(&map->fromSource, pdbRva) : pdbRva;
+}
+
+
+uint32_t PdbAddressMapSectionToRva(PDB_ADDRESS_MAP* map, uint16_t section, uint32_t offset)
+{
+	const PDB_SECTIONS* sections = map->symbols;
+
+	if ((section == 0) || (section > sections->count))
+		return 0;
+
+	return PdbAddressMapToImageRva(map, sections->headers[section - 1].virtualAddress + offset);
+}
+
+
+bool PdbAddressMapRvaToSection(PDB_ADDRESS_MAP* map, uint32_t rva, uint16_t* section, uint32_t* offset)
+{
+	const PDB_SECTIONS* sections = map->symbols;
+
+	rva = PdbAddressMapToPdbRva(map, rva);
+	if (rva == 0)
+		return false;
+
+	return SectionEntry(sections, PdbUpperBound(sections->starts, sections->count, rva), rva, section, offset);
+}
+
+
+uint32_t PdbAddressMapRvasToSections(PDB_ADDRESS_MAP* map, const uint32_t* rvas, uint32_t count,
+	uint16_t* sections, uint32_t* offsets)
+{
+	const PDB_SECTIONS* symbols = map->symbols;
+	uint32_t omapPos = 0;
+	uint32_t sectionPos = 0;
+	uint32_t mapped = 0;
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		uint32_t rva = rvas[i];
+		uint32_t entry;
+
+		// Tolerate unsorted input by starting over, rather than answering wrong
+		if ((i > 0) && (rva < rvas[i - 1]))
+		{
+			omapPos = 0;
+			sectionPos = 0;
+		}
+
+		// The input is sorted, so its position in OMAP only moves forward.
+		// OMAP reorders, so the section search starts over each time, but
+		// without OMAP it moves forward too.
+		if (map->omap)
+		{
+			omapPos = UpperBoundFrom(map->toSource.from, map->toSource.count, rva, omapPos);
+			rva = OmapEntry(&map->toSource, omapPos, rva);
+			entry = PdbUpperBound(symbols->starts, symbols->count, rva);
+		}
+		else
+		{
+			sectionPos = UpperBoundFrom(symbols->starts, symbols->count, rva, sectionPos);
+			entry = sectionPos;
+		}
+
+		if (rva && SectionEntry(symbols, entry, rva, &sections[i], &offsets[i]))
+		{
+			mapped++;
+		}
+		else
+		{
+			sections[i] = 0;
+			offsets[i] = 0;
+		}
+	}
+
+	return mapped;
+}
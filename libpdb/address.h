@@ -0,0 +1,86 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __ADDRESS_H__
+#define __ADDRESS_H__
+
+
+typedef struct PDB_ADDRESS_MAP PDB_ADDRESS_MAP;
+
+// An IMAGE_SECTION_HEADER, the parts of it that matter for addresses
+typedef struct PDB_SECTION_HEADER
+{
+	char name[9]; // Terminated
+	uint32_t virtualSize;
+	uint32_t virtualAddress;
+	uint32_t rawSize;
+	uint32_t characteristics;
+} PDB_SECTION_HEADER;
+
+// Symbols are recorded as section:offset in the layout the linker produced.
+// When a tool like BBT has reordered the image since, OMAP maps between the
+// image's RVAs and the pdb's, and the pdb's section:offset addresses are
+// relative to the original section headers.  The functions below take and
+// return image RVAs and go through OMAP when there is one, so callers don't
+// need to know whether the image was reordered.
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Load the section headers and OMAP tables.  NULL if the pdb has no
+	// section headers.
+	PDBAPI PDB_ADDRESS_MAP* PdbAddressMapOpen(PDB_DBI* dbi);
+	PDBAPI void PdbAddressMapClose(PDB_ADDRESS_MAP* map);
+
+	PDBAPI bool PdbAddressMapHasOmap(PDB_ADDRESS_MAP* map);
+
+	// The image's sections, numbered from 1
+	PDBAPI uint16_t PdbAddressMapGetSectionCount(PDB_ADDRESS_MAP* map);
+	PDBAPI bool PdbAddressMapGetSection(PDB_ADDRESS_MAP* map, uint16_t section, PDB_SECTION_HEADER* header);
+
+	// A pdb address (as in PDB_SYMBOL) to an image RVA.  0 if the address
+	// isn't in a section or its code was dropped.
+	PDBAPI uint32_t PdbAddressMapSectionToRva(PDB_ADDRESS_MAP* map, uint16_t section, uint32_t offset);
+
+	// An image RVA to a pdb address, for looking it up in the symbols
+	PDBAPI bool PdbAddressMapRvaToSection(PDB_ADDRESS_MAP* map, uint32_t rva, uint16_t* section, uint32_t* offset);
+
+	// The same for a whole array of RVAs, which must be sorted.  Each lookup
+	// starts where the previous one ended.  RVAs that don't map get section
+	// 0.  Returns how many did map.
+	PDBAPI uint32_t PdbAddressMapRvasToSections(PDB_ADDRESS_MAP* map, const uint32_t* rvas, uint32_t count,
+		uint16_t* sections, uint32_t* offsets);
+
+	// Just the OMAP step, RVAs are returned unchanged without OMAP.  0 if
+	// the address was dropped.
+	PDBAPI uint32_t PdbAddressMapToPdbRva(PDB_ADDRESS_MAP* map, uint32_t imageRva);
+	PDBAPI uint32_t PdbAddressMapToImageRva(PDB_ADDRESS_MAP* map, uint32_t pdbRva);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __ADDRESS_H__ */
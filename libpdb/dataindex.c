@@ -0,0 +1,579 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pdb.h"
+#include "dbi.h"
+#include "tpi.h"
+#include "layout.h"
+#include "dataindex.h"
+#include "internal.h"
+
+
+// DATASYM32 up to the name: type, offset, section
+#define PDB_DATA_SIZE 10
+
+
+typedef struct DATA_ENTRY
+{
+	uint32_t offset;
+	uint32_t size;
+	uint32_t typeId;
+	uint32_t name; // Into the index's names
+	uint16_t section;
+	uint16_t kind;
+} DATA_ENTRY;
+
+struct PDB_DATA_INDEX
+{
+	PDB_LAYOUT* layout;
+
+	DATA_ENTRY* entries; // Sorted by address
+	uint32_t count;
+	char* names;
+
+	uint32_t* offsets; // Each entry's offset, for searching
+	uint32_t* sectionFirst; // The first entry of each section, and one past the last
+	uint32_t sectionCount; // One more than the highest section number
+};
+
+// Where a path is being written
+typedef struct PATH_BUFFER
+{
+	char* buff;
+	size_t size;
+	size_t len;
+} PATH_BUFFER;
+
+
+static int CompareEntries(const void* a, const void* b)
+{
+	const DATA_ENTRY* left = (const DATA_ENTRY*)a;
+	const DATA_ENTRY* right = (const DATA_ENTRY*)b;
+
+	if (left->section != right->section)
+		return (left->section < right->section) ? -1 : 1;
+
+	if (left->offset != right->offset)
+		return (left->offset < right->offset) ? -1 : 1;
+
+	// Globals ahead of statics at the same address
+	return (int)right->kind - (int)left->kind;
+}
+
+
+// The variables being read
+typedef struct DATA_LOAD
+{
+	PDB_DATA_INDEX* index;
+	uint32_t capacity;
+	size_t namesCapacity;
+	size_t namesLen;
+} DATA_LOAD;
+
+
+static bool AddData(void* ctxt, const uint8_t* record, uint16_t recordLen)
+{
+	DATA_LOAD* load = (DATA_LOAD*)ctxt;
+	PDB_DATA_INDEX* index = load->index;
+	const char* name = (const char*)(record + 2 + PDB_DATA_SIZE);
+	size_t nameLen = strlen(name) + 1;
+	DATA_ENTRY* entry;
+
+	(void)recordLen;
+
+	if (index->count == load->capacity)
+	{
+		DATA_ENTRY* entries;
+
+		load->capacity = load->capacity ? (load->capacity * 2) : 1024;
+		entries = (DATA_ENTRY*)realloc(index->entries, sizeof(DATA_ENTRY) * load->capacity);
+		if (!entries)
+			return false;
+
+		index->entries = entries;
+	}
+
+	if (load->namesLen + nameLen > load->namesCapacity)
+	{
+		char* names;
+
+		load->namesCapacity = (load->namesCapacity + nameLen) * 2;
+		names = (char*)realloc(index->names, load->namesCapacity);
+		if (!names)
+			return false;
+
+		index->names = names;
+	}
+
+	entry = &index->entries[index->count++];
+	memcpy(&entry->typeId, record + 2, 4);
+	memcpy(&entry->offset, record + 6, 4);
+	memcpy(&entry->section, record + 10, 2);
+	memcpy(&entry->kind, record, 2);
+	entry->name = (uint32_t)load->namesLen;
+	entry->size = 0;
+
+	memcpy(index->names + load->namesLen, name, nameLen);
+	load->namesLen += nameLen;
+
+	return true;
+}
+
+
+// Keep the S_GDATA32 and S_LDATA32 records of the symbol record stream
+static bool LoadData(PDB_DATA_INDEX* index, PDB_STREAM* stream)
+{
+	static const uint16_t kinds[] = { SYMBOL_TYPE_GDATA32, SYMBOL_TYPE_LDATA32 };
+	DATA_LOAD load;
+
+	memset(&load, 0, sizeof(load));
+	load.index = index;
+
+	return PdbDbiScanSymbolRecords(stream, kinds, 2, 2 + PDB_DATA_SIZE, AddData, &load);
+}
+
+
+// Size every variable from its type, then sort and drop the duplicates
+// that the same variable gets from several modules
+static void SizeEntries(PDB_DATA_INDEX* index)
+{
+	uint32_t count = 0;
+	uint32_t i;
+
+	for (i = 0; i < index->count; i++)
+	{
+		const PDB_TYPE_NODE* node = PdbLayoutResolveShallow(index->layout, index->entries[i].typeId);
+		uint64_t size = node ? node->size : 0;
+
+		if (size > UINT32_MAX)
+			size = UINT32_MAX;
+
+		// Unsized variables still claim their first byte
+		index->entries[i].size = size ? (uint32_t)size : 1;
+	}
+
+	qsort(index->entries, index->count, sizeof(DATA_ENTRY), CompareEntries);
+
+	for (i = 0; i < index->count; i++)
+	{
+		if (count && (index->entries[count - 1].section == index->entries[i].section)
+			&& (index->entries[count - 1].offset == index->entries[i].offset))
+			continue;
+
+		index->entries[count++] = index->entries[i];
+	}
+
+	index->count = count;
+}
+
+
+static bool BuildSectionIndex(PDB_DATA_INDEX* index)
+{
+	uint32_t section = 0;
+	uint32_t i;
+
+	index->sectionCount = index->count ? (index->entries[index->count - 1].section + 1u) : 1;
+	index->sectionFirst = (uint32_t*)malloc(sizeof(uint32_t) * (index->sectionCount + 1));
+	index->offsets = (uint32_t*)PdbAlignedAlloc(sizeof(uint32_t) * (index->count + 1));
+
+	if (!index->sectionFirst || !index->offsets)
+		return false;
+
+	for (i = 0; i < index->count; i++)
+	{
+		index->offsets[i] = index->entries[i].offset;
+
+		while (section <= index->entries[i].section)
+			index->sectionFirst[section++] = i;
+	}
+
+	while (section <= index->sectionCount)
+		index->sectionFirst[section++] = index->count;
+
+	return true;
+}
+
+
+PDB_DATA_INDEX* PdbDataIndexBuild(PDB_DBI* dbi, PDB_TYPES* types)
+{
+	PDB_FILE* pdb = PdbDbiGetPdb(dbi);
+	PDB_DATA_INDEX* index;
+	PDB_STREAM* stream;
+	uint64_t start = PdbTimeNow();
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_BEGIN, "PdbDataIndexBuild", 0, 0);
+
+	index = (PDB_DATA_INDEX*)calloc(1, sizeof(PDB_DATA_INDEX));
+	if (!index)
+		goto DONE;
+
+	index->layout = PdbLayoutCreate(types);
+	if (!index->layout)
+		goto FAIL;
+
+	stream = PdbStreamOpen(pdb, PdbDbiGetSymbolRecordStream(dbi));
+	if (stream)
+	{
+		bool loaded;
+
+		// Read once, front to back
+		PdbStreamSetAccess(stream, PDB_ACCESS_ONCE);
+		loaded = LoadData(index, stream);
+		PdbStreamClose(stream);
+
+		if (!loaded)
+			goto FAIL;
+	}
+
+	SizeEntries(index);
+
+	if (!BuildSectionIndex(index))
+		goto FAIL;
+
+	goto DONE;
+
+FAIL:
+	PdbDataIndexClose(index);
+	index = NULL;
+
+DONE:
+	PdbStatsAddTime(pdb, PDB_SUBSYSTEM_DBI, start);
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_END, "PdbDataIndexBuild", 0, 0);
+
+	return index;
+}
+
+
+void PdbDataIndexClose(PDB_DATA_INDEX* index)
+{
+	if (index->layout)
+		PdbLayoutDestroy(index->layout);
+
+	free(index->entries);
+	free(index->names);
+	PdbAlignedFree(index->offsets);
+	free(index->sectionFirst);
+	free(index);
+}
+
+
+uint32_t PdbDataIndexGetCount(PDB_DATA_INDEX* index)
+{
+	return index->count;
+}
+
+
+static void GetSymbol(PDB_DATA_INDEX* index, const DATA_ENTRY* entry, PDB_DATA_SYMBOL* symbol)
+{
+	symbol->name = index->names + entry->name;
+	symbol->typeId = entry->typeId;
+	symbol->offset = entry->offset;
+	symbol->size = entry->size;
+	symbol->section = entry->section;
+	symbol->kind = (PDB_SYMBOL_TYPES)entry->kind;
+}
+
+
+bool PdbDataIndexGet(PDB_DATA_INDEX* index, uint32_t i, PDB_DATA_SYMBOL* symbol)
+{
+	if (i >= index->count)
+		return false;
+
+	GetSymbol(index, &index->entries[i], symbol);
+
+	return true;
+}
+
+
+// The entry in [first, end) containing the address, or NULL
+static const DATA_ENTRY* FindInRange(PDB_DATA_INDEX* index, uint32_t first, uint32_t end, uint32_t offset)
+{
+	const DATA_ENTRY* entry;
+	uint32_t found = PdbUpperBound(index->offsets + first, end - first, offset);
+
+	if (found == 0)
+		return NULL;
+
+	entry = &index->entries[first + found - 1];
+	if (offset - entry->offset >= entry->size)
+		return NULL;
+
+	return entry;
+}
+
+
+static const DATA_ENTRY* FindEntry(PDB_DATA_INDEX* index, uint16_t section, uint32_t offset)
+{
+	if (section >= index->sectionCount)
+		return NULL;
+
+	return FindInRange(index, index->sectionFirst[section], index->sectionFirst[section + 1], offset);
+}
+
+
+bool PdbDataIndexFind(PDB_DATA_INDEX* index, uint16_t section, uint32_t offset, PDB_DATA_SYMBOL* symbol)
+{
+	const DATA_ENTRY* entry = FindEntry(index, section, offset);
+
+	if (!entry)
+		return false;
+
+	GetSymbol(index, entry, symbol);
+
+	return true;
+}
+
+
+static void AppendPath(PATH_BUFFER* path, const char* text)
+{
+	size_t len = strlen(text);
+
+	if (path->len + 1 >= path->size)
+		return;
+
+	if (path->len + len + 1 > path->size)
+		len = path->size - path->len - 1;
+
+	memcpy(path->buff + path->len, text, len);
+	path->len += len;
+	path->buff[path->len] = 0;
+}
+
+
+// The member or base of a udt that holds the offset.  Union members overlap,
+// and the first one that fits wins.
+static const PDB_TYPE_FIELD* FieldAt(PDB_LAYOUT* layout, const PDB_TYPE_NODE* node, uint64_t offset)
+{
+	uint32_t i;
+
+	for (i = 0; i < node->fieldCount; i++)
+	{
+		const PDB_TYPE_FIELD* field = &node->fields[i];
+		const PDB_TYPE_NODE* type;
+
+		// Virtual bases and the vfptr aren't at a fixed place in a variable
+		// of their own
+		if ((field->leaf != LEAF_TYPE_MEMBER) && (field->leaf != LEAF_TYPE_BCLASS))
+			continue;
+
+		if (offset < field->offset)
+			continue;
+
+		type = PdbLayoutGetFieldType(layout, field);
+		if (type && (offset - field->offset < type->size))
+			return field;
+	}
+
+	return NULL;
+}
+
+
+// Look through modifiers to the type underneath
+static const PDB_TYPE_NODE* StripModifiers(const PDB_TYPE_NODE* node)
+{
+	while (node && (node->kind == PDB_NODE_MODIFIER))
+		node = node->element;
+
+	return node;
+}
+
+
+// Step down from the variable's type into the innermost member or array
+// element that holds the offset
+static void WalkPath(PDB_LAYOUT* layout, const PDB_TYPE_NODE* node, uint64_t offset, PATH_BUFFER* path,
+	PDB_DATA_LOCATION* location)
+{
+	char text[32];
+
+	while ((node = StripModifiers(node)) != NULL)
+	{
+		location->typeId = node->typeId;
+
+		if (node->kind == PDB_NODE_ARRAY)
+		{
+			const PDB_TYPE_NODE* element = node->element;
+			uint64_t i;
+
+			if (!element || !element->size)
+				break;
+
+			i = offset / element->size;
+			if (node->count && (i >= node->count))
+				break;
+
+			sprintf(text, "[%llu]", (unsigned long long)i);
+			AppendPath(path, text);
+
+			offset -= i * element->size;
+			node = element;
+		}
+		else if ((node->kind == PDB_NODE_STRUCT) || (node->kind == PDB_NODE_UNION))
+		{
+			const PDB_TYPE_FIELD* field = FieldAt(layout, node, offset);
+
+			if (!field)
+				break;
+
+			// Base class members read as the derived class's own
+			if (field->leaf == LEAF_TYPE_MEMBER)
+			{
+				AppendPath(path, ".");
+				AppendPath(path, field->name ? field->name : "");
+			}
+
+			offset -= field->offset;
+			node = field->type;
+		}
+		else
+		{
+			// Scalars, pointers and bitfields (which share their storage
+			// unit, so the first one stands for all of them)
+			break;
+		}
+	}
+
+	location->remainder = (uint32_t)offset;
+	if (offset)
+	{
+		sprintf(text, "+0x%llx", (unsigned long long)offset);
+		AppendPath(path, text);
+	}
+}
+
+
+static void Describe(PDB_DATA_INDEX* index, const DATA_ENTRY* entry, const PDB_TYPE_NODE* node,
+	uint32_t offset, PATH_BUFFER* path, PDB_DATA_LOCATION* location)
+{
+	GetSymbol(index, entry, &location->variable);
+	location->typeId = entry->typeId;
+	location->path = path->buff;
+
+	path->len = 0;
+	if (path->size)
+		path->buff[0] = 0;
+
+	AppendPath(path, index->names + entry->name);
+	WalkPath(index->layout, node, offset - entry->offset, path, location);
+}
+
+
+bool PdbDataIndexDescribe(PDB_DATA_INDEX* index, uint16_t section, uint32_t offset,
+	char* path, size_t pathSize, PDB_DATA_LOCATION* location)
+{
+	const DATA_ENTRY* entry = FindEntry(index, section, offset);
+	PATH_BUFFER buffer;
+
+	if (!entry)
+		return false;
+
+	buffer.buff = path;
+	buffer.size = pathSize;
+	buffer.len = 0;
+
+	Describe(index, entry, PdbLayoutResolveShallow(index->layout, entry->typeId), offset, &buffer, location);
+
+	return true;
+}
+
+
+// Search forward from a known entry, doubling the step until the address is
+// passed, so nearby addresses cost a few compares rather than a full search
+static const DATA_ENTRY* FindForward(PDB_DATA_INDEX* index, uint16_t section, uint32_t offset, uint32_t from)
+{
+	uint32_t end = index->sectionFirst[section + 1];
+	uint32_t step = 1;
+	uint32_t limit = from + 1;
+
+	while ((limit < end) && (index->offsets[limit] <= offset))
+	{
+		from = limit;
+		limit = ((end - limit) > step) ? (limit + step) : end;
+		step *= 2;
+	}
+
+	return FindInRange(index, from, (limit < end) ? limit : end, offset);
+}
+
+
+uint32_t PdbDataIndexDescribeBatch(PDB_DATA_INDEX* index, const uint16_t* sections,
+	const uint32_t* offsets, uint32_t count, PdbDataLocationFunction locationFn, void* ctxt)
+{
+	const DATA_ENTRY* last = NULL;
+	const PDB_TYPE_NODE* node = NULL;
+	PATH_BUFFER path;
+	uint32_t found = 0;
+	uint32_t i;
+
+	path.size = 1024;
+	path.len = 0;
+	path.buff = (char*)malloc(path.size);
+	if (!path.buff)
+		return 0;
+
+	for (i = 0; i < count; i++)
+	{
+		const DATA_ENTRY* entry;
+		PDB_DATA_LOCATION location;
+
+		if (sections[i] >= index->sectionCount)
+			continue;
+
+		// Sorted addresses only ever move forward from the last variable
+		if (last && (last->section == sections[i]) && (offsets[i] >= last->offset))
+		{
+			if (offsets[i] - last->offset < last->size)
+				entry = last;
+			else
+				entry = FindForward(index, sections[i], offsets[i], (uint32_t)(last - index->entries));
+		}
+		else
+		{
+			entry = FindEntry(index, sections[i], offsets[i]);
+		}
+
+		if (!entry)
+			continue;
+
+		if (entry != last)
+		{
+			node = PdbLayoutResolveShallow(index->layout, entry->typeId);
+			last = entry;
+		}
+
+		Describe(index, entry, node, offsets[i], &path, &location);
+		found++;
+
+		if (!locationFn(ctxt, i, &location))
+			break;
+	}
+
+	free(path.buff);
+
+	return found;
+}
@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __DATAINDEX_H__
+#define __DATAINDEX_H__
+
+
+typedef struct PDB_DATA_INDEX PDB_DATA_INDEX;
+
+// A global or file static variable from an S_GDATA32 or S_LDATA32 record
+typedef struct PDB_DATA_SYMBOL
+{
+	const char* name; // Owned by the index
+	uint32_t typeId;
+	uint32_t offset; // Offset within the section
+	uint32_t size; // Bytes, from the type.  At least one.
+	uint16_t section; // One based
+	PDB_SYMBOL_TYPES kind;
+} PDB_DATA_SYMBOL;
+
+// What an address inside a variable refers to
+typedef struct PDB_DATA_LOCATION
+{
+	PDB_DATA_SYMBOL variable;
+	const char* path; // Such as "g_Table[3].Entry.Flink"
+	uint32_t typeId; // Type of the innermost member or element the path reaches
+	uint32_t remainder; // Bytes past the start of it
+} PDB_DATA_LOCATION;
+
+// Called for each address of a batch that falls inside a variable.  index
+// is the address's position in the batch.  The location's path is only
+// valid for the duration of the call.  Return false to stop the batch.
+typedef bool (*PdbDataLocationFunction)(void* ctxt, uint32_t index, const PDB_DATA_LOCATION* location);
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Read the data symbols from the symbol record stream and size each one
+	// from its type, giving a sorted set of address ranges.  types is used
+	// to describe addresses later and must stay open until the index is
+	// closed.
+	PDBAPI PDB_DATA_INDEX* PdbDataIndexBuild(PDB_DBI* dbi, PDB_TYPES* types);
+	PDBAPI void PdbDataIndexClose(PDB_DATA_INDEX* index);
+
+	PDBAPI uint32_t PdbDataIndexGetCount(PDB_DATA_INDEX* index);
+	PDBAPI bool PdbDataIndexGet(PDB_DATA_INDEX* index, uint32_t i, PDB_DATA_SYMBOL* symbol);
+
+	// The variable containing the address.  This doesn't touch the types, so
+	// it can be called from several threads at once.
+	PDBAPI bool PdbDataIndexFind(PDB_DATA_INDEX* index, uint16_t section, uint32_t offset, PDB_DATA_SYMBOL* symbol);
+
+	// Walk the variable's type down to the member or array element holding
+	// the address, writing its path to path (truncated to fit).  Types are
+	// decoded on demand and kept, so only one thread may describe at a time.
+	PDBAPI bool PdbDataIndexDescribe(PDB_DATA_INDEX* index, uint16_t section, uint32_t offset,
+		char* path, size_t pathSize, PDB_DATA_LOCATION* location);
+
+	// Describe many addresses, sorted by section then offset.  Each address
+	// is found by searching forward from the previous one, and consecutive
+	// addresses in the same variable share its decoded type.  Unsorted
+	// addresses are still described, just more slowly.  Returns how many
+	// were inside a variable.
+	PDBAPI uint32_t PdbDataIndexDescribeBatch(PDB_DATA_INDEX* index, const uint16_t* sections,
+		const uint32_t* offsets, uint32_t count, PdbDataLocationFunction locationFn, void* ctxt);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __DATAINDEX_H__ */
@@ -0,0 +1,448 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "dbi.h"
+#include "internal.h"
+
+
+#define PDB_DBI_SIGNATURE_V2            0xffffffff
+
+#define PDB_DBI_VERSION_VC41            930803
+#define PDB_DBI_VERSION_V50             19960307
+#define PDB_DBI_VERSION_V60             19970606
+#define PDB_DBI_VERSION_V70             19990903
+#define PDB_DBI_VERSION_V110            20091201
+
+
+struct PDB_DBI
+{
+	PDB_FILE* pdb;
+	PDB_STREAM* stream;
+	uint32_t version;
+	uint32_t age;
+	uint16_t globalsStream; // Global symbol hash
+	uint16_t buildNumber;
+	uint16_t publicsStream; // Public symbol hash
+	uint16_t dllVersion;
+	uint16_t symRecordStream; // The records the two hashes refer to
+	uint16_t dllBuild;
+
+	// Sizes of the substreams that follow the header, in this order
+	uint32_t modInfoSize;
+	uint32_t secContribSize;
+	uint32_t secMapSize;
+	uint32_t fileInfoSize;
+	uint32_t typeServerMapSize;
+	uint32_t mfcTypeServer;
+	uint32_t dbgHeaderSize;
+	uint32_t ecInfoSize;
+
+	uint16_t flags;
+	uint16_t machine; // IMAGE_FILE_MACHINE_*
+
+	uint16_t debugStreams[PDB_DEBUG_STREAM_COUNT];
+
+	// Loaded on demand, the names point into moduleInfo
+	PDB_MODULE* modules;
+	uint32_t moduleCount;
+	uint8_t* moduleInfo;
+	bool modulesLoaded;
+};
+
+
+// Size of a module info record up to its names
+#define PDB_MODULE_INFO_SIZE 64
+
+
+static bool PdbDbiReadHeader(PDB_DBI* dbi)
+{
+	uint32_t signature;
+	PDB_CURSOR cursor;
+
+	PdbCursorOpen(&cursor, dbi->stream, 0);
+
+	if (!PdbCursorReadU32(&cursor, &signature))
+		return false;
+
+	// Only the "new" (VC4.1 and later) header is supported
+	if (signature != PDB_DBI_SIGNATURE_V2)
+		return false;
+
+	if (!PdbCursorReadU32(&cursor, &dbi->version))
+		return false;
+
+	if ((dbi->version != PDB_DBI_VERSION_VC41)
+		&& (dbi->version != PDB_DBI_VERSION_V50)
+		&& (dbi->version != PDB_DBI_VERSION_V60)
+		&& (dbi->version != PDB_DBI_VERSION_V70)
+		&& (dbi->version != PDB_DBI_VERSION_V110))
+		return false;
+
+	if (!PdbCursorReadU32(&cursor, &dbi->age))
+		return false;
+
+	if (!PdbCursorReadU16(&cursor, &dbi->globalsStream))
+		return false;
+	if (!PdbCursorReadU16(&cursor, &dbi->buildNumber))
+		return false;
+	if (!PdbCursorReadU16(&cursor, &dbi->publicsStream))
+		return false;
+	if (!PdbCursorReadU16(&cursor, &dbi->dllVersion))
+		return false;
+	if (!PdbCursorReadU16(&cursor, &dbi->symRecordStream))
+		return false;
+	if (!PdbCursorReadU16(&cursor, &dbi->dllBuild))
+		return false;
+
+	// The substream sizes
+	if (!PdbCursorReadU32(&cursor, &dbi->modInfoSize))
+		return false;
+	if (!PdbCursorReadU32(&cursor, &dbi->secContribSize))
+		return false;
+	if (!PdbCursorReadU32(&cursor, &dbi->secMapSize))
+		return false;
+	if (!PdbCursorReadU32(&cursor, &dbi->fileInfoSize))
+		return false;
+	if (!PdbCursorReadU32(&cursor, &dbi->typeServerMapSize))
+		return false;
+	if (!PdbCursorReadU32(&cursor, &dbi->mfcTypeServer))
+		return false;
+	if (!PdbCursorReadU32(&cursor, &dbi->dbgHeaderSize))
+		return false;
+	if (!PdbCursorReadU32(&cursor, &dbi->ecInfoSize))
+		return false;
+
+	if (!PdbCursorReadU16(&cursor, &dbi->flags))
+		return false;
+	if (!PdbCursorReadU16(&cursor, &dbi->machine))
+		return false;
+
+	// Pad to 64 bytes
+	if (!PdbCursorSkip(&cursor, 4))
+		return false;
+
+	PdbCursorClose(&cursor);
+
+	return true;
+}
+
+
+// The debug header is the last substream.  Older pdbs list fewer streams,
+// and the ones they leave out (or a header that can't be read) are treated
+// as missing rather than failing the whole stream.
+static void PdbDbiReadDebugHeader(PDB_DBI* dbi)
+{
+	uint64_t offset = 64;
+	uint32_t size = dbi->dbgHeaderSize;
+	uint32_t i;
+
+	for (i = 0; i < PDB_DEBUG_STREAM_COUNT; i++)
+		dbi->debugStreams[i] = PDB_STREAM_NONE;
+
+	offset += (uint64_t)dbi->modInfoSize + dbi->secContribSize + dbi->secMapSize + dbi->fileInfoSize
+		+ dbi->typeServerMapSize + dbi->ecInfoSize;
+
+	if (size > sizeof(dbi->debugStreams))
+		size = sizeof(dbi->debugStreams);
+
+	if ((size == 0) || (offset + size > PdbStreamGetSize(dbi->stream)))
+		return;
+
+	if (!PdbStreamSeek(dbi->stream, offset) || !PdbStreamRead(dbi->stream, (uint8_t*)dbi->debugStreams, size))
+	{
+		for (i = 0; i < PDB_DEBUG_STREAM_COUNT; i++)
+			dbi->debugStreams[i] = PDB_STREAM_NONE;
+	}
+}
+
+
+PDB_DBI* PdbDbiOpen(PDB_FILE* pdb)
+{
+	PDB_DBI* dbi;
+	PDB_STREAM* stream;
+	uint64_t start = PdbTimeNow();
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_BEGIN, "PdbDbiOpen", 0, 0);
+
+	stream = PdbStreamOpen(pdb, PDB_STREAM_DEBUG_INFO);
+
+	if (!stream)
+	{
+		dbi = NULL;
+		goto DONE;
+	}
+
+	dbi = (PDB_DBI*)malloc(sizeof(PDB_DBI));
+	memset(dbi, 0, sizeof(PDB_DBI));
+	dbi->pdb = pdb;
+	dbi->stream = stream;
+
+	if (!PdbDbiReadHeader(dbi))
+	{
+		PdbStreamClose(stream);
+		free(dbi);
+		dbi = NULL;
+		goto DONE;
+	}
+
+	PdbDbiReadDebugHeader(dbi);
+
+DONE:
+	PdbStatsAddTime(pdb, PDB_SUBSYSTEM_DBI, start);
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_END, "PdbDbiOpen", 0, 0);
+
+	return dbi;
+}
+
+
+void PdbDbiClose(PDB_DBI* dbi)
+{
+	free(dbi->modules);
+	free(dbi->moduleInfo);
+	PdbStreamClose(dbi->stream);
+	free(dbi);
+}
+
+
+PDB_FILE* PdbDbiGetPdb(PDB_DBI* dbi)
+{
+	return dbi->pdb;
+}
+
+
+uint32_t PdbDbiGetAge(PDB_DBI* dbi)
+{
+	return dbi->age;
+}
+
+
+uint16_t PdbDbiGetMachine(PDB_DBI* dbi)
+{
+	return dbi->machine;
+}
+
+
+uint16_t PdbDbiGetGlobalsStream(PDB_DBI* dbi)
+{
+	return dbi->globalsStream;
+}
+
+
+uint16_t PdbDbiGetPublicsStream(PDB_DBI* dbi)
+{
+	return dbi->publicsStream;
+}
+
+
+uint16_t PdbDbiGetSymbolRecordStream(PDB_DBI* dbi)
+{
+	return dbi->symRecordStream;
+}
+
+
+uint16_t PdbDbiGetDebugStream(PDB_DBI* dbi, PDB_DEBUG_STREAM which)
+{
+	if ((uint32_t)which >= PDB_DEBUG_STREAM_COUNT)
+		return PDB_STREAM_NONE;
+
+	return dbi->debugStreams[which];
+}
+
+
+// The module info substream comes straight after the header.  Each record
+// is fixed fields, the module and object names, then padding to 4 bytes.
+static bool PdbDbiLoadModules(PDB_DBI* dbi)
+{
+	uint32_t size = dbi->modInfoSize;
+	uint32_t capacity = 0;
+	uint32_t offset = 0;
+
+	if (dbi->modulesLoaded)
+		return (dbi->modules != NULL);
+
+	dbi->modulesLoaded = true;
+
+	if ((uint64_t)64 + size > PdbStreamGetSize(dbi->stream))
+		return false;
+
+	dbi->moduleInfo = (uint8_t*)malloc(size ? size : 1);
+	if (!dbi->moduleInfo)
+		return false;
+
+	if (!PdbStreamSeek(dbi->stream, 64) || !PdbStreamRead(dbi->stream, dbi->moduleInfo, size))
+		goto FAIL;
+
+	while (size - offset >= PDB_MODULE_INFO_SIZE)
+	{
+		const uint8_t* raw = dbi->moduleInfo + offset;
+		const uint8_t* name = raw + PDB_MODULE_INFO_SIZE;
+		const uint8_t* end = dbi->moduleInfo + size;
+		const uint8_t* objectName;
+		PDB_MODULE* module;
+
+		objectName = (const uint8_t*)memchr(name, 0, end - name);
+		if (!objectName)
+			goto FAIL;
+
+		objectName++;
+		if (!memchr(objectName, 0, end - objectName))
+			goto FAIL;
+
+		if (dbi->moduleCount == capacity)
+		{
+			PDB_MODULE* modules;
+
+			capacity = capacity ? (capacity * 2) : 256;
+			modules = (PDB_MODULE*)realloc(dbi->modules, sizeof(PDB_MODULE) * capacity);
+			if (!modules)
+				goto FAIL;
+
+			dbi->modules = modules;
+		}
+
+		module = &dbi->modules[dbi->moduleCount++];
+		module->name = (const char*)name;
+		module->objectName = (const char*)objectName;
+		memcpy(&module->stream, raw + 34, 2);
+		memcpy(&module->symbolsSize, raw + 36, 4);
+		memcpy(&module->linesSize, raw + 40, 4);
+		memcpy(&module->c13LinesSize, raw + 44, 4);
+		memcpy(&module->sourceFileCount, raw + 48, 2);
+
+		offset = (uint32_t)((objectName + strlen((const char*)objectName) + 1) - dbi->moduleInfo);
+		offset = (offset + 3) & ~3;
+		if (offset > size)
+			break;
+	}
+
+	// A pdb without modules still counts as loaded
+	if (!dbi->modules)
+		dbi->modules = (PDB_MODULE*)malloc(sizeof(PDB_MODULE));
+
+	return (dbi->modules != NULL);
+
+FAIL:
+	free(dbi->modules);
+	free(dbi->moduleInfo);
+	dbi->modules = NULL;
+	dbi->moduleInfo = NULL;
+	dbi->moduleCount = 0;
+
+	return false;
+}
+
+
+uint32_t PdbDbiGetModuleCount(PDB_DBI* dbi)
+{
+	if (!PdbDbiLoadModules(dbi))
+		return 0;
+
+	return dbi->moduleCount;
+}
+
+
+bool PdbDbiGetModule(PDB_DBI* dbi, uint32_t index, PDB_MODULE* module)
+{
+	if (!PdbDbiLoadModules(dbi) || (index >= dbi->moduleCount))
+		return false;
+
+	*module = dbi->modules[index];
+
+	return true;
+}
+
+
+static bool PdbDbiIsKind(const uint16_t* kinds, uint32_t kindCount, uint16_t kind)
+{
+	uint32_t i;
+
+	for (i = 0; i < kindCount; i++)
+	{
+		if (kinds[i] == kind)
+			return true;
+	}
+
+	return false;
+}
+
+
+bool PdbDbiScanSymbolRecords(PDB_STREAM* stream, const uint16_t* kinds, uint32_t kindCount, uint16_t minLen,
+	PdbSymbolRecordFunction recordFn, void* ctxt)
+{
+	uint8_t* record = (uint8_t*)malloc(0x10001);
+	uint32_t size = PdbStreamGetSize(stream);
+	uint32_t offset = 0;
+	bool result = false;
+	PDB_CURSOR cursor;
+
+	if (!record)
+		return false;
+
+	PdbCursorOpen(&cursor, stream, 0);
+
+	while (offset + 4 <= size)
+	{
+		uint16_t recordLen;
+		uint16_t kind;
+
+		if (!PdbCursorReadU16(&cursor, &recordLen))
+			break;
+
+		if ((recordLen < 2) || (offset + 2 + recordLen > size))
+			break;
+
+		if (!PdbCursorReadU16(&cursor, &kind))
+			break;
+
+		// Only the records that are kept get copied out of the stream
+		if (!PdbDbiIsKind(kinds, kindCount, kind) || (recordLen < minLen))
+		{
+			if (!PdbCursorSkip(&cursor, recordLen - 2))
+				break;
+
+			offset += 2 + recordLen;
+			continue;
+		}
+
+		if (!PdbCursorRead(&cursor, record + 2, recordLen - 2))
+			break;
+
+		offset += 2 + recordLen;
+		*(uint16_t*)record = kind;
+		record[recordLen] = 0;
+
+		if (!recordFn(ctxt, record, recordLen))
+			goto DONE;
+	}
+
+	result = (offset == size);
+
+DONE:
+	free(record);
+	return result;
+}
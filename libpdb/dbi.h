@@ -0,0 +1,116 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __DBI_H__
+#define __DBI_H__
+
+
+typedef struct PDB_DBI PDB_DBI;
+typedef enum PDB_SYMBOL_TYPES PDB_SYMBOL_TYPES;
+typedef enum PDB_DEBUG_STREAM PDB_DEBUG_STREAM;
+
+// Symbol record kinds (S_*) found in the symbol record and module streams
+enum PDB_SYMBOL_TYPES
+{
+	SYMBOL_TYPE_END = 0x0006,
+	SYMBOL_TYPE_SKIP = 0x0007,
+	SYMBOL_TYPE_OBJNAME = 0x1101,
+	SYMBOL_TYPE_THUNK32 = 0x1102,
+	SYMBOL_TYPE_BLOCK32 = 0x1103,
+	SYMBOL_TYPE_LABEL32 = 0x1105,
+	SYMBOL_TYPE_LDATA32 = 0x110C,
+	SYMBOL_TYPE_GDATA32 = 0x110D,
+	SYMBOL_TYPE_PUB32 = 0x110E,
+	SYMBOL_TYPE_LPROC32 = 0x110F,
+	SYMBOL_TYPE_GPROC32 = 0x1110,
+	SYMBOL_TYPE_LTHREAD32 = 0x1112,
+	SYMBOL_TYPE_GTHREAD32 = 0x1113,
+	SYMBOL_TYPE_PROCREF = 0x1125,
+	SYMBOL_TYPE_DATAREF = 0x1126,
+	SYMBOL_TYPE_LPROCREF = 0x1127,
+	SYMBOL_TYPE_LPROC32_ID = 0x1146,
+	SYMBOL_TYPE_GPROC32_ID = 0x1147,
+	SYMBOL_TYPE_INLINESITE = 0x114D,
+	SYMBOL_TYPE_INLINESITE_END = 0x114E,
+	SYMBOL_TYPE_PROC_ID_END = 0x114F,
+	SYMBOL_TYPE_INLINESITE2 = 0x115D
+};
+
+// A module (object file) from the module info substream
+typedef struct PDB_MODULE
+{
+	const char* name; // Owned by the dbi
+	const char* objectName; // The object or library it was linked from
+	uint16_t stream; // Its symbols and lines, PDB_STREAM_NONE if it has neither
+	uint32_t symbolsSize; // Bytes of symbols at the start of the stream, including the 4 byte signature
+	uint32_t linesSize; // C11 lines after the symbols
+	uint32_t c13LinesSize; // C13 lines after those
+	uint16_t sourceFileCount;
+} PDB_MODULE;
+
+// The streams listed in the optional debug header at the end of the DBI
+// stream, in the order they are listed
+enum PDB_DEBUG_STREAM
+{
+	PDB_DEBUG_FPO = 0,
+	PDB_DEBUG_EXCEPTION = 1,
+	PDB_DEBUG_FIXUP = 2,
+	PDB_DEBUG_OMAP_TO_SRC = 3, // Image addresses to the addresses the pdb uses
+	PDB_DEBUG_OMAP_FROM_SRC = 4, // And back
+	PDB_DEBUG_SECTION_HEADERS = 5, // The image's IMAGE_SECTION_HEADERs
+	PDB_DEBUG_TOKEN_RID_MAP = 6,
+	PDB_DEBUG_XDATA = 7,
+	PDB_DEBUG_PDATA = 8,
+	PDB_DEBUG_NEW_FPO = 9,
+	PDB_DEBUG_SECTION_HEADERS_ORIG = 10, // The section headers before OMAP reordering
+	PDB_DEBUG_STREAM_COUNT
+};
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	PDBAPI PDB_DBI* PdbDbiOpen(PDB_FILE* pdb);
+	PDBAPI void PdbDbiClose(PDB_DBI* dbi);
+
+	PDBAPI PDB_FILE* PdbDbiGetPdb(PDB_DBI* dbi);
+	PDBAPI uint32_t PdbDbiGetAge(PDB_DBI* dbi);
+	PDBAPI uint16_t PdbDbiGetMachine(PDB_DBI* dbi);
+	PDBAPI uint16_t PdbDbiGetGlobalsStream(PDB_DBI* dbi);
+	PDBAPI uint16_t PdbDbiGetPublicsStream(PDB_DBI* dbi);
+	PDBAPI uint16_t PdbDbiGetSymbolRecordStream(PDB_DBI* dbi);
+
+	// PDB_STREAM_NONE if the pdb doesn't have the stream
+	PDBAPI uint16_t PdbDbiGetDebugStream(PDB_DBI* dbi, PDB_DEBUG_STREAM which);
+
+	// The module info substream is read the first time it's asked for
+	PDBAPI uint32_t PdbDbiGetModuleCount(PDB_DBI* dbi);
+	PDBAPI bool PdbDbiGetModule(PDB_DBI* dbi, uint32_t index, PDB_MODULE* module);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __DBI_H__ */
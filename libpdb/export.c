@@ -0,0 +1,949 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "tpi.h"
+#include "export.h"
+
+
+// Output is gathered here and handed to stdio in large writes
+#define PDB_EXPORT_BUFFER_SIZE (4 * 1024 * 1024)
+
+// Block limits for the binary format
+#define PDB_EXPORT_BLOCK_ROWS 65536
+#define PDB_EXPORT_BLOCK_MEMBERS (128 * 1024)
+#define PDB_EXPORT_BLOCK_REFS (128 * 1024)
+#define PDB_EXPORT_BLOCK_STRINGS (4 * 1024 * 1024)
+
+// The most a single record can hold.  Field list entries are at least 8
+// bytes and references 4, and a record is at most 0xffff bytes.
+#define PDB_EXPORT_RECORD_MEMBERS (0x10000 / 8)
+#define PDB_EXPORT_RECORD_REFS (0x10000 / 4)
+#define PDB_EXPORT_RECORD_STRINGS (0x10000 + 64)
+
+#define PDB_EXPORT_NO_NAME 0xffffffff
+
+
+typedef struct EXPORT_ROW
+{
+	uint32_t typeId;
+	uint16_t leaf;
+	bool hasSize;
+	uint64_t size;
+	uint32_t attr;
+	uint32_t count;
+	const char* name;
+	bool pointer; // Built in rows only, a pointer to the named type
+	uint32_t refCount;
+	uint32_t refs[PDB_EXPORT_RECORD_REFS];
+	uint8_t roles[PDB_EXPORT_RECORD_REFS];
+	uint32_t memberCount;
+	PDB_TYPE_MEMBER members[PDB_EXPORT_RECORD_MEMBERS];
+} EXPORT_ROW;
+
+
+// One block of the binary format, column by column
+typedef struct EXPORT_BLOCK
+{
+	uint32_t rows;
+	uint32_t members;
+	uint32_t refs;
+	uint32_t stringBytes;
+
+	uint64_t* rowSize;
+	uint32_t* rowTypeId;
+	uint32_t* rowName;
+	uint32_t* rowAttr;
+	uint32_t* rowCount;
+	uint32_t* rowRefEnd;
+	uint32_t* rowMemberEnd;
+	uint16_t* rowLeaf;
+
+	uint64_t* memberOffset;
+	uint64_t* memberVbindex;
+	uint32_t* memberType;
+	uint32_t* memberVbptr;
+	uint32_t* memberName;
+	uint16_t* memberLeaf;
+	uint16_t* memberAttr;
+
+	uint32_t* refTypeId;
+	uint8_t* refRole;
+
+	char* strings;
+} EXPORT_BLOCK;
+
+
+typedef struct EXPORT_STATE
+{
+	PDB_EXPORT_FORMAT format;
+	FILE* out;
+	uint8_t* buff;
+	size_t used;
+	bool failed;
+	uint8_t simpleSeen[PDB_TYPE_SIMPLE_MAX / 8]; // Built in types referenced so far
+	EXPORT_ROW row;
+	EXPORT_BLOCK block;
+} EXPORT_STATE;
+
+
+static const char* const g_refNames[] =
+{
+	"type", "field", "derived", "vshape", "utype", "return", "class", "this",
+	"arglist", "args", "element", "index", "containing", "bases", "methods"
+};
+
+
+static const char g_hexDigits[] = "0123456789abcdef";
+
+
+static void ExportFlush(EXPORT_STATE* state)
+{
+	if (state->used && (fwrite(state->buff, 1, state->used, state->out) != state->used))
+		state->failed = true;
+
+	state->used = 0;
+}
+
+
+// Make room for bytes more output
+static uint8_t* ExportReserve(EXPORT_STATE* state, size_t bytes)
+{
+	if (state->used + bytes > PDB_EXPORT_BUFFER_SIZE)
+		ExportFlush(state);
+
+	return state->buff + state->used;
+}
+
+
+static void ExportWrite(EXPORT_STATE* state, const void* data, size_t bytes)
+{
+	// Big columns go straight out rather than through the buffer
+	if (bytes >= PDB_EXPORT_BUFFER_SIZE / 2)
+	{
+		ExportFlush(state);
+		if (fwrite(data, 1, bytes, state->out) != bytes)
+			state->failed = true;
+		return;
+	}
+
+	memcpy(ExportReserve(state, bytes), data, bytes);
+	state->used += bytes;
+}
+
+
+static void ExportLiteral(EXPORT_STATE* state, const char* str)
+{
+	ExportWrite(state, str, strlen(str));
+}
+
+
+static void ExportUnsigned(EXPORT_STATE* state, uint64_t value)
+{
+	char digits[20];
+	size_t count = 0;
+	uint8_t* out;
+
+	do
+	{
+		digits[count++] = (char)('0' + (value % 10));
+		value /= 10;
+	} while (value);
+
+	out = ExportReserve(state, count);
+	state->used += count;
+
+	while (count)
+		*out++ = (uint8_t)digits[--count];
+}
+
+
+static void ExportSigned(EXPORT_STATE* state, int64_t value)
+{
+	if (value < 0)
+	{
+		ExportLiteral(state, "-");
+		ExportUnsigned(state, (uint64_t)0 - (uint64_t)value);
+	}
+	else
+	{
+		ExportUnsigned(state, (uint64_t)value);
+	}
+}
+
+
+static void ExportHex16(EXPORT_STATE* state, uint16_t value)
+{
+	uint8_t* out = ExportReserve(state, 6);
+
+	out[0] = '0';
+	out[1] = 'x';
+	out[2] = (uint8_t)g_hexDigits[(value >> 12) & 0xf];
+	out[3] = (uint8_t)g_hexDigits[(value >> 8) & 0xf];
+	out[4] = (uint8_t)g_hexDigits[(value >> 4) & 0xf];
+	out[5] = (uint8_t)g_hexDigits[value & 0xf];
+	state->used += 6;
+}
+
+
+// A quoted JSON string, names are passed through as UTF-8
+static void ExportString(EXPORT_STATE* state, const char* str)
+{
+	size_t len = strlen(str);
+	uint8_t* out = ExportReserve(state, (len * 6) + 2);
+	const uint8_t* in = (const uint8_t*)str;
+
+	*out++ = '"';
+
+	for (; *in; in++)
+	{
+		if ((*in == '"') || (*in == '\\'))
+		{
+			*out++ = '\\';
+			*out++ = *in;
+		}
+		else if (*in < 0x20)
+		{
+			*out++ = '\\';
+			*out++ = 'u';
+			*out++ = '0';
+			*out++ = '0';
+			*out++ = (uint8_t)g_hexDigits[*in >> 4];
+			*out++ = (uint8_t)g_hexDigits[*in & 0xf];
+		}
+		else
+		{
+			*out++ = *in;
+		}
+	}
+
+	*out++ = '"';
+
+	state->used = (size_t)(out - state->buff);
+}
+
+
+static const char* GetLeafName(uint16_t leaf)
+{
+	switch (leaf)
+	{
+	case 0: return "simple";
+	case LEAF_TYPE_VTSHAPE: return "LF_VTSHAPE";
+	case LEAF_TYPE_LABEL: return "LF_LABEL";
+	case LEAF_TYPE_MODIFIER: return "LF_MODIFIER";
+	case LEAF_TYPE_POINTER: return "LF_POINTER";
+	case LEAF_TYPE_PROCEDURE: return "LF_PROCEDURE";
+	case LEAF_TYPE_MFUNCTION: return "LF_MFUNCTION";
+	case LEAF_TYPE_VFTPATH: return "LF_VFTPATH";
+	case LEAF_TYPE_OEM: return "LF_OEM";
+	case LEAF_TYPE_SKIP: return "LF_SKIP";
+	case LEAF_TYPE_ARGLIST: return "LF_ARGLIST";
+	case LEAF_TYPE_FIELDLIST: return "LF_FIELDLIST";
+	case LEAF_TYPE_DERIVED: return "LF_DERIVED";
+	case LEAF_TYPE_BITFIELD: return "LF_BITFIELD";
+	case LEAF_TYPE_METHODLIST: return "LF_METHODLIST";
+	case LEAF_TYPE_BCLASS: return "LF_BCLASS";
+	case LEAF_TYPE_VBCLASS: return "LF_VBCLASS";
+	case LEAF_TYPE_IVBCLASS: return "LF_IVBCLASS";
+	case LEAF_TYPE_INDEX: return "LF_INDEX";
+	case LEAF_TYPE_VFUNCTAB: return "LF_VFUNCTAB";
+	case LEAF_TYPE_FRIENDCLS: return "LF_FRIENDCLS";
+	case LEAF_TYPE_VFUNCOFF: return "LF_VFUNCOFF";
+	case LEAF_TYPE_TYPESERVER: return "LF_TYPESERVER";
+	case LEAF_TYPE_ENUMERATE: return "LF_ENUMERATE";
+	case LEAF_TYPE_ARRAY: return "LF_ARRAY";
+	case LEAF_TYPE_CLASS: return "LF_CLASS";
+	case LEAF_TYPE_STRUCTURE: return "LF_STRUCTURE";
+	case LEAF_TYPE_UNION: return "LF_UNION";
+	case LEAF_TYPE_ENUM: return "LF_ENUM";
+	case LEAF_TYPE_DIMARRAY: return "LF_DIMARRAY";
+	case LEAF_TYPE_PRECOMP: return "LF_PRECOMP";
+	case LEAF_TYPE_ALIAS: return "LF_ALIAS";
+	case LEAF_TYPE_FRIENDFCN: return "LF_FRIENDFCN";
+	case LEAF_TYPE_MEMBER: return "LF_MEMBER";
+	case LEAF_TYPE_STMEMBER: return "LF_STMEMBER";
+	case LEAF_TYPE_METHOD: return "LF_METHOD";
+	case LEAF_TYPE_NESTTYPE: return "LF_NESTTYPE";
+	case LEAF_TYPE_ONEMETHOD: return "LF_ONEMETHOD";
+	case LEAF_TYPE_NESTTYPEEX: return "LF_NESTTYPEEX";
+	case LEAF_TYPE_MEMBERMODIFY: return "LF_MEMBERMODIFY";
+	case LEAF_TYPE_MANAGED: return "LF_MANAGED";
+	case LEAF_TYPE_TYPESERVER2: return "LF_TYPESERVER2";
+	case LEAF_TYPE_STRIDED_ARRAY: return "LF_STRIDED_ARRAY";
+	case LEAF_TYPE_HLSL: return "LF_HLSL";
+	case LEAF_TYPE_MODIFIER_EX: return "LF_MODIFIER_EX";
+	case LEAF_TYPE_INTERFACE: return "LF_INTERFACE";
+	case LEAF_TYPE_BINTERFACE: return "LF_BINTERFACE";
+	case LEAF_TYPE_VECTOR: return "LF_VECTOR";
+	case LEAF_TYPE_MATRIX: return "LF_MATRIX";
+	case LEAF_TYPE_VFTABLE: return "LF_VFTABLE";
+	default: return NULL;
+	}
+}
+
+
+static void AddRef(EXPORT_STATE* state, PDB_EXPORT_REF role, uint32_t typeId)
+{
+	EXPORT_ROW* row = &state->row;
+
+	if (row->refCount >= PDB_EXPORT_RECORD_REFS)
+		return;
+
+	row->refs[row->refCount] = typeId;
+	row->roles[row->refCount] = (uint8_t)role;
+	row->refCount++;
+
+	// Built in types get a row of their own at the end
+	if (typeId < PDB_TYPE_SIMPLE_MAX)
+		state->simpleSeen[typeId >> 3] |= (uint8_t)(1 << (typeId & 7));
+}
+
+
+// Pull the name, size and references out of a record
+static void DecodeRecord(EXPORT_STATE* state, const uint8_t* data, uint16_t len)
+{
+	EXPORT_ROW* row = &state->row;
+	PDB_TYPE_UDT udt;
+	size_t pos;
+	uint32_t count;
+	uint32_t i;
+
+	switch (row->leaf)
+	{
+	case LEAF_TYPE_CLASS:
+	case LEAF_TYPE_STRUCTURE:
+	case LEAF_TYPE_INTERFACE:
+	case LEAF_TYPE_UNION:
+	case LEAF_TYPE_ENUM:
+		if (!PdbTypesParseUdt(row->leaf, data, len, &udt, &row->name))
+			break;
+		row->attr = udt.prop;
+		row->count = udt.count;
+		if (row->leaf != LEAF_TYPE_ENUM)
+		{
+			row->hasSize = true;
+			row->size = udt.size;
+		}
+		else
+		{
+			AddRef(state, PDB_EXPORT_REF_UTYPE, udt.utype);
+		}
+		AddRef(state, PDB_EXPORT_REF_FIELD, udt.field);
+		if (udt.derived)
+			AddRef(state, PDB_EXPORT_REF_DERIVED, udt.derived);
+		if (udt.vshape)
+			AddRef(state, PDB_EXPORT_REF_VSHAPE, udt.vshape);
+		break;
+	case LEAF_TYPE_MODIFIER:
+		// type, modifier bits
+		if (len < 6)
+			break;
+		AddRef(state, PDB_EXPORT_REF_TYPE, *(uint32_t*)data);
+		row->attr = *(uint16_t*)(data + 4);
+		break;
+	case LEAF_TYPE_POINTER:
+		// type, attributes (size in bits 13-18), then the class for pointers to members
+		if (len < 8)
+			break;
+		AddRef(state, PDB_EXPORT_REF_TYPE, *(uint32_t*)data);
+		row->attr = *(uint32_t*)(data + 4);
+		row->hasSize = true;
+		row->size = (row->attr >> 13) & 0x3f;
+		if ((len >= 12) && ((((row->attr >> 5) & 0x7) == 2) || (((row->attr >> 5) & 0x7) == 3)))
+			AddRef(state, PDB_EXPORT_REF_CONTAINING, *(uint32_t*)(data + 8));
+		break;
+	case LEAF_TYPE_PROCEDURE:
+		// return type, call type, attributes, parameter count, arglist
+		if (len < 12)
+			break;
+		AddRef(state, PDB_EXPORT_REF_RETURN, *(uint32_t*)data);
+		row->attr = data[4] | (data[5] << 8);
+		row->count = *(uint16_t*)(data + 6);
+		AddRef(state, PDB_EXPORT_REF_ARGLIST, *(uint32_t*)(data + 8));
+		break;
+	case LEAF_TYPE_MFUNCTION:
+		// return type, class, this, call type, attributes, parameter count, arglist, this adjust
+		if (len < 20)
+			break;
+		AddRef(state, PDB_EXPORT_REF_RETURN, *(uint32_t*)data);
+		AddRef(state, PDB_EXPORT_REF_CLASS, *(uint32_t*)(data + 4));
+		AddRef(state, PDB_EXPORT_REF_THIS, *(uint32_t*)(data + 8));
+		row->attr = data[12] | (data[13] << 8);
+		row->count = *(uint16_t*)(data + 14);
+		AddRef(state, PDB_EXPORT_REF_ARGLIST, *(uint32_t*)(data + 16));
+		break;
+	case LEAF_TYPE_ARGLIST:
+	case LEAF_TYPE_VFTPATH:
+		// count, then that many type indices
+		if (len < 4)
+			break;
+		count = *(uint32_t*)data;
+		if (count > (uint32_t)(len - 4) / 4)
+			count = (len - 4) / 4;
+		row->count = count;
+		for (i = 0; i < count; i++)
+		{
+			AddRef(state, (row->leaf == LEAF_TYPE_ARGLIST) ? PDB_EXPORT_REF_ARG : PDB_EXPORT_REF_BASE,
+				*(uint32_t*)(data + 4 + (i * 4)));
+		}
+		break;
+	case LEAF_TYPE_BITFIELD:
+		// type, length, position
+		if (len < 6)
+			break;
+		AddRef(state, PDB_EXPORT_REF_TYPE, *(uint32_t*)data);
+		row->count = data[4];
+		row->attr = data[5];
+		break;
+	case LEAF_TYPE_ARRAY:
+		// element type, index type, size, name
+		if (len < 8)
+			break;
+		AddRef(state, PDB_EXPORT_REF_ELEMENT, *(uint32_t*)data);
+		AddRef(state, PDB_EXPORT_REF_INDEX, *(uint32_t*)(data + 4));
+		pos = PdbTypesReadNumeric(data + 8, len - 8, &row->size);
+		if (pos == 0)
+			break;
+		row->hasSize = true;
+		if (data[8 + pos] != 0)
+			row->name = (const char*)(data + 8 + pos);
+		break;
+	case LEAF_TYPE_METHODLIST:
+		// attribute, padding, type, and a vtable offset for intro virtuals
+		pos = 0;
+		while (pos + 8 <= len)
+		{
+			uint16_t attr = *(uint16_t*)(data + pos);
+
+			AddRef(state, PDB_EXPORT_REF_METHOD, *(uint32_t*)(data + pos + 4));
+			row->count++;
+			pos += 8;
+
+			if ((PDB_TYPE_ATTR_MPROP(attr) == PDB_TYPE_MPROP_INTRO)
+				|| (PDB_TYPE_ATTR_MPROP(attr) == PDB_TYPE_MPROP_PUREINTRO))
+				pos += 4;
+		}
+		break;
+	case LEAF_TYPE_VTSHAPE:
+		if (len < 2)
+			break;
+		row->count = *(uint16_t*)data;
+		break;
+	case LEAF_TYPE_LABEL:
+		if (len < 2)
+			break;
+		row->attr = *(uint16_t*)data;
+		break;
+	case LEAF_TYPE_VFTABLE:
+		// owner, base vftable, offset in the object, names length, names
+		if (len < 16)
+			break;
+		AddRef(state, PDB_EXPORT_REF_TYPE, *(uint32_t*)data);
+		if (*(uint32_t*)(data + 4))
+			AddRef(state, PDB_EXPORT_REF_BASE, *(uint32_t*)(data + 4));
+		row->attr = *(uint32_t*)(data + 8);
+		if (len > 16)
+			row->name = (const char*)(data + 16);
+		break;
+	case LEAF_TYPE_FIELDLIST:
+		pos = 0;
+		while ((pos < len) && (row->memberCount < PDB_EXPORT_RECORD_MEMBERS))
+		{
+			PDB_TYPE_MEMBER* member = &row->members[row->memberCount];
+			size_t memberLen = PdbTypesParseMember(data + pos, len - pos, member);
+
+			if (memberLen == 0)
+				break;
+
+			if (member->type)
+				AddRef(state, PDB_EXPORT_REF_TYPE, member->type);
+
+			row->memberCount++;
+			pos += memberLen;
+		}
+		row->count = row->memberCount;
+		break;
+	default:
+		break;
+	}
+}
+
+
+static void WriteJsonMember(EXPORT_STATE* state, const PDB_TYPE_MEMBER* member)
+{
+	const char* leafName = GetLeafName((uint16_t)member->leaf);
+
+	ExportLiteral(state, "{\"leaf\":");
+	if (leafName)
+		ExportString(state, leafName);
+	else
+	{
+		ExportLiteral(state, "\"");
+		ExportHex16(state, (uint16_t)member->leaf);
+		ExportLiteral(state, "\"");
+	}
+
+	if (member->attr)
+	{
+		ExportLiteral(state, ",\"attr\":");
+		ExportUnsigned(state, member->attr);
+	}
+
+	if (member->name)
+	{
+		ExportLiteral(state, ",\"name\":");
+		ExportString(state, member->name);
+	}
+
+	if (member->type)
+	{
+		ExportLiteral(state, ",\"type\":");
+		ExportUnsigned(state, member->type);
+	}
+
+	if (member->leaf == LEAF_TYPE_ENUMERATE)
+	{
+		// Signed numeric leaves come back sign extended
+		ExportLiteral(state, ",\"value\":");
+		ExportSigned(state, (int64_t)member->offset);
+	}
+	else
+	{
+		ExportLiteral(state, (member->leaf == LEAF_TYPE_METHOD) ? ",\"count\":" : ",\"offset\":");
+		ExportUnsigned(state, member->offset);
+	}
+
+	if (member->vbptr)
+	{
+		ExportLiteral(state, ",\"vbptr\":");
+		ExportUnsigned(state, member->vbptr);
+		ExportLiteral(state, ",\"vbindex\":");
+		ExportUnsigned(state, member->vbindex);
+	}
+
+	ExportLiteral(state, "}");
+}
+
+
+static void WriteJsonRow(EXPORT_STATE* state)
+{
+	EXPORT_ROW* row = &state->row;
+	const char* leafName = GetLeafName(row->leaf);
+	uint32_t i;
+
+	ExportLiteral(state, "{\"ti\":");
+	ExportUnsigned(state, row->typeId);
+
+	ExportLiteral(state, ",\"leaf\":");
+	if (leafName)
+		ExportString(state, leafName);
+	else
+	{
+		ExportLiteral(state, "\"");
+		ExportHex16(state, row->leaf);
+		ExportLiteral(state, "\"");
+	}
+
+	if (row->name)
+	{
+		ExportLiteral(state, ",\"name\":");
+		ExportString(state, row->name);
+
+		// Built in pointers are named after what they point to, reopen the
+		// string to add the star
+		if (row->pointer)
+		{
+			state->used--;
+			ExportLiteral(state, "*\"");
+		}
+	}
+
+	if (row->hasSize)
+	{
+		ExportLiteral(state, ",\"size\":");
+		ExportUnsigned(state, row->size);
+	}
+
+	if (row->attr)
+	{
+		ExportLiteral(state, ",\"attr\":");
+		ExportUnsigned(state, row->attr);
+	}
+
+	if (row->count)
+	{
+		ExportLiteral(state, ",\"count\":");
+		ExportUnsigned(state, row->count);
+	}
+
+	// Member types are listed with the members rather than on their own
+	if (row->leaf != LEAF_TYPE_FIELDLIST)
+	{
+		for (i = 0; i < row->refCount; i++)
+		{
+			uint8_t role = row->roles[i];
+			bool list = ((role == PDB_EXPORT_REF_ARG) || (role == PDB_EXPORT_REF_BASE)
+				|| (role == PDB_EXPORT_REF_METHOD));
+
+			// Repeated roles are gathered into an array
+			if (list && (i > 0) && (row->roles[i - 1] == role))
+			{
+				ExportLiteral(state, ",");
+			}
+			else
+			{
+				ExportLiteral(state, ",\"");
+				ExportLiteral(state, g_refNames[role]);
+				ExportLiteral(state, list ? "\":[" : "\":");
+			}
+
+			ExportUnsigned(state, row->refs[i]);
+
+			if (list && ((i + 1 == row->refCount) || (row->roles[i + 1] != role)))
+				ExportLiteral(state, "]");
+		}
+	}
+
+	if (row->memberCount)
+	{
+		ExportLiteral(state, ",\"members\":[");
+
+		for (i = 0; i < row->memberCount; i++)
+		{
+			if (i)
+				ExportLiteral(state, ",");
+			WriteJsonMember(state, &row->members[i]);
+		}
+
+		ExportLiteral(state, "]");
+	}
+
+	ExportLiteral(state, "}\n");
+}
+
+
+static uint32_t AddBlockString(EXPORT_BLOCK* block, const char* str, bool pointer)
+{
+	uint32_t offset = block->stringBytes;
+	size_t len = strlen(str);
+
+	memcpy(block->strings + block->stringBytes, str, len);
+	block->stringBytes += (uint32_t)len;
+
+	if (pointer)
+		block->strings[block->stringBytes++] = '*';
+
+	block->strings[block->stringBytes++] = 0;
+
+	return offset;
+}
+
+
+static void WriteBlock(EXPORT_STATE* state)
+{
+	EXPORT_BLOCK* block = &state->block;
+	uint32_t header[4];
+	uint64_t zero = 0;
+	size_t columnBytes;
+
+	if (block->rows == 0)
+		return;
+
+	// Pad the strings so the next block stays 8 byte aligned
+	while (block->stringBytes & 7)
+		block->strings[block->stringBytes++] = 0;
+
+	header[0] = block->rows;
+	header[1] = block->members;
+	header[2] = block->refs;
+	header[3] = block->stringBytes;
+	ExportWrite(state, header, sizeof(header));
+
+	ExportWrite(state, block->rowSize, block->rows * sizeof(uint64_t));
+	ExportWrite(state, block->rowTypeId, block->rows * sizeof(uint32_t));
+	ExportWrite(state, block->rowName, block->rows * sizeof(uint32_t));
+	ExportWrite(state, block->rowAttr, block->rows * sizeof(uint32_t));
+	ExportWrite(state, block->rowCount, block->rows * sizeof(uint32_t));
+	ExportWrite(state, block->rowRefEnd, block->rows * sizeof(uint32_t));
+	ExportWrite(state, block->rowMemberEnd, block->rows * sizeof(uint32_t));
+
+	ExportWrite(state, block->memberOffset, block->members * sizeof(uint64_t));
+	ExportWrite(state, block->memberVbindex, block->members * sizeof(uint64_t));
+	ExportWrite(state, block->memberType, block->members * sizeof(uint32_t));
+	ExportWrite(state, block->memberVbptr, block->members * sizeof(uint32_t));
+	ExportWrite(state, block->memberName, block->members * sizeof(uint32_t));
+
+	ExportWrite(state, block->refTypeId, block->refs * sizeof(uint32_t));
+
+	ExportWrite(state, block->rowLeaf, block->rows * sizeof(uint16_t));
+	ExportWrite(state, block->memberLeaf, block->members * sizeof(uint16_t));
+	ExportWrite(state, block->memberAttr, block->members * sizeof(uint16_t));
+	ExportWrite(state, block->refRole, block->refs);
+
+	// Row columns are 34 bytes a row, member columns 32 and ref columns 5
+	columnBytes = ((size_t)block->rows * 34) + ((size_t)block->members * 32) + ((size_t)block->refs * 5);
+	if (columnBytes & 7)
+		ExportWrite(state, &zero, 8 - (columnBytes & 7));
+
+	ExportWrite(state, block->strings, block->stringBytes);
+
+	block->rows = 0;
+	block->members = 0;
+	block->refs = 0;
+	block->stringBytes = 0;
+}
+
+
+static void AddBinaryRow(EXPORT_STATE* state)
+{
+	EXPORT_ROW* row = &state->row;
+	EXPORT_BLOCK* block = &state->block;
+	uint32_t index;
+	uint32_t i;
+
+	// Start a new block if this record might not fit
+	if ((block->rows == PDB_EXPORT_BLOCK_ROWS)
+		|| (block->members + PDB_EXPORT_RECORD_MEMBERS > PDB_EXPORT_BLOCK_MEMBERS)
+		|| (block->refs + PDB_EXPORT_RECORD_REFS > PDB_EXPORT_BLOCK_REFS)
+		|| (block->stringBytes + PDB_EXPORT_RECORD_STRINGS > PDB_EXPORT_BLOCK_STRINGS))
+		WriteBlock(state);
+
+	index = block->rows++;
+
+	block->rowSize[index] = row->hasSize ? row->size : 0;
+	block->rowTypeId[index] = row->typeId;
+	block->rowName[index] = row->name ? AddBlockString(block, row->name, row->pointer) : PDB_EXPORT_NO_NAME;
+	block->rowAttr[index] = row->attr;
+	block->rowCount[index] = row->count;
+	block->rowLeaf[index] = row->leaf;
+
+	for (i = 0; i < row->refCount; i++)
+	{
+		block->refTypeId[block->refs] = row->refs[i];
+		block->refRole[block->refs] = row->roles[i];
+		block->refs++;
+	}
+
+	for (i = 0; i < row->memberCount; i++)
+	{
+		const PDB_TYPE_MEMBER* member = &row->members[i];
+
+		block->memberOffset[block->members] = member->offset;
+		block->memberVbindex[block->members] = member->vbindex;
+		block->memberType[block->members] = member->type;
+		block->memberVbptr[block->members] = member->vbptr;
+		block->memberName[block->members] = member->name
+			? AddBlockString(block, member->name, false) : PDB_EXPORT_NO_NAME;
+		block->memberLeaf[block->members] = (uint16_t)member->leaf;
+		block->memberAttr[block->members] = member->attr;
+		block->members++;
+	}
+
+	block->rowRefEnd[index] = block->refs;
+	block->rowMemberEnd[index] = block->members;
+}
+
+
+static void WriteRow(EXPORT_STATE* state)
+{
+	if (state->format == PDB_EXPORT_NDJSON)
+		WriteJsonRow(state);
+	else
+		AddBinaryRow(state);
+}
+
+
+static void ResetRow(EXPORT_ROW* row, uint32_t typeId, uint16_t leaf)
+{
+	row->typeId = typeId;
+	row->leaf = leaf;
+	row->hasSize = false;
+	row->size = 0;
+	row->attr = 0;
+	row->count = 0;
+	row->name = NULL;
+	row->pointer = false;
+	row->refCount = 0;
+	row->memberCount = 0;
+}
+
+
+static bool ExportRecord(void* ctxt, uint32_t typeId, uint16_t leaf, const uint8_t* data, uint16_t len)
+{
+	EXPORT_STATE* state = (EXPORT_STATE*)ctxt;
+
+	ResetRow(&state->row, typeId, leaf);
+	DecodeRecord(state, data, len);
+	WriteRow(state);
+
+	// Stop early if the output went away
+	return !state->failed;
+}
+
+
+// A row for each built in type that was referenced
+static void ExportSimpleTypes(EXPORT_STATE* state)
+{
+	uint32_t typeId;
+
+	for (typeId = 0; typeId < PDB_TYPE_SIMPLE_MAX; typeId++)
+	{
+		if (!(state->simpleSeen[typeId >> 3] & (1 << (typeId & 7))))
+			continue;
+
+		ResetRow(&state->row, typeId, 0);
+		state->row.name = PdbTypesGetSimpleName(typeId);
+		state->row.pointer = (PDB_TYPE_SIMPLE_MODE(typeId) != 0);
+		state->row.hasSize = true;
+		state->row.size = PdbTypesGetSimpleSize(typeId);
+
+		// No type, and indices nothing is known about
+		if (!state->row.name)
+		{
+			if (typeId == 0)
+				continue;
+			state->row.name = "<unknown>";
+		}
+
+		WriteRow(state);
+	}
+}
+
+
+static bool AllocBlock(EXPORT_BLOCK* block)
+{
+	memset(block, 0, sizeof(EXPORT_BLOCK));
+
+	block->rowSize = (uint64_t*)malloc(PDB_EXPORT_BLOCK_ROWS * sizeof(uint64_t));
+	block->rowTypeId = (uint32_t*)malloc(PDB_EXPORT_BLOCK_ROWS * sizeof(uint32_t));
+	block->rowName = (uint32_t*)malloc(PDB_EXPORT_BLOCK_ROWS * sizeof(uint32_t));
+	block->rowAttr = (uint32_t*)malloc(PDB_EXPORT_BLOCK_ROWS * sizeof(uint32_t));
+	block->rowCount = (uint32_t*)malloc(PDB_EXPORT_BLOCK_ROWS * sizeof(uint32_t));
+	block->rowRefEnd = (uint32_t*)malloc(PDB_EXPORT_BLOCK_ROWS * sizeof(uint32_t));
+	block->rowMemberEnd = (uint32_t*)malloc(PDB_EXPORT_BLOCK_ROWS * sizeof(uint32_t));
+	block->rowLeaf = (uint16_t*)malloc(PDB_EXPORT_BLOCK_ROWS * sizeof(uint16_t));
+
+	block->memberOffset = (uint64_t*)malloc(PDB_EXPORT_BLOCK_MEMBERS * sizeof(uint64_t));
+	block->memberVbindex = (uint64_t*)malloc(PDB_EXPORT_BLOCK_MEMBERS * sizeof(uint64_t));
+	block->memberType = (uint32_t*)malloc(PDB_EXPORT_BLOCK_MEMBERS * sizeof(uint32_t));
+	block->memberVbptr = (uint32_t*)malloc(PDB_EXPORT_BLOCK_MEMBERS * sizeof(uint32_t));
+	block->memberName = (uint32_t*)malloc(PDB_EXPORT_BLOCK_MEMBERS * sizeof(uint32_t));
+	block->memberLeaf = (uint16_t*)malloc(PDB_EXPORT_BLOCK_MEMBERS * sizeof(uint16_t));
+	block->memberAttr = (uint16_t*)malloc(PDB_EXPORT_BLOCK_MEMBERS * sizeof(uint16_t));
+
+	block->refTypeId = (uint32_t*)malloc(PDB_EXPORT_BLOCK_REFS * sizeof(uint32_t));
+	block->refRole = (uint8_t*)malloc(PDB_EXPORT_BLOCK_REFS);
+
+	block->strings = (char*)malloc(PDB_EXPORT_BLOCK_STRINGS);
+
+	return (block->rowSize && block->rowTypeId && block->rowName && block->rowAttr
+		&& block->rowCount && block->rowRefEnd && block->rowMemberEnd && block->rowLeaf
+		&& block->memberOffset && block->memberVbindex && block->memberType
+		&& block->memberVbptr && block->memberName && block->memberLeaf
+		&& block->memberAttr && block->refTypeId && block->refRole && block->strings);
+}
+
+
+static void FreeBlock(EXPORT_BLOCK* block)
+{
+	free(block->rowSize);
+	free(block->rowTypeId);
+	free(block->rowName);
+	free(block->rowAttr);
+	free(block->rowCount);
+	free(block->rowRefEnd);
+	free(block->rowMemberEnd);
+	free(block->rowLeaf);
+	free(block->memberOffset);
+	free(block->memberVbindex);
+	free(block->memberType);
+	free(block->memberVbptr);
+	free(block->memberName);
+	free(block->memberLeaf);
+	free(block->memberAttr);
+	free(block->refTypeId);
+	free(block->refRole);
+	free(block->strings);
+}
+
+
+bool PdbTypesExport(PDB_TYPES* types, PDB_EXPORT_FORMAT format, FILE* out)
+{
+	EXPORT_STATE* state;
+	bool result;
+
+	if ((format != PDB_EXPORT_NDJSON) && (format != PDB_EXPORT_BINARY))
+		return false;
+
+	// Everything is allocated up front, nothing per record
+	state = (EXPORT_STATE*)calloc(1, sizeof(EXPORT_STATE));
+	if (!state)
+		return false;
+
+	state->format = format;
+	state->out = out;
+	state->buff = (uint8_t*)malloc(PDB_EXPORT_BUFFER_SIZE);
+
+	if (!state->buff || ((format == PDB_EXPORT_BINARY) && !AllocBlock(&state->block)))
+	{
+		FreeBlock(&state->block);
+		free(state->buff);
+		free(state);
+		return false;
+	}
+
+	if (format == PDB_EXPORT_BINARY)
+	{
+		uint32_t header[4];
+
+		header[0] = PDB_EXPORT_VERSION;
+		header[1] = PdbTypesGetMinId(types);
+		header[2] = PdbTypesGetMaxId(types);
+		header[3] = 0;
+
+		ExportWrite(state, PDB_EXPORT_MAGIC, 8);
+		ExportWrite(state, header, sizeof(header));
+	}
+
+	result = PdbTypesWalk(types, ExportRecord, state);
+
+	if (result)
+		ExportSimpleTypes(state);
+
+	if (format == PDB_EXPORT_BINARY)
+		WriteBlock(state);
+
+	ExportFlush(state);
+
+	if (fflush(out))
+		state->failed = true;
+
+	result = (result && !state->failed);
+
+	FreeBlock(&state->block);
+	free(state->buff);
+	free(state);
+
+	return result;
+}
@@ -0,0 +1,100 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __EXPORT_H__
+#define __EXPORT_H__
+
+
+typedef enum PDB_EXPORT_FORMAT
+{
+	PDB_EXPORT_NDJSON = 0, // One JSON object per line
+	PDB_EXPORT_BINARY = 1 // Columnar blocks, described below
+} PDB_EXPORT_FORMAT;
+
+// What a reference from one record to another type is for
+typedef enum PDB_EXPORT_REF
+{
+	PDB_EXPORT_REF_TYPE = 0, // Modified, pointed to, or bitfield type
+	PDB_EXPORT_REF_FIELD = 1, // Field list of a udt
+	PDB_EXPORT_REF_DERIVED = 2, // Derivation list of a class
+	PDB_EXPORT_REF_VSHAPE = 3, // Vtable shape of a class
+	PDB_EXPORT_REF_UTYPE = 4, // Underlying type of an enum
+	PDB_EXPORT_REF_RETURN = 5, // Return type of a function
+	PDB_EXPORT_REF_CLASS = 6, // Class of a member function
+	PDB_EXPORT_REF_THIS = 7, // This pointer of a member function
+	PDB_EXPORT_REF_ARGLIST = 8, // Argument list of a function
+	PDB_EXPORT_REF_ARG = 9, // One argument in an argument list
+	PDB_EXPORT_REF_ELEMENT = 10, // Array element type
+	PDB_EXPORT_REF_INDEX = 11, // Array index type
+	PDB_EXPORT_REF_CONTAINING = 12, // Class of a pointer to member
+	PDB_EXPORT_REF_BASE = 13, // Base in a vftable path, or the base vftable
+	PDB_EXPORT_REF_METHOD = 14 // One overload in a method list
+} PDB_EXPORT_REF;
+
+// The binary format, all little endian:
+//
+// Header: char magic[8] "PDBTYPES", uint32 version (1), uint32 minId,
+// uint32 maxId, uint32 reserved.
+//
+// Then blocks to the end of the file, each starting with uint32 rows,
+// members, refs and stringBytes, followed by these columns in order:
+//
+//   rows:    uint64 size, uint32 typeId, name, attr, count, refEnd, memberEnd
+//   members: uint64 offset, vbindex, uint32 type, vbptr, name
+//   refs:    uint32 typeId
+//   uint16 row leaf, member leaf, member attr, then uint8 ref role
+//   zero padding to an 8 byte boundary, then stringBytes of NUL terminated names
+//
+// refEnd and memberEnd are the running totals for the block, so a row's refs
+// and members run from the previous row's end up to its own.  Names are
+// offsets into the block's strings, 0xffffffff when there is none.  The
+// strings are padded so every block is a multiple of 8 bytes.
+//
+// Built in types that are referenced come last as rows with leaf 0.  The
+// meaning of attr and count depends on the leaf:
+//
+//   struct/class/union/enum: attr is the property bits, count the members
+//   pointer: attr is the pointer attributes, size the pointer size
+//   modifier: attr is the modifier bits
+//   procedure/mfunction: attr is the call type | function attributes << 8,
+//     count the parameters
+//   arglist, vftpath, methodlist, vtshape, fieldlist: count is the entries
+//   bitfield: attr is the starting bit, count the bit length
+#define PDB_EXPORT_MAGIC "PDBTYPES"
+#define PDB_EXPORT_VERSION 1
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Write every type record, with the types it references, to out in one
+	// pass over the type stream
+	PDBAPI bool PdbTypesExport(PDB_TYPES* types, PDB_EXPORT_FORMAT format, FILE* out);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __EXPORT_H__ */
@@ -0,0 +1,870 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "pdb.h"
+#include "dbi.h"
+#include "names.h"
+#include "framedata.h"
+#include "internal.h"
+
+
+#define PDB_FPO_RECORD_SIZE 16
+#define PDB_FRAMEDATA_RECORD_SIZE 32
+
+// Deeper than any program the compilers write
+#define PDB_FRAME_STACK_SIZE 32
+
+#define PDB_FRAME_NO_PROGRAM 0xffffffff
+
+// Longest token a program can use
+#define PDB_FRAME_TOKEN_SIZE 32
+
+// Variables a program names itself, beyond the temporaries
+#define PDB_FRAME_SCRATCH_COUNT 16
+
+
+// Programs are compiled to 32 bit words, the opcode in the low byte and a
+// variable in the rest.  PUSH_CONST is followed by its value.
+enum FRAME_OP
+{
+	FRAME_OP_END = 0,
+	FRAME_OP_PUSH_CONST,
+	FRAME_OP_PUSH_VAR,
+	FRAME_OP_ADD,
+	FRAME_OP_SUB,
+	FRAME_OP_MUL,
+	FRAME_OP_DIV,
+	FRAME_OP_MOD,
+	FRAME_OP_DEREF, // ^
+	FRAME_OP_ALIGN, // @, align down
+	FRAME_OP_ASSIGN, // Pops the value into the variable
+	FRAME_OP_NOP // Only while compiling
+};
+
+#define FRAME_OP(op, var) ((uint32_t)(op) | ((uint32_t)(var) << 8))
+
+// Variables a program can use.  The registers come first so the caller's
+// array maps straight onto them.  Any other $name, like $L and $P or a
+// register saved by number, gets a scratch slot for the program.  The
+// fields describe the frame and can't be assigned.
+enum FRAME_VAR
+{
+	FRAME_VAR_T0 = PDB_FRAME_REG_COUNT,
+	FRAME_VAR_SCRATCH = FRAME_VAR_T0 + 10,
+	FRAME_VAR_RA_SEARCH = FRAME_VAR_SCRATCH + PDB_FRAME_SCRATCH_COUNT,
+	FRAME_VAR_SAVED_REGS,
+	FRAME_VAR_LOCALS,
+	FRAME_VAR_PARAMS,
+	FRAME_VAR_PROLOG,
+	FRAME_VAR_COUNT
+};
+
+typedef struct FRAME_NAME
+{
+	const char* name;
+	uint32_t var;
+} FRAME_NAME;
+
+static const FRAME_NAME g_frameNames[] =
+{
+	{"$eip", PDB_FRAME_REG_EIP},
+	{"$esp", PDB_FRAME_REG_ESP},
+	{"$ebp", PDB_FRAME_REG_EBP},
+	{"$eax", PDB_FRAME_REG_EAX},
+	{"$ebx", PDB_FRAME_REG_EBX},
+	{"$ecx", PDB_FRAME_REG_ECX},
+	{"$edx", PDB_FRAME_REG_EDX},
+	{"$esi", PDB_FRAME_REG_ESI},
+	{"$edi", PDB_FRAME_REG_EDI},
+	{".raSearch", FRAME_VAR_RA_SEARCH},
+	{".raSearchStart", FRAME_VAR_RA_SEARCH},
+	{".cbSavedRegs", FRAME_VAR_SAVED_REGS},
+	{".cbLocals", FRAME_VAR_LOCALS},
+	{".cbParams", FRAME_VAR_PARAMS},
+	{".cbProlog", FRAME_VAR_PROLOG}
+};
+
+typedef struct FRAME_ENTRY
+{
+	PDB_FRAME_RECORD record;
+	uint32_t programOffset; // In /names, 0 if none
+	uint32_t code; // Into the compiled programs, or PDB_FRAME_NO_PROGRAM
+} FRAME_ENTRY;
+
+// A record's range while the table is built
+typedef struct FRAME_RANGE
+{
+	uint32_t start;
+	uint64_t end;
+	uint32_t entry;
+} FRAME_RANGE;
+
+struct PDB_FRAME_DATA
+{
+	FRAME_ENTRY* entries; // In stream order, FPO first
+	uint32_t entryCount;
+
+	// The records flattened to ranges that don't overlap, for searching
+	uint32_t* starts; // Sorted
+	uint32_t* ends;
+	uint32_t* rangeEntries;
+	uint32_t rangeCount;
+
+	uint32_t* code;
+	uint32_t codeSize;
+	uint32_t codeCapacity;
+
+	PDB_NAMES* names;
+};
+
+
+static bool FramesAlloc(PDB_FRAME_DATA* frames, uint32_t count)
+{
+	FRAME_ENTRY* entries;
+
+	if (count > 0xffffffff / sizeof(FRAME_ENTRY) - frames->entryCount)
+		return false;
+
+	entries = (FRAME_ENTRY*)realloc(frames->entries, sizeof(FRAME_ENTRY) * (frames->entryCount + count));
+	if (!entries)
+		return false;
+
+	frames->entries = entries;
+	memset(&entries[frames->entryCount], 0, sizeof(FRAME_ENTRY) * count);
+
+	return true;
+}
+
+
+static uint8_t* ReadDebugStream(PDB_FILE* pdb, uint16_t streamId, uint32_t* size)
+{
+	PDB_STREAM* stream;
+	uint8_t* buff;
+
+	*size = 0;
+
+	if (streamId == PDB_STREAM_NONE)
+		return NULL;
+
+	stream = PdbStreamOpen(pdb, streamId);
+	if (!stream)
+		return NULL;
+
+	*size = PdbStreamGetSize(stream);
+	buff = (uint8_t*)malloc(*size ? *size : 1);
+
+	PdbStreamSetAccess(stream, PDB_ACCESS_ONCE);
+
+	if (buff && !PdbStreamRead(stream, buff, *size))
+	{
+		free(buff);
+		buff = NULL;
+	}
+
+	PdbStreamEndAccess(stream);
+	PdbStreamClose(stream);
+
+	return buff;
+}
+
+
+// FPO_DATA from the old FPO stream
+static bool LoadFpo(PDB_FRAME_DATA* frames, PDB_FILE* pdb, uint16_t streamId)
+{
+	uint32_t size;
+	uint8_t* buff = ReadDebugStream(pdb, streamId, &size);
+	uint32_t count = size / PDB_FPO_RECORD_SIZE;
+	uint32_t i;
+
+	if (!buff)
+		return false;
+
+	if (!FramesAlloc(frames, count))
+	{
+		free(buff);
+		return false;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		const uint8_t* raw = buff + (i * PDB_FPO_RECORD_SIZE);
+		FRAME_ENTRY* entry = &frames->entries[frames->entryCount++];
+		PDB_FRAME_RECORD* record = &entry->record;
+		uint32_t locals;
+		uint16_t params;
+		uint16_t bits;
+
+		memcpy(&record->rva, raw, 4);
+		memcpy(&record->size, raw + 4, 4);
+		memcpy(&locals, raw + 8, 4);
+		memcpy(&params, raw + 12, 2);
+		memcpy(&bits, raw + 14, 2);
+
+		// cbProlog:8 cbRegs:3 fHasSEH:1 fUseBP:1 reserved:1 cbFrame:2, the
+		// counts are in dwords
+		record->localsSize = locals * 4;
+		record->paramsSize = (uint32_t)params * 4;
+		record->prologSize = bits & 0xff;
+		record->savedRegsSize = ((bits >> 8) & 7) * 4;
+		record->type = (PDB_FRAME_TYPE)((bits >> 14) & 3);
+
+		if (bits & 0x800)
+			record->flags |= PDB_FRAME_FLAG_SEH;
+		if (bits & 0x1000)
+			record->flags |= PDB_FRAME_FLAG_USES_EBP;
+
+		entry->code = PDB_FRAME_NO_PROGRAM;
+	}
+
+	free(buff);
+
+	return true;
+}
+
+
+// FRAMEDATA from the new FPO stream
+static bool LoadFrameData(PDB_FRAME_DATA* frames, PDB_FILE* pdb, uint16_t streamId)
+{
+	uint32_t size;
+	uint8_t* buff = ReadDebugStream(pdb, streamId, &size);
+	uint32_t count = size / PDB_FRAMEDATA_RECORD_SIZE;
+	uint32_t i;
+
+	if (!buff)
+		return false;
+
+	if (!FramesAlloc(frames, count))
+	{
+		free(buff);
+		return false;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		const uint8_t* raw = buff + (i * PDB_FRAMEDATA_RECORD_SIZE);
+		FRAME_ENTRY* entry = &frames->entries[frames->entryCount++];
+		PDB_FRAME_RECORD* record = &entry->record;
+		uint16_t prolog;
+		uint16_t savedRegs;
+		uint32_t flags;
+
+		memcpy(&record->rva, raw, 4);
+		memcpy(&record->size, raw + 4, 4);
+		memcpy(&record->localsSize, raw + 8, 4);
+		memcpy(&record->paramsSize, raw + 12, 4);
+		memcpy(&record->maxStackSize, raw + 16, 4);
+		memcpy(&entry->programOffset, raw + 20, 4);
+		memcpy(&prolog, raw + 24, 2);
+		memcpy(&savedRegs, raw + 26, 2);
+		memcpy(&flags, raw + 28, 4);
+
+		record->prologSize = prolog;
+		record->savedRegsSize = savedRegs;
+		record->type = PDB_FRAME_TYPE_FRAMEDATA;
+		record->flags = flags & (PDB_FRAME_FLAG_SEH | PDB_FRAME_FLAG_EH | PDB_FRAME_FLAG_FUNCTION_START);
+
+		entry->code = PDB_FRAME_NO_PROGRAM;
+	}
+
+	free(buff);
+
+	return true;
+}
+
+
+static bool EmitCode(PDB_FRAME_DATA* frames, uint32_t word)
+{
+	if (frames->codeSize == frames->codeCapacity)
+	{
+		uint32_t capacity = frames->codeCapacity ? (frames->codeCapacity * 2) : 256;
+		uint32_t* code = (uint32_t*)realloc(frames->code, sizeof(uint32_t) * capacity);
+
+		if (!code)
+			return false;
+
+		frames->code = code;
+		frames->codeCapacity = capacity;
+	}
+
+	frames->code[frames->codeSize++] = word;
+
+	return true;
+}
+
+
+// Scratch names are numbered in the order the program first uses them
+static bool LookupVariable(const char* token, char scratch[][PDB_FRAME_TOKEN_SIZE], uint32_t* scratchCount,
+	uint32_t* var)
+{
+	uint32_t i;
+
+	// $T0 to $T9
+	if ((token[0] == '$') && (token[1] == 'T') && (token[2] >= '0') && (token[2] <= '9') && !token[3])
+	{
+		*var = FRAME_VAR_T0 + (token[2] - '0');
+		return true;
+	}
+
+	for (i = 0; i < sizeof(g_frameNames) / sizeof(g_frameNames[0]); i++)
+	{
+		if (strcmp(g_frameNames[i].name, token) == 0)
+		{
+			*var = g_frameNames[i].var;
+			return true;
+		}
+	}
+
+	if ((token[0] != '$') || !token[1])
+		return false;
+
+	for (i = 0; i < *scratchCount; i++)
+	{
+		if (strcmp(scratch[i], token) == 0)
+		{
+			*var = FRAME_VAR_SCRATCH + i;
+			return true;
+		}
+	}
+
+	if (*scratchCount == PDB_FRAME_SCRATCH_COUNT)
+		return false;
+
+	strcpy(scratch[*scratchCount], token);
+	*var = FRAME_VAR_SCRATCH + (*scratchCount)++;
+
+	return true;
+}
+
+
+// Compile a postfix program, checking the stack as it goes so the evaluator
+// never has to.  An assignment's target is pushed before its value, so it
+// can only be recognized when the = is reached: the PUSH_VAR that pushed
+// it becomes a NOP and the ASSIGN names the variable instead.  The NOPs are
+// squeezed out at the end.  Returns the program's offset in the code, or
+// PDB_FRAME_NO_PROGRAM.
+static uint32_t CompileProgram(PDB_FRAME_DATA* frames, const char* text)
+{
+	uint32_t start = frames->codeSize;
+	int64_t pushedBy[PDB_FRAME_STACK_SIZE]; // The PUSH_VAR for each slot, or -1
+	uint32_t depth = 0;
+	char token[PDB_FRAME_TOKEN_SIZE];
+	char scratch[PDB_FRAME_SCRATCH_COUNT][PDB_FRAME_TOKEN_SIZE];
+	uint32_t scratchCount = 0;
+	uint32_t i;
+	uint32_t j;
+
+	while (*text)
+	{
+		uint32_t len = 0;
+		uint32_t var;
+
+		while ((*text == ' ') || (*text == '\t') || (*text == '\r') || (*text == '\n'))
+			text++;
+
+		if (!*text)
+			break;
+
+		while (*text && (*text != ' ') && (*text != '\t') && (*text != '\r') && (*text != '\n'))
+		{
+			if (len + 1 >= sizeof(token))
+				goto FAIL;
+
+			token[len++] = *text++;
+		}
+
+		token[len] = 0;
+
+		if ((len == 1) && strchr("+-*/%@", token[0]))
+		{
+			static const uint8_t ops[] = {FRAME_OP_ADD, FRAME_OP_SUB, FRAME_OP_MUL, FRAME_OP_DIV, FRAME_OP_MOD, FRAME_OP_ALIGN};
+
+			if (depth < 2)
+				goto FAIL;
+
+			if (!EmitCode(frames, FRAME_OP(ops[strchr("+-*/%@", token[0]) - "+-*/%@"], 0)))
+				goto FAIL;
+
+			depth--;
+			pushedBy[depth - 1] = -1;
+		}
+		else if ((len == 1) && (token[0] == '^'))
+		{
+			if ((depth < 1) || !EmitCode(frames, FRAME_OP(FRAME_OP_DEREF, 0)))
+				goto FAIL;
+
+			pushedBy[depth - 1] = -1;
+		}
+		else if ((len == 1) && (token[0] == '='))
+		{
+			uint32_t target;
+
+			if ((depth < 2) || (pushedBy[depth - 2] < 0))
+				goto FAIL;
+
+			target = frames->code[pushedBy[depth - 2]] >> 8;
+			if (target >= FRAME_VAR_RA_SEARCH)
+				goto FAIL;
+
+			frames->code[pushedBy[depth - 2]] = FRAME_OP(FRAME_OP_NOP, 0);
+
+			if (!EmitCode(frames, FRAME_OP(FRAME_OP_ASSIGN, target)))
+				goto FAIL;
+
+			depth -= 2;
+		}
+		else if ((token[0] >= '0') && (token[0] <= '9'))
+		{
+			char* end;
+			uint32_t value = (uint32_t)strtoul(token, &end, 10);
+
+			if (*end || (depth == PDB_FRAME_STACK_SIZE))
+				goto FAIL;
+
+			if (!EmitCode(frames, FRAME_OP(FRAME_OP_PUSH_CONST, 0)) || !EmitCode(frames, value))
+				goto FAIL;
+
+			pushedBy[depth++] = -1;
+		}
+		else if (LookupVariable(token, scratch, &scratchCount, &var))
+		{
+			if (depth == PDB_FRAME_STACK_SIZE)
+				goto FAIL;
+
+			pushedBy[depth++] = frames->codeSize;
+
+			if (!EmitCode(frames, FRAME_OP(FRAME_OP_PUSH_VAR, var)))
+				goto FAIL;
+		}
+		else
+		{
+			goto FAIL;
+		}
+	}
+
+	// Every value has to have been assigned somewhere
+	if ((depth != 0) || !EmitCode(frames, FRAME_OP(FRAME_OP_END, 0)))
+		goto FAIL;
+
+	for (i = start, j = start; i < frames->codeSize; i++)
+	{
+		uint32_t op = frames->code[i] & 0xff;
+
+		if (op != FRAME_OP_NOP)
+			frames->code[j++] = frames->code[i];
+
+		if (op == FRAME_OP_PUSH_CONST)
+			frames->code[j++] = frames->code[++i];
+	}
+
+	frames->codeSize = j;
+
+	return start;
+
+FAIL:
+	frames->codeSize = start;
+
+	return PDB_FRAME_NO_PROGRAM;
+}
+
+
+static bool RunProgram(const uint32_t* code, uint32_t* vars, PdbFrameReadFunction readFn, void* ctxt)
+{
+	uint32_t stack[PDB_FRAME_STACK_SIZE];
+	uint32_t sp = 0;
+
+	for (;;)
+	{
+		uint32_t word = *code++;
+		uint32_t b;
+
+		switch (word & 0xff)
+		{
+		case FRAME_OP_END:
+			return true;
+		case FRAME_OP_PUSH_CONST:
+			stack[sp++] = *code++;
+			break;
+		case FRAME_OP_PUSH_VAR:
+			stack[sp++] = vars[word >> 8];
+			break;
+		case FRAME_OP_ADD:
+			b = stack[--sp];
+			stack[sp - 1] += b;
+			break;
+		case FRAME_OP_SUB:
+			b = stack[--sp];
+			stack[sp - 1] -= b;
+			break;
+		case FRAME_OP_MUL:
+			b = stack[--sp];
+			stack[sp - 1] *= b;
+			break;
+		case FRAME_OP_DIV:
+			b = stack[--sp];
+			if (b == 0)
+				return false;
+			stack[sp - 1] /= b;
+			break;
+		case FRAME_OP_MOD:
+			b = stack[--sp];
+			if (b == 0)
+				return false;
+			stack[sp - 1] %= b;
+			break;
+		case FRAME_OP_ALIGN:
+			b = stack[--sp];
+			if (b == 0)
+				return false;
+			stack[sp - 1] &= ~(b - 1);
+			break;
+		case FRAME_OP_DEREF:
+			if (!readFn(ctxt, stack[sp - 1], &stack[sp - 1]))
+				return false;
+			break;
+		case FRAME_OP_ASSIGN:
+			vars[word >> 8] = stack[--sp];
+			break;
+		default:
+			return false;
+		}
+	}
+}
+
+
+static int CompareOffsets(const void* a, const void* b)
+{
+	uint32_t left = *(const uint32_t*)a;
+	uint32_t right = *(const uint32_t*)b;
+
+	return (left < right) ? -1 : (left > right);
+}
+
+
+// Compile each distinct program once, the same program is shared by many
+// blocks
+static bool CompilePrograms(PDB_FRAME_DATA* frames)
+{
+	uint32_t* offsets = (uint32_t*)malloc(sizeof(uint32_t) * 2 * (frames->entryCount + 1));
+	uint32_t* codes;
+	uint32_t count = 0;
+	uint32_t unique = 0;
+	uint32_t i;
+
+	if (!offsets)
+		return false;
+
+	codes = offsets + frames->entryCount + 1;
+
+	for (i = 0; i < frames->entryCount; i++)
+	{
+		if (frames->entries[i].programOffset)
+			offsets[count++] = frames->entries[i].programOffset;
+	}
+
+	qsort(offsets, count, sizeof(uint32_t), CompareOffsets);
+
+	for (i = 0; i < count; i++)
+	{
+		const char* text;
+
+		if ((unique > 0) && (offsets[unique - 1] == offsets[i]))
+			continue;
+
+		offsets[unique] = offsets[i];
+		text = PdbNamesGet(frames->names, offsets[i]);
+		codes[unique++] = text ? CompileProgram(frames, text) : PDB_FRAME_NO_PROGRAM;
+	}
+
+	for (i = 0; i < frames->entryCount; i++)
+	{
+		FRAME_ENTRY* entry = &frames->entries[i];
+		uint32_t found;
+
+		if (!entry->programOffset)
+			continue;
+
+		found = PdbUpperBound(offsets, unique, entry->programOffset) - 1;
+		entry->code = codes[found];
+		entry->record.program = PdbNamesGet(frames->names, entry->programOffset);
+	}
+
+	free(offsets);
+
+	return true;
+}
+
+
+static int CompareRanges(const void* a, const void* b)
+{
+	const FRAME_RANGE* left = (const FRAME_RANGE*)a;
+	const FRAME_RANGE* right = (const FRAME_RANGE*)b;
+
+	// Outer ranges before the ones they contain, then stream order so
+	// FRAMEDATA beats FPO for the same block
+	if (left->start != right->start)
+		return (left->start < right->start) ? -1 : 1;
+
+	if (left->end != right->end)
+		return (left->end > right->end) ? -1 : 1;
+
+	return (left->entry < right->entry) ? -1 : (left->entry > right->entry);
+}
+
+
+static void AddRange(PDB_FRAME_DATA* frames, uint32_t start, uint64_t end, uint32_t entry)
+{
+	if (start >= end)
+		return;
+
+	frames->starts[frames->rangeCount] = start;
+	frames->ends[frames->rangeCount] = (end > 0xffffffff) ? 0xffffffff : (uint32_t)end;
+	frames->rangeEntries[frames->rangeCount] = entry;
+	frames->rangeCount++;
+}
+
+
+// Flatten the records into ranges that don't overlap, with each address
+// belonging to the innermost record that covers it.  Sweep the records in
+// start order keeping the enclosing ones on a stack: a record ends the
+// range of the one around it, which picks up again after it.
+static bool BuildRanges(PDB_FRAME_DATA* frames)
+{
+	uint32_t count = frames->entryCount;
+	FRAME_RANGE* ranges = (FRAME_RANGE*)malloc(sizeof(FRAME_RANGE) * (count + 1));
+	uint32_t* stack = (uint32_t*)malloc(sizeof(uint32_t) * (count + 1));
+	uint64_t cursor = 0;
+	uint32_t depth = 0;
+	uint32_t i;
+	bool result = false;
+
+	// Each record adds at most its own range and splits one other in two
+	frames->starts = (uint32_t*)PdbAlignedAlloc(sizeof(uint32_t) * (2 * (size_t)count + 1));
+	frames->ends = (uint32_t*)malloc(sizeof(uint32_t) * (2 * (size_t)count + 1));
+	frames->rangeEntries = (uint32_t*)malloc(sizeof(uint32_t) * (2 * (size_t)count + 1));
+
+	if (!ranges || !stack || !frames->starts || !frames->ends || !frames->rangeEntries)
+		goto DONE;
+
+	for (i = 0; i < count; i++)
+	{
+		ranges[i].start = frames->entries[i].record.rva;
+		ranges[i].end = (uint64_t)frames->entries[i].record.rva + frames->entries[i].record.size;
+		ranges[i].entry = i;
+	}
+
+	qsort(ranges, count, sizeof(FRAME_RANGE), CompareRanges);
+
+	for (i = 0; i <= count; i++)
+	{
+		// One past the end closes everything still open
+		uint64_t start = (i < count) ? ranges[i].start : ((uint64_t)1 << 33);
+
+		while ((depth > 0) && (ranges[stack[depth - 1]].end <= start))
+		{
+			const FRAME_RANGE* top = &ranges[stack[--depth]];
+
+			if (cursor < top->end)
+			{
+				AddRange(frames, (uint32_t)cursor, top->end, top->entry);
+				cursor = top->end;
+			}
+		}
+
+		if (i == count)
+			break;
+
+		if ((depth > 0) && (cursor < start))
+			AddRange(frames, (uint32_t)cursor, start, ranges[stack[depth - 1]].entry);
+
+		if (cursor < start)
+			cursor = start;
+
+		stack[depth++] = i;
+	}
+
+	result = true;
+
+DONE:
+	free(ranges);
+	free(stack);
+
+	return result;
+}
+
+
+PDB_FRAME_DATA* PdbFrameDataOpen(PDB_DBI* dbi)
+{
+	PDB_FILE* pdb = PdbDbiGetPdb(dbi);
+	PDB_FRAME_DATA* frames = (PDB_FRAME_DATA*)calloc(1, sizeof(PDB_FRAME_DATA));
+	bool fpo;
+	bool frameData;
+
+	if (!frames)
+		return NULL;
+
+	fpo = LoadFpo(frames, pdb, PdbDbiGetDebugStream(dbi, PDB_DEBUG_FPO));
+	frameData = LoadFrameData(frames, pdb, PdbDbiGetDebugStream(dbi, PDB_DEBUG_NEW_FPO));
+
+	if (!fpo && !frameData)
+		goto FAIL;
+
+	// Without /names the records are still good for their sizes
+	if (frameData)
+	{
+		frames->names = PdbNamesOpen(pdb);
+
+		if (frames->names && !CompilePrograms(frames))
+			goto FAIL;
+	}
+
+	if (!BuildRanges(frames))
+		goto FAIL;
+
+	return frames;
+
+FAIL:
+	PdbFrameDataClose(frames);
+
+	return NULL;
+}
+
+
+void PdbFrameDataClose(PDB_FRAME_DATA* frames)
+{
+	free(frames->entries);
+	PdbAlignedFree(frames->starts);
+	free(frames->ends);
+	free(frames->rangeEntries);
+	free(frames->code);
+
+	if (frames->names)
+		PdbNamesClose(frames->names);
+
+	free(frames);
+}
+
+
+uint32_t PdbFrameDataGetCount(PDB_FRAME_DATA* frames)
+{
+	return frames->entryCount;
+}
+
+
+static const FRAME_ENTRY* FindEntry(PDB_FRAME_DATA* frames, uint32_t rva)
+{
+	uint32_t range = PdbUpperBound(frames->starts, frames->rangeCount, rva);
+
+	if ((range == 0) || (rva >= frames->ends[range - 1]))
+		return NULL;
+
+	return &frames->entries[frames->rangeEntries[range - 1]];
+}
+
+
+bool PdbFrameDataFind(PDB_FRAME_DATA* frames, uint32_t rva, PDB_FRAME_RECORD* record)
+{
+	const FRAME_ENTRY* entry = FindEntry(frames, rva);
+
+	if (!entry)
+		return false;
+
+	*record = entry->record;
+
+	return true;
+}
+
+
+bool PdbFrameDataUnwind(PDB_FRAME_DATA* frames, uint32_t rva, uint32_t regs[PDB_FRAME_REG_COUNT],
+	PdbFrameReadFunction readFn, void* ctxt)
+{
+	const FRAME_ENTRY* entry = FindEntry(frames, rva);
+	const PDB_FRAME_RECORD* record;
+	uint32_t vars[FRAME_VAR_COUNT];
+	uint32_t ra;
+
+	if (!entry)
+		return false;
+
+	record = &entry->record;
+
+	switch (record->type)
+	{
+	case PDB_FRAME_TYPE_FRAMEDATA:
+		if (entry->code == PDB_FRAME_NO_PROGRAM)
+		{
+			if (entry->programOffset)
+				return false;
+
+			break;
+		}
+
+		// The temporaries and scratch variables start at zero, the caller's registers start as
+		// this frame's so the ones the program leaves alone carry over
+		memset(vars, 0, sizeof(vars));
+		memcpy(vars, regs, sizeof(uint32_t) * PDB_FRAME_REG_COUNT);
+		vars[FRAME_VAR_RA_SEARCH] = regs[PDB_FRAME_REG_ESP] + record->localsSize + record->savedRegsSize;
+		vars[FRAME_VAR_SAVED_REGS] = record->savedRegsSize;
+		vars[FRAME_VAR_LOCALS] = record->localsSize;
+		vars[FRAME_VAR_PARAMS] = record->paramsSize;
+		vars[FRAME_VAR_PROLOG] = record->prologSize;
+
+		if (!RunProgram(frames->code + entry->code, vars, readFn, ctxt))
+			return false;
+
+		memcpy(regs, vars, sizeof(uint32_t) * PDB_FRAME_REG_COUNT);
+
+		return true;
+	case PDB_FRAME_TYPE_STANDARD:
+		{
+			uint32_t ebp = regs[PDB_FRAME_REG_EBP];
+			uint32_t eip;
+			uint32_t callerEbp;
+
+			if (!readFn(ctxt, ebp + 4, &eip) || !readFn(ctxt, ebp, &callerEbp))
+				return false;
+
+			regs[PDB_FRAME_REG_EIP] = eip;
+			regs[PDB_FRAME_REG_ESP] = ebp + 8;
+			regs[PDB_FRAME_REG_EBP] = callerEbp;
+
+			return true;
+		}
+	case PDB_FRAME_TYPE_FPO:
+		break;
+	default:
+		return false;
+	}
+
+	// No frame pointer, the return address is above the locals and the
+	// saved registers
+	ra = regs[PDB_FRAME_REG_ESP] + record->localsSize + record->savedRegsSize;
+
+	if (!readFn(ctxt, ra, &regs[PDB_FRAME_REG_EIP]))
+		return false;
+
+	regs[PDB_FRAME_REG_ESP] = ra + 4;
+
+	return true;
+}
@@ -0,0 +1,122 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __FRAMEDATA_H__
+#define __FRAMEDATA_H__
+
+
+typedef struct PDB_FRAME_DATA PDB_FRAME_DATA;
+typedef enum PDB_FRAME_TYPE PDB_FRAME_TYPE;
+typedef enum PDB_FRAME_FLAGS PDB_FRAME_FLAGS;
+typedef enum PDB_FRAME_REGISTER PDB_FRAME_REGISTER;
+
+// How an x86 function's frame is laid out, from the FPO and the newer
+// FRAMEDATA debug streams.  FRAMEDATA describes the frame with a small
+// postfix program in /names ("$T0 .raSearch = $eip $T0 ^ = $esp $T0 4 + =")
+// that computes the caller's registers.  The programs are compiled once when
+// the frame data is opened, so unwinding a frame is one lookup and running
+// the compiled program.
+//
+// Addresses are RVAs in the pdb's layout, translate image RVAs with
+// PdbAddressMapToPdbRva first.
+
+enum PDB_FRAME_TYPE
+{
+	PDB_FRAME_TYPE_FPO = 0, // Frame pointer omitted
+	PDB_FRAME_TYPE_TRAP = 1, // Kernel trap frame
+	PDB_FRAME_TYPE_TSS = 2, // Task switch
+	PDB_FRAME_TYPE_STANDARD = 3, // ebp frame
+	PDB_FRAME_TYPE_FRAMEDATA = 4 // From the FRAMEDATA stream
+};
+
+enum PDB_FRAME_FLAGS
+{
+	PDB_FRAME_FLAG_SEH = 0x1,
+	PDB_FRAME_FLAG_EH = 0x2, // C++ exception handling (FRAMEDATA)
+	PDB_FRAME_FLAG_FUNCTION_START = 0x4, // The block starts the function (FRAMEDATA)
+	PDB_FRAME_FLAG_USES_EBP = 0x8 // ebp is used as a general register (FPO)
+};
+
+// The registers a frame program can read and set
+enum PDB_FRAME_REGISTER
+{
+	PDB_FRAME_REG_EIP = 0,
+	PDB_FRAME_REG_ESP,
+	PDB_FRAME_REG_EBP,
+	PDB_FRAME_REG_EAX,
+	PDB_FRAME_REG_EBX,
+	PDB_FRAME_REG_ECX,
+	PDB_FRAME_REG_EDX,
+	PDB_FRAME_REG_ESI,
+	PDB_FRAME_REG_EDI,
+	PDB_FRAME_REG_COUNT
+};
+
+typedef struct PDB_FRAME_RECORD
+{
+	uint32_t rva;
+	uint32_t size;
+	uint32_t localsSize; // Bytes, as are the sizes below
+	uint32_t paramsSize;
+	uint32_t maxStackSize; // FRAMEDATA only
+	uint32_t prologSize;
+	uint32_t savedRegsSize;
+	PDB_FRAME_TYPE type;
+	uint32_t flags; // PDB_FRAME_FLAGS
+	const char* program; // Owned by the frame data, NULL if there isn't one
+} PDB_FRAME_RECORD;
+
+// Read 4 bytes of the stopped thread's stack.  Return false if the address
+// can't be read.
+typedef bool (*PdbFrameReadFunction)(void* ctxt, uint32_t address, uint32_t* value);
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Load the FPO and FRAMEDATA records.  Where records overlap the one
+	// for the innermost block wins.  NULL if the pdb has neither stream.
+	PDBAPI PDB_FRAME_DATA* PdbFrameDataOpen(PDB_DBI* dbi);
+	PDBAPI void PdbFrameDataClose(PDB_FRAME_DATA* frames);
+
+	PDBAPI uint32_t PdbFrameDataGetCount(PDB_FRAME_DATA* frames);
+
+	// The record covering rva
+	PDBAPI bool PdbFrameDataFind(PDB_FRAME_DATA* frames, uint32_t rva, PDB_FRAME_RECORD* record);
+
+	// Replace the registers of the frame stopped at rva with its caller's.
+	// Frames with a program run it, .raSearch is the address of the return
+	// address after the locals and saved registers.  Frames without one
+	// use ebp when they have a standard frame and the sizes when they don't.
+	// False if there's no record for rva, it's a trap or task frame, its
+	// program failed to compile or a read failed.
+	PDBAPI bool PdbFrameDataUnwind(PDB_FRAME_DATA* frames, uint32_t rva, uint32_t regs[PDB_FRAME_REG_COUNT],
+		PdbFrameReadFunction readFn, void* ctxt);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __FRAMEDATA_H__ */
@@ -0,0 +1,432 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "tpi.h"
+#include "idindex.h"
+
+
+typedef struct ID_FUNC
+{
+	uint32_t id;
+	uint32_t scope;
+	uint32_t type;
+	uint32_t name; // Offset into text
+	uint16_t leaf;
+} ID_FUNC;
+
+typedef struct ID_STRING
+{
+	uint32_t id;
+	uint32_t text; // Offset into text
+} ID_STRING;
+
+typedef struct ID_SOURCE
+{
+	uint32_t typeId;
+	uint32_t id; // Of the source line record, to keep the first of duplicates
+	uint32_t src; // String id, or /names offset for LF_UDT_MOD_SRC_LINE
+	uint32_t line;
+	uint16_t module;
+	uint16_t leaf;
+} ID_SOURCE;
+
+typedef struct ID_NAME
+{
+	const char* name;
+	uint32_t func;
+} ID_NAME;
+
+struct PDB_ID_INDEX
+{
+	ID_FUNC* funcs; // In id order
+	uint32_t funcCount;
+	uint32_t funcCapacity;
+	ID_NAME* byName; // Sorted by name, then id
+
+	ID_STRING* strings; // In id order
+	uint32_t stringCount;
+	uint32_t stringCapacity;
+
+	ID_SOURCE* sources; // Sorted by type index
+	uint32_t sourceCount;
+	uint32_t sourceCapacity;
+
+	// Storage for the names and strings
+	char* text;
+	size_t textUsed;
+	size_t textSize;
+};
+
+
+static uint32_t ReadU32(const uint8_t* buff)
+{
+	uint32_t value;
+
+	memcpy(&value, buff, sizeof(value));
+
+	return value;
+}
+
+
+// Make room for one more element of size in *array
+static bool Grow(void** array, uint32_t* capacity, uint32_t count, size_t size)
+{
+	uint32_t grown;
+	void* resized;
+
+	if (count < *capacity)
+		return true;
+
+	grown = *capacity ? (*capacity * 2) : 1024;
+	resized = realloc(*array, grown * size);
+	if (!resized)
+		return false;
+
+	*array = resized;
+	*capacity = grown;
+
+	return true;
+}
+
+
+static bool AddText(PDB_ID_INDEX* index, const char* str, uint32_t* offset)
+{
+	size_t len = strlen(str) + 1;
+
+	if (index->textUsed + len > index->textSize)
+	{
+		size_t size = index->textSize ? (index->textSize * 2) : (64 * 1024);
+		char* grown;
+
+		while (index->textUsed + len > size)
+			size *= 2;
+
+		grown = (char*)realloc(index->text, size);
+		if (!grown)
+			return false;
+
+		index->text = grown;
+		index->textSize = size;
+	}
+
+	memcpy(index->text + index->textUsed, str, len);
+	*offset = (uint32_t)index->textUsed;
+	index->textUsed += len;
+
+	return true;
+}
+
+
+static bool CollectId(void* ctxt, uint32_t id, uint16_t leaf, const uint8_t* data, uint16_t len)
+{
+	PDB_ID_INDEX* index = (PDB_ID_INDEX*)ctxt;
+
+	switch (leaf)
+	{
+	case LEAF_TYPE_FUNC_ID:
+	case LEAF_TYPE_MFUNC_ID:
+	{
+		ID_FUNC* func;
+
+		if (len < 8)
+			return true;
+
+		if (!Grow((void**)&index->funcs, &index->funcCapacity, index->funcCount, sizeof(ID_FUNC)))
+			return false;
+
+		func = &index->funcs[index->funcCount];
+		func->id = id;
+		func->scope = ReadU32(data);
+		func->type = ReadU32(data + 4);
+		func->leaf = leaf;
+
+		if (!AddText(index, (const char*)data + 8, &func->name))
+			return false;
+
+		index->funcCount++;
+		return true;
+	}
+
+	case LEAF_TYPE_STRING_ID:
+	{
+		ID_STRING* string;
+
+		if (len < 4)
+			return true;
+
+		if (!Grow((void**)&index->strings, &index->stringCapacity, index->stringCount, sizeof(ID_STRING)))
+			return false;
+
+		string = &index->strings[index->stringCount];
+		string->id = id;
+
+		if (!AddText(index, (const char*)data + 4, &string->text))
+			return false;
+
+		index->stringCount++;
+		return true;
+	}
+
+	case LEAF_TYPE_UDT_SRC_LINE:
+	case LEAF_TYPE_UDT_MOD_SRC_LINE:
+	{
+		ID_SOURCE* source;
+
+		if ((len < 12) || ((leaf == LEAF_TYPE_UDT_MOD_SRC_LINE) && (len < 14)))
+			return true;
+
+		if (!Grow((void**)&index->sources, &index->sourceCapacity, index->sourceCount, sizeof(ID_SOURCE)))
+			return false;
+
+		source = &index->sources[index->sourceCount++];
+		source->typeId = ReadU32(data);
+		source->id = id;
+		source->src = ReadU32(data + 4);
+		source->line = ReadU32(data + 8);
+		source->module = 0;
+		source->leaf = leaf;
+
+		if (leaf == LEAF_TYPE_UDT_MOD_SRC_LINE)
+			memcpy(&source->module, data + 12, sizeof(source->module));
+
+		return true;
+	}
+
+	default:
+		return true;
+	}
+}
+
+
+static int CompareNames(const void* a, const void* b)
+{
+	const ID_NAME* left = (const ID_NAME*)a;
+	const ID_NAME* right = (const ID_NAME*)b;
+	int cmp = strcmp(left->name, right->name);
+
+	if (cmp)
+		return cmp;
+
+	return (left->func < right->func) ? -1 : (left->func > right->func);
+}
+
+
+static int CompareSources(const void* a, const void* b)
+{
+	const ID_SOURCE* left = (const ID_SOURCE*)a;
+	const ID_SOURCE* right = (const ID_SOURCE*)b;
+
+	if (left->typeId != right->typeId)
+		return (left->typeId < right->typeId) ? -1 : 1;
+
+	return (left->id < right->id) ? -1 : (left->id > right->id);
+}
+
+
+PDB_ID_INDEX* PdbIdIndexBuild(PDB_TYPES* ids)
+{
+	PDB_ID_INDEX* index = (PDB_ID_INDEX*)calloc(1, sizeof(PDB_ID_INDEX));
+	uint32_t i;
+
+	if (!index)
+		return NULL;
+
+	if (!PdbTypesWalk(ids, CollectId, index))
+		goto FAIL;
+
+	// The text is done moving, so names can be pointed at now
+	index->byName = (ID_NAME*)malloc(sizeof(ID_NAME) * (index->funcCount + 1));
+	if (!index->byName)
+		goto FAIL;
+
+	for (i = 0; i < index->funcCount; i++)
+	{
+		index->byName[i].name = index->text + index->funcs[i].name;
+		index->byName[i].func = i;
+	}
+
+	qsort(index->byName, index->funcCount, sizeof(ID_NAME), CompareNames);
+	qsort(index->sources, index->sourceCount, sizeof(ID_SOURCE), CompareSources);
+
+	return index;
+
+FAIL:
+	PdbIdIndexClose(index);
+
+	return NULL;
+}
+
+
+void PdbIdIndexClose(PDB_ID_INDEX* index)
+{
+	free(index->funcs);
+	free(index->byName);
+	free(index->strings);
+	free(index->sources);
+	free(index->text);
+	free(index);
+}
+
+
+uint32_t PdbIdIndexGetFunctionCount(PDB_ID_INDEX* index)
+{
+	return index->funcCount;
+}
+
+
+static void FillFunction(PDB_ID_INDEX* index, uint32_t i, PDB_FUNC_ID* func)
+{
+	func->id = index->funcs[i].id;
+	func->leaf = (PDB_LEAF_TYPES)index->funcs[i].leaf;
+	func->scope = index->funcs[i].scope;
+	func->type = index->funcs[i].type;
+	func->name = index->text + index->funcs[i].name;
+}
+
+
+bool PdbIdIndexGetFunction(PDB_ID_INDEX* index, uint32_t id, PDB_FUNC_ID* func)
+{
+	uint32_t low = 0;
+	uint32_t high = index->funcCount;
+
+	while (low < high)
+	{
+		uint32_t mid = low + ((high - low) / 2);
+
+		if (index->funcs[mid].id == id)
+		{
+			FillFunction(index, mid, func);
+			return true;
+		}
+
+		if (index->funcs[mid].id < id)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return false;
+}
+
+
+uint32_t PdbIdIndexFindFunctions(PDB_ID_INDEX* index, const char* name,
+	PdbFuncIdFunction funcFn, void* ctxt)
+{
+	uint32_t low = 0;
+	uint32_t high = index->funcCount;
+	uint32_t count = 0;
+
+	// Find the first entry with the name
+	while (low < high)
+	{
+		uint32_t mid = low + ((high - low) / 2);
+
+		if (strcmp(index->byName[mid].name, name) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (; (low < index->funcCount) && (strcmp(index->byName[low].name, name) == 0); low++)
+	{
+		count++;
+
+		if (funcFn)
+		{
+			PDB_FUNC_ID func;
+
+			FillFunction(index, index->byName[low].func, &func);
+
+			if (!funcFn(ctxt, &func))
+				break;
+		}
+	}
+
+	return count;
+}
+
+
+const char* PdbIdIndexGetString(PDB_ID_INDEX* index, uint32_t id)
+{
+	uint32_t low = 0;
+	uint32_t high = index->stringCount;
+
+	while (low < high)
+	{
+		uint32_t mid = low + ((high - low) / 2);
+
+		if (index->strings[mid].id == id)
+			return index->text + index->strings[mid].text;
+
+		if (index->strings[mid].id < id)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return NULL;
+}
+
+
+bool PdbIdIndexGetUdtSource(PDB_ID_INDEX* index, uint32_t typeId, PDB_UDT_SOURCE* source)
+{
+	uint32_t low = 0;
+	uint32_t high = index->sourceCount;
+	const ID_SOURCE* found;
+
+	// The first record for the type, duplicates come from merged modules
+	while (low < high)
+	{
+		uint32_t mid = low + ((high - low) / 2);
+
+		if (index->sources[mid].typeId < typeId)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if ((low == index->sourceCount) || (index->sources[low].typeId != typeId))
+		return false;
+
+	found = &index->sources[low];
+
+	source->typeId = typeId;
+	source->leaf = (PDB_LEAF_TYPES)found->leaf;
+	source->line = found->line;
+	source->module = found->module;
+
+	if (found->leaf == LEAF_TYPE_UDT_SRC_LINE)
+	{
+		source->file = PdbIdIndexGetString(index, found->src);
+		source->nameOffset = 0;
+	}
+	else
+	{
+		source->file = NULL;
+		source->nameOffset = found->src;
+	}
+
+	return true;
+}
@@ -0,0 +1,83 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __IDINDEX_H__
+#define __IDINDEX_H__
+
+
+typedef struct PDB_ID_INDEX PDB_ID_INDEX;
+
+// A function id (LF_FUNC_ID or LF_MFUNC_ID), what inline sites refer to
+typedef struct PDB_FUNC_ID
+{
+	uint32_t id;
+	PDB_LEAF_TYPES leaf;
+	uint32_t scope; // String id of the scope (LF_FUNC_ID, 0 if global) or the class type (LF_MFUNC_ID)
+	uint32_t type; // The procedure or member function type
+	const char* name; // Owned by the index
+} PDB_FUNC_ID;
+
+// Where a udt is defined (LF_UDT_SRC_LINE or LF_UDT_MOD_SRC_LINE)
+typedef struct PDB_UDT_SOURCE
+{
+	uint32_t typeId;
+	PDB_LEAF_TYPES leaf;
+	const char* file; // Owned by the index, NULL for LF_UDT_MOD_SRC_LINE
+	uint32_t nameOffset; // The file's offset in the /names stream (LF_UDT_MOD_SRC_LINE), see PdbNamesGet
+	uint32_t line;
+	uint16_t module; // The contributing module (LF_UDT_MOD_SRC_LINE)
+} PDB_UDT_SOURCE;
+
+// Called for each function id with a name.  Return false to stop.
+typedef bool (*PdbFuncIdFunction)(void* ctxt, const PDB_FUNC_ID* func);
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Read the id stream (see PdbIdsOpen) once and keep what the lookups
+	// below need in memory, so none of them touch the file
+	PDBAPI PDB_ID_INDEX* PdbIdIndexBuild(PDB_TYPES* ids);
+	PDBAPI void PdbIdIndexClose(PDB_ID_INDEX* index);
+
+	PDBAPI uint32_t PdbIdIndexGetFunctionCount(PDB_ID_INDEX* index);
+	PDBAPI bool PdbIdIndexGetFunction(PDB_ID_INDEX* index, uint32_t id, PDB_FUNC_ID* func);
+
+	// Every function id with the name, in id order.  Returns how many were
+	// reported, funcFn may be NULL to just count them.
+	PDBAPI uint32_t PdbIdIndexFindFunctions(PDB_ID_INDEX* index, const char* name,
+		PdbFuncIdFunction funcFn, void* ctxt);
+
+	// The text of an LF_STRING_ID, NULL if id isn't one
+	PDBAPI const char* PdbIdIndexGetString(PDB_ID_INDEX* index, uint32_t id);
+
+	// typeId is a type index from the type stream, see PdbTypesFind
+	PDBAPI bool PdbIdIndexGetUdtSource(PDB_ID_INDEX* index, uint32_t typeId, PDB_UDT_SOURCE* source);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __IDINDEX_H__ */
@@ -0,0 +1,1019 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "pdb.h"
+#include "dbi.h"
+#include "tpi.h"
+#include "pool.h"
+#include "names.h"
+#include "idindex.h"
+#include "modsyms.h"
+#include "inlines.h"
+#include "internal.h"
+
+
+#define PDB_INLINE_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+// Sites nested deeper than this are skipped
+#define PDB_INLINE_MAX_DEPTH 64
+
+// C13 line subsections
+#define PDB_DEBUG_S_IGNORE 0x80000000
+#define PDB_DEBUG_S_FILECHKSMS 0xF4
+#define PDB_DEBUG_S_INLINEELINES 0xF6
+
+// Inlinee lines with extra files after each entry
+#define PDB_INLINEE_SOURCE_LINE_EX 1
+
+#define PDB_INLINE_NO_FILE 0xffffffff
+
+// Binary annotation opcodes
+enum INLINE_OP
+{
+	INLINE_OP_INVALID = 0, // Padding at the end of the record
+	INLINE_OP_CODE_OFFSET,
+	INLINE_OP_CHANGE_CODE_OFFSET_BASE,
+	INLINE_OP_CHANGE_CODE_OFFSET,
+	INLINE_OP_CHANGE_CODE_LENGTH,
+	INLINE_OP_CHANGE_FILE,
+	INLINE_OP_CHANGE_LINE_OFFSET,
+	INLINE_OP_CHANGE_LINE_END_DELTA,
+	INLINE_OP_CHANGE_RANGE_KIND,
+	INLINE_OP_CHANGE_COLUMN_START,
+	INLINE_OP_CHANGE_COLUMN_END_DELTA,
+	INLINE_OP_CHANGE_CODE_OFFSET_AND_LINE_OFFSET,
+	INLINE_OP_CHANGE_CODE_LENGTH_AND_CODE_OFFSET,
+	INLINE_OP_CHANGE_COLUMN_END
+};
+
+
+typedef struct INLINE_RANGE
+{
+	uint32_t start; // Section offsets
+	uint32_t end;
+	uint32_t inlinee;
+	uint32_t file; // In /names, or PDB_INLINE_NO_FILE
+	uint32_t line;
+	uint32_t depth;
+} INLINE_RANGE;
+
+// Where each inlinee's source starts, from a module's C13 lines
+typedef struct INLINEE_SOURCE
+{
+	uint32_t file; // Into the module's checksums
+	uint32_t line;
+} INLINEE_SOURCE;
+
+typedef struct INLINE_MODULE
+{
+	PDB_STREAM* stream;
+	uint32_t symbolsSize;
+	uint32_t linesOffset; // The C13 lines
+	uint32_t linesSize;
+
+	// Loaded with the module's first function
+	bool loaded;
+	uint32_t* inlinees; // Sorted
+	INLINEE_SOURCE* sources;
+	uint32_t inlineeCount;
+	uint8_t* checksums;
+	uint32_t checksumsSize;
+} INLINE_MODULE;
+
+// One function's decoded sites, allocated as a single block with its
+// arrays after it.  Shared between lookups while refs is held.
+typedef struct INLINE_FUNCTION
+{
+	uint64_t key; // Module, then the offset of its record
+	struct INLINE_FUNCTION* hashNext;
+	struct INLINE_FUNCTION* prev; // Least recently used at the tail
+	struct INLINE_FUNCTION* next;
+	uint32_t refs;
+	bool evicted; // Out of the cache, freed by the last release
+	size_t bytes;
+
+	INLINE_RANGE* ranges; // By depth, then start
+	uint32_t* starts;
+	uint32_t* depthFirst; // The first range at each depth, and one past the last
+	uint32_t depthCount;
+	uint16_t section;
+} INLINE_FUNCTION;
+
+// Ranges while a function is decoded
+typedef struct INLINE_DECODE
+{
+	INLINE_RANGE* ranges;
+	uint32_t count;
+	uint32_t capacity;
+	bool failed;
+} INLINE_DECODE;
+
+struct PDB_INLINE_CACHE
+{
+	PDB_FUNCTION_TABLE* functions;
+	PDB_ID_INDEX* ids;
+	PDB_NAMES* names;
+
+	INLINE_MODULE* modules;
+	uint32_t moduleCount;
+
+	// Everything below is under the lock
+	PDB_LOCK* lock;
+	INLINE_FUNCTION** buckets;
+	uint32_t bucketCount;
+	INLINE_FUNCTION* head;
+	INLINE_FUNCTION* tail;
+	size_t budget;
+	PDB_INLINE_STATS stats;
+};
+
+
+static uint32_t HashKey(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+
+	return (uint32_t)key;
+}
+
+
+static bool ReadOperand(const uint8_t** p, const uint8_t* end, uint32_t* value)
+{
+	const uint8_t* b = *p;
+
+	if (b >= end)
+		return false;
+
+	// 1, 2 or 4 bytes, big endian, the length in the top bits
+	if ((b[0] & 0x80) == 0)
+	{
+		*value = b[0];
+		*p += 1;
+	}
+	else if (((b[0] & 0xc0) == 0x80) && (end - b >= 2))
+	{
+		*value = ((uint32_t)(b[0] & 0x3f) << 8) | b[1];
+		*p += 2;
+	}
+	else if (((b[0] & 0xe0) == 0xc0) && (end - b >= 4))
+	{
+		*value = ((uint32_t)(b[0] & 0x1f) << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+		*p += 4;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+// Signed operands keep the sign in the low bit
+static int32_t DecodeSigned(uint32_t value)
+{
+	return (value & 1) ? -(int32_t)(value >> 1) : (int32_t)(value >> 1);
+}
+
+
+static void LoadModuleLines(INLINE_MODULE* module, INLINE_MODULE* lines)
+{
+	uint8_t* buff = NULL;
+	INLINEE_SOURCE* sources = NULL;
+	uint32_t capacity = 0;
+	uint32_t offset = 0;
+
+	memset(lines, 0, sizeof(INLINE_MODULE));
+
+	if (!module->stream || !module->linesSize)
+		return;
+
+	buff = (uint8_t*)malloc(module->linesSize);
+	if (!buff || !PdbStreamReadAt(module->stream, module->linesOffset, buff, module->linesSize))
+		goto DONE;
+
+	while (module->linesSize - offset >= 8)
+	{
+		const uint8_t* data = buff + offset + 8;
+		uint32_t kind;
+		uint32_t size;
+
+		memcpy(&kind, buff + offset, 4);
+		memcpy(&size, buff + offset + 4, 4);
+
+		if (size > module->linesSize - offset - 8)
+			break;
+
+		kind &= ~PDB_DEBUG_S_IGNORE;
+
+		if ((kind == PDB_DEBUG_S_FILECHKSMS) && !lines->checksums)
+		{
+			lines->checksums = (uint8_t*)malloc(size ? size : 1);
+			if (lines->checksums)
+			{
+				memcpy(lines->checksums, data, size);
+				lines->checksumsSize = size;
+			}
+		}
+		else if ((kind == PDB_DEBUG_S_INLINEELINES) && (size >= 4))
+		{
+			uint32_t signature;
+			uint32_t pos = 4;
+
+			memcpy(&signature, data, 4);
+
+			// inlinee, file, line, then a count of extra files and the files
+			while (size - pos >= 12)
+			{
+				uint32_t inlinee;
+
+				if (lines->inlineeCount == capacity)
+				{
+					uint32_t* inlinees;
+					INLINEE_SOURCE* grown;
+
+					capacity = capacity ? (capacity * 2) : 64;
+					inlinees = (uint32_t*)realloc(lines->inlinees, sizeof(uint32_t) * capacity);
+					if (inlinees)
+						lines->inlinees = inlinees;
+					grown = (INLINEE_SOURCE*)realloc(sources, sizeof(INLINEE_SOURCE) * capacity);
+					if (grown)
+						sources = grown;
+
+					if (!inlinees || !grown)
+						goto DONE;
+				}
+
+				memcpy(&inlinee, data + pos, 4);
+				lines->inlinees[lines->inlineeCount] = inlinee;
+				memcpy(&sources[lines->inlineeCount].file, data + pos + 4, 4);
+				memcpy(&sources[lines->inlineeCount].line, data + pos + 8, 4);
+				lines->inlineeCount++;
+				pos += 12;
+
+				if (signature == PDB_INLINEE_SOURCE_LINE_EX)
+				{
+					uint32_t extra;
+
+					if (size - pos < 4)
+						break;
+
+					memcpy(&extra, data + pos, 4);
+					if (extra > (size - pos - 4) / 4)
+						break;
+
+					pos += 4 + (extra * 4);
+				}
+			}
+		}
+
+		offset += 8 + ((size + 3) & ~3u);
+	}
+
+	// Sorted by inlinee with an insertion sort, the compilers write them
+	// in order already
+	{
+		uint32_t i;
+
+		for (i = 1; i < lines->inlineeCount; i++)
+		{
+			uint32_t key = lines->inlinees[i];
+			INLINEE_SOURCE source = sources[i];
+			uint32_t j;
+
+			for (j = i; (j > 0) && (lines->inlinees[j - 1] > key); j--)
+			{
+				lines->inlinees[j] = lines->inlinees[j - 1];
+				sources[j] = sources[j - 1];
+			}
+
+			lines->inlinees[j] = key;
+			sources[j] = source;
+		}
+	}
+
+DONE:
+	lines->sources = sources;
+	lines->loaded = true;
+	free(buff);
+}
+
+
+static void FreeModuleLines(INLINE_MODULE* module)
+{
+	free(module->inlinees);
+	free(module->sources);
+	free(module->checksums);
+	module->inlinees = NULL;
+	module->sources = NULL;
+	module->checksums = NULL;
+	module->inlineeCount = 0;
+	module->checksumsSize = 0;
+}
+
+
+// The file ids in lines and annotations are offsets into the checksums,
+// which start with the name's offset in /names
+static uint32_t FileName(const INLINE_MODULE* module, uint32_t file)
+{
+	uint32_t name;
+
+	if ((file == PDB_INLINE_NO_FILE) || (file > module->checksumsSize) || (module->checksumsSize - file < 4))
+		return PDB_INLINE_NO_FILE;
+
+	memcpy(&name, module->checksums + file, 4);
+
+	return name;
+}
+
+
+static void AddRange(INLINE_DECODE* decode, uint32_t start, uint32_t end, uint32_t inlinee,
+	uint32_t file, uint32_t line, uint32_t depth)
+{
+	INLINE_RANGE* range;
+
+	if (end <= start)
+		return;
+
+	if (decode->count == decode->capacity)
+	{
+		INLINE_RANGE* ranges;
+
+		decode->capacity = decode->capacity ? (decode->capacity * 2) : 16;
+		ranges = (INLINE_RANGE*)realloc(decode->ranges, sizeof(INLINE_RANGE) * decode->capacity);
+		if (!ranges)
+		{
+			decode->failed = true;
+			return;
+		}
+
+		decode->ranges = ranges;
+	}
+
+	range = &decode->ranges[decode->count++];
+	range->start = start;
+	range->end = end;
+	range->inlinee = inlinee;
+	range->file = file;
+	range->line = line;
+	range->depth = depth;
+}
+
+
+// One site's annotations as they run.  Code offsets are from the start of
+// the function.  Each change of code offset starts a new range with the
+// current line, which runs until the next one or until a code length ends
+// it.
+typedef struct INLINE_SITE
+{
+	INLINE_DECODE* decode;
+	const INLINE_MODULE* module;
+	const PDB_FUNCTION* func;
+	uint32_t inlinee;
+	uint32_t depth;
+
+	bool open;
+	uint32_t openStart;
+	uint32_t openFile;
+	int64_t openLine;
+} INLINE_SITE;
+
+
+static void CloseRange(INLINE_SITE* site, uint32_t codeOffset)
+{
+	if (!site->open)
+		return;
+
+	AddRange(site->decode, site->func->offset + site->openStart, site->func->offset + codeOffset,
+		site->inlinee, FileName(site->module, site->openFile), (uint32_t)site->openLine, site->depth);
+
+	site->open = false;
+}
+
+
+static void OpenRange(INLINE_SITE* site, uint32_t codeOffset, uint32_t file, int64_t line)
+{
+	CloseRange(site, codeOffset);
+
+	site->open = true;
+	site->openStart = codeOffset;
+	site->openFile = file;
+	site->openLine = line;
+}
+
+
+static void RunAnnotations(INLINE_DECODE* decode, const INLINE_MODULE* module, const PDB_FUNCTION* func,
+	uint32_t inlinee, uint32_t depth, const uint8_t* p, const uint8_t* end)
+{
+	uint32_t found = PdbUpperBound(module->inlinees, module->inlineeCount, inlinee);
+	uint32_t file = PDB_INLINE_NO_FILE;
+	int64_t line = 0;
+	uint32_t codeOffset = 0;
+	INLINE_SITE site;
+
+	memset(&site, 0, sizeof(site));
+	site.decode = decode;
+	site.module = module;
+	site.func = func;
+	site.inlinee = inlinee;
+	site.depth = depth;
+
+	// Lines are relative to where the inlinee's source starts
+	if ((found > 0) && (module->inlinees[found - 1] == inlinee))
+	{
+		file = module->sources[found - 1].file;
+		line = module->sources[found - 1].line;
+	}
+
+	while (p < end)
+	{
+		uint32_t op;
+		uint32_t a;
+		uint32_t b;
+
+		if (!ReadOperand(&p, end, &op) || (op == INLINE_OP_INVALID))
+			break;
+
+		if (!ReadOperand(&p, end, &a))
+			break;
+
+		switch (op)
+		{
+		case INLINE_OP_CODE_OFFSET:
+			codeOffset = a;
+			break;
+		case INLINE_OP_CHANGE_CODE_OFFSET:
+			codeOffset += a;
+			OpenRange(&site, codeOffset, file, line);
+			break;
+		case INLINE_OP_CHANGE_CODE_LENGTH:
+			codeOffset += a;
+			CloseRange(&site, codeOffset);
+			break;
+		case INLINE_OP_CHANGE_FILE:
+			file = a;
+			break;
+		case INLINE_OP_CHANGE_LINE_OFFSET:
+			line += DecodeSigned(a);
+			break;
+		case INLINE_OP_CHANGE_CODE_OFFSET_AND_LINE_OFFSET:
+			// The code delta is the low 4 bits, the line delta the rest
+			line += DecodeSigned(a >> 4);
+			codeOffset += a & 0xf;
+			OpenRange(&site, codeOffset, file, line);
+			break;
+		case INLINE_OP_CHANGE_CODE_LENGTH_AND_CODE_OFFSET:
+			// Length first, then the offset
+			if (!ReadOperand(&p, end, &b))
+				goto DONE;
+			codeOffset += b;
+			OpenRange(&site, codeOffset, file, line);
+			codeOffset += a;
+			CloseRange(&site, codeOffset);
+			break;
+		case INLINE_OP_CHANGE_CODE_OFFSET_BASE:
+		case INLINE_OP_CHANGE_LINE_END_DELTA:
+		case INLINE_OP_CHANGE_RANGE_KIND:
+		case INLINE_OP_CHANGE_COLUMN_START:
+		case INLINE_OP_CHANGE_COLUMN_END_DELTA:
+		case INLINE_OP_CHANGE_COLUMN_END:
+			break;
+		default:
+			goto DONE;
+		}
+	}
+
+DONE:
+	// A range still open runs to the end of the function
+	if (site.open && (func->length > site.openStart))
+		CloseRange(&site, func->length);
+}
+
+
+static int CompareRanges(const void* a, const void* b)
+{
+	const INLINE_RANGE* left = (const INLINE_RANGE*)a;
+	const INLINE_RANGE* right = (const INLINE_RANGE*)b;
+
+	if (left->depth != right->depth)
+		return (left->depth < right->depth) ? -1 : 1;
+
+	if (left->start != right->start)
+		return (left->start < right->start) ? -1 : 1;
+
+	return 0;
+}
+
+
+// Read the function's records and run the annotations of every site in it.
+// Runs without the lock, the module's lines are loaded by then.
+static INLINE_FUNCTION* DecodeFunction(const INLINE_MODULE* module, const PDB_FUNCTION* func)
+{
+	INLINE_DECODE decode;
+	INLINE_FUNCTION* function = NULL;
+	uint8_t header[12]; // Length, kind, parent, end
+	uint8_t* buff = NULL;
+	uint32_t end;
+	uint32_t size;
+	uint32_t offset;
+	uint32_t depth = 0;
+	uint32_t i;
+
+	memset(&decode, 0, sizeof(decode));
+
+	if (!module->stream || (func->symbolOffset > module->symbolsSize)
+		|| (module->symbolsSize - func->symbolOffset < sizeof(header)))
+		return NULL;
+
+	if (!PdbStreamReadAt(module->stream, func->symbolOffset, header, sizeof(header)))
+		return NULL;
+
+	memcpy(&end, header + 8, 4);
+	if ((end <= func->symbolOffset) || (end > module->symbolsSize))
+		return NULL;
+
+	size = end - func->symbolOffset;
+	buff = (uint8_t*)malloc(size);
+	if (!buff || !PdbStreamReadAt(module->stream, func->symbolOffset, buff, size))
+		goto DONE;
+
+	// Skip the function's own record
+	offset = 2 + ((uint32_t)header[0] | ((uint32_t)header[1] << 8));
+
+	while (size - offset >= 4)
+	{
+		const uint8_t* record = buff + offset;
+		uint16_t recordLen;
+		uint16_t kind;
+		uint32_t next;
+
+		memcpy(&recordLen, record, 2);
+		memcpy(&kind, record + 2, 2);
+
+		next = offset + 2 + recordLen;
+		if ((recordLen < 2) || (next > size))
+			break;
+
+		if ((kind == SYMBOL_TYPE_INLINESITE) || (kind == SYMBOL_TYPE_INLINESITE2))
+		{
+			// Parent, end, inlinee, and the invocation count for the 2 form
+			uint32_t fixed = (kind == SYMBOL_TYPE_INLINESITE) ? 12 : 16;
+			uint32_t inlinee;
+
+			if ((depth < PDB_INLINE_MAX_DEPTH) && (recordLen - 2u >= fixed))
+			{
+				memcpy(&inlinee, record + 12, 4);
+				RunAnnotations(&decode, module, func, inlinee, depth, record + 4 + fixed, buff + next);
+			}
+
+			depth++;
+		}
+		else if ((kind == SYMBOL_TYPE_INLINESITE_END) && (depth > 0))
+		{
+			depth--;
+		}
+
+		offset = next;
+	}
+
+	if (decode.failed)
+		goto DONE;
+
+	qsort(decode.ranges, decode.count, sizeof(INLINE_RANGE), CompareRanges);
+
+	{
+		uint32_t depthCount = decode.count ? (decode.ranges[decode.count - 1].depth + 1) : 0;
+		size_t bytes = sizeof(INLINE_FUNCTION) + (sizeof(INLINE_RANGE) * decode.count)
+			+ (sizeof(uint32_t) * decode.count) + (sizeof(uint32_t) * (depthCount + 1));
+		uint32_t level = 0;
+
+		function = (INLINE_FUNCTION*)calloc(1, bytes);
+		if (!function)
+			goto DONE;
+
+		function->bytes = bytes;
+		function->section = func->section;
+		function->depthCount = depthCount;
+		function->ranges = (INLINE_RANGE*)(function + 1);
+		function->starts = (uint32_t*)(function->ranges + decode.count);
+		function->depthFirst = function->starts + decode.count;
+
+		for (i = 0; i < decode.count; i++)
+		{
+			function->ranges[i] = decode.ranges[i];
+			function->starts[i] = decode.ranges[i].start;
+
+			while (level <= decode.ranges[i].depth)
+				function->depthFirst[level++] = i;
+		}
+
+		while (level <= depthCount)
+			function->depthFirst[level++] = decode.count;
+	}
+
+DONE:
+	free(buff);
+	free(decode.ranges);
+
+	return function;
+}
+
+
+static INLINE_FUNCTION* HashFind(PDB_INLINE_CACHE* cache, uint64_t key)
+{
+	INLINE_FUNCTION* function = cache->buckets[HashKey(key) & (cache->bucketCount - 1)];
+
+	while (function && (function->key != key))
+		function = function->hashNext;
+
+	return function;
+}
+
+
+static void HashRemove(PDB_INLINE_CACHE* cache, INLINE_FUNCTION* function)
+{
+	INLINE_FUNCTION** link = &cache->buckets[HashKey(function->key) & (cache->bucketCount - 1)];
+
+	while (*link != function)
+		link = &(*link)->hashNext;
+
+	*link = function->hashNext;
+}
+
+
+static void HashInsert(PDB_INLINE_CACHE* cache, INLINE_FUNCTION* function)
+{
+	uint32_t bucket;
+
+	// Keep about one function per bucket
+	if (cache->stats.functions >= cache->bucketCount)
+	{
+		uint32_t count = cache->bucketCount * 2;
+		INLINE_FUNCTION** buckets = (INLINE_FUNCTION**)calloc(count, sizeof(INLINE_FUNCTION*));
+
+		if (buckets)
+		{
+			uint32_t i;
+
+			for (i = 0; i < cache->bucketCount; i++)
+			{
+				while (cache->buckets[i])
+				{
+					INLINE_FUNCTION* moved = cache->buckets[i];
+
+					cache->buckets[i] = moved->hashNext;
+					bucket = HashKey(moved->key) & (count - 1);
+					moved->hashNext = buckets[bucket];
+					buckets[bucket] = moved;
+				}
+			}
+
+			free(cache->buckets);
+			cache->buckets = buckets;
+			cache->bucketCount = count;
+		}
+	}
+
+	bucket = HashKey(function->key) & (cache->bucketCount - 1);
+	function->hashNext = cache->buckets[bucket];
+	cache->buckets[bucket] = function;
+	cache->stats.functions++;
+	cache->stats.bytes += function->bytes;
+}
+
+
+static void LruUnlink(PDB_INLINE_CACHE* cache, INLINE_FUNCTION* function)
+{
+	if (function->prev)
+		function->prev->next = function->next;
+	else
+		cache->head = function->next;
+
+	if (function->next)
+		function->next->prev = function->prev;
+	else
+		cache->tail = function->prev;
+
+	function->prev = NULL;
+	function->next = NULL;
+}
+
+
+static void LruPush(PDB_INLINE_CACHE* cache, INLINE_FUNCTION* function)
+{
+	function->prev = NULL;
+	function->next = cache->head;
+
+	if (cache->head)
+		cache->head->prev = function;
+	else
+		cache->tail = function;
+
+	cache->head = function;
+}
+
+
+// Drop least recently used functions until the rest fit.  One that's in
+// use is freed when its last user releases it.
+static void Evict(PDB_INLINE_CACHE* cache, INLINE_FUNCTION* keep)
+{
+	while ((cache->stats.bytes > cache->budget) && cache->tail && (cache->tail != keep))
+	{
+		INLINE_FUNCTION* victim = cache->tail;
+
+		LruUnlink(cache, victim);
+		HashRemove(cache, victim);
+		cache->stats.functions--;
+		cache->stats.bytes -= victim->bytes;
+		cache->stats.evictions++;
+
+		if (victim->refs)
+			victim->evicted = true;
+		else
+			free(victim);
+	}
+}
+
+
+PDB_INLINE_CACHE* PdbInlineCacheOpen(PDB_DBI* dbi, PDB_FUNCTION_TABLE* functions, PDB_ID_INDEX* ids, size_t budget)
+{
+	PDB_FILE* pdb = PdbDbiGetPdb(dbi);
+	PDB_INLINE_CACHE* cache = (PDB_INLINE_CACHE*)calloc(1, sizeof(PDB_INLINE_CACHE));
+	uint32_t i;
+
+	if (!cache)
+		return NULL;
+
+	cache->functions = functions;
+	cache->ids = ids;
+	cache->budget = budget ? budget : PDB_INLINE_DEFAULT_BUDGET;
+	cache->names = PdbNamesOpen(pdb);
+	cache->moduleCount = PdbDbiGetModuleCount(dbi);
+	cache->modules = (INLINE_MODULE*)calloc(cache->moduleCount ? cache->moduleCount : 1, sizeof(INLINE_MODULE));
+	cache->bucketCount = 256;
+	cache->buckets = (INLINE_FUNCTION**)calloc(cache->bucketCount, sizeof(INLINE_FUNCTION*));
+	cache->lock = PdbLockCreate();
+
+	if (!cache->modules || !cache->buckets || !cache->lock)
+		goto FAIL;
+
+	// Opening a stream isn't thread safe, so they're all opened here and
+	// lookups only make positioned reads
+	for (i = 0; i < cache->moduleCount; i++)
+	{
+		INLINE_MODULE* module = &cache->modules[i];
+		PDB_MODULE info;
+
+		if (!PdbDbiGetModule(dbi, i, &info) || (info.stream == PDB_STREAM_NONE))
+			continue;
+
+		module->stream = PdbStreamOpen(pdb, info.stream);
+		if (!module->stream)
+			continue;
+
+		module->symbolsSize = info.symbolsSize;
+		module->linesOffset = info.symbolsSize + info.linesSize;
+		module->linesSize = info.c13LinesSize;
+
+		if ((uint64_t)module->linesOffset + module->linesSize > PdbStreamGetSize(module->stream))
+			module->linesSize = 0;
+		if (module->symbolsSize > PdbStreamGetSize(module->stream))
+			module->symbolsSize = PdbStreamGetSize(module->stream);
+	}
+
+	return cache;
+
+FAIL:
+	PdbInlineCacheClose(cache);
+
+	return NULL;
+}
+
+
+void PdbInlineCacheClose(PDB_INLINE_CACHE* cache)
+{
+	INLINE_FUNCTION* function = cache->head;
+	uint32_t i;
+
+	while (function)
+	{
+		INLINE_FUNCTION* next = function->next;
+
+		free(function);
+		function = next;
+	}
+
+	if (cache->modules)
+	{
+		for (i = 0; i < cache->moduleCount; i++)
+		{
+			if (cache->modules[i].stream)
+				PdbStreamClose(cache->modules[i].stream);
+			FreeModuleLines(&cache->modules[i]);
+		}
+	}
+
+	if (cache->names)
+		PdbNamesClose(cache->names);
+	if (cache->lock)
+		PdbLockDestroy(cache->lock);
+
+	free(cache->modules);
+	free(cache->buckets);
+	free(cache);
+}
+
+
+// Find the function's decoded sites, decoding them if they aren't cached.
+// Decoding happens outside the lock; if two threads decode the same
+// function the first one in wins.
+static INLINE_FUNCTION* AcquireFunction(PDB_INLINE_CACHE* cache, const PDB_FUNCTION* func)
+{
+	INLINE_MODULE* module;
+	INLINE_FUNCTION* function;
+	INLINE_FUNCTION* decoded;
+	uint64_t key = ((uint64_t)func->module << 32) | func->symbolOffset;
+	bool loaded;
+
+	if (func->module >= cache->moduleCount)
+		return NULL;
+
+	module = &cache->modules[func->module];
+
+	PdbLockAcquire(cache->lock);
+
+	function = HashFind(cache, key);
+	if (function)
+	{
+		function->refs++;
+		LruUnlink(cache, function);
+		LruPush(cache, function);
+		cache->stats.hits++;
+	}
+
+	loaded = module->loaded;
+
+	PdbLockRelease(cache->lock);
+
+	if (function)
+		return function;
+
+	if (!loaded)
+	{
+		INLINE_MODULE lines;
+
+		LoadModuleLines(module, &lines);
+
+		PdbLockAcquire(cache->lock);
+
+		if (!module->loaded)
+		{
+			module->inlinees = lines.inlinees;
+			module->sources = lines.sources;
+			module->inlineeCount = lines.inlineeCount;
+			module->checksums = lines.checksums;
+			module->checksumsSize = lines.checksumsSize;
+			module->loaded = true;
+		}
+		else
+		{
+			FreeModuleLines(&lines);
+		}
+
+		PdbLockRelease(cache->lock);
+	}
+
+	decoded = DecodeFunction(module, func);
+	if (!decoded)
+		return NULL;
+
+	decoded->key = key;
+
+	PdbLockAcquire(cache->lock);
+
+	function = HashFind(cache, key);
+	if (function)
+	{
+		LruUnlink(cache, function);
+		cache->stats.hits++;
+	}
+	else
+	{
+		function = decoded;
+		decoded = NULL;
+		HashInsert(cache, function);
+		cache->stats.misses++;
+	}
+
+	function->refs++;
+	LruPush(cache, function);
+	Evict(cache, function);
+
+	PdbLockRelease(cache->lock);
+
+	free(decoded);
+
+	return function;
+}
+
+
+static void ReleaseFunction(PDB_INLINE_CACHE* cache, INLINE_FUNCTION* function)
+{
+	bool last;
+
+	PdbLockAcquire(cache->lock);
+
+	function->refs--;
+	last = (function->refs == 0) && function->evicted;
+
+	PdbLockRelease(cache->lock);
+
+	if (last)
+		free(function);
+}
+
+
+uint32_t PdbInlineCacheFind(PDB_INLINE_CACHE* cache, uint16_t section, uint32_t offset,
+	PDB_INLINE_FRAME* frames, uint32_t max)
+{
+	PDB_FUNCTION func;
+	INLINE_FUNCTION* function;
+	uint32_t count = 0;
+	uint32_t depth;
+
+	if (!PdbFunctionTableFind(cache->functions, section, offset, &func))
+		return 0;
+
+	function = AcquireFunction(cache, &func);
+	if (!function)
+		return 0;
+
+	// Sites at one depth don't overlap, so each depth is a single search.
+	// A depth that doesn't cover the address can't have deeper ones that do.
+	for (depth = 0; depth < function->depthCount; depth++)
+	{
+		uint32_t first = function->depthFirst[depth];
+		uint32_t found = PdbUpperBound(function->starts + first, function->depthFirst[depth + 1] - first, offset);
+		const INLINE_RANGE* range;
+
+		if (found == 0)
+			break;
+
+		range = &function->ranges[first + found - 1];
+		if (offset >= range->end)
+			break;
+
+		if (count < max)
+		{
+			PDB_INLINE_FRAME* frame = &frames[count];
+			PDB_FUNC_ID id;
+
+			frame->inlinee = range->inlinee;
+			frame->name = (cache->ids && PdbIdIndexGetFunction(cache->ids, range->inlinee, &id)) ? id.name : NULL;
+			frame->file = (cache->names && (range->file != PDB_INLINE_NO_FILE))
+				? PdbNamesGet(cache->names, range->file) : NULL;
+			frame->line = range->line;
+			frame->section = function->section;
+			frame->offset = range->start;
+			frame->length = range->end - range->start;
+			frame->depth = depth;
+		}
+
+		count++;
+	}
+
+	ReleaseFunction(cache, function);
+
+	return count;
+}
+
+
+void PdbInlineCacheGetStats(PDB_INLINE_CACHE* cache, PDB_INLINE_STATS* stats)
+{
+	PdbLockAcquire(cache->lock);
+	*stats = cache->stats;
+	PdbLockRelease(cache->lock);
+}
@@ -0,0 +1,81 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __INLINES_H__
+#define __INLINES_H__
+
+
+typedef struct PDB_INLINE_CACHE PDB_INLINE_CACHE;
+
+// One inlined call the address is in
+typedef struct PDB_INLINE_FRAME
+{
+	uint32_t inlinee; // The LF_FUNC_ID or LF_MFUNC_ID in the id stream
+	const char* name; // From the id index, NULL without one
+	const char* file; // NULL if the module's lines don't say
+	uint32_t line;
+	uint16_t section;
+	uint32_t offset; // The range of code the line covers
+	uint32_t length;
+	uint32_t depth; // 0 for a call inlined straight into the function
+} PDB_INLINE_FRAME;
+
+typedef struct PDB_INLINE_STATS
+{
+	uint64_t hits; // Lookups answered from a decoded function
+	uint64_t misses; // Functions that had to be decoded
+	uint64_t evictions;
+	uint64_t bytes; // Held by decoded functions
+	uint32_t functions;
+} PDB_INLINE_STATS;
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Inline sites are described by S_INLINESITE records inside each
+	// function, as binary annotations: a little program that walks the
+	// function's code giving the line of each range.  The cache runs a
+	// function's annotations the first time an address in it is looked up
+	// and keeps the resulting ranges, least recently used functions going
+	// once the decoded ones take more than budget bytes (0 for a default).
+	// ids may be NULL if names aren't needed.  Lookups can be made from
+	// several threads at once, they share the decoded functions.
+	PDBAPI PDB_INLINE_CACHE* PdbInlineCacheOpen(PDB_DBI* dbi, PDB_FUNCTION_TABLE* functions,
+		PDB_ID_INDEX* ids, size_t budget);
+	PDBAPI void PdbInlineCacheClose(PDB_INLINE_CACHE* cache);
+
+	// The inlined calls at the address, outermost first.  Returns how many
+	// there are, of which the first max are stored in frames.
+	PDBAPI uint32_t PdbInlineCacheFind(PDB_INLINE_CACHE* cache, uint16_t section, uint32_t offset,
+		PDB_INLINE_FRAME* frames, uint32_t max);
+
+	PDBAPI void PdbInlineCacheGetStats(PDB_INLINE_CACHE* cache, PDB_INLINE_STATS* stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __INLINES_H__ */
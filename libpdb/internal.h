@@ -0,0 +1,223 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __INTERNAL_H__
+#define __INTERNAL_H__
+
+// Helpers shared between the library's modules, not exported
+
+
+// Monotonic clock in nanoseconds
+uint64_t PdbTimeNow(void);
+
+// Cache line aligned memory, for arrays that are searched a lot
+#define PDB_CACHE_LINE 64
+
+void* PdbAlignedAlloc(size_t size);
+void PdbAlignedFree(void* ptr);
+
+// The number of sorted keys <= key, branch free
+uint32_t PdbUpperBound(const uint32_t* keys, uint32_t count, uint32_t key);
+
+// Read from the pdb's source without touching the stats, so it is safe to
+// call from several threads at once
+bool PdbFileReadAt(PDB_FILE* pdb, void* buff, size_t bytes, uint64_t offset);
+
+// A read window onto a stream for parsers that decode a field at a time.
+// The window is the stream's page buffer, so the inline readers below only
+// call into the stream when it runs out.  Don't mix in PdbStreamRead on the
+// same stream while a cursor is in use, PdbCursorClose moves the stream's
+// read position to where the cursor stopped.
+typedef struct PDB_CURSOR
+{
+	PDB_STREAM* stream;
+	const uint8_t* data; // The window, data[0] is at stream offset base
+	uint64_t base;
+	uint32_t pos; // Read position in the window
+	uint32_t len; // Bytes in the window
+	uint32_t size; // Bytes in the stream
+} PDB_CURSOR;
+
+void PdbCursorOpen(PDB_CURSOR* cursor, PDB_STREAM* stream, uint64_t offset);
+void PdbCursorClose(PDB_CURSOR* cursor);
+
+// Slide the window so it holds at least bytes from the read position.  False
+// if the stream ends first.
+bool PdbCursorFill(PDB_CURSOR* cursor, uint32_t bytes);
+
+// The out of line halves of the readers below, for when the window runs out
+bool PdbCursorReadSlow(PDB_CURSOR* cursor, void* buff, uint64_t bytes);
+bool PdbCursorReadCStringSlow(PDB_CURSOR* cursor, char* buff, size_t size);
+bool PdbCursorReadNumericSlow(PDB_CURSOR* cursor, uint64_t* value); // In tpi.c
+
+static inline uint64_t PdbCursorTell(const PDB_CURSOR* cursor)
+{
+	return cursor->base + cursor->pos;
+}
+
+static inline bool PdbCursorSeek(PDB_CURSOR* cursor, uint64_t offset)
+{
+	if (offset > cursor->size)
+		return false;
+
+	// Keep the window if the offset is in it
+	if ((offset >= cursor->base) && (offset - cursor->base <= cursor->len))
+	{
+		cursor->pos = (uint32_t)(offset - cursor->base);
+	}
+	else
+	{
+		cursor->base = offset;
+		cursor->pos = 0;
+		cursor->len = 0;
+	}
+
+	return true;
+}
+
+static inline bool PdbCursorSkip(PDB_CURSOR* cursor, uint64_t bytes)
+{
+	return PdbCursorSeek(cursor, PdbCursorTell(cursor) + bytes);
+}
+
+static inline bool PdbCursorRead(PDB_CURSOR* cursor, void* buff, uint64_t bytes)
+{
+	if ((bytes > cursor->len - cursor->pos) || !bytes)
+		return PdbCursorReadSlow(cursor, buff, bytes);
+
+	memcpy(buff, cursor->data + cursor->pos, (size_t)bytes);
+	cursor->pos += (uint32_t)bytes;
+
+	return true;
+}
+
+static inline bool PdbCursorReadU16(PDB_CURSOR* cursor, uint16_t* value)
+{
+	if ((cursor->len - cursor->pos < 2) && !PdbCursorFill(cursor, 2))
+		return false;
+
+	memcpy(value, cursor->data + cursor->pos, 2);
+	cursor->pos += 2;
+
+	return true;
+}
+
+static inline bool PdbCursorReadU32(PDB_CURSOR* cursor, uint32_t* value)
+{
+	if ((cursor->len - cursor->pos < 4) && !PdbCursorFill(cursor, 4))
+		return false;
+
+	memcpy(value, cursor->data + cursor->pos, 4);
+	cursor->pos += 4;
+
+	return true;
+}
+
+// The next bytes in the window without reading past them, NULL if they
+// can't all be in it at once
+static inline const uint8_t* PdbCursorPeek(PDB_CURSOR* cursor, uint32_t bytes)
+{
+	if ((cursor->len - cursor->pos < bytes) && !PdbCursorFill(cursor, bytes))
+		return NULL;
+
+	return cursor->data + cursor->pos;
+}
+
+// Read a terminated string, cut to fit in size bytes (terminator included)
+// but always consumed up to and including its terminator
+static inline bool PdbCursorReadCString(PDB_CURSOR* cursor, char* buff, size_t size)
+{
+	const uint8_t* start = NULL;
+	const uint8_t* end = NULL;
+
+	if (cursor->len > cursor->pos)
+	{
+		start = cursor->data + cursor->pos;
+		end = (const uint8_t*)memchr(start, 0, cursor->len - cursor->pos);
+	}
+
+	if (!end || ((size_t)(end - start) >= size))
+		return PdbCursorReadCStringSlow(cursor, buff, size);
+
+	memcpy(buff, start, (end - start) + 1);
+	cursor->pos += (uint32_t)(end - start) + 1;
+
+	return true;
+}
+
+// Read a numeric leaf (see PdbTypesReadNumeric).  Values under 0x8000 are
+// the leaf itself and never leave the window.
+static inline bool PdbCursorReadNumeric(PDB_CURSOR* cursor, uint64_t* value)
+{
+	uint16_t leaf;
+
+	if (cursor->len - cursor->pos >= 2)
+	{
+		memcpy(&leaf, cursor->data + cursor->pos, 2);
+		if (leaf < 0x8000)
+		{
+			*value = leaf;
+			cursor->pos += 2;
+			return true;
+		}
+	}
+
+	return PdbCursorReadNumericSlow(cursor, value);
+}
+
+// Called with each symbol record a scan keeps, starting with its kind and
+// terminated after its recordLen bytes.  False stops the scan.
+typedef bool (*PdbSymbolRecordFunction)(void* ctxt, const uint8_t* record, uint16_t recordLen);
+
+// Walk a symbol record stream, passing recordFn the records of the given
+// kinds that are at least minLen long.  Only those are copied out of the
+// stream.  False if recordFn stops it or the stream ends mid record.
+bool PdbDbiScanSymbolRecords(PDB_STREAM* stream, const uint16_t* kinds, uint32_t kindCount, uint16_t minLen,
+	PdbSymbolRecordFunction recordFn, void* ctxt);
+
+// The FILE behind a source from PdbIoOpenFile, NULL for any other source
+FILE* PdbIoGetFile(const PDB_IO_OPS* io, void* ctxt);
+
+// MSFZ (compressed) containers.  NULL if the file isn't one or is damaged.
+// Reads are safe from several threads at once.
+typedef struct PDB_MSFZ PDB_MSFZ;
+
+PDB_MSFZ* PdbMsfzOpen(PDB_FILE* pdb, uint64_t fileSize);
+void PdbMsfzClose(PDB_MSFZ* msfz);
+uint32_t PdbMsfzGetStreamCount(PDB_MSFZ* msfz);
+bool PdbMsfzGetStreamSize(PDB_MSFZ* msfz, uint32_t streamId, uint32_t* size); // False for nil streams
+bool PdbMsfzRead(PDB_MSFZ* msfz, uint32_t streamId, uint64_t offset, uint8_t* buff, uint64_t bytes);
+
+// Add the time since start to the subsystem's counter
+void PdbStatsAddTime(PDB_FILE* pdb, PDB_SUBSYSTEM subsystem, uint64_t start);
+
+// The installed trace hook, NULL when tracing is off.  Check PDB_TRACING()
+// before building an event so disabled tracing costs a single branch.
+extern PdbTraceFunction g_pdbTraceFn;
+
+#define PDB_TRACING() (g_pdbTraceFn != NULL)
+
+// Report a phase begin/end, or an I/O event that started at start
+void PdbTraceEmit(PDB_TRACE_EVENT event, const char* name, uint64_t arg, uint64_t start);
+
+
+#endif /* __INTERNAL_H__ */
@@ -0,0 +1,249 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef WIN32
+#define _FILE_OFFSET_BITS 64 // off_t past 4GB on 32 bit builds
+#endif /* WIN32 */
+
+#include <string.h>
+#include <errno.h>
+
+#include "pdb.h"
+#include "internal.h"
+
+#ifdef WIN32
+#include <windows.h>
+#include <io.h>
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif /* WIN32 */
+
+
+typedef struct PDB_IO_FILE
+{
+	FILE* file;
+	uint64_t size;
+} PDB_IO_FILE;
+
+typedef struct PDB_IO_MEMORY
+{
+	const uint8_t* data;
+	size_t size;
+} PDB_IO_MEMORY;
+
+
+// Positioned reads don't go through (or move) the stdio position, so they
+// are safe to make from several threads at once
+static bool FileRead(void* ctxt, uint64_t offset, void* buff, size_t bytes)
+{
+	PDB_IO_FILE* io = (PDB_IO_FILE*)ctxt;
+#ifdef WIN32
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno(io->file));
+	OVERLAPPED overlapped;
+	DWORD bytesRead;
+
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = (DWORD)offset;
+	overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+	if (!ReadFile(file, buff, (DWORD)bytes, &bytesRead, &overlapped))
+		return false;
+
+	return (bytesRead == bytes);
+#else
+	uint8_t* pbuff = (uint8_t*)buff;
+
+	while (bytes)
+	{
+		ssize_t bytesRead = pread(fileno(io->file), pbuff, bytes, (off_t)offset);
+
+		if (bytesRead < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		// Ran off the end of the file
+		if (bytesRead == 0)
+			return false;
+
+		pbuff += bytesRead;
+		bytes -= (size_t)bytesRead;
+		offset += (uint64_t)bytesRead;
+	}
+
+	return true;
+#endif /* WIN32 */
+}
+
+
+static uint64_t FileGetSize(void* ctxt)
+{
+	return ((PDB_IO_FILE*)ctxt)->size;
+}
+
+
+static void FileAdvise(void* ctxt, uint64_t offset, uint64_t bytes, PDB_IO_ADVICE advice)
+{
+#ifdef WIN32
+	// No equivalent for a stdio handle, the hints are best effort anyway
+	(void)ctxt;
+	(void)offset;
+	(void)bytes;
+	(void)advice;
+#else
+	PDB_IO_FILE* io = (PDB_IO_FILE*)ctxt;
+	int posixAdvice;
+
+	switch (advice)
+	{
+	case PDB_IO_WILLNEED:
+		posixAdvice = POSIX_FADV_WILLNEED;
+		break;
+	case PDB_IO_DONTNEED:
+		posixAdvice = POSIX_FADV_DONTNEED;
+		break;
+	case PDB_IO_RANDOM:
+		posixAdvice = POSIX_FADV_RANDOM;
+		break;
+	default:
+		posixAdvice = POSIX_FADV_NORMAL;
+		break;
+	}
+
+	posix_fadvise(fileno(io->file), (off_t)offset, (off_t)bytes, posixAdvice);
+#endif /* WIN32 */
+}
+
+
+static void FileClose(void* ctxt)
+{
+	PDB_IO_FILE* io = (PDB_IO_FILE*)ctxt;
+
+	fclose(io->file);
+	free(io);
+}
+
+
+static const PDB_IO_OPS g_pdbFileIo =
+{
+	FileRead,
+	FileGetSize,
+	FileAdvise,
+	FileClose
+};
+
+
+const PDB_IO_OPS* PdbIoOpenFile(const char* name, void** ctxt)
+{
+	PDB_IO_FILE* io;
+	FILE* file = fopen(name, "rb");
+
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open pdb file.  OS reports: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	io = (PDB_IO_FILE*)malloc(sizeof(PDB_IO_FILE));
+	if (!io)
+	{
+		fclose(file);
+		return NULL;
+	}
+
+	io->file = file;
+
+	// Sizing doesn't disturb the positioned reads
+	if (fseeko(file, 0, SEEK_END))
+	{
+		FileClose(io);
+		return NULL;
+	}
+
+	io->size = (uint64_t)ftello(file);
+
+	*ctxt = io;
+	return &g_pdbFileIo;
+}
+
+
+FILE* PdbIoGetFile(const PDB_IO_OPS* io, void* ctxt)
+{
+	if (io != &g_pdbFileIo)
+		return NULL;
+
+	return ((PDB_IO_FILE*)ctxt)->file;
+}
+
+
+static bool MemoryRead(void* ctxt, uint64_t offset, void* buff, size_t bytes)
+{
+	PDB_IO_MEMORY* io = (PDB_IO_MEMORY*)ctxt;
+
+	if ((offset > io->size) || (bytes > io->size - offset))
+		return false;
+
+	memcpy(buff, io->data + offset, bytes);
+
+	return true;
+}
+
+
+static uint64_t MemoryGetSize(void* ctxt)
+{
+	return ((PDB_IO_MEMORY*)ctxt)->size;
+}
+
+
+static void MemoryClose(void* ctxt)
+{
+	free(ctxt);
+}
+
+
+static const PDB_IO_OPS g_pdbMemoryIo =
+{
+	MemoryRead,
+	MemoryGetSize,
+	NULL,
+	MemoryClose
+};
+
+
+const PDB_IO_OPS* PdbIoOpenMemory(const void* data, size_t size, void** ctxt)
+{
+	PDB_IO_MEMORY* io = (PDB_IO_MEMORY*)malloc(sizeof(PDB_IO_MEMORY));
+
+	if (!io)
+		return NULL;
+
+	io->data = (const uint8_t*)data;
+	io->size = size;
+
+	*ctxt = io;
+	return &g_pdbMemoryIo;
+}
@@ -0,0 +1,839 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "tpi.h"
+#include "layout.h"
+
+
+// Nodes, fields and names are carved out of chunks this big
+#define PDB_LAYOUT_CHUNK_SIZE (64 * 1024)
+
+// Longer modifier, array or base class chains than this are taken to be a
+// broken (cyclic) type graph
+#define PDB_LAYOUT_MAX_DEPTH 256
+
+// How many field list records a single udt can continue through
+#define PDB_LAYOUT_MAX_LISTS 64
+
+
+typedef struct PDB_LAYOUT_CHUNK
+{
+	struct PDB_LAYOUT_CHUNK* next;
+	size_t used;
+	size_t size;
+	uint8_t data[1];
+} PDB_LAYOUT_CHUNK;
+
+struct PDB_LAYOUT
+{
+	PDB_TYPES* types;
+	uint32_t minId;
+	uint32_t typeCount;
+	PDB_TYPE_NODE** nodes; // Memoized nodes by type index
+	PDB_TYPE_NODE* simple[PDB_TYPE_SIMPLE_MAX]; // And for the built in types
+	PDB_LAYOUT_CHUNK* chunks;
+	PDB_TYPE_NODE** pending; // Work list for CompleteNode
+	uint32_t pendingSize;
+};
+
+// Udt nodes are decoded with their field list, but what the fields embed is
+// only resolved when asked for.  Completed nodes have every type reachable
+// without following a pointer resolved.
+typedef struct PDB_LAYOUT_NODE
+{
+	PDB_TYPE_NODE node;
+	bool complete;
+} PDB_LAYOUT_NODE;
+
+// A field list entry pulled out of the record before its type is resolved,
+// since resolving reuses the record buffer
+typedef struct PDB_LAYOUT_ENTRY
+{
+	PDB_TYPE_MEMBER member;
+	const char* name; // Copied out of the record
+} PDB_LAYOUT_ENTRY;
+
+
+static const PDB_TYPE_NODE* ResolveNode(PDB_LAYOUT* layout, uint32_t typeId, uint32_t depth);
+
+
+static void* LayoutAlloc(PDB_LAYOUT* layout, size_t bytes)
+{
+	PDB_LAYOUT_CHUNK* chunk = layout->chunks;
+	void* result;
+
+	// Keep everything pointer aligned
+	bytes = (bytes + 7) & ~(size_t)7;
+
+	if (!chunk || (chunk->used + bytes > chunk->size))
+	{
+		size_t size = (bytes > PDB_LAYOUT_CHUNK_SIZE) ? bytes : PDB_LAYOUT_CHUNK_SIZE;
+
+		chunk = (PDB_LAYOUT_CHUNK*)malloc(sizeof(PDB_LAYOUT_CHUNK) + size);
+		if (!chunk)
+			return NULL;
+
+		chunk->next = layout->chunks;
+		chunk->used = 0;
+		chunk->size = size;
+		layout->chunks = chunk;
+	}
+
+	result = chunk->data + chunk->used;
+	chunk->used += bytes;
+
+	return result;
+}
+
+
+static const char* LayoutCopyString(PDB_LAYOUT* layout, const char* str)
+{
+	size_t len = strlen(str) + 1;
+	char* copy = (char*)LayoutAlloc(layout, len);
+
+	if (copy)
+		memcpy(copy, str, len);
+
+	return copy;
+}
+
+
+static PDB_TYPE_NODE* NewNode(PDB_LAYOUT* layout, uint32_t typeId, PDB_NODE_KIND kind, uint16_t leaf)
+{
+	PDB_TYPE_NODE* node = (PDB_TYPE_NODE*)LayoutAlloc(layout, sizeof(PDB_LAYOUT_NODE));
+
+	if (!node)
+		return NULL;
+
+	memset(node, 0, sizeof(PDB_LAYOUT_NODE));
+	node->typeId = typeId;
+	node->kind = kind;
+	node->leaf = leaf;
+
+	return node;
+}
+
+
+static const PDB_TYPE_NODE* ResolveSimple(PDB_LAYOUT* layout, uint32_t typeId)
+{
+	PDB_TYPE_NODE* node = layout->simple[typeId];
+
+	if (node)
+		return node;
+
+	if (PDB_TYPE_SIMPLE_MODE(typeId))
+	{
+		// Pointers to built in types are encoded in the index itself
+		node = NewNode(layout, typeId, PDB_NODE_POINTER, 0);
+		if (!node)
+			return NULL;
+		node->pointee = PDB_TYPE_SIMPLE_KIND(typeId);
+	}
+	else
+	{
+		node = NewNode(layout, typeId, PDB_NODE_SIMPLE, 0);
+		if (!node)
+			return NULL;
+		node->name = PdbTypesGetSimpleName(typeId);
+	}
+
+	node->size = PdbTypesGetSimpleSize(typeId);
+	layout->simple[typeId] = node;
+
+	return node;
+}
+
+
+// Gather the entries of a field list, following LF_INDEX continuations.
+// The caller frees the array.
+static PDB_LAYOUT_ENTRY* ReadFieldList(PDB_LAYOUT* layout, uint32_t field, uint32_t* count)
+{
+	PDB_LAYOUT_ENTRY* entries = NULL;
+	uint32_t capacity = 0;
+	uint32_t lists;
+
+	*count = 0;
+
+	for (lists = 0; field && (lists < PDB_LAYOUT_MAX_LISTS); lists++)
+	{
+		const uint8_t* data;
+		uint16_t leaf;
+		uint16_t len;
+		size_t pos = 0;
+		bool validated;
+
+		if (!PdbTypesGetRecord(layout->types, field, &leaf, &data, &len)
+			|| (leaf != LEAF_TYPE_FIELDLIST))
+			break;
+
+		field = 0;
+
+		// Records of a validated stream skip the decoder's bounds checks
+		validated = PdbTypesValidate(layout->types);
+
+		while (pos < len)
+		{
+			PDB_TYPE_MEMBER member;
+			size_t memberLen = validated ? PdbTypesParseMemberUnchecked(data + pos, len - pos, &member)
+				: PdbTypesParseMember(data + pos, len - pos, &member);
+
+			if (memberLen == 0)
+				break;
+
+			pos += memberLen;
+
+			switch (member.leaf)
+			{
+			case LEAF_TYPE_INDEX:
+				field = member.type;
+				continue;
+			case LEAF_TYPE_MEMBER:
+			case LEAF_TYPE_BCLASS:
+			case LEAF_TYPE_VBCLASS:
+			case LEAF_TYPE_IVBCLASS:
+			case LEAF_TYPE_VFUNCTAB:
+			case LEAF_TYPE_ENUMERATE:
+				break;
+			default:
+				// Takes no space in the object
+				continue;
+			}
+
+			if (*count == capacity)
+			{
+				PDB_LAYOUT_ENTRY* grown;
+
+				capacity = capacity ? (capacity * 2) : 32;
+				grown = (PDB_LAYOUT_ENTRY*)realloc(entries, capacity * sizeof(PDB_LAYOUT_ENTRY));
+				if (!grown)
+				{
+					free(entries);
+					*count = 0;
+					return NULL;
+				}
+				entries = grown;
+			}
+
+			entries[*count].member = member;
+			entries[*count].name = member.name ? LayoutCopyString(layout, member.name) : NULL;
+			(*count)++;
+		}
+	}
+
+	return entries;
+}
+
+
+static bool ResolveFields(PDB_LAYOUT* layout, PDB_TYPE_NODE* node, uint32_t field)
+{
+	PDB_LAYOUT_ENTRY* entries;
+	PDB_TYPE_FIELD* fields;
+	uint32_t count;
+	uint32_t i;
+
+	entries = ReadFieldList(layout, field, &count);
+	if (!count)
+	{
+		free(entries);
+		return true;
+	}
+
+	fields = (PDB_TYPE_FIELD*)LayoutAlloc(layout, count * sizeof(PDB_TYPE_FIELD));
+	if (!fields)
+	{
+		free(entries);
+		return false;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		fields[i].leaf = entries[i].member.leaf;
+		fields[i].name = entries[i].name;
+		fields[i].offset = entries[i].member.offset;
+		fields[i].attr = entries[i].member.attr;
+		fields[i].typeId = (entries[i].member.leaf == LEAF_TYPE_ENUMERATE) ? 0 : entries[i].member.type;
+		fields[i].type = NULL;
+	}
+
+	node->fields = fields;
+	node->fieldCount = count;
+
+	free(entries);
+
+	return true;
+}
+
+
+static const PDB_TYPE_NODE* ResolveUdt(PDB_LAYOUT* layout, uint32_t typeId, uint16_t leaf,
+	const uint8_t* data, uint16_t len, uint32_t depth)
+{
+	PDB_TYPE_UDT udt;
+	PDB_TYPE_NODE* node;
+	const char* name;
+	uint32_t index = typeId - layout->minId;
+
+	if (PdbTypesValidate(layout->types) ? !PdbTypesParseUdtUnchecked(leaf, data, len, &udt, &name)
+		: !PdbTypesParseUdt(leaf, data, len, &udt, &name))
+		return NewNode(layout, typeId, PDB_NODE_UNKNOWN, leaf);
+
+	// The name lives in the record buffer, which the lookups below reuse
+	name = LayoutCopyString(layout, name);
+	if (!name)
+		return NULL;
+
+	// Members usually refer to the forward reference, lay out the definition
+	if (udt.prop & PDB_TYPE_PROP_FWDREF)
+	{
+		PDB_TYPE_UDT definition;
+
+		if (PdbTypesFind(layout->types, name, &definition) && (definition.typeId != typeId))
+		{
+			const PDB_TYPE_NODE* resolved = ResolveNode(layout, definition.typeId, depth + 1);
+
+			layout->nodes[index] = (PDB_TYPE_NODE*)resolved;
+			return resolved;
+		}
+	}
+
+	if (leaf == LEAF_TYPE_ENUM)
+		node = NewNode(layout, typeId, PDB_NODE_ENUM, leaf);
+	else if (leaf == LEAF_TYPE_UNION)
+		node = NewNode(layout, typeId, PDB_NODE_UNION, leaf);
+	else
+		node = NewNode(layout, typeId, PDB_NODE_STRUCT, leaf);
+
+	if (!node)
+		return NULL;
+
+	node->name = name;
+	node->size = udt.size;
+	node->attr = udt.prop;
+
+	layout->nodes[index] = node;
+
+	if (leaf == LEAF_TYPE_ENUM)
+	{
+		node->element = ResolveNode(layout, udt.utype, depth + 1);
+		if (node->element)
+			node->size = node->element->size;
+	}
+
+	if (!ResolveFields(layout, node, udt.field))
+		return NULL;
+
+	return node;
+}
+
+
+static const PDB_TYPE_NODE* ResolveRecord(PDB_LAYOUT* layout, uint32_t typeId, uint32_t depth)
+{
+	PDB_TYPE_NODE* node;
+	const uint8_t* data;
+	uint16_t leaf;
+	uint16_t len;
+	uint32_t elementId;
+	size_t numLen;
+
+	if (!PdbTypesGetRecord(layout->types, typeId, &leaf, &data, &len))
+		return NULL;
+
+	switch (leaf)
+	{
+	case LEAF_TYPE_STRUCTURE:
+	case LEAF_TYPE_CLASS:
+	case LEAF_TYPE_INTERFACE:
+	case LEAF_TYPE_UNION:
+	case LEAF_TYPE_ENUM:
+		return ResolveUdt(layout, typeId, leaf, data, len, depth);
+	case LEAF_TYPE_POINTER:
+		// type, attributes (size in bits 13-18)
+		node = NewNode(layout, typeId, PDB_NODE_POINTER, leaf);
+		if (!node || (len < 8))
+			return node;
+		node->pointee = *(uint32_t*)data;
+		node->attr = *(uint32_t*)(data + 4);
+		node->size = (node->attr >> 13) & 0x3f;
+		return node;
+	case LEAF_TYPE_MODIFIER:
+		// type, modifier bits
+		node = NewNode(layout, typeId, PDB_NODE_MODIFIER, leaf);
+		if (!node || (len < 6))
+			return node;
+		elementId = *(uint32_t*)data;
+		node->attr = *(uint16_t*)(data + 4);
+		node->element = ResolveNode(layout, elementId, depth + 1);
+		if (node->element)
+			node->size = node->element->size;
+		return node;
+	case LEAF_TYPE_ARRAY:
+		// element type, index type, size, name
+		node = NewNode(layout, typeId, PDB_NODE_ARRAY, leaf);
+		if (!node || (len < 8))
+			return node;
+		elementId = *(uint32_t*)data;
+		numLen = PdbTypesReadNumeric(data + 8, len - 8, &node->size);
+		if (numLen == 0)
+			node->size = 0;
+		node->element = ResolveNode(layout, elementId, depth + 1);
+		if (node->element && node->element->size)
+			node->count = node->size / node->element->size;
+		return node;
+	case LEAF_TYPE_BITFIELD:
+		// type, length, position
+		node = NewNode(layout, typeId, PDB_NODE_BITFIELD, leaf);
+		if (!node || (len < 6))
+			return node;
+		elementId = *(uint32_t*)data;
+		node->bitLength = data[4];
+		node->bitPosition = data[5];
+		node->element = ResolveNode(layout, elementId, depth + 1);
+		if (node->element)
+			node->size = node->element->size;
+		return node;
+	case LEAF_TYPE_PROCEDURE:
+	case LEAF_TYPE_MFUNCTION:
+		return NewNode(layout, typeId, PDB_NODE_FUNCTION, leaf);
+	default:
+		return NewNode(layout, typeId, PDB_NODE_UNKNOWN, leaf);
+	}
+}
+
+
+static const PDB_TYPE_NODE* ResolveNode(PDB_LAYOUT* layout, uint32_t typeId, uint32_t depth)
+{
+	const PDB_TYPE_NODE* node;
+	uint32_t index;
+
+	if (typeId < PDB_TYPE_SIMPLE_MAX)
+		return ResolveSimple(layout, typeId);
+
+	if ((typeId < layout->minId) || (typeId - layout->minId >= layout->typeCount))
+		return NULL;
+
+	index = typeId - layout->minId;
+
+	if (layout->nodes[index])
+		return layout->nodes[index];
+
+	if (depth > PDB_LAYOUT_MAX_DEPTH)
+		return NULL;
+
+	node = ResolveRecord(layout, typeId, depth);
+
+	// Udts have already put themselves in the cache
+	if (node && !layout->nodes[index])
+		layout->nodes[index] = (PDB_TYPE_NODE*)node;
+
+	return node;
+}
+
+
+// What a field embeds, resolved on first use
+static const PDB_TYPE_NODE* FieldType(PDB_LAYOUT* layout, const PDB_TYPE_FIELD* field)
+{
+	if (!field->type && field->typeId)
+		((PDB_TYPE_FIELD*)field)->type = ResolveNode(layout, field->typeId, 0);
+
+	return field->type;
+}
+
+
+static bool PushPending(PDB_LAYOUT* layout, uint32_t* count, const PDB_TYPE_NODE* node)
+{
+	if (!node || ((PDB_LAYOUT_NODE*)node)->complete)
+		return true;
+
+	if (*count == layout->pendingSize)
+	{
+		uint32_t size = layout->pendingSize ? (layout->pendingSize * 2) : 256;
+		PDB_TYPE_NODE** grown = (PDB_TYPE_NODE**)realloc(layout->pending, size * sizeof(PDB_TYPE_NODE*));
+
+		if (!grown)
+			return false;
+
+		layout->pending = grown;
+		layout->pendingSize = size;
+	}
+
+	layout->pending[(*count)++] = (PDB_TYPE_NODE*)node;
+
+	return true;
+}
+
+
+// Resolve everything the node embeds.  Structures nest arbitrarily deep, so
+// this works from a list rather than recursing.
+static bool CompleteNode(PDB_LAYOUT* layout, const PDB_TYPE_NODE* node)
+{
+	uint32_t count = 0;
+
+	if (!PushPending(layout, &count, node))
+		return false;
+
+	while (count)
+	{
+		PDB_LAYOUT_NODE* next = (PDB_LAYOUT_NODE*)layout->pending[--count];
+		uint32_t i;
+
+		if (next->complete)
+			continue;
+
+		next->complete = true;
+
+		if (!PushPending(layout, &count, next->node.element))
+			return false;
+
+		for (i = 0; i < next->node.fieldCount; i++)
+		{
+			if (!PushPending(layout, &count, FieldType(layout, &next->node.fields[i])))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+PDB_LAYOUT* PdbLayoutCreate(PDB_TYPES* types)
+{
+	PDB_LAYOUT* layout = (PDB_LAYOUT*)calloc(1, sizeof(PDB_LAYOUT));
+
+	if (!layout)
+		return NULL;
+
+	layout->types = types;
+	layout->minId = PdbTypesGetMinId(types);
+	layout->typeCount = PdbTypesGetCount(types);
+	layout->nodes = (PDB_TYPE_NODE**)calloc((size_t)layout->typeCount + 1, sizeof(PDB_TYPE_NODE*));
+
+	if (!layout->nodes)
+	{
+		free(layout);
+		return NULL;
+	}
+
+	return layout;
+}
+
+
+void PdbLayoutDestroy(PDB_LAYOUT* layout)
+{
+	PDB_LAYOUT_CHUNK* chunk = layout->chunks;
+
+	while (chunk)
+	{
+		PDB_LAYOUT_CHUNK* next = chunk->next;
+
+		free(chunk);
+		chunk = next;
+	}
+
+	free(layout->pending);
+	free(layout->nodes);
+	free(layout);
+}
+
+
+const PDB_TYPE_NODE* PdbLayoutResolve(PDB_LAYOUT* layout, uint32_t typeId)
+{
+	const PDB_TYPE_NODE* node = ResolveNode(layout, typeId, 0);
+
+	if (!node || !CompleteNode(layout, node))
+		return NULL;
+
+	return node;
+}
+
+
+const PDB_TYPE_NODE* PdbLayoutResolveName(PDB_LAYOUT* layout, const char* name)
+{
+	PDB_TYPE_UDT udt;
+
+	if (!PdbTypesFind(layout->types, name, &udt))
+		return NULL;
+
+	return PdbLayoutResolve(layout, udt.typeId);
+}
+
+
+const PDB_TYPE_NODE* PdbLayoutResolveShallow(PDB_LAYOUT* layout, uint32_t typeId)
+{
+	return ResolveNode(layout, typeId, 0);
+}
+
+
+const PDB_TYPE_NODE* PdbLayoutGetFieldType(PDB_LAYOUT* layout, const PDB_TYPE_FIELD* field)
+{
+	return FieldType(layout, field);
+}
+
+
+// A path in the batch, ordered by its root type name
+typedef struct PDB_FIELD_QUERY
+{
+	const char* path;
+	size_t rootLen;
+	uint32_t index;
+} PDB_FIELD_QUERY;
+
+
+static int CompareQueries(const void* a, const void* b)
+{
+	const PDB_FIELD_QUERY* left = (const PDB_FIELD_QUERY*)a;
+	const PDB_FIELD_QUERY* right = (const PDB_FIELD_QUERY*)b;
+	size_t len = (left->rootLen < right->rootLen) ? left->rootLen : right->rootLen;
+	int result = memcmp(left->path, right->path, len);
+
+	if (result)
+		return result;
+
+	if (left->rootLen != right->rootLen)
+		return (left->rootLen < right->rootLen) ? -1 : 1;
+
+	return (left->index < right->index) ? -1 : 1;
+}
+
+
+// Look through modifiers to the type underneath
+static const PDB_TYPE_NODE* StripModifiers(const PDB_TYPE_NODE* node)
+{
+	while (node && (node->kind == PDB_NODE_MODIFIER))
+		node = node->element;
+
+	return node;
+}
+
+
+// Find a data member by name, searching non virtual bases after the udt's own
+// members.  Virtual base offsets aren't known without an object.
+static const PDB_TYPE_FIELD* FindField(PDB_LAYOUT* layout, const PDB_TYPE_NODE* node,
+	const char* name, size_t len, uint64_t* offset, uint32_t depth)
+{
+	uint32_t i;
+
+	if (depth > PDB_LAYOUT_MAX_DEPTH)
+		return NULL;
+
+	for (i = 0; i < node->fieldCount; i++)
+	{
+		const PDB_TYPE_FIELD* field = &node->fields[i];
+
+		if ((field->leaf == LEAF_TYPE_MEMBER) && field->name
+			&& !strncmp(field->name, name, len) && (field->name[len] == '\0'))
+		{
+			*offset += field->offset;
+			return field;
+		}
+	}
+
+	for (i = 0; i < node->fieldCount; i++)
+	{
+		const PDB_TYPE_FIELD* field = &node->fields[i];
+		uint64_t baseOffset = *offset + field->offset;
+		const PDB_TYPE_NODE* base;
+		const PDB_TYPE_FIELD* found;
+
+		if (field->leaf != LEAF_TYPE_BCLASS)
+			continue;
+
+		base = FieldType(layout, field);
+		if (!base)
+			continue;
+
+		found = FindField(layout, base, name, len, &baseOffset, depth + 1);
+		if (found)
+		{
+			*offset = baseOffset;
+			return found;
+		}
+	}
+
+	return NULL;
+}
+
+
+static bool ResolvePath(PDB_LAYOUT* layout, const PDB_TYPE_NODE* node, const char* path,
+	PDB_FIELD_OFFSET* result)
+{
+	uint64_t offset = 0;
+
+	while (*path)
+	{
+		const PDB_TYPE_FIELD* field;
+		const char* end;
+		size_t len;
+
+		node = StripModifiers(node);
+		if (!node || ((node->kind != PDB_NODE_STRUCT) && (node->kind != PDB_NODE_UNION)))
+			return false;
+
+		for (end = path; *end && (*end != '.') && (*end != '['); end++);
+		len = end - path;
+
+		field = FindField(layout, node, path, len, &offset, 0);
+		if (!field)
+			return false;
+
+		node = FieldType(layout, field);
+		path = end;
+
+		// Subscripts step into array elements
+		while (*path == '[')
+		{
+			char* close;
+			uint64_t element = strtoul(path + 1, &close, 0);
+
+			node = StripModifiers(node);
+			if (!node || (node->kind != PDB_NODE_ARRAY) || !node->element || (*close != ']')
+				|| (element >= node->count))
+				return false;
+
+			node = node->element;
+			offset += element * node->size;
+			path = close + 1;
+		}
+
+		if (*path == '.')
+			path++;
+		else if (*path)
+			return false;
+	}
+
+	if (!node)
+		return false;
+
+	result->found = true;
+	result->offset = offset;
+	result->size = node->size;
+	result->typeId = node->typeId;
+
+	if (node->kind == PDB_NODE_BITFIELD)
+	{
+		result->bitPosition = node->bitPosition;
+		result->bitLength = node->bitLength;
+	}
+
+	return true;
+}
+
+
+uint32_t PdbLayoutResolveFieldPaths(PDB_LAYOUT* layout, const char** paths, uint32_t count,
+	PDB_FIELD_OFFSET* offsets)
+{
+	PDB_FIELD_QUERY* queries;
+	PDB_TYPE_UDT udt;
+	char* root = NULL;
+	size_t rootSize = 0;
+	uint32_t found = 0;
+	uint32_t i;
+
+	memset(offsets, 0, count * sizeof(PDB_FIELD_OFFSET));
+
+	queries = (PDB_FIELD_QUERY*)malloc(count * sizeof(PDB_FIELD_QUERY));
+	if (!queries)
+		return 0;
+
+	for (i = 0; i < count; i++)
+	{
+		const char* dot = strchr(paths[i], '.');
+
+		queries[i].path = paths[i];
+		queries[i].rootLen = dot ? (size_t)(dot - paths[i]) : strlen(paths[i]);
+		queries[i].index = i;
+	}
+
+	qsort(queries, count, sizeof(PDB_FIELD_QUERY), CompareQueries);
+
+	for (i = 0; i < count; )
+	{
+		const PDB_TYPE_NODE* node;
+		size_t rootLen = queries[i].rootLen;
+		uint32_t last;
+
+		// Find the end of the group sharing this root
+		for (last = i + 1; last < count; last++)
+		{
+			if ((queries[last].rootLen != rootLen)
+				|| memcmp(queries[last].path, queries[i].path, rootLen))
+				break;
+		}
+
+		if (rootLen + 1 > rootSize)
+		{
+			char* grown = (char*)realloc(root, rootLen + 1);
+
+			if (!grown)
+				break;
+
+			root = grown;
+			rootSize = rootLen + 1;
+		}
+
+		memcpy(root, queries[i].path, rootLen);
+		root[rootLen] = '\0';
+
+		// Only the field lists along the paths are decoded
+		node = PdbTypesFind(layout->types, root, &udt) ? ResolveNode(layout, udt.typeId, 0) : NULL;
+
+		for (; i < last; i++)
+		{
+			const char* path = queries[i].path + rootLen;
+
+			if (!node)
+				continue;
+
+			if (*path == '.')
+				path++;
+
+			if (ResolvePath(layout, node, path, &offsets[queries[i].index]))
+				found++;
+		}
+	}
+
+	free(root);
+	free(queries);
+
+	return found;
+}
+
+
+uint32_t PdbTypesResolveFieldPaths(PDB_TYPES* types, const char** paths, uint32_t count,
+	PDB_FIELD_OFFSET* offsets)
+{
+	PDB_LAYOUT* layout = PdbLayoutCreate(types);
+	uint32_t found;
+
+	if (!layout)
+	{
+		memset(offsets, 0, count * sizeof(PDB_FIELD_OFFSET));
+		return 0;
+	}
+
+	found = PdbLayoutResolveFieldPaths(layout, paths, count, offsets);
+
+	PdbLayoutDestroy(layout);
+
+	return found;
+}
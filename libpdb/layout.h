@@ -0,0 +1,121 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __LAYOUT_H__
+#define __LAYOUT_H__
+
+
+typedef struct PDB_LAYOUT PDB_LAYOUT;
+typedef struct PDB_TYPE_NODE PDB_TYPE_NODE;
+
+typedef enum PDB_NODE_KIND
+{
+	PDB_NODE_UNKNOWN = 0, // A record the resolver doesn't decode
+	PDB_NODE_SIMPLE = 1, // Built in type
+	PDB_NODE_STRUCT = 2, // Struct, class or interface
+	PDB_NODE_UNION = 3,
+	PDB_NODE_ENUM = 4,
+	PDB_NODE_POINTER = 5,
+	PDB_NODE_ARRAY = 6,
+	PDB_NODE_MODIFIER = 7, // const, volatile, unaligned
+	PDB_NODE_BITFIELD = 8,
+	PDB_NODE_FUNCTION = 9
+} PDB_NODE_KIND;
+
+// A data member, base class, vfptr or enumerate of a udt.  Methods, static
+// members and nested types don't take up space in the object and are left out.
+typedef struct PDB_TYPE_FIELD
+{
+	PDB_LEAF_TYPES leaf; // LF_MEMBER, LF_BCLASS, LF_VBCLASS, LF_IVBCLASS, LF_VFUNCTAB or LF_ENUMERATE
+	const char* name; // NULL for bases and the vfptr
+	uint64_t offset; // Byte offset, vbptr offset for virtual bases, or the enumerate's value
+	uint16_t attr;
+	uint32_t typeId; // As recorded in the field list, 0 for enumerates
+	const PDB_TYPE_NODE* type; // NULL for enumerates
+} PDB_TYPE_FIELD;
+
+struct PDB_TYPE_NODE
+{
+	uint32_t typeId; // Forward references resolve to the definition's node
+	PDB_NODE_KIND kind;
+	uint16_t leaf; // The record's leaf, 0 for built in types
+	const char* name; // Udts, enums and built in types
+	uint64_t size; // Bytes
+	const PDB_TYPE_NODE* element; // Modified type, array element, bitfield base, or enum underlying type
+	uint32_t pointee; // Pointers only, see PdbLayoutResolve
+	uint64_t count; // Array elements
+	uint32_t attr; // Property bits, pointer attributes or modifier bits
+	uint8_t bitPosition; // Bitfields only
+	uint8_t bitLength;
+	uint32_t fieldCount;
+	const PDB_TYPE_FIELD* fields;
+};
+
+// Where a member path such as "_KTHREAD.ApcState.Process" ends up
+typedef struct PDB_FIELD_OFFSET
+{
+	bool found;
+	uint64_t offset; // From the start of the root type
+	uint64_t size; // Bytes, the storage unit for bitfields
+	uint32_t typeId; // Type of the final member
+	uint8_t bitPosition; // Bitfields only
+	uint8_t bitLength;
+} PDB_FIELD_OFFSET;
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// A resolver keeps every node it has decoded, so types shared between
+	// structures are only read once.  Nodes live until the resolver is destroyed.
+	PDBAPI PDB_LAYOUT* PdbLayoutCreate(PDB_TYPES* types);
+	PDBAPI void PdbLayoutDestroy(PDB_LAYOUT* layout);
+
+	// Resolve the type and everything embedded in it.  Pointers aren't followed,
+	// so that resolving a structure doesn't pull in the whole type graph.
+	// Resolve their pointee separately when it is wanted.
+	PDBAPI const PDB_TYPE_NODE* PdbLayoutResolve(PDB_LAYOUT* layout, uint32_t typeId);
+	PDBAPI const PDB_TYPE_NODE* PdbLayoutResolveName(PDB_LAYOUT* layout, const char* name);
+
+	// Decode just the type itself.  The type of each field stays NULL until
+	// PdbLayoutGetFieldType resolves it (or the node is resolved in full).
+	PDBAPI const PDB_TYPE_NODE* PdbLayoutResolveShallow(PDB_LAYOUT* layout, uint32_t typeId);
+	PDBAPI const PDB_TYPE_NODE* PdbLayoutGetFieldType(PDB_LAYOUT* layout, const PDB_TYPE_FIELD* field);
+
+	// Resolve a batch of member paths.  A path is a udt name followed by
+	// '.' separated members, each of which may be subscripted ("Name[2]").
+	// Members of base classes are found too.  Paths sharing a root type are
+	// resolved together, and each field list is decoded once for the batch.
+	// Returns how many paths were found, the rest have found set to false.
+	PDBAPI uint32_t PdbLayoutResolveFieldPaths(PDB_LAYOUT* layout, const char** paths, uint32_t count,
+		PDB_FIELD_OFFSET* offsets);
+	PDBAPI uint32_t PdbTypesResolveFieldPaths(PDB_TYPES* types, const char** paths, uint32_t count,
+		PDB_FIELD_OFFSET* offsets);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __LAYOUT_H__ */
@@ -0,0 +1,506 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "pdb.h"
+#include "dbi.h"
+#include "pool.h"
+#include "modsyms.h"
+#include "internal.h"
+
+
+// A module stream starts with its CodeView signature
+#define PDB_MODULE_SIGNATURE_SIZE 4
+
+// PROCSYM32 up to the name: parent, end, next, length, debug start, debug
+// end, type, offset, section, flags
+#define PDB_PROC_SIZE 35
+
+
+typedef struct FUNCTION_ENTRY
+{
+	uint32_t offset;
+	uint32_t length;
+	uint32_t symbolOffset;
+	uint32_t name; // Into the module's names
+	uint16_t section;
+	uint16_t module;
+	uint16_t kind;
+} FUNCTION_ENTRY;
+
+// One module's share of the work.  Everything the worker produces stays
+// in here until the merge.
+typedef struct MODULE_ITEM
+{
+	PDB_STREAM* stream;
+	uint32_t symbolsSize;
+	uint16_t module;
+	FUNCTION_ENTRY* entries;
+	uint32_t count;
+	char* names;
+} MODULE_ITEM;
+
+// Merge two adjacent sorted runs of src into dst
+typedef struct MERGE_ITEM
+{
+	const FUNCTION_ENTRY* src;
+	FUNCTION_ENTRY* dst;
+	uint32_t start;
+	uint32_t middle;
+	uint32_t end;
+} MERGE_ITEM;
+
+struct PDB_FUNCTION_TABLE
+{
+	FUNCTION_ENTRY* entries; // Sorted by address
+	uint32_t count;
+
+	uint32_t* offsets; // Each entry's offset, for searching
+	uint32_t* sectionFirst; // The first entry of each section, and one past the last
+	uint32_t sectionCount; // One more than the highest section number
+
+	char** names; // Each module's names
+	uint32_t moduleCount;
+};
+
+
+static bool EntryBefore(const FUNCTION_ENTRY* left, const FUNCTION_ENTRY* right)
+{
+	if (left->section != right->section)
+		return (left->section < right->section);
+
+	return (left->offset < right->offset);
+}
+
+
+static int CompareEntries(const void* a, const void* b)
+{
+	const FUNCTION_ENTRY* left = (const FUNCTION_ENTRY*)a;
+	const FUNCTION_ENTRY* right = (const FUNCTION_ENTRY*)b;
+
+	if (EntryBefore(left, right))
+		return -1;
+
+	return EntryBefore(right, left);
+}
+
+
+static bool AddFunction(MODULE_ITEM* item, const uint8_t* record, uint32_t recordSize, uint32_t symbolOffset,
+	uint16_t kind, uint32_t* capacity, size_t* namesCapacity, size_t* namesLen)
+{
+	const uint8_t* body = record + 4;
+	const char* name = (const char*)(body + PDB_PROC_SIZE);
+	const char* nameEnd = (const char*)memchr(name, 0, recordSize - 4 - PDB_PROC_SIZE);
+	size_t nameLen = nameEnd ? (size_t)(nameEnd - name) : (recordSize - 4 - PDB_PROC_SIZE);
+	FUNCTION_ENTRY* entry;
+
+	if (item->count == *capacity)
+	{
+		FUNCTION_ENTRY* entries;
+
+		*capacity = *capacity ? (*capacity * 2) : 64;
+		entries = (FUNCTION_ENTRY*)realloc(item->entries, sizeof(FUNCTION_ENTRY) * *capacity);
+		if (!entries)
+			return false;
+
+		item->entries = entries;
+	}
+
+	if (*namesLen + nameLen + 1 > *namesCapacity)
+	{
+		char* names;
+
+		*namesCapacity = (*namesCapacity * 2) + nameLen + 1;
+		names = (char*)realloc(item->names, *namesCapacity);
+		if (!names)
+			return false;
+
+		item->names = names;
+	}
+
+	entry = &item->entries[item->count++];
+	memcpy(&entry->length, body + 12, 4);
+	memcpy(&entry->offset, body + 28, 4);
+	memcpy(&entry->section, body + 32, 2);
+	entry->symbolOffset = symbolOffset;
+	entry->module = item->module;
+	entry->kind = kind;
+	entry->name = (uint32_t)*namesLen;
+
+	memcpy(item->names + *namesLen, name, nameLen);
+	item->names[*namesLen + nameLen] = 0;
+	*namesLen += nameLen + 1;
+
+	return true;
+}
+
+
+// Runs on a pool thread.  The module's symbols are read in one positioned
+// read, then walked skipping from each function straight to its S_END so
+// the locals and blocks inside aren't looked at.
+static void ParseModule(void* ctxt)
+{
+	MODULE_ITEM* item = (MODULE_ITEM*)ctxt;
+	uint32_t size = item->symbolsSize;
+	uint8_t* buff = (uint8_t*)malloc(size ? size : 1);
+	uint32_t offset = PDB_MODULE_SIGNATURE_SIZE;
+	uint32_t capacity = 0;
+	size_t namesCapacity = 0;
+	size_t namesLen = 0;
+
+	if (!buff || !PdbStreamReadAt(item->stream, 0, buff, size))
+		goto DONE;
+
+	while (offset + 4 <= size)
+	{
+		const uint8_t* record = buff + offset;
+		uint16_t recordLen;
+		uint16_t kind;
+		uint32_t next;
+
+		memcpy(&recordLen, record, 2);
+		memcpy(&kind, record + 2, 2);
+
+		next = offset + 2 + recordLen;
+		if ((recordLen < 2) || (next > size))
+			break;
+
+		if (((kind == SYMBOL_TYPE_GPROC32) || (kind == SYMBOL_TYPE_LPROC32)
+			|| (kind == SYMBOL_TYPE_GPROC32_ID) || (kind == SYMBOL_TYPE_LPROC32_ID))
+			&& (2 + (uint32_t)recordLen >= 4 + PDB_PROC_SIZE))
+		{
+			uint32_t end;
+
+			if (!AddFunction(item, record, 2 + recordLen, offset, kind, &capacity, &namesCapacity, &namesLen))
+			{
+				// Leave the module out rather than merge an unsorted run
+				item->count = 0;
+				goto DONE;
+			}
+
+			// The end is an offset in the stream, like the record's own
+			memcpy(&end, record + 8, 4);
+			if ((end > offset) && (end < size))
+				next = end;
+		}
+
+		offset = next;
+	}
+
+	if (item->count)
+		qsort(item->entries, item->count, sizeof(FUNCTION_ENTRY), CompareEntries);
+
+DONE:
+	free(buff);
+}
+
+
+static void MergeRuns(void* ctxt)
+{
+	MERGE_ITEM* item = (MERGE_ITEM*)ctxt;
+	uint32_t left = item->start;
+	uint32_t right = item->middle;
+	uint32_t out = item->start;
+
+	while ((left < item->middle) && (right < item->end))
+	{
+		// Take from the left on ties so equal addresses keep module order
+		if (EntryBefore(&item->src[right], &item->src[left]))
+			item->dst[out++] = item->src[right++];
+		else
+			item->dst[out++] = item->src[left++];
+	}
+
+	memcpy(&item->dst[out], &item->src[left], sizeof(FUNCTION_ENTRY) * (item->middle - left));
+	out += item->middle - left;
+	memcpy(&item->dst[out], &item->src[right], sizeof(FUNCTION_ENTRY) * (item->end - right));
+}
+
+
+// Merge the modules' sorted runs pairwise, each pass halving the number
+// of runs with its merges spread over the pool
+static bool MergeModules(PDB_FUNCTION_TABLE* table, PDB_POOL* pool, uint32_t* runs, uint32_t runCount)
+{
+	FUNCTION_ENTRY* other = (FUNCTION_ENTRY*)malloc(sizeof(FUNCTION_ENTRY) * (table->count ? table->count : 1));
+	MERGE_ITEM* merges = (MERGE_ITEM*)malloc(sizeof(MERGE_ITEM) * ((runCount / 2) + 1));
+
+	if (!other || !merges)
+	{
+		free(other);
+		free(merges);
+		return false;
+	}
+
+	// runs[i] is where run i starts, runs[runCount] is the end
+	while (runCount > 1)
+	{
+		uint32_t mergeCount = 0;
+		uint32_t i;
+		FUNCTION_ENTRY* swap;
+
+		for (i = 0; i + 1 < runCount; i += 2)
+		{
+			MERGE_ITEM* merge = &merges[mergeCount++];
+
+			merge->src = table->entries;
+			merge->dst = other;
+			merge->start = runs[i];
+			merge->middle = runs[i + 1];
+			merge->end = runs[i + 2];
+
+			if (!PdbPoolSubmit(pool, MergeRuns, merge))
+				MergeRuns(merge);
+		}
+
+		// An odd run out is carried over as it is
+		if (runCount & 1)
+		{
+			memcpy(&other[runs[runCount - 1]], &table->entries[runs[runCount - 1]],
+				sizeof(FUNCTION_ENTRY) * (runs[runCount] - runs[runCount - 1]));
+		}
+
+		PdbPoolWait(pool);
+
+		for (i = 0; i < runCount; i += 2)
+			runs[i / 2] = runs[i];
+		runs[(runCount + 1) / 2] = runs[runCount];
+		runCount = (runCount + 1) / 2;
+
+		swap = table->entries;
+		table->entries = other;
+		other = swap;
+	}
+
+	free(other);
+	free(merges);
+
+	return true;
+}
+
+
+static bool BuildSectionIndex(PDB_FUNCTION_TABLE* table)
+{
+	uint32_t section = 0;
+	uint32_t i;
+
+	table->sectionCount = table->count ? (table->entries[table->count - 1].section + 1u) : 1;
+	table->sectionFirst = (uint32_t*)malloc(sizeof(uint32_t) * (table->sectionCount + 1));
+	table->offsets = (uint32_t*)PdbAlignedAlloc(sizeof(uint32_t) * table->count);
+
+	if (!table->sectionFirst || !table->offsets)
+		return false;
+
+	for (i = 0; i < table->count; i++)
+	{
+		table->offsets[i] = table->entries[i].offset;
+
+		while (section <= table->entries[i].section)
+			table->sectionFirst[section++] = i;
+	}
+
+	while (section <= table->sectionCount)
+		table->sectionFirst[section++] = table->count;
+
+	return true;
+}
+
+
+PDB_FUNCTION_TABLE* PdbFunctionTableBuild(PDB_DBI* dbi, uint32_t threads)
+{
+	PDB_FILE* pdb = PdbDbiGetPdb(dbi);
+	uint32_t moduleCount = PdbDbiGetModuleCount(dbi);
+	PDB_FUNCTION_TABLE* table = (PDB_FUNCTION_TABLE*)calloc(1, sizeof(PDB_FUNCTION_TABLE));
+	MODULE_ITEM* items = (MODULE_ITEM*)calloc(moduleCount ? moduleCount : 1, sizeof(MODULE_ITEM));
+	uint32_t* runs = (uint32_t*)malloc(sizeof(uint32_t) * (moduleCount + 1));
+	PDB_POOL* pool = PdbPoolCreate(threads);
+	uint32_t runCount = 0;
+	uint32_t i;
+	bool result = false;
+
+	if (!table || !items || !runs || !pool)
+		goto DONE;
+
+	table->moduleCount = moduleCount;
+	table->names = (char**)calloc(moduleCount ? moduleCount : 1, sizeof(char*));
+	if (!table->names)
+		goto DONE;
+
+	// Opening a stream reads the directory through the shared file
+	// position, so that part stays on this thread.  Biggest modules first
+	// would balance better, but stealing takes care of most of it.
+	for (i = 0; i < moduleCount; i++)
+	{
+		PDB_MODULE module;
+
+		if (!PdbDbiGetModule(dbi, i, &module) || (module.stream == PDB_STREAM_NONE)
+			|| (module.symbolsSize <= PDB_MODULE_SIGNATURE_SIZE))
+			continue;
+
+		items[i].module = (uint16_t)i;
+		items[i].stream = PdbStreamOpen(pdb, module.stream);
+		if (!items[i].stream)
+			continue;
+
+		items[i].symbolsSize = module.symbolsSize;
+		if (items[i].symbolsSize > PdbStreamGetSize(items[i].stream))
+			items[i].symbolsSize = PdbStreamGetSize(items[i].stream);
+	}
+
+	for (i = 0; i < moduleCount; i++)
+	{
+		if (items[i].stream && !PdbPoolSubmit(pool, ParseModule, &items[i]))
+			ParseModule(&items[i]);
+	}
+
+	PdbPoolWait(pool);
+
+	for (i = 0; i < moduleCount; i++)
+		table->count += items[i].count;
+
+	table->entries = (FUNCTION_ENTRY*)malloc(sizeof(FUNCTION_ENTRY) * (table->count ? table->count : 1));
+	if (!table->entries)
+		goto DONE;
+
+	// Lay the runs out end to end, the table takes the names over
+	table->count = 0;
+	for (i = 0; i < moduleCount; i++)
+	{
+		table->names[i] = items[i].names;
+		items[i].names = NULL;
+
+		if (!items[i].count)
+			continue;
+
+		runs[runCount++] = table->count;
+		memcpy(&table->entries[table->count], items[i].entries, sizeof(FUNCTION_ENTRY) * items[i].count);
+		table->count += items[i].count;
+	}
+
+	runs[runCount] = table->count;
+
+	if (!MergeModules(table, pool, runs, runCount))
+		goto DONE;
+
+	if (!BuildSectionIndex(table))
+		goto DONE;
+
+	result = true;
+
+DONE:
+	if (pool)
+		PdbPoolDestroy(pool);
+
+	if (items)
+	{
+		for (i = 0; i < moduleCount; i++)
+		{
+			if (items[i].stream)
+				PdbStreamClose(items[i].stream);
+			free(items[i].entries);
+			free(items[i].names);
+		}
+	}
+
+	free(items);
+	free(runs);
+
+	if (!result && table)
+	{
+		PdbFunctionTableClose(table);
+		table = NULL;
+	}
+
+	return table;
+}
+
+
+void PdbFunctionTableClose(PDB_FUNCTION_TABLE* table)
+{
+	uint32_t i;
+
+	if (table->names)
+	{
+		for (i = 0; i < table->moduleCount; i++)
+			free(table->names[i]);
+	}
+
+	free(table->names);
+	free(table->entries);
+	PdbAlignedFree(table->offsets);
+	free(table->sectionFirst);
+	free(table);
+}
+
+
+uint32_t PdbFunctionTableGetCount(PDB_FUNCTION_TABLE* table)
+{
+	return table->count;
+}
+
+
+static void GetFunction(PDB_FUNCTION_TABLE* table, const FUNCTION_ENTRY* entry, PDB_FUNCTION* func)
+{
+	func->name = table->names[entry->module] + entry->name;
+	func->offset = entry->offset;
+	func->length = entry->length;
+	func->section = entry->section;
+	func->module = entry->module;
+	func->symbolOffset = entry->symbolOffset;
+	func->kind = (PDB_SYMBOL_TYPES)entry->kind;
+}
+
+
+bool PdbFunctionTableGet(PDB_FUNCTION_TABLE* table, uint32_t index, PDB_FUNCTION* func)
+{
+	if (index >= table->count)
+		return false;
+
+	GetFunction(table, &table->entries[index], func);
+
+	return true;
+}
+
+
+bool PdbFunctionTableFind(PDB_FUNCTION_TABLE* table, uint16_t section, uint32_t offset, PDB_FUNCTION* func)
+{
+	const FUNCTION_ENTRY* entry;
+	uint32_t first;
+	uint32_t found;
+
+	if (section >= table->sectionCount)
+		return false;
+
+	first = table->sectionFirst[section];
+	found = PdbUpperBound(table->offsets + first, table->sectionFirst[section + 1] - first, offset);
+	if (found == 0)
+		return false;
+
+	entry = &table->entries[first + found - 1];
+	if (offset - entry->offset >= entry->length)
+		return false;
+
+	GetFunction(table, entry, func);
+
+	return true;
+}
@@ -0,0 +1,68 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __MODSYMS_H__
+#define __MODSYMS_H__
+
+
+typedef struct PDB_FUNCTION_TABLE PDB_FUNCTION_TABLE;
+
+// A function from a module's S_GPROC32 or S_LPROC32 record (or their _ID
+// forms)
+typedef struct PDB_FUNCTION
+{
+	const char* name; // Owned by the table
+	uint32_t offset; // Offset within the section
+	uint32_t length;
+	uint16_t section; // One based
+	uint16_t module; // See PdbDbiGetModule
+	uint32_t symbolOffset; // Of the record in the module's stream
+	PDB_SYMBOL_TYPES kind;
+} PDB_FUNCTION;
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Read every module's symbols on a pool of threads (0 for one per
+	// processor) and keep the functions, sorted by address.  Each module is
+	// read with positioned reads and sorted by the worker that parsed it,
+	// then the sorted runs are merged in parallel.  Modules that can't be
+	// read are left out.  The lookups below don't touch the file and can be
+	// made from several threads at once.
+	PDBAPI PDB_FUNCTION_TABLE* PdbFunctionTableBuild(PDB_DBI* dbi, uint32_t threads);
+	PDBAPI void PdbFunctionTableClose(PDB_FUNCTION_TABLE* table);
+
+	PDBAPI uint32_t PdbFunctionTableGetCount(PDB_FUNCTION_TABLE* table);
+	PDBAPI bool PdbFunctionTableGet(PDB_FUNCTION_TABLE* table, uint32_t index, PDB_FUNCTION* func);
+
+	// The function containing the address
+	PDBAPI bool PdbFunctionTableFind(PDB_FUNCTION_TABLE* table, uint16_t section, uint32_t offset, PDB_FUNCTION* func);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __MODSYMS_H__ */
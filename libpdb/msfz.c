@@ -0,0 +1,742 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "pdb.h"
+#include "pool.h"
+#include "internal.h"
+
+// zstd chunks need the zstd library, define PDB_USE_ZSTD and link against
+// it to read them.  Containers without zstd chunks work either way.
+#ifdef PDB_USE_ZSTD
+#include <zstd.h>
+#endif /* PDB_USE_ZSTD */
+
+
+// An MSFZ container holds the same streams as an MSF file, but each stream
+// is a list of fragments instead of pages.  A fragment is either a range of
+// the file or a range of a compressed chunk's decompressed data.  Chunks are
+// listed in a chunk table, and the stream directory (which may itself be
+// compressed) lists each stream's fragments.
+
+static const char PDB_SIGNATURE_MSFZ[] = "Microsoft MSFZ Container\r\n\x1a" "ALD\0";
+
+#define PDB_MSFZ_SIGNATURE_SIZE 32
+#define PDB_MSFZ_VERSION 0
+
+// signature, version, directory offset, chunk table offset, stream count,
+// directory compression, compressed and uncompressed directory size, chunk
+// count, chunk table size
+#define PDB_MSFZ_HEADER_SIZE 80
+
+// file offset, compression, compressed size, uncompressed size
+#define PDB_MSFZ_CHUNK_ENTRY_SIZE 20
+
+// Directory entries are dwords.  A nil stream is a single PDB_MSFZ_NIL_STREAM,
+// anything else is (size, location low, location high) fragments ending
+// with a zero size.
+#define PDB_MSFZ_NIL_STREAM 0xffffffff
+
+// Set in a fragment location's high dword when the rest of it is a chunk
+// index and the low dword an offset within the chunk
+#define PDB_MSFZ_CHUNK_LOCATION 0x80000000
+
+// Decompressed chunks kept between reads
+#define PDB_MSFZ_CACHE_SIZE (64 * 1024 * 1024)
+
+// A read needing this many uncached chunks decompresses them in parallel
+#define PDB_MSFZ_PARALLEL_CHUNKS 2
+
+// A parallel batch holds at most this share of the cache budget, so a long
+// read decompresses ahead in steps instead of all at once
+#define PDB_MSFZ_AHEAD_SHARE 4
+
+#define MSFZ_NONE 0xffffffff
+
+typedef enum MSFZ_COMPRESSION
+{
+	MSFZ_COMPRESSION_NONE = 0,
+	MSFZ_COMPRESSION_ZSTD = 1,
+	MSFZ_COMPRESSION_DEFLATE = 2
+} MSFZ_COMPRESSION;
+
+typedef struct MSFZ_FRAGMENT
+{
+	uint64_t offset; // File offset, or offset within the chunk
+	uint32_t chunk; // MSFZ_NONE for uncompressed fragments
+	uint32_t size;
+} MSFZ_FRAGMENT;
+
+typedef struct MSFZ_STREAM
+{
+	uint32_t size; // PDB_MSFZ_NIL_STREAM for nil streams
+	uint32_t firstFragment;
+	uint32_t fragmentCount;
+} MSFZ_STREAM;
+
+typedef struct MSFZ_CHUNK
+{
+	uint64_t fileOffset;
+	uint32_t compression;
+	uint32_t compressedSize;
+	uint32_t size;
+
+	uint8_t* data; // Decompressed, NULL when not cached
+	uint32_t prev; // Least recently used list, most recent first
+	uint32_t next;
+} MSFZ_CHUNK;
+
+// A chunk decompressed by a pool worker
+typedef struct MSFZ_DECOMPRESS_ITEM
+{
+	PDB_MSFZ* msfz;
+	uint32_t chunk;
+	uint8_t* data;
+} MSFZ_DECOMPRESS_ITEM;
+
+struct PDB_MSFZ
+{
+	PDB_FILE* pdb;
+
+	MSFZ_STREAM* streams;
+	uint32_t streamCount;
+
+	MSFZ_FRAGMENT* fragments;
+	uint32_t* fragmentStarts; // Offset of each fragment within its stream, for searching
+	uint32_t fragmentCount;
+
+	MSFZ_CHUNK* chunks;
+	uint32_t chunkCount;
+
+	PDB_LOCK* lock; // Guards the cached chunk data and the list
+	uint32_t head;
+	uint32_t tail;
+	uint64_t cached; // Decompressed bytes held
+	uint64_t budget;
+
+	PDB_LOCK* poolLock; // One parallel batch at a time, PdbPoolWait waits for everything
+	PDB_POOL* pool; // Created by the first read that wants it
+};
+
+
+// Read size bytes at offset and decompress them to expected bytes
+static uint8_t* Decompress(PDB_FILE* pdb, uint32_t compression, uint64_t offset, uint32_t size, uint32_t expected)
+{
+	uint8_t* compressed;
+	uint8_t* data = NULL;
+
+	compressed = (uint8_t*)malloc(size ? size : 1);
+	if (!compressed)
+		return NULL;
+
+	if (!PdbFileReadAt(pdb, compressed, size, offset))
+	{
+		free(compressed);
+		return NULL;
+	}
+
+	switch (compression)
+	{
+	case MSFZ_COMPRESSION_NONE:
+		if (size != expected)
+			break;
+
+		return compressed;
+
+#ifdef PDB_USE_ZSTD
+	case MSFZ_COMPRESSION_ZSTD:
+	{
+		size_t result;
+
+		data = (uint8_t*)malloc(expected ? expected : 1);
+		if (!data)
+			break;
+
+		result = ZSTD_decompress(data, expected, compressed, size);
+		if (ZSTD_isError(result) || (result != expected))
+		{
+			free(data);
+			data = NULL;
+		}
+		break;
+	}
+#endif /* PDB_USE_ZSTD */
+
+	default:
+		// Not built in (or unknown)
+		break;
+	}
+
+	free(compressed);
+
+	return data;
+}
+
+
+static void LruUnlink(PDB_MSFZ* msfz, uint32_t index)
+{
+	MSFZ_CHUNK* chunk = &msfz->chunks[index];
+
+	if (chunk->prev != MSFZ_NONE)
+		msfz->chunks[chunk->prev].next = chunk->next;
+	else
+		msfz->head = chunk->next;
+
+	if (chunk->next != MSFZ_NONE)
+		msfz->chunks[chunk->next].prev = chunk->prev;
+	else
+		msfz->tail = chunk->prev;
+
+	chunk->prev = MSFZ_NONE;
+	chunk->next = MSFZ_NONE;
+}
+
+
+static void LruPushFront(PDB_MSFZ* msfz, uint32_t index)
+{
+	MSFZ_CHUNK* chunk = &msfz->chunks[index];
+
+	chunk->prev = MSFZ_NONE;
+	chunk->next = msfz->head;
+
+	if (msfz->head != MSFZ_NONE)
+		msfz->chunks[msfz->head].prev = index;
+	else
+		msfz->tail = index;
+
+	msfz->head = index;
+}
+
+
+// Called with the lock held.  Takes ownership of data.
+static void CacheInsert(PDB_MSFZ* msfz, uint32_t index, uint8_t* data)
+{
+	MSFZ_CHUNK* chunk = &msfz->chunks[index];
+
+	// Someone else got there first
+	if (chunk->data)
+	{
+		free(data);
+		return;
+	}
+
+	chunk->data = data;
+	msfz->cached += chunk->size;
+	LruPushFront(msfz, index);
+}
+
+
+// Called with the lock held.  Chunks a read is still copying from may go,
+// the read decompresses them again.
+static void CacheTrim(PDB_MSFZ* msfz)
+{
+	while ((msfz->cached > msfz->budget) && (msfz->tail != MSFZ_NONE))
+	{
+		uint32_t index = msfz->tail;
+		MSFZ_CHUNK* chunk = &msfz->chunks[index];
+
+		LruUnlink(msfz, index);
+		free(chunk->data);
+		chunk->data = NULL;
+		msfz->cached -= chunk->size;
+	}
+}
+
+
+static uint8_t* DecompressChunk(PDB_MSFZ* msfz, uint32_t index)
+{
+	const MSFZ_CHUNK* chunk = &msfz->chunks[index];
+
+	return Decompress(msfz->pdb, chunk->compression, chunk->fileOffset, chunk->compressedSize, chunk->size);
+}
+
+
+static void DecompressWorker(void* ctxt)
+{
+	MSFZ_DECOMPRESS_ITEM* item = (MSFZ_DECOMPRESS_ITEM*)ctxt;
+
+	item->data = DecompressChunk(item->msfz, item->chunk);
+}
+
+
+static bool LoadChunks(PDB_MSFZ* msfz, const uint8_t* header, uint64_t fileSize)
+{
+	uint64_t offset;
+	uint32_t tableSize;
+	uint8_t* table;
+	uint32_t i;
+
+	memcpy(&offset, header + 48, 8);
+	memcpy(&msfz->chunkCount, header + 72, 4);
+	memcpy(&tableSize, header + 76, 4);
+
+	if (((uint64_t)msfz->chunkCount * PDB_MSFZ_CHUNK_ENTRY_SIZE != tableSize)
+		|| (offset > fileSize) || (tableSize > fileSize - offset))
+		return false;
+
+	// Zeroed so that closing after a failure here only frees loaded chunks
+	msfz->chunks = (MSFZ_CHUNK*)calloc(msfz->chunkCount + 1, sizeof(MSFZ_CHUNK));
+	table = (uint8_t*)malloc(tableSize + 1);
+
+	if (!msfz->chunks || !table || !PdbFileReadAt(msfz->pdb, table, tableSize, offset))
+	{
+		free(table);
+		return false;
+	}
+
+	for (i = 0; i < msfz->chunkCount; i++)
+	{
+		const uint8_t* entry = table + (i * PDB_MSFZ_CHUNK_ENTRY_SIZE);
+		MSFZ_CHUNK* chunk = &msfz->chunks[i];
+
+		memcpy(&chunk->fileOffset, entry, 8);
+		memcpy(&chunk->compression, entry + 8, 4);
+		memcpy(&chunk->compressedSize, entry + 12, 4);
+		memcpy(&chunk->size, entry + 16, 4);
+		chunk->data = NULL;
+		chunk->prev = MSFZ_NONE;
+		chunk->next = MSFZ_NONE;
+
+		if ((chunk->fileOffset > fileSize) || (chunk->compressedSize > fileSize - chunk->fileOffset))
+		{
+			free(table);
+			return false;
+		}
+
+#ifndef PDB_USE_ZSTD
+		if (chunk->compression == MSFZ_COMPRESSION_ZSTD)
+		{
+			fprintf(stderr, "This pdb has zstd compressed chunks, rebuild with PDB_USE_ZSTD to read them.\n");
+			free(table);
+			return false;
+		}
+#endif /* PDB_USE_ZSTD */
+	}
+
+	free(table);
+
+	return true;
+}
+
+
+static bool AddFragment(PDB_MSFZ* msfz, MSFZ_STREAM* stream, uint32_t size, uint32_t low, uint32_t high,
+	uint64_t fileSize, uint32_t* capacity)
+{
+	MSFZ_FRAGMENT* fragment;
+
+	if ((uint64_t)stream->size + size > UINT32_MAX - 1)
+		return false;
+
+	if (msfz->fragmentCount == *capacity)
+	{
+		MSFZ_FRAGMENT* fragments;
+		uint32_t* starts;
+
+		*capacity = *capacity ? (*capacity * 2) : 256;
+		fragments = (MSFZ_FRAGMENT*)realloc(msfz->fragments, sizeof(MSFZ_FRAGMENT) * *capacity);
+		if (!fragments)
+			return false;
+		msfz->fragments = fragments;
+
+		starts = (uint32_t*)realloc(msfz->fragmentStarts, sizeof(uint32_t) * *capacity);
+		if (!starts)
+			return false;
+		msfz->fragmentStarts = starts;
+	}
+
+	fragment = &msfz->fragments[msfz->fragmentCount];
+	fragment->size = size;
+
+	if (high & PDB_MSFZ_CHUNK_LOCATION)
+	{
+		fragment->chunk = high & ~PDB_MSFZ_CHUNK_LOCATION;
+		fragment->offset = low;
+
+		if ((fragment->chunk >= msfz->chunkCount)
+			|| ((uint64_t)low + size > msfz->chunks[fragment->chunk].size))
+			return false;
+	}
+	else
+	{
+		fragment->chunk = MSFZ_NONE;
+		fragment->offset = ((uint64_t)high << 32) | low;
+
+		if ((fragment->offset > fileSize) || (size > fileSize - fragment->offset))
+			return false;
+	}
+
+	msfz->fragmentStarts[msfz->fragmentCount++] = stream->size;
+	stream->fragmentCount++;
+	stream->size += size;
+
+	return true;
+}
+
+
+static bool LoadDirectory(PDB_MSFZ* msfz, const uint8_t* header, uint64_t fileSize)
+{
+	uint64_t offset;
+	uint32_t compression;
+	uint32_t compressedSize;
+	uint32_t size;
+	uint32_t* directory;
+	uint32_t count;
+	uint32_t capacity = 0;
+	uint32_t pos = 0;
+	uint32_t i;
+	bool result = false;
+
+	memcpy(&offset, header + 40, 8);
+	memcpy(&msfz->streamCount, header + 56, 4);
+	memcpy(&compression, header + 60, 4);
+	memcpy(&compressedSize, header + 64, 4);
+	memcpy(&size, header + 68, 4);
+
+	if ((offset > fileSize) || (compressedSize > fileSize - offset) || (size % 4))
+		return false;
+
+	directory = (uint32_t*)Decompress(msfz->pdb, compression, offset, compressedSize, size);
+	if (!directory)
+		return false;
+
+	count = size / 4;
+
+	msfz->streams = (MSFZ_STREAM*)malloc(sizeof(MSFZ_STREAM) * (msfz->streamCount + 1));
+	if (!msfz->streams)
+		goto DONE;
+
+	for (i = 0; i < msfz->streamCount; i++)
+	{
+		MSFZ_STREAM* stream = &msfz->streams[i];
+
+		stream->size = 0;
+		stream->firstFragment = msfz->fragmentCount;
+		stream->fragmentCount = 0;
+
+		if (pos >= count)
+			goto DONE;
+
+		if (directory[pos] == PDB_MSFZ_NIL_STREAM)
+		{
+			stream->size = PDB_MSFZ_NIL_STREAM;
+			pos++;
+			continue;
+		}
+
+		for (;;)
+		{
+			if (pos >= count)
+				goto DONE;
+
+			// The terminator
+			if (directory[pos] == 0)
+				break;
+
+			if (count - pos < 3)
+				goto DONE;
+
+			if (!AddFragment(msfz, stream, directory[pos], directory[pos + 1], directory[pos + 2],
+				fileSize, &capacity))
+				goto DONE;
+
+			pos += 3;
+		}
+
+		pos++;
+	}
+
+	result = true;
+
+DONE:
+	free(directory);
+
+	return result;
+}
+
+
+PDB_MSFZ* PdbMsfzOpen(PDB_FILE* pdb, uint64_t fileSize)
+{
+	uint8_t header[PDB_MSFZ_HEADER_SIZE];
+	PDB_MSFZ* msfz;
+	uint64_t version;
+
+	if ((fileSize < PDB_MSFZ_HEADER_SIZE) || !PdbFileReadAt(pdb, header, PDB_MSFZ_HEADER_SIZE, 0))
+		return NULL;
+
+	if (memcmp(header, PDB_SIGNATURE_MSFZ, PDB_MSFZ_SIGNATURE_SIZE) != 0)
+		return NULL;
+
+	memcpy(&version, header + PDB_MSFZ_SIGNATURE_SIZE, 8);
+	if (version != PDB_MSFZ_VERSION)
+		return NULL;
+
+	msfz = (PDB_MSFZ*)calloc(1, sizeof(PDB_MSFZ));
+	if (!msfz)
+		return NULL;
+
+	msfz->pdb = pdb;
+	msfz->head = MSFZ_NONE;
+	msfz->tail = MSFZ_NONE;
+	msfz->budget = PDB_MSFZ_CACHE_SIZE;
+	msfz->lock = PdbLockCreate();
+	msfz->poolLock = PdbLockCreate();
+
+	if (!msfz->lock || !msfz->poolLock || !LoadChunks(msfz, header, fileSize)
+		|| !LoadDirectory(msfz, header, fileSize))
+	{
+		PdbMsfzClose(msfz);
+		return NULL;
+	}
+
+	return msfz;
+}
+
+
+void PdbMsfzClose(PDB_MSFZ* msfz)
+{
+	uint32_t i;
+
+	if (msfz->pool)
+		PdbPoolDestroy(msfz->pool);
+
+	if (msfz->chunks)
+	{
+		for (i = 0; i < msfz->chunkCount; i++)
+			free(msfz->chunks[i].data);
+	}
+
+	if (msfz->lock)
+		PdbLockDestroy(msfz->lock);
+	if (msfz->poolLock)
+		PdbLockDestroy(msfz->poolLock);
+
+	free(msfz->chunks);
+	free(msfz->fragments);
+	free(msfz->fragmentStarts);
+	free(msfz->streams);
+	free(msfz);
+}
+
+
+uint32_t PdbMsfzGetStreamCount(PDB_MSFZ* msfz)
+{
+	return msfz->streamCount;
+}
+
+
+bool PdbMsfzGetStreamSize(PDB_MSFZ* msfz, uint32_t streamId, uint32_t* size)
+{
+	if ((streamId >= msfz->streamCount) || (msfz->streams[streamId].size == PDB_MSFZ_NIL_STREAM))
+		return false;
+
+	*size = msfz->streams[streamId].size;
+
+	return true;
+}
+
+
+// The first fragment of the stream holding offset
+static uint32_t FindFragment(PDB_MSFZ* msfz, const MSFZ_STREAM* stream, uint64_t offset)
+{
+	uint32_t found = PdbUpperBound(msfz->fragmentStarts + stream->firstFragment, stream->fragmentCount,
+		(uint32_t)offset);
+
+	return stream->firstFragment + (found ? (found - 1) : 0);
+}
+
+
+// Decompress the uncached chunks behind [offset, offset + bytes) on the pool
+// when there are enough of them to be worth it.  A batch stops short once
+// its chunks would take up its share of the cache.  Returns the stream
+// offset the batch covers up to, the read calls again when it gets there.
+static uint64_t DecompressAhead(PDB_MSFZ* msfz, const MSFZ_STREAM* stream, uint64_t offset, uint64_t bytes)
+{
+	MSFZ_DECOMPRESS_ITEM* items = NULL;
+	uint32_t count = 0;
+	uint32_t capacity = 0;
+	uint32_t end = stream->firstFragment + stream->fragmentCount;
+	uint32_t last = MSFZ_NONE;
+	uint64_t batchSize = 0;
+	uint64_t covered = offset + bytes;
+	uint32_t i;
+
+	PdbLockAcquire(msfz->lock);
+
+	for (i = FindFragment(msfz, stream, offset); i < end; i++)
+	{
+		const MSFZ_FRAGMENT* fragment = &msfz->fragments[i];
+
+		if (msfz->fragmentStarts[i] >= offset + bytes)
+			break;
+
+		// Consecutive fragments usually share their chunk
+		if ((fragment->chunk == MSFZ_NONE) || (fragment->chunk == last) || msfz->chunks[fragment->chunk].data)
+			continue;
+
+		// Always take one, so the read moves forward
+		if (count && (batchSize + msfz->chunks[fragment->chunk].size > msfz->budget / PDB_MSFZ_AHEAD_SHARE))
+		{
+			covered = msfz->fragmentStarts[i];
+			break;
+		}
+
+		last = fragment->chunk;
+		batchSize += msfz->chunks[fragment->chunk].size;
+
+		if (count == capacity)
+		{
+			MSFZ_DECOMPRESS_ITEM* grown;
+
+			capacity = capacity ? (capacity * 2) : 16;
+			grown = (MSFZ_DECOMPRESS_ITEM*)realloc(items, sizeof(MSFZ_DECOMPRESS_ITEM) * capacity);
+			if (!grown)
+				break;
+			items = grown;
+		}
+
+		items[count].msfz = msfz;
+		items[count].chunk = fragment->chunk;
+		items[count].data = NULL;
+		count++;
+	}
+
+	if ((count >= PDB_MSFZ_PARALLEL_CHUNKS) && !msfz->pool)
+		msfz->pool = PdbPoolCreate(0);
+
+	PdbLockRelease(msfz->lock);
+
+	if ((count < PDB_MSFZ_PARALLEL_CHUNKS) || !msfz->pool)
+	{
+		free(items);
+		return covered;
+	}
+
+	PdbLockAcquire(msfz->poolLock);
+
+	for (i = 0; i < count; i++)
+	{
+		if (!PdbPoolSubmit(msfz->pool, DecompressWorker, &items[i]))
+			DecompressWorker(&items[i]);
+	}
+
+	PdbPoolWait(msfz->pool);
+	PdbLockRelease(msfz->poolLock);
+
+	// A stream can list a chunk again further on, CacheInsert drops the copy
+	PdbLockAcquire(msfz->lock);
+	for (i = 0; i < count; i++)
+	{
+		if (items[i].data)
+			CacheInsert(msfz, items[i].chunk, items[i].data);
+	}
+	CacheTrim(msfz);
+	PdbLockRelease(msfz->lock);
+
+	free(items);
+
+	return covered;
+}
+
+
+static bool CopyFromChunk(PDB_MSFZ* msfz, uint32_t index, uint64_t offset, uint8_t* buff, uint32_t bytes)
+{
+	MSFZ_CHUNK* chunk = &msfz->chunks[index];
+
+	PdbLockAcquire(msfz->lock);
+
+	if (!chunk->data)
+	{
+		uint8_t* data;
+
+		// Decompress without holding up other readers
+		PdbLockRelease(msfz->lock);
+		data = DecompressChunk(msfz, index);
+		if (!data)
+			return false;
+
+		PdbLockAcquire(msfz->lock);
+		CacheInsert(msfz, index, data);
+	}
+	else
+	{
+		LruUnlink(msfz, index);
+		LruPushFront(msfz, index);
+	}
+
+	memcpy(buff, chunk->data + offset, bytes);
+
+	// Done with it, it can go if the cache is over budget
+	CacheTrim(msfz);
+
+	PdbLockRelease(msfz->lock);
+
+	return true;
+}
+
+
+bool PdbMsfzRead(PDB_MSFZ* msfz, uint32_t streamId, uint64_t offset, uint8_t* buff, uint64_t bytes)
+{
+	const MSFZ_STREAM* stream;
+	uint64_t ahead;
+	uint32_t end;
+	uint32_t i;
+	bool result = true;
+
+	if ((streamId >= msfz->streamCount) || (msfz->streams[streamId].size == PDB_MSFZ_NIL_STREAM))
+		return false;
+
+	stream = &msfz->streams[streamId];
+	if ((offset > stream->size) || (bytes > stream->size - offset))
+		return false;
+
+	if (!bytes)
+		return true;
+
+	ahead = offset;
+
+	end = stream->firstFragment + stream->fragmentCount;
+	for (i = FindFragment(msfz, stream, offset); (i < end) && bytes && result; i++)
+	{
+		const MSFZ_FRAGMENT* fragment = &msfz->fragments[i];
+		uint64_t within = offset - msfz->fragmentStarts[i];
+		uint32_t len = fragment->size - (uint32_t)within;
+
+		if (offset >= ahead)
+			ahead = DecompressAhead(msfz, stream, offset, bytes);
+
+		if (len > bytes)
+			len = (uint32_t)bytes;
+
+		if (fragment->chunk == MSFZ_NONE)
+			result = PdbFileReadAt(msfz->pdb, buff, len, fragment->offset + within);
+		else
+			result = CopyFromChunk(msfz, fragment->chunk, fragment->offset + within, buff, len);
+
+		buff += len;
+		offset += len;
+		bytes -= len;
+	}
+
+	return result && !bytes;
+}
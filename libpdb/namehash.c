@@ -0,0 +1,496 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "namehash.h"
+
+// Vector kernels are built for x64, where SSE2 is always there and AVX2 is
+// checked for at run time.  Everything else gets the scalar kernels.
+#if defined(_M_X64) || defined(__x86_64__)
+#define PDB_SIMD_X64
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PDB_TARGET_AVX2
+#else
+#define PDB_TARGET_AVX2 __attribute__((target("avx2")))
+#endif /* _MSC_VER */
+#endif
+
+
+// Vector loads must stay inside the page the string is known to be in
+#define PDB_PAGE_SIZE 4096
+
+
+typedef struct PDB_NAME_KERNELS
+{
+	PDB_SIMD_LEVEL level;
+	uint32_t (*hash)(const char* name);
+	uint32_t (*hashLength)(const char* name, size_t len);
+	size_t (*length)(const char* name);
+	void (*toLower)(char* dst, const char* src, size_t len);
+} PDB_NAME_KERNELS;
+
+
+// Picked on first use.  Every thread picks the same table, so the race to
+// set it is harmless.
+static const PDB_NAME_KERNELS* g_kernels = NULL;
+
+
+// The name hash used by the TPI hash stream (and the other MSF name tables),
+// LHashPbCb in Microsoft's PDB sources.  Note that this is not the rotating
+// hash in Ch 7.5 of "Microsoft Symbol and Type Information", that one is
+// for the old CodeView symbol tables and never matches a PDB's buckets.
+//
+// It XORs the name's dwords together, so any split of the name into
+// dword aligned pieces can be XORed in any order and give the same hash.
+static uint32_t FinishHash(uint32_t sum)
+{
+	sum |= 0x20202020; // tolower, case insensitive
+	sum ^= (sum >> 11);
+
+	return sum ^ (sum >> 16);
+}
+
+
+// XOR in whole dwords, then a trailing word and byte, if any
+static uint32_t HashTail(const uint8_t* pName, size_t len, uint32_t sum)
+{
+	uint32_t val;
+	size_t i;
+
+	for (i = 0; i + 4 <= len; i += 4)
+	{
+		memcpy(&val, pName + i, 4);
+		sum ^= val;
+	}
+
+	if (len - i >= 2)
+	{
+		sum ^= (uint32_t)(pName[i] | (pName[i + 1] << 8));
+		i += 2;
+	}
+
+	if (len - i == 1)
+		sum ^= pName[i];
+
+	return sum;
+}
+
+
+static uint32_t HashLengthScalar(const char* name, size_t len)
+{
+	return FinishHash(HashTail((const uint8_t*)name, len, 0));
+}
+
+
+static uint32_t HashScalar(const char* name)
+{
+	return HashLengthScalar(name, strlen(name));
+}
+
+
+static size_t LengthScalar(const char* name)
+{
+	return strlen(name);
+}
+
+
+static void ToLowerScalar(char* dst, const char* src, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		char c = src[i];
+
+		dst[i] = ((c >= 'A') && (c <= 'Z')) ? (char)(c | 0x20) : c;
+	}
+}
+
+
+static const PDB_NAME_KERNELS g_scalarKernels =
+{
+	PDB_SIMD_SCALAR, HashScalar, HashLengthScalar, LengthScalar, ToLowerScalar
+};
+
+
+#ifdef PDB_SIMD_X64
+
+static uint32_t LowestBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return (uint32_t)__builtin_ctz(mask);
+#endif /* _MSC_VER */
+}
+
+
+// Is a load of bytes at p confined to p's page?
+static bool FitsInPage(const uint8_t* p, size_t bytes)
+{
+	return ((size_t)((uintptr_t)p & (PDB_PAGE_SIZE - 1)) <= PDB_PAGE_SIZE - bytes);
+}
+
+
+// Scalar check for a terminator in the next bytes, for loads that would
+// cross into the next page
+static size_t FindZero(const uint8_t* p, size_t bytes)
+{
+	size_t i;
+
+	for (i = 0; i < bytes; i++)
+	{
+		if (!p[i])
+			break;
+	}
+
+	return i;
+}
+
+
+// The dword lanes of a vector XORed together.  XOR doesn't care about order,
+// so this is the same as XORing the dwords one at a time.
+static uint32_t Reduce128(__m128i acc)
+{
+	acc = _mm_xor_si128(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_xor_si128(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	return (uint32_t)_mm_cvtsi128_si32(acc);
+}
+
+
+// Find the terminator and hash in the same pass over the name
+static uint32_t HashSse2(const char* name)
+{
+	const uint8_t* p = (const uint8_t*)name;
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc = zero;
+	size_t i = 0;
+
+	for (;;)
+	{
+		__m128i v;
+		int mask;
+
+		if (!FitsInPage(p + i, 16))
+		{
+			size_t tail = FindZero(p + i, 16);
+
+			if (tail < 16)
+				return FinishHash(HashTail(p + i, tail, Reduce128(acc)));
+		}
+
+		v = _mm_loadu_si128((const __m128i*)(p + i));
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+
+		if (mask)
+			return FinishHash(HashTail(p + i, LowestBit(mask), Reduce128(acc)));
+
+		acc = _mm_xor_si128(acc, v);
+		i += 16;
+	}
+}
+
+
+static uint32_t HashLengthSse2(const char* name, size_t len)
+{
+	const uint8_t* p = (const uint8_t*)name;
+	__m128i acc = _mm_setzero_si128();
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16)
+		acc = _mm_xor_si128(acc, _mm_loadu_si128((const __m128i*)(p + i)));
+
+	return FinishHash(HashTail(p + i, len - i, Reduce128(acc)));
+}
+
+
+// Aligned loads never cross a page, so can safely read past the terminator
+static size_t LengthSse2(const char* name)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const char* block = (const char*)((uintptr_t)name & ~(uintptr_t)15);
+	uint32_t mask;
+
+	mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)block), zero));
+	mask >>= (name - block);
+
+	if (mask)
+		return LowestBit(mask);
+
+	for (;;)
+	{
+		block += 16;
+		mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)block), zero));
+
+		if (mask)
+			return (size_t)(block - name) + LowestBit(mask);
+	}
+}
+
+
+static void ToLowerSse2(char* dst, const char* src, size_t len)
+{
+	const __m128i beforeA = _mm_set1_epi8('A' - 1);
+	const __m128i afterZ = _mm_set1_epi8('Z' + 1);
+	const __m128i caseBit = _mm_set1_epi8(0x20);
+	size_t i;
+
+	// Bytes above 0x7f compare as negative, so are never upper case
+	for (i = 0; i + 16 <= len; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, beforeA), _mm_cmplt_epi8(v, afterZ));
+
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(v, _mm_and_si128(upper, caseBit)));
+	}
+
+	ToLowerScalar(dst + i, src + i, len - i);
+}
+
+
+static const PDB_NAME_KERNELS g_sse2Kernels =
+{
+	PDB_SIMD_SSE2, HashSse2, HashLengthSse2, LengthSse2, ToLowerSse2
+};
+
+
+PDB_TARGET_AVX2 static uint32_t Reduce256(__m256i acc)
+{
+	return Reduce128(_mm_xor_si128(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+}
+
+
+PDB_TARGET_AVX2 static uint32_t HashAvx2(const char* name)
+{
+	const uint8_t* p = (const uint8_t*)name;
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i acc = zero;
+	size_t i = 0;
+
+	for (;;)
+	{
+		__m256i v;
+		uint32_t mask;
+
+		if (!FitsInPage(p + i, 32))
+		{
+			size_t tail = FindZero(p + i, 32);
+
+			if (tail < 32)
+				return FinishHash(HashTail(p + i, tail, Reduce256(acc)));
+		}
+
+		v = _mm256_loadu_si256((const __m256i*)(p + i));
+		mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+
+		if (mask)
+			return FinishHash(HashTail(p + i, LowestBit(mask), Reduce256(acc)));
+
+		acc = _mm256_xor_si256(acc, v);
+		i += 32;
+	}
+}
+
+
+PDB_TARGET_AVX2 static uint32_t HashLengthAvx2(const char* name, size_t len)
+{
+	const uint8_t* p = (const uint8_t*)name;
+	__m256i acc = _mm256_setzero_si256();
+	size_t i;
+
+	for (i = 0; i + 32 <= len; i += 32)
+		acc = _mm256_xor_si256(acc, _mm256_loadu_si256((const __m256i*)(p + i)));
+
+	return FinishHash(HashTail(p + i, len - i, Reduce256(acc)));
+}
+
+
+PDB_TARGET_AVX2 static size_t LengthAvx2(const char* name)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const char* block = (const char*)((uintptr_t)name & ~(uintptr_t)31);
+	uint32_t mask;
+
+	mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)block), zero));
+	mask >>= (name - block);
+
+	if (mask)
+		return LowestBit(mask);
+
+	for (;;)
+	{
+		block += 32;
+		mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)block), zero));
+
+		if (mask)
+			return (size_t)(block - name) + LowestBit(mask);
+	}
+}
+
+
+PDB_TARGET_AVX2 static void ToLowerAvx2(char* dst, const char* src, size_t len)
+{
+	const __m256i beforeA = _mm256_set1_epi8('A' - 1);
+	const __m256i afterZ = _mm256_set1_epi8('Z' + 1);
+	const __m256i caseBit = _mm256_set1_epi8(0x20);
+	size_t i;
+
+	for (i = 0; i + 32 <= len; i += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+		__m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, beforeA), _mm256_cmpgt_epi8(afterZ, v));
+
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(v, _mm256_and_si256(upper, caseBit)));
+	}
+
+	ToLowerSse2(dst + i, src + i, len - i);
+}
+
+
+static const PDB_NAME_KERNELS g_avx2Kernels =
+{
+	PDB_SIMD_AVX2, HashAvx2, HashLengthAvx2, LengthAvx2, ToLowerAvx2
+};
+
+#endif /* PDB_SIMD_X64 */
+
+
+static PDB_SIMD_LEVEL DetectSimdLevel(void)
+{
+#ifdef PDB_SIMD_X64
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return PDB_SIMD_SSE2;
+
+	// The OS has to save the ymm registers too (OSXSAVE, AVX, and XCR0)
+	__cpuid(info, 1);
+	if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || ((_xgetbv(0) & 6) != 6))
+		return PDB_SIMD_SSE2;
+
+	__cpuidex(info, 7, 0);
+
+	return (info[1] & (1 << 5)) ? PDB_SIMD_AVX2 : PDB_SIMD_SSE2;
+#else
+	__builtin_cpu_init();
+
+	return __builtin_cpu_supports("avx2") ? PDB_SIMD_AVX2 : PDB_SIMD_SSE2;
+#endif /* _MSC_VER */
+#else
+	return PDB_SIMD_SCALAR;
+#endif /* PDB_SIMD_X64 */
+}
+
+
+static const PDB_NAME_KERNELS* SelectKernels(PDB_SIMD_LEVEL level)
+{
+	PDB_SIMD_LEVEL supported = DetectSimdLevel();
+
+	if (level > supported)
+		level = supported;
+
+#ifdef PDB_SIMD_X64
+	if (level == PDB_SIMD_AVX2)
+		return &g_avx2Kernels;
+
+	if (level == PDB_SIMD_SSE2)
+		return &g_sse2Kernels;
+#endif /* PDB_SIMD_X64 */
+
+	return &g_scalarKernels;
+}
+
+
+static const PDB_NAME_KERNELS* GetKernels(void)
+{
+	if (!g_kernels)
+		g_kernels = SelectKernels(PDB_SIMD_AVX2);
+
+	return g_kernels;
+}
+
+
+uint32_t PdbHashName(const char* name)
+{
+	return GetKernels()->hash(name);
+}
+
+
+uint32_t PdbHashNameLength(const char* name, size_t len)
+{
+	return GetKernels()->hashLength(name, len);
+}
+
+
+void PdbHashNames(const char* const* names, uint32_t count, uint32_t* hashes)
+{
+	const PDB_NAME_KERNELS* kernels = GetKernels();
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+	{
+#ifdef PDB_SIMD_X64
+		// Names are usually scattered, start fetching the next ones early
+		if (i + 4 < count)
+			_mm_prefetch(names[i + 4], _MM_HINT_T0);
+#endif /* PDB_SIMD_X64 */
+
+		hashes[i] = kernels->hash(names[i]);
+	}
+}
+
+
+size_t PdbNameLength(const char* name)
+{
+	return GetKernels()->length(name);
+}
+
+
+void PdbNameToLower(char* dst, const char* src, size_t len)
+{
+	GetKernels()->toLower(dst, src, len);
+}
+
+
+PDB_SIMD_LEVEL PdbGetSimdLevel(void)
+{
+	return GetKernels()->level;
+}
+
+
+PDB_SIMD_LEVEL PdbSetSimdLevel(PDB_SIMD_LEVEL level)
+{
+	g_kernels = SelectKernels(level);
+
+	return g_kernels->level;
+}
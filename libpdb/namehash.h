@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __NAMEHASH_H__
+#define __NAMEHASH_H__
+
+
+// Which kernels the name functions use
+typedef enum PDB_SIMD_LEVEL
+{
+	PDB_SIMD_SCALAR = 0,
+	PDB_SIMD_SSE2 = 1,
+	PDB_SIMD_AVX2 = 2
+} PDB_SIMD_LEVEL;
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// The hash the pdb's name hash tables are built with (version 1 of the
+	// MSF hash).  Take it modulo the table's bucket count.
+	PDBAPI uint32_t PdbHashName(const char* name);
+	PDBAPI uint32_t PdbHashNameLength(const char* name, size_t len);
+
+	// Hash a batch of terminated names into hashes
+	PDBAPI void PdbHashNames(const char* const* names, uint32_t count, uint32_t* hashes);
+
+	// strlen, and ASCII lower casing of len bytes (dst may be src)
+	PDBAPI size_t PdbNameLength(const char* name);
+	PDBAPI void PdbNameToLower(char* dst, const char* src, size_t len);
+
+	// The best level the processor supports is picked on first use.  Setting
+	// a level above what is supported picks the best supported one.
+	PDBAPI PDB_SIMD_LEVEL PdbGetSimdLevel(void);
+	PDBAPI PDB_SIMD_LEVEL PdbSetSimdLevel(PDB_SIMD_LEVEL level);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __NAMEHASH_H__ */
@@ -0,0 +1,848 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "tpi.h"
+#include "namehash.h"
+#include "nameindex.h"
+
+
+#define PDB_NAME_INDEX_MAGIC "PDBNAMES"
+#define PDB_NAME_INDEX_VERSION 1
+
+// Trigram keys are 24 bits, sorted in two passes of this many bits
+#define PDB_GRAM_RADIX_BITS 12
+
+
+// Starts every index, in memory and on disk
+typedef struct PDB_NAME_INDEX_HEADER
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t age;
+	uint8_t guid[16];
+	uint32_t names;
+	uint32_t nameBytes;
+	uint32_t grams;
+	uint32_t postings;
+} PDB_NAME_INDEX_HEADER;
+
+struct PDB_NAME_INDEX
+{
+	// The header and arrays are a single block, laid out as they are saved
+	uint8_t* block;
+	size_t blockSize;
+
+	const PDB_NAME_INDEX_HEADER* header;
+	const uint32_t* nameOffsets;
+	const uint32_t* typeIds;
+	const uint32_t* gramKeys;
+	const uint32_t* gramStarts;
+	const uint32_t* postings;
+	const char* names;
+};
+
+// A name as collected from the type stream
+typedef struct NAME_ENTRY
+{
+	const char* name;
+	uint32_t typeId;
+} NAME_ENTRY;
+
+typedef struct NAME_COLLECTOR
+{
+	char* names;
+	size_t namesUsed;
+	size_t namesSize;
+	uint32_t* offsets;
+	uint32_t* typeIds;
+	uint32_t count;
+	uint32_t capacity;
+} NAME_COLLECTOR;
+
+
+static uint32_t GramKey(const char* p)
+{
+	return ((uint32_t)(uint8_t)p[0] << 16) | ((uint32_t)(uint8_t)p[1] << 8) | (uint8_t)p[2];
+}
+
+
+// Bytes the arrays and names take up after the header
+static size_t BlockSize(uint32_t names, uint32_t nameBytes, uint32_t grams, uint32_t postings)
+{
+	return sizeof(PDB_NAME_INDEX_HEADER)
+		+ ((size_t)names * 2 + grams + (grams + 1) + postings) * sizeof(uint32_t) + nameBytes;
+}
+
+
+static void SetPointers(PDB_NAME_INDEX* index)
+{
+	const PDB_NAME_INDEX_HEADER* header = (const PDB_NAME_INDEX_HEADER*)index->block;
+	const uint32_t* arrays = (const uint32_t*)(index->block + sizeof(PDB_NAME_INDEX_HEADER));
+
+	index->header = header;
+	index->nameOffsets = arrays;
+	index->typeIds = index->nameOffsets + header->names;
+	index->gramKeys = index->typeIds + header->names;
+	index->gramStarts = index->gramKeys + header->grams;
+	index->postings = index->gramStarts + header->grams + 1;
+	index->names = (const char*)(index->postings + header->postings);
+}
+
+
+static bool CollectName(void* ctxt, uint32_t typeId, uint16_t leaf, const uint8_t* data, uint16_t len)
+{
+	NAME_COLLECTOR* collector = (NAME_COLLECTOR*)ctxt;
+	PDB_TYPE_UDT udt;
+	const char* name;
+	size_t nameLen;
+
+	if (!PdbTypesParseUdtDefinition(leaf, data, len, &udt, &name))
+		return true;
+
+	nameLen = strlen(name) + 1;
+
+	if (collector->namesUsed + nameLen > collector->namesSize)
+	{
+		size_t size = collector->namesSize ? (collector->namesSize * 2) : (1024 * 1024);
+		char* grown;
+
+		while (collector->namesUsed + nameLen > size)
+			size *= 2;
+
+		grown = (char*)realloc(collector->names, size);
+		if (!grown)
+			return false;
+
+		collector->names = grown;
+		collector->namesSize = size;
+	}
+
+	if (collector->count == collector->capacity)
+	{
+		uint32_t capacity = collector->capacity ? (collector->capacity * 2) : 4096;
+		uint32_t* offsets = (uint32_t*)realloc(collector->offsets, capacity * sizeof(uint32_t));
+		uint32_t* typeIds;
+
+		if (!offsets)
+			return false;
+		collector->offsets = offsets;
+
+		typeIds = (uint32_t*)realloc(collector->typeIds, capacity * sizeof(uint32_t));
+		if (!typeIds)
+			return false;
+		collector->typeIds = typeIds;
+
+		collector->capacity = capacity;
+	}
+
+	memcpy(collector->names + collector->namesUsed, name, nameLen);
+	collector->offsets[collector->count] = (uint32_t)collector->namesUsed;
+	collector->typeIds[collector->count] = typeId;
+	collector->namesUsed += nameLen;
+	collector->count++;
+
+	return true;
+}
+
+
+static int CompareEntries(const void* a, const void* b)
+{
+	const NAME_ENTRY* left = (const NAME_ENTRY*)a;
+	const NAME_ENTRY* right = (const NAME_ENTRY*)b;
+	int result = strcmp(left->name, right->name);
+
+	if (result)
+		return result;
+
+	return (left->typeId < right->typeId) ? -1 : (left->typeId > right->typeId);
+}
+
+
+// Drop later definitions of a name, keeping the first, and sort what's left
+static NAME_ENTRY* UniqueNames(NAME_COLLECTOR* collector, uint32_t* count)
+{
+	NAME_ENTRY* entries = NULL;
+	const char** names = NULL;
+	uint32_t* hashes = NULL;
+	uint32_t* slots = NULL;
+	uint32_t slotCount = 1024;
+	uint32_t i;
+
+	*count = 0;
+
+	while (slotCount < collector->count * 2)
+		slotCount *= 2;
+
+	entries = (NAME_ENTRY*)malloc(((size_t)collector->count + 1) * sizeof(NAME_ENTRY));
+	names = (const char**)malloc(((size_t)collector->count + 1) * sizeof(const char*));
+	hashes = (uint32_t*)malloc(((size_t)collector->count + 1) * sizeof(uint32_t));
+	slots = (uint32_t*)calloc(slotCount, sizeof(uint32_t));
+
+	if (!entries || !names || !hashes || !slots)
+	{
+		free(entries);
+		entries = NULL;
+		goto DONE;
+	}
+
+	for (i = 0; i < collector->count; i++)
+		names[i] = collector->names + collector->offsets[i];
+
+	PdbHashNames(names, collector->count, hashes);
+
+	for (i = 0; i < collector->count; i++)
+	{
+		uint32_t slot = hashes[i] & (slotCount - 1);
+		bool duplicate = false;
+
+		while (slots[slot])
+		{
+			if (strcmp(entries[slots[slot] - 1].name, names[i]) == 0)
+			{
+				duplicate = true;
+				break;
+			}
+
+			slot = (slot + 1) & (slotCount - 1);
+		}
+
+		if (duplicate)
+			continue;
+
+		entries[*count].name = names[i];
+		entries[*count].typeId = collector->typeIds[i];
+		slots[slot] = ++(*count);
+	}
+
+	qsort(entries, *count, sizeof(NAME_ENTRY), CompareEntries);
+
+DONE:
+	free(slots);
+	free(hashes);
+	free(names);
+
+	return entries;
+}
+
+
+// Stable sort of (key << 32 | name) pairs on their 24 bit key
+static bool SortGrams(uint64_t* pairs, size_t count)
+{
+	uint64_t* temp = (uint64_t*)malloc((count + 1) * sizeof(uint64_t));
+	uint32_t* buckets = (uint32_t*)malloc(((size_t)1 << PDB_GRAM_RADIX_BITS) * sizeof(uint32_t));
+	uint32_t shift;
+
+	if (!temp || !buckets)
+	{
+		free(buckets);
+		free(temp);
+		return false;
+	}
+
+	for (shift = 32; shift < 56; shift += PDB_GRAM_RADIX_BITS)
+	{
+		uint32_t mask = (1 << PDB_GRAM_RADIX_BITS) - 1;
+		uint32_t total = 0;
+		size_t i;
+
+		memset(buckets, 0, ((size_t)1 << PDB_GRAM_RADIX_BITS) * sizeof(uint32_t));
+
+		for (i = 0; i < count; i++)
+			buckets[(pairs[i] >> shift) & mask]++;
+
+		for (i = 0; i < ((size_t)1 << PDB_GRAM_RADIX_BITS); i++)
+		{
+			uint32_t bucket = buckets[i];
+
+			buckets[i] = total;
+			total += bucket;
+		}
+
+		for (i = 0; i < count; i++)
+			temp[buckets[(pairs[i] >> shift) & mask]++] = pairs[i];
+
+		memcpy(pairs, temp, count * sizeof(uint64_t));
+	}
+
+	free(buckets);
+	free(temp);
+
+	return true;
+}
+
+
+// Every distinct (trigram, name) pair, sorted by trigram then name
+static uint64_t* CollectGrams(const NAME_ENTRY* entries, uint32_t count, size_t* pairCount)
+{
+	uint64_t* pairs;
+	size_t total = 0;
+	size_t unique = 0;
+	size_t i;
+	uint32_t name;
+
+	*pairCount = 0;
+
+	for (name = 0; name < count; name++)
+	{
+		size_t len = PdbNameLength(entries[name].name);
+
+		if (len >= 3)
+			total += len - 2;
+	}
+
+	pairs = (uint64_t*)malloc((total + 1) * sizeof(uint64_t));
+	if (!pairs)
+		return NULL;
+
+	total = 0;
+
+	for (name = 0; name < count; name++)
+	{
+		const char* p;
+
+		for (p = entries[name].name; p[0] && p[1] && p[2]; p++)
+			pairs[total++] = ((uint64_t)GramKey(p) << 32) | name;
+	}
+
+	if (!SortGrams(pairs, total))
+	{
+		free(pairs);
+		return NULL;
+	}
+
+	// A name with the same trigram twice only needs to be listed once
+	for (i = 0; i < total; i++)
+	{
+		if ((unique == 0) || (pairs[unique - 1] != pairs[i]))
+			pairs[unique++] = pairs[i];
+	}
+
+	*pairCount = unique;
+
+	return pairs;
+}
+
+
+PDB_NAME_INDEX* PdbNameIndexBuild(PDB_TYPES* types)
+{
+	PDB_NAME_INDEX* index = NULL;
+	PDB_NAME_INDEX_HEADER* header;
+	NAME_COLLECTOR collector;
+	NAME_ENTRY* entries = NULL;
+	uint64_t* pairs = NULL;
+	size_t pairCount = 0;
+	uint32_t count = 0;
+	uint32_t nameBytes = 0;
+	uint32_t grams = 0;
+	uint32_t* arrays;
+	char* names;
+	size_t i;
+
+	memset(&collector, 0, sizeof(collector));
+
+	if (!PdbTypesWalk(types, CollectName, &collector))
+		goto DONE;
+
+	entries = UniqueNames(&collector, &count);
+	if (!entries)
+		goto DONE;
+
+	pairs = CollectGrams(entries, count, &pairCount);
+	if (!pairs)
+		goto DONE;
+
+	for (i = 0; i < count; i++)
+		nameBytes += (uint32_t)strlen(entries[i].name) + 1;
+
+	for (i = 0; i < pairCount; i++)
+	{
+		if ((i == 0) || ((pairs[i] >> 32) != (pairs[i - 1] >> 32)))
+			grams++;
+	}
+
+	index = (PDB_NAME_INDEX*)calloc(1, sizeof(PDB_NAME_INDEX));
+	if (!index)
+		goto DONE;
+
+	index->blockSize = BlockSize(count, nameBytes, grams, (uint32_t)pairCount);
+	index->block = (uint8_t*)malloc(index->blockSize);
+	if (!index->block)
+	{
+		free(index);
+		index = NULL;
+		goto DONE;
+	}
+
+	header = (PDB_NAME_INDEX_HEADER*)index->block;
+	memset(header, 0, sizeof(PDB_NAME_INDEX_HEADER));
+	memcpy(header->magic, PDB_NAME_INDEX_MAGIC, sizeof(header->magic));
+	header->version = PDB_NAME_INDEX_VERSION;
+	header->names = count;
+	header->nameBytes = nameBytes;
+	header->grams = grams;
+	header->postings = (uint32_t)pairCount;
+	PdbGetSignature(PdbTypesGetPdb(types), header->guid, &header->age);
+
+	SetPointers(index);
+
+	// Names, in sorted order
+	arrays = (uint32_t*)(index->block + sizeof(PDB_NAME_INDEX_HEADER));
+	names = (char*)index->names;
+	nameBytes = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		size_t len = strlen(entries[i].name) + 1;
+
+		arrays[i] = nameBytes;
+		arrays[count + i] = entries[i].typeId;
+		memcpy(names + nameBytes, entries[i].name, len);
+		nameBytes += (uint32_t)len;
+	}
+
+	// Then the trigrams and their postings
+	arrays += (size_t)count * 2;
+	grams = 0;
+
+	for (i = 0; i < pairCount; i++)
+	{
+		uint32_t key = (uint32_t)(pairs[i] >> 32);
+
+		if ((i == 0) || (key != (uint32_t)(pairs[i - 1] >> 32)))
+		{
+			arrays[grams] = key;
+			arrays[header->grams + grams] = (uint32_t)i;
+			grams++;
+		}
+
+		arrays[header->grams * 2 + 1 + i] = (uint32_t)pairs[i];
+	}
+
+	arrays[header->grams * 2] = (uint32_t)pairCount;
+
+DONE:
+	free(pairs);
+	free(entries);
+	free(collector.typeIds);
+	free(collector.offsets);
+	free(collector.names);
+
+	return index;
+}
+
+
+void PdbNameIndexClose(PDB_NAME_INDEX* index)
+{
+	free(index->block);
+	free(index);
+}
+
+
+// Make sure a loaded index can't send a query out of bounds
+static bool ValidateIndex(const PDB_NAME_INDEX* index)
+{
+	const PDB_NAME_INDEX_HEADER* header = index->header;
+	uint32_t i;
+
+	if ((header->nameBytes == 0) ? (header->names != 0) : (index->names[header->nameBytes - 1] != '\0'))
+		return false;
+
+	for (i = 0; i < header->names; i++)
+	{
+		if (index->nameOffsets[i] >= header->nameBytes)
+			return false;
+	}
+
+	if ((index->gramStarts[0] != 0) || (index->gramStarts[header->grams] != header->postings))
+		return false;
+
+	for (i = 0; i < header->grams; i++)
+	{
+		if (index->gramStarts[i] > index->gramStarts[i + 1])
+			return false;
+	}
+
+	for (i = 0; i < header->postings; i++)
+	{
+		if (index->postings[i] >= header->names)
+			return false;
+	}
+
+	return true;
+}
+
+
+PDB_NAME_INDEX* PdbNameIndexLoad(const char* path, PDB_FILE* pdb)
+{
+	PDB_NAME_INDEX* index = NULL;
+	PDB_NAME_INDEX_HEADER header;
+	uint8_t guid[16];
+	uint32_t age;
+	FILE* file;
+	size_t size;
+
+	if (!PdbGetSignature(pdb, guid, &age))
+		return NULL;
+
+	file = fopen(path, "rb");
+	if (!file)
+		return NULL;
+
+	if ((fread(&header, sizeof(header), 1, file) != 1)
+		|| memcmp(header.magic, PDB_NAME_INDEX_MAGIC, sizeof(header.magic))
+		|| (header.version != PDB_NAME_INDEX_VERSION)
+		|| (header.age != age) || memcmp(header.guid, guid, sizeof(guid)))
+		goto DONE;
+
+	// Check the counts against the file before trusting them with an allocation
+	size = BlockSize(header.names, header.nameBytes, header.grams, header.postings);
+
+	if ((fseek(file, 0, SEEK_END) != 0) || ((size_t)ftell(file) != size))
+		goto DONE;
+
+	index = (PDB_NAME_INDEX*)calloc(1, sizeof(PDB_NAME_INDEX));
+	if (!index)
+		goto DONE;
+
+	index->blockSize = size;
+	index->block = (uint8_t*)malloc(size);
+
+	if (!index->block || (fseek(file, 0, SEEK_SET) != 0) || (fread(index->block, 1, size, file) != size))
+		goto FAIL;
+
+	SetPointers(index);
+
+	if (ValidateIndex(index))
+		goto DONE;
+
+FAIL:
+	free(index->block);
+	free(index);
+	index = NULL;
+
+DONE:
+	fclose(file);
+
+	return index;
+}
+
+
+bool PdbNameIndexSave(PDB_NAME_INDEX* index, const char* path)
+{
+	FILE* file = fopen(path, "wb");
+	bool result;
+
+	if (!file)
+		return false;
+
+	result = (fwrite(index->block, 1, index->blockSize, file) == index->blockSize);
+
+	if (fclose(file))
+		result = false;
+
+	// Don't leave a partial index behind to be found later
+	if (!result)
+		remove(path);
+
+	return result;
+}
+
+
+PDB_NAME_INDEX* PdbNameIndexOpen(PDB_TYPES* types, const char* path)
+{
+	PDB_NAME_INDEX* index = PdbNameIndexLoad(path, PdbTypesGetPdb(types));
+
+	if (index)
+		return index;
+
+	index = PdbNameIndexBuild(types);
+
+	// Failing to save only costs the next run a rebuild
+	if (index)
+		PdbNameIndexSave(index, path);
+
+	return index;
+}
+
+
+uint32_t PdbNameIndexGetCount(PDB_NAME_INDEX* index)
+{
+	return index->header->names;
+}
+
+
+static const char* IndexName(PDB_NAME_INDEX* index, uint32_t i)
+{
+	return index->names + index->nameOffsets[i];
+}
+
+
+// Count a match and pass it on, false when the caller wants to stop
+static bool ReportMatch(PDB_NAME_INDEX* index, uint32_t i, PdbNameMatchFunction matchFn, void* ctxt,
+	uint32_t* matches)
+{
+	(*matches)++;
+
+	if (!matchFn)
+		return true;
+
+	return matchFn(ctxt, IndexName(index, i), index->typeIds[i]);
+}
+
+
+// The first name not sorting before the first len characters of str
+static uint32_t LowerBound(PDB_NAME_INDEX* index, const char* str, size_t len)
+{
+	uint32_t low = 0;
+	uint32_t high = index->header->names;
+
+	while (low < high)
+	{
+		uint32_t mid = low + (high - low) / 2;
+
+		if (strncmp(IndexName(index, mid), str, len) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+
+// The postings of the rarest trigram in run, the names that could contain
+// it.  false if some trigram isn't in any name, so nothing can match.
+static bool FindCandidates(PDB_NAME_INDEX* index, const char* run, size_t len,
+	const uint32_t** candidates, uint32_t* count)
+{
+	size_t i;
+
+	*candidates = NULL;
+	*count = 0;
+
+	for (i = 0; i + 3 <= len; i++)
+	{
+		uint32_t key = GramKey(run + i);
+		uint32_t low = 0;
+		uint32_t high = index->header->grams;
+		uint32_t postings;
+
+		while (low < high)
+		{
+			uint32_t mid = low + (high - low) / 2;
+
+			if (index->gramKeys[mid] < key)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+
+		if ((low == index->header->grams) || (index->gramKeys[low] != key))
+			return false;
+
+		postings = index->gramStarts[low + 1] - index->gramStarts[low];
+
+		if (!*candidates || (postings < *count))
+		{
+			*candidates = index->postings + index->gramStarts[low];
+			*count = postings;
+		}
+	}
+
+	return true;
+}
+
+
+uint32_t PdbNameIndexFindPrefix(PDB_NAME_INDEX* index, const char* prefix,
+	PdbNameMatchFunction matchFn, void* ctxt)
+{
+	size_t len = strlen(prefix);
+	uint32_t matches = 0;
+	uint32_t i;
+
+	// Names with the prefix sort together, starting where the prefix would
+	for (i = LowerBound(index, prefix, len); i < index->header->names; i++)
+	{
+		if (strncmp(IndexName(index, i), prefix, len) != 0)
+			break;
+
+		if (!ReportMatch(index, i, matchFn, ctxt, &matches))
+			break;
+	}
+
+	return matches;
+}
+
+
+uint32_t PdbNameIndexFindSubstring(PDB_NAME_INDEX* index, const char* substring,
+	PdbNameMatchFunction matchFn, void* ctxt)
+{
+	size_t len = strlen(substring);
+	const uint32_t* candidates;
+	uint32_t count;
+	uint32_t matches = 0;
+	uint32_t i;
+
+	if (len < 3)
+	{
+		for (i = 0; i < index->header->names; i++)
+		{
+			if (strstr(IndexName(index, i), substring) && !ReportMatch(index, i, matchFn, ctxt, &matches))
+				break;
+		}
+
+		return matches;
+	}
+
+	if (!FindCandidates(index, substring, len, &candidates, &count))
+		return 0;
+
+	for (i = 0; i < count; i++)
+	{
+		if (strstr(IndexName(index, candidates[i]), substring)
+			&& !ReportMatch(index, candidates[i], matchFn, ctxt, &matches))
+			break;
+	}
+
+	return matches;
+}
+
+
+static bool GlobMatch(const char* pattern, const char* name)
+{
+	const char* star = NULL; // The last '*' seen, to backtrack to
+	const char* resume = NULL; // Where in name that '*' is matching up to
+
+	while (*name)
+	{
+		if (*pattern == '*')
+		{
+			star = pattern++;
+			resume = name;
+		}
+		else if ((*pattern == '?') || (*pattern == *name))
+		{
+			pattern++;
+			name++;
+		}
+		else if (star)
+		{
+			// Let the '*' swallow one more character and try again
+			pattern = star + 1;
+			name = ++resume;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while (*pattern == '*')
+		pattern++;
+
+	return (*pattern == '\0');
+}
+
+
+uint32_t PdbNameIndexFindGlob(PDB_NAME_INDEX* index, const char* pattern,
+	PdbNameMatchFunction matchFn, void* ctxt)
+{
+	size_t wildcard = strcspn(pattern, "*?");
+	const char* run = NULL;
+	size_t runLen = 0;
+	const char* p;
+	const uint32_t* candidates;
+	uint32_t count;
+	uint32_t matches = 0;
+	uint32_t i;
+
+	// No wildcards, look the name up
+	if (pattern[wildcard] == '\0')
+	{
+		i = LowerBound(index, pattern, wildcard);
+
+		if ((i < index->header->names) && (strcmp(IndexName(index, i), pattern) == 0))
+			ReportMatch(index, i, matchFn, ctxt, &matches);
+
+		return matches;
+	}
+
+	// A literal prefix narrows it down to a range of names
+	if (wildcard > 0)
+	{
+		for (i = LowerBound(index, pattern, wildcard); i < index->header->names; i++)
+		{
+			const char* name = IndexName(index, i);
+
+			// Past the names with this prefix?
+			if (strncmp(name, pattern, wildcard) != 0)
+				break;
+
+			if (GlobMatch(pattern, name) && !ReportMatch(index, i, matchFn, ctxt, &matches))
+				break;
+		}
+
+		return matches;
+	}
+
+	// Otherwise go by the longest literal run
+	for (p = pattern; *p; )
+	{
+		size_t len = strcspn(p, "*?");
+
+		if (len > runLen)
+		{
+			run = p;
+			runLen = len;
+		}
+
+		p += len;
+		if (*p)
+			p++;
+	}
+
+	if (runLen >= 3)
+	{
+		if (!FindCandidates(index, run, runLen, &candidates, &count))
+			return 0;
+
+		for (i = 0; i < count; i++)
+		{
+			if (GlobMatch(pattern, IndexName(index, candidates[i]))
+				&& !ReportMatch(index, candidates[i], matchFn, ctxt, &matches))
+				break;
+		}
+
+		return matches;
+	}
+
+	for (i = 0; i < index->header->names; i++)
+	{
+		if (GlobMatch(pattern, IndexName(index, i)) && !ReportMatch(index, i, matchFn, ctxt, &matches))
+			break;
+	}
+
+	return matches;
+}
@@ -0,0 +1,87 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __NAMEINDEX_H__
+#define __NAMEINDEX_H__
+
+
+typedef struct PDB_NAME_INDEX PDB_NAME_INDEX;
+
+// Called for each name that matches, in sorted name order.  typeId is the
+// first definition with that name.  Return false to stop.
+typedef bool (*PdbNameMatchFunction)(void* ctxt, const char* name, uint32_t typeId);
+
+// The file format, all little endian:
+//
+// Header: char magic[8] "PDBNAMES", uint32 version (1), uint32 age,
+// uint8 guid[16], uint32 names, nameBytes, grams, postings.
+//
+// Then the arrays, in order:
+//
+//   uint32 nameOffset[names], typeId[names]: the names in sorted order
+//   uint32 gramKey[grams]: each distinct trigram, sorted, as b0 << 16 | b1 << 8 | b2
+//   uint32 gramStart[grams + 1]: gram i's postings are [gramStart[i], gramStart[i + 1])
+//   uint32 posting[postings]: sorted indices of the names containing the trigram
+//   char nameBytes: the NUL terminated names that nameOffset points into
+//
+// guid and age are the pdb's, see PdbGetSignature.
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Index the names of every struct, class, union and enum definition.
+	// Names are kept sorted for prefix queries, with a trigram index for
+	// substring queries.  Matching is case sensitive.
+	PDBAPI PDB_NAME_INDEX* PdbNameIndexBuild(PDB_TYPES* types);
+	PDBAPI void PdbNameIndexClose(PDB_NAME_INDEX* index);
+
+	// An index saved for this pdb, NULL if the file is missing, damaged, or
+	// was saved for a different build
+	PDBAPI PDB_NAME_INDEX* PdbNameIndexLoad(const char* path, PDB_FILE* pdb);
+	PDBAPI bool PdbNameIndexSave(PDB_NAME_INDEX* index, const char* path);
+
+	// Load the index saved at path, or build it and save it there
+	PDBAPI PDB_NAME_INDEX* PdbNameIndexOpen(PDB_TYPES* types, const char* path);
+
+	PDBAPI uint32_t PdbNameIndexGetCount(PDB_NAME_INDEX* index);
+
+	// The queries return the number of matches reported.  matchFn may be NULL
+	// to just count them.  Substrings shorter than three characters, and globs
+	// without a literal prefix or a three character run, check every name.
+	PDBAPI uint32_t PdbNameIndexFindPrefix(PDB_NAME_INDEX* index, const char* prefix,
+		PdbNameMatchFunction matchFn, void* ctxt);
+	PDBAPI uint32_t PdbNameIndexFindSubstring(PDB_NAME_INDEX* index, const char* substring,
+		PdbNameMatchFunction matchFn, void* ctxt);
+
+	// '*' matches any run of characters and '?' any single one
+	PDBAPI uint32_t PdbNameIndexFindGlob(PDB_NAME_INDEX* index, const char* pattern,
+		PdbNameMatchFunction matchFn, void* ctxt);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __NAMEINDEX_H__ */
@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <stdlib.h>
+
+#include "pdb.h"
+#include "names.h"
+
+
+#define PDB_NAMES_SIGNATURE 0xEFFEEFFE
+#define PDB_NAMES_HEADER_SIZE 12
+
+
+struct PDB_NAMES
+{
+	char* strings; // Terminated after the last string
+	uint32_t size;
+};
+
+
+PDB_NAMES* PdbNamesOpen(PDB_FILE* pdb)
+{
+	uint16_t streamId = PdbGetNamedStream(pdb, "/names");
+	PDB_STREAM* stream;
+	PDB_NAMES* names = NULL;
+	uint32_t header[3]; // signature, version, string bytes
+
+	if (streamId == PDB_STREAM_NONE)
+		return NULL;
+
+	stream = PdbStreamOpen(pdb, streamId);
+	if (!stream)
+		return NULL;
+
+	if (!PdbStreamRead(stream, (uint8_t*)header, sizeof(header)) || (header[0] != PDB_NAMES_SIGNATURE)
+		|| (header[2] > PdbStreamGetSize(stream) - PDB_NAMES_HEADER_SIZE))
+		goto FAIL;
+
+	names = (PDB_NAMES*)calloc(1, sizeof(PDB_NAMES));
+	if (!names)
+		goto FAIL;
+
+	// The hash buckets after the strings are for finding a string's offset,
+	// which nothing needs yet
+	names->size = header[2];
+	names->strings = (char*)malloc(names->size + 1);
+	if (!names->strings || !PdbStreamRead(stream, (uint8_t*)names->strings, names->size))
+		goto FAIL;
+
+	names->strings[names->size] = 0;
+
+	PdbStreamClose(stream);
+
+	return names;
+
+FAIL:
+	if (names)
+		PdbNamesClose(names);
+
+	PdbStreamClose(stream);
+
+	return NULL;
+}
+
+
+void PdbNamesClose(PDB_NAMES* names)
+{
+	free(names->strings);
+	free(names);
+}
+
+
+const char* PdbNamesGet(PDB_NAMES* names, uint32_t offset)
+{
+	if (offset >= names->size)
+		return (offset == 0) ? "" : NULL;
+
+	return names->strings + offset;
+}
@@ -0,0 +1,51 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __NAMES_H__
+#define __NAMES_H__
+
+
+typedef struct PDB_NAMES PDB_NAMES;
+
+// The /names stream is the pdb's shared string table.  Line numbers, frame
+// data programs and a few type records refer to strings in it by offset.
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Read the whole string table.  NULL if the pdb has no /names stream.
+	PDBAPI PDB_NAMES* PdbNamesOpen(PDB_FILE* pdb);
+	PDBAPI void PdbNamesClose(PDB_NAMES* names);
+
+	// The string at offset, NULL if the offset is out of range.  Offset 0
+	// is the empty string.
+	PDBAPI const char* PdbNamesGet(PDB_NAMES* names, uint32_t offset);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __NAMES_H__ */
@@ -29,11 +29,19 @@ http://ccimetadata.codeplex.com/ Microsoft Common Compiler Infrastructure Metada
 
 */
 
+#ifdef __linux__
+#define _GNU_SOURCE // copy_file_range
+#endif /* __linux__ */
+
+#ifndef WIN32
+#define _FILE_OFFSET_BITS 64 // off_t past 4GB on 32 bit builds
+#endif /* WIN32 */
 
 #include <string.h>
 #include <errno.h>
 
 #include "pdb.h"
+#include "internal.h"
 
 const char PDB_SIGNATURE_V2[] = "Microsoft C/C++ program database 2.00\r\n";
 const char PDB_SIGNATURE_V7[] = "Microsoft C/C++ MSF 7.00\r\n";
@@ -41,25 +49,73 @@ const char PDB_SIGNATURE_V7[] = "Microsoft C/C++ MSF 7.00\r\n";
 #define PDB_HEADER_SIZE_V2 (sizeof(PDB_SIGNATURE_V2) + 4)
 #define PDB_HEADEr_SIZE_V7 (sizeof(PDB_SIGNATURE_V7) + 5)
 
+// Stream size recorded in the directory for deleted streams
+#define PDB_NIL_STREAM_SIZE 0xffffffff
+
+// Page sizes are powers of two.  Large pdbs move up from 4K to as much as 64K
+// pages to stay addressable.
+#define PDB_MIN_PAGE_SIZE 0x200
+#define PDB_MAX_PAGE_SIZE 0x10000
+
+// Where the v7 header lists the pages holding the root stream's page list
+#define PDB_ROOT_MAP_OFFSET_V7 52
+
+// How far ahead of a sequential reader to ask the OS to prefetch
+#define PDB_READAHEAD_WINDOW (4 * 1024 * 1024)
+
+// Chunk size for stream copies that can't be done in the kernel
+#define PDB_COPY_BUFFER_SIZE (1024 * 1024)
+
+// Smallest fetch made while reading the header and root page list
+#define PDB_FILE_BUFFER_SIZE 4096
+
+// Stream buffering granularity in MSFZ containers, which have no pages
+#define PDB_MSFZ_PAGE_SIZE 4096
+
+// Pages a stream keeps from its last fetch, and how far sequential readers
+// fetch in one go
+#define PDB_STREAM_BUFFER_SIZE (64 * 1024)
+
 
 #ifdef WIN32
-#define fseeko _fseeki64
-#define ftello _ftelli64
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#else
+#include <pthread.h>
+#endif /* __linux__ */
 #endif /* WIN32 */
 
 
 struct PDB_FILE
 {
-	char* name; // file name
-	FILE* file;
+	const PDB_IO_OPS* io; // Where the bytes come from
+	void* ioCtxt;
+	uint64_t fileSize;
+	uint64_t lastReadEnd; // Where the last counted read ended
+
+	uint64_t position; // Next byte for the header parser
+	uint8_t* buffer; // Fetched around position
+	uint64_t bufferStart;
+	size_t bufferLen;
+
 	uint8_t version; // version from the header (2 or 7 are known)
 	uint32_t streamCount; // number of streams in the file
 	uint32_t pageSize; // bytes per page
+	uint32_t pageShift; // log2(pageSize)
 	uint32_t pageCount; // total file bytes / page bytes
 	uint32_t flagPage;
 
 	PDB_STREAM* root;
-	PDB_STREAM* lastAccessed;
+	PDB_MSFZ* msfz; // Compressed container, NULL for MSF files
+
+	PDB_STATS stats; // I/O and parse counters, see PdbGetStats
 };
 
 
@@ -71,40 +127,245 @@ struct PDB_STREAM
 	uint64_t currentOffset; // The current offset
 	uint32_t pageCount; // Total pages in this stream
 	uint32_t size; // Total bytes in the stream
+	PDB_STREAM_ACCESS access; // The access pattern hint given by the consumer
+	uint64_t readahead; // Stream offset up to which prefetch has been requested
+
+	uint8_t* buffer; // Pages from the last fetch, allocated on first read
+	uint64_t bufferStart; // Stream offset of the first buffered byte
+	uint32_t bufferLen;
+	uint32_t bufferSize;
 };
 
 
-static bool PdbCheckFileSize(PDB_FILE* pdb)
+uint64_t PdbTimeNow(void)
 {
-	off_t currentOffset;
-	off_t fileSize;
-	uint64_t expectedPages;
+#ifdef WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
 
-	// Don't divide by zero
-	if (pdb->pageSize == 0)
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+
+	QueryPerformanceCounter(&counter);
+
+	// Split the conversion to avoid overflowing the multiply
+	return ((counter.QuadPart / frequency.QuadPart) * 1000000000)
+		+ (((counter.QuadPart % frequency.QuadPart) * 1000000000) / frequency.QuadPart);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+#endif /* WIN32 */
+}
+
+
+void* PdbAlignedAlloc(size_t size)
+{
+#ifdef WIN32
+	return _aligned_malloc(size ? size : 1, PDB_CACHE_LINE);
+#else
+	void* ptr;
+
+	if (posix_memalign(&ptr, PDB_CACHE_LINE, size ? size : 1))
+		return NULL;
+
+	return ptr;
+#endif /* WIN32 */
+}
+
+
+void PdbAlignedFree(void* ptr)
+{
+#ifdef WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif /* WIN32 */
+}
+
+
+// The number of keys <= key.  Each step picks its half with a conditional
+// move rather than a branch, so the loop runs the same number of times
+// whatever the data and never mispredicts.
+uint32_t PdbUpperBound(const uint32_t* keys, uint32_t count, uint32_t key)
+{
+	const uint32_t* base = keys;
+	uint32_t n = count;
+
+	if (n == 0)
+		return 0;
+
+	while (n > 1)
+	{
+		uint32_t half = n / 2;
+
+		base = (base[half] <= key) ? (base + half) : base;
+		n -= half;
+	}
+
+	return (uint32_t)(base - keys) + (*base <= key);
+}
+
+
+void PdbStatsAddTime(PDB_FILE* pdb, PDB_SUBSYSTEM subsystem, uint64_t start)
+{
+	pdb->stats.time[subsystem] += PdbTimeNow() - start;
+}
+
+
+PdbTraceFunction g_pdbTraceFn = NULL;
+static void* g_pdbTraceCtxt = NULL;
+
+
+// The calling thread's id as the system reports it, so that traces line
+// up with other tools
+static uint32_t PdbThreadId(void)
+{
+#ifdef WIN32
+	return (uint32_t)GetCurrentThreadId();
+#elif defined(__linux__)
+	return (uint32_t)syscall(SYS_gettid);
+#else
+	return (uint32_t)(uintptr_t)pthread_self();
+#endif /* WIN32 */
+}
+
+
+void PdbSetTraceHook(PdbTraceFunction traceFn, void* ctxt)
+{
+	g_pdbTraceCtxt = ctxt;
+	g_pdbTraceFn = traceFn;
+}
+
+
+void PdbTraceEmit(PDB_TRACE_EVENT event, const char* name, uint64_t arg, uint64_t start)
+{
+	PDB_TRACE_RECORD record;
+	uint64_t now = PdbTimeNow();
+
+	if (!g_pdbTraceFn)
+		return;
+
+	record.event = event;
+	record.name = name;
+	record.arg = arg;
+	record.thread = PdbThreadId();
+
+	if (event == PDB_TRACE_IO)
+	{
+		record.timestamp = start;
+		record.duration = now - start;
+	}
+	else
+	{
+		record.timestamp = now;
+		record.duration = 0;
+	}
+
+	g_pdbTraceFn(g_pdbTraceCtxt, &record);
+}
+
+
+bool PdbFileReadAt(PDB_FILE* pdb, void* buff, size_t bytes, uint64_t offset)
+{
+	return pdb->io->read(pdb->ioCtxt, offset, buff, bytes);
+}
+
+
+// A read on the single threaded paths, counted in the stats
+static bool PdbFileFetch(PDB_FILE* pdb, void* buff, size_t bytes, uint64_t offset)
+{
+	pdb->stats.reads++;
+
+	if (offset != pdb->lastReadEnd)
+		pdb->stats.seeks++;
+
+	if (!PdbFileReadAt(pdb, buff, bytes, offset))
 		return false;
 
-	// Preserve the current offset, we are going to validate the file size
-	currentOffset = ftello(pdb->file);
+	pdb->stats.bytesRead += bytes;
+	pdb->lastReadEnd = offset + bytes;
+
+	return true;
+}
+
+
+// Sequential reads for the header and the root page list.  They go through
+// a small buffer so that each field isn't a fetch of its own.
+static size_t PdbFileRead(PDB_FILE* pdb, void* buff, size_t bytes)
+{
+	if ((pdb->position < pdb->bufferStart)
+		|| (pdb->position + bytes > pdb->bufferStart + pdb->bufferLen))
+	{
+		size_t len = (bytes > PDB_FILE_BUFFER_SIZE) ? bytes : PDB_FILE_BUFFER_SIZE;
+		uint8_t* buffer;
+
+		if (pdb->position >= pdb->fileSize)
+			return 0;
+
+		if (len > pdb->fileSize - pdb->position)
+			len = (size_t)(pdb->fileSize - pdb->position);
+
+		if (len < bytes)
+			return 0;
+
+		buffer = (uint8_t*)realloc(pdb->buffer, len);
+		if (!buffer)
+			return 0;
+
+		pdb->buffer = buffer;
+		pdb->bufferLen = 0;
+
+		if (!PdbFileFetch(pdb, pdb->buffer, len, pdb->position))
+			return 0;
 
-	// Goto the end of the file
-	if (fseeko(pdb->file, 0, SEEK_END))
+		pdb->bufferStart = pdb->position;
+		pdb->bufferLen = len;
+	}
+
+	memcpy(buff, pdb->buffer + (pdb->position - pdb->bufferStart), bytes);
+	pdb->position += bytes;
+
+	return bytes;
+}
+
+
+static void PdbFileSeek(PDB_FILE* pdb, uint64_t offset)
+{
+	pdb->position = offset;
+}
+
+
+// Check the page size from the header, pages are addressed with shifts
+static bool PdbSetPageSize(PDB_FILE* pdb, uint32_t pageSize)
+{
+	if ((pageSize < PDB_MIN_PAGE_SIZE) || (pageSize > PDB_MAX_PAGE_SIZE) || (pageSize & (pageSize - 1)))
 		return false;
 
-	fileSize = ftello(pdb->file);
+	pdb->pageSize = pageSize;
+	for (pdb->pageShift = 0; (1u << pdb->pageShift) < pageSize; pdb->pageShift++);
+
+	return true;
+}
+
+
+static bool PdbCheckFileSize(PDB_FILE* pdb)
+{
+	uint64_t expectedPages;
+
+	// Don't divide by zero
+	if (pdb->pageSize == 0)
+		return false;
 
 	// Calculate the expected file size
-	expectedPages = ((uint64_t)fileSize / pdb->pageSize)
-		+ ((fileSize % pdb->pageSize) ? 1 : 0);
+	expectedPages = (pdb->fileSize + pdb->pageSize - 1) >> pdb->pageShift;
 
 	// See if the size yields the expected number of pages
 	if (expectedPages != pdb->pageCount)
 		return false;
 
-	// Return to the saved offset
-	if (fseeko(pdb->file, currentOffset, SEEK_SET))
-		return false;
-
 	return true;
 }
 
@@ -116,7 +377,7 @@ static uint32_t GetPageCount(PDB_FILE* pdb, uint32_t bytes)
 		return 0;
 
 	// Round up in cases where it isn't a multiple of the page size
-	return (bytes / pdb->pageSize) + ((bytes % pdb->pageSize != 0) ? 1 : 0);
+	return (uint32_t)(((uint64_t)bytes + pdb->pageSize - 1) >> pdb->pageShift);
 }
 
 
@@ -126,9 +387,120 @@ uint16_t PdbGetStreamCount(PDB_FILE* pdb)
 }
 
 
-static bool PdbStreamOpenRoot(PDB_FILE* pdb, uint16_t rootStreamPageIndex, uint32_t size)
+bool PdbGetSignature(PDB_FILE* pdb, uint8_t guid[16], uint32_t* age)
+{
+	PDB_STREAM* stream = PdbStreamOpen(pdb, PDB_STREAM_PROGRAM_INFO);
+	uint32_t header[3]; // version, signature, age
+	bool result;
+
+	if (!stream)
+		return false;
+
+	memset(guid, 0, 16);
+
+	result = PdbStreamRead(stream, (uint8_t*)header, sizeof(header));
+
+	if (result)
+	{
+		*age = header[2];
+
+		if (PdbStreamGetSize(stream) >= sizeof(header) + 16)
+			result = PdbStreamRead(stream, guid, 16);
+		else
+			memcpy(guid, &header[1], 4);
+	}
+
+	PdbStreamClose(stream);
+
+	return result;
+}
+
+
+// Program info stream versions from VC7 on have a GUID after the age
+#define PDB_INFO_VERSION_VC70 20000404
+
+
+// The named stream table follows the header: the names, then a hash table
+// of (name offset, stream) pairs.  The pairs are stored in bucket order for
+// the buckets marked present, which is all that's needed to scan them.
+uint16_t PdbGetNamedStream(PDB_FILE* pdb, const char* name)
+{
+	PDB_STREAM* stream = PdbStreamOpen(pdb, PDB_STREAM_PROGRAM_INFO);
+	uint32_t header[3]; // version, signature, age
+	uint32_t size = stream ? PdbStreamGetSize(stream) : 0;
+	uint32_t namesSize;
+	uint32_t table[2]; // size, capacity
+	uint32_t words;
+	uint32_t deletedWords;
+	uint32_t* present = NULL;
+	char* names = NULL;
+	uint16_t result = PDB_STREAM_NONE;
+	PDB_CURSOR cursor;
+	uint32_t i;
+
+	if (!stream)
+		return PDB_STREAM_NONE;
+
+	PdbCursorOpen(&cursor, stream, 0);
+
+	if (!PdbCursorRead(&cursor, header, sizeof(header)))
+		goto DONE;
+
+	if ((header[0] >= PDB_INFO_VERSION_VC70) && !PdbCursorSeek(&cursor, sizeof(header) + 16))
+		goto DONE;
+
+	// Every count is checked against the stream before it sizes anything
+	if (!PdbCursorReadU32(&cursor, &namesSize) || (namesSize > size))
+		goto DONE;
+
+	names = (char*)malloc(namesSize + 1);
+	if (!names || !PdbCursorRead(&cursor, names, namesSize))
+		goto DONE;
+	names[namesSize] = 0;
+
+	if (!PdbCursorReadU32(&cursor, &table[0]) || !PdbCursorReadU32(&cursor, &table[1])
+		|| !PdbCursorReadU32(&cursor, &words) || (words > size / 4))
+		goto DONE;
+
+	present = (uint32_t*)malloc(((size_t)words + 1) * 4);
+	if (!present || !PdbCursorRead(&cursor, present, (uint64_t)words * 4))
+		goto DONE;
+
+	// Skip the deleted bucket bit vector
+	if (!PdbCursorReadU32(&cursor, &deletedWords) || !PdbCursorSkip(&cursor, (uint64_t)deletedWords * 4))
+		goto DONE;
+
+	for (i = 0; (i < table[1]) && (i / 32 < words); i++)
+	{
+		uint32_t pair[2]; // name offset, stream
+
+		if (!(present[i / 32] & (1u << (i % 32))))
+			continue;
+
+		if (!PdbCursorReadU32(&cursor, &pair[0]) || !PdbCursorReadU32(&cursor, &pair[1]))
+			break;
+
+		if ((pair[0] < namesSize) && (strcmp(names + pair[0], name) == 0))
+		{
+			result = (uint16_t)pair[1];
+			break;
+		}
+	}
+
+DONE:
+	free(present);
+	free(names);
+	PdbStreamClose(stream);
+
+	return result;
+}
+
+
+static bool PdbStreamLoadRoot(PDB_FILE* pdb, uint32_t rootMapPage, uint32_t size)
 {
 	PDB_STREAM* root = (PDB_STREAM*)malloc(sizeof(PDB_STREAM));
+	uint32_t perMapPage = pdb->pageSize / 4;
+	uint32_t mapPage = rootMapPage;
 	size_t i;
 
 	pdb->root = root;
@@ -136,33 +508,62 @@ static bool PdbStreamOpenRoot(PDB_FILE* pdb, uint16_t rootStreamPageIndex, uint3
 	root->pdb = pdb;
 	root->currentOffset = 0;
 	root->size = size;
+	root->access = PDB_ACCESS_NORMAL;
+	root->readahead = 0;
+	root->buffer = NULL;
+	root->bufferStart = 0;
+	root->bufferLen = 0;
+	root->bufferSize = 0;
 
 	// Calculate the number of pages comprising the root stream
 	root->pageCount = GetPageCount(pdb, size);
 
 	// Allocate storage for the pdb's root page list
-	root->pages = (uint32_t*)malloc(pdb->pageCount * sizeof(uint32_t));
-	memset(root->pages, 0, pdb->pageCount * sizeof(uint32_t));
+	root->pages = (uint32_t*)calloc(root->pageCount + 1, sizeof(uint32_t));
+	if (!root->pages)
+		return false;
 
 	// Follow yet another layer of indirection (don't be fooled by Sven's docs,
 	// the root page index in the header points to the list of indices 
 	// that comprise the root stream)
 
-	// Go to the list of page indices that belong to the root stream
-	if (fseeko(pdb->file, (rootStreamPageIndex * pdb->pageSize), SEEK_SET))
-		return false;
-
 	// Get the root stream pages
 	for (i = 0; i < root->pageCount; i++)
 	{
 		if (pdb->version == 2)
 		{
-			if (fread(&root->pages[i], 1, 2, pdb->file) != 2)
+			// Go to the list of page indices that belong to the root stream
+			if (i == 0)
+				PdbFileSeek(pdb, (uint64_t)rootMapPage << pdb->pageShift);
+
+			if (PdbFileRead(pdb, &root->pages[i], 2) != 2)
 				return false;
 		}
 		else if (pdb->version == 7)
 		{
-			if (fread(&root->pages[i], 1, 4, pdb->file) != 4)
+			// The list spans as many pages as it needs.  Big pdbs have more
+			// than one, and the header lists them one after the other.
+			if ((i % perMapPage) == 0)
+			{
+				if (i)
+				{
+					uint64_t entry = PDB_ROOT_MAP_OFFSET_V7 + ((i / perMapPage) * 4);
+
+					if (entry + 4 > pdb->pageSize)
+						return false;
+
+					PdbFileSeek(pdb, entry);
+					if (PdbFileRead(pdb, &mapPage, 4) != 4)
+						return false;
+				}
+
+				if (mapPage >= pdb->pageCount)
+					return false;
+
+				PdbFileSeek(pdb, (uint64_t)mapPage << pdb->pageShift);
+			}
+
+			if (PdbFileRead(pdb, &root->pages[i], 4) != 4)
 				return false;
 		}
 	}
@@ -182,6 +583,26 @@ static bool PdbStreamOpenRoot(PDB_FILE* pdb, uint16_t rootStreamPageIndex, uint3
 }
 
 
+static bool PdbStreamOpenRoot(PDB_FILE* pdb, uint32_t rootMapPage, uint32_t size)
+{
+	uint64_t start = PdbTimeNow();
+	bool result;
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_BEGIN, "RootDirectory", 0, 0);
+
+	result = PdbStreamLoadRoot(pdb, rootMapPage, size);
+
+	// The root stream is the stream directory, account for it as such
+	PdbStatsAddTime(pdb, PDB_SUBSYSTEM_DIRECTORY, start);
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_END, "RootDirectory", 0, 0);
+
+	return result;
+}
+
+
 static bool PdbSeekToStreamSize(PDB_FILE* pdb, uint16_t streamId)
 {
 	uint32_t streamSizesOffset;
@@ -202,15 +623,15 @@ static bool PdbSeekToStreamPageDirectory(PDB_FILE* pdb, uint16_t streamId, uint3
 	uint32_t directoriesBase; // The beginning of the directories in the root stream
 	uint32_t streamDirectoryOffset; // The offset in the page directories for the stream of interest
 	uint32_t offset; // The final offset to seek to
+	PDB_CURSOR cursor;
 	uint16_t i;
 
 	// Sanity check the stream id
 	if (streamId >= pdb->streamCount)
 		return false;
 
-	// Seek to the beginning of the root stream (after the stream count)
-	if (!PdbStreamSeek(pdb->root, 4))
-		return false;
+	// Start at the beginning of the root stream (after the stream count)
+	PdbCursorOpen(&cursor, pdb->root, 4);
 
 	*streamSize = 0;
 	streamDirectoryOffset = 0;
@@ -220,16 +641,24 @@ static bool PdbSeekToStreamPageDirectory(PDB_FILE* pdb, uint16_t streamId, uint3
 		uint32_t size;
 
 		// Read each stream size
-		if (!PdbStreamRead(pdb->root, (uint8_t*)&size, 4))
+		if (!PdbCursorReadU32(&cursor, &size))
 			return false;
 
+		// Deleted streams have no pages
+		if (size == PDB_NIL_STREAM_SIZE)
+			size = 0;
+
 		// Add the number of bytes needed to store the page
 		// indices for the stream
 		streamDirectoryOffset += (4 * GetPageCount(pdb, size));
 	}
 
 	// Read the size of the stream of interest
-	if (!PdbStreamRead(pdb->root, (uint8_t*)streamSize, 4))
+	if (!PdbCursorReadU32(&cursor, streamSize))
+		return false;
+
+	// Nothing to open if the stream was deleted
+	if (*streamSize == PDB_NIL_STREAM_SIZE)
 		return false;
 
 	// The directories begin after the sizes
@@ -246,85 +675,213 @@ static bool PdbSeekToStreamPageDirectory(PDB_FILE* pdb, uint16_t streamId, uint3
 
 bool PdbStreamSeek(PDB_STREAM* stream, uint64_t offset)
 {
-	if (stream->pageCount)
+	// Avoid div0
+	if (!stream->pageCount || (stream->pdb->pageSize == 0))
+		return false;
+
+	// Sanity check the offset
+	if (offset >= stream->size)
+		return false;
+
+	// Reads fetch whatever pages they need, so nothing else has to move
+	stream->currentOffset = offset;
+
+	return true;
+}
+
+
+static uint32_t PdbStreamGetRunLength(PDB_STREAM* stream, uint32_t page)
+{
+	uint32_t run = 1;
+
+	// Count the pages that are physically adjacent in the file
+	while ((page + run < stream->pageCount)
+		&& (stream->pages[page + run] == stream->pages[page] + run))
+		run++;
+
+	return run;
+}
+
+
+static void PdbStreamAdvise(PDB_STREAM* stream, uint64_t offset, uint64_t bytes, PDB_IO_ADVICE advice)
+{
+	PDB_FILE* pdb = stream->pdb;
+	uint32_t pageSize = pdb->pageSize;
+	uint32_t page;
+	uint64_t end;
+
+	// Compressed containers decompress on demand, there's nothing to hint
+	if (!pdb->io->advise || pdb->msfz || (pageSize == 0) || (offset >= stream->size))
+		return;
+
+	end = offset + bytes;
+	if (end > stream->size)
+		end = stream->size;
+
+	// Walk the physical runs of pages covering [offset, end) and advise each one
+	page = (uint32_t)(offset / pageSize);
+	while (((uint64_t)page * pageSize) < end)
 	{
-		uint64_t page;
-		uint64_t fileOffset;
+		uint32_t run = PdbStreamGetRunLength(stream, page);
+		uint64_t runBytes;
 
-		// Avoid div0
-		if (stream->pdb->pageSize == 0)
-			return false;
+		// Don't advise past the requested range
+		runBytes = (uint64_t)run * pageSize;
+		if (((uint64_t)page * pageSize) + runBytes > end)
+			runBytes = end - ((uint64_t)page * pageSize);
 
-		// Sanity check the offset
-		if (offset >= stream->size)
-			return false;
+		pdb->io->advise(pdb->ioCtxt, (uint64_t)stream->pages[page] * pageSize, runBytes, advice);
 
-		// Calculate the page number within the stream this offset appears at
-		page = offset / stream->pdb->pageSize;
+		page += run;
+	}
+}
 
-		// Use the stream page number to lookup the page index within the file and then 
-		// to calculate the offset of the page within the file
-		// It may not be an even multiple of page size, so add back the remainder
-		fileOffset = (stream->pages[page] * stream->pdb->pageSize)
-			+ (offset % stream->pdb->pageSize);
 
-		// Goto the page containing the requested offset
-		if (fseeko(stream->pdb->file, fileOffset, SEEK_SET))
-			return false;
+static void PdbStreamReadAhead(PDB_STREAM* stream, uint64_t offset)
+{
+	// The reader seeked past the prefetched region, restart from there
+	if (stream->readahead < offset)
+		stream->readahead = offset;
 
-		// Update last accessed
-		stream->pdb->lastAccessed = stream;
+	// Keep the prefetched region a window ahead of the reader.  Wait until the
+	// reader is halfway through the last window so the advice is batched.
+	if (offset + (PDB_READAHEAD_WINDOW / 2) < stream->readahead)
+		return;
 
-		// Update the current offset
-		stream->currentOffset = offset;
+	if (stream->readahead >= stream->size)
+		return;
 
-		return true;
+	PdbStreamAdvise(stream, stream->readahead, PDB_READAHEAD_WINDOW, PDB_IO_WILLNEED);
+	stream->readahead += PDB_READAHEAD_WINDOW;
+}
+
+
+bool PdbStreamSetAccess(PDB_STREAM* stream, PDB_STREAM_ACCESS access)
+{
+	// Clear out the old hint first
+	if (stream->access != PDB_ACCESS_NORMAL)
+		PdbStreamEndAccess(stream);
+
+	stream->access = access;
+
+	switch (access)
+	{
+	case PDB_ACCESS_NORMAL:
+		break;
+	case PDB_ACCESS_SEQUENTIAL:
+	case PDB_ACCESS_ONCE:
+		// Prefetch the first window from wherever the reader is now
+		stream->readahead = stream->currentOffset;
+		PdbStreamReadAhead(stream, stream->currentOffset);
+		break;
+	case PDB_ACCESS_RANDOM:
+		PdbStreamAdvise(stream, 0, stream->size, PDB_IO_RANDOM);
+		break;
+	default:
+		stream->access = PDB_ACCESS_NORMAL;
+		return false;
 	}
 
-	return false;
+	return true;
+}
+
+
+void PdbStreamEndAccess(PDB_STREAM* stream)
+{
+	switch (stream->access)
+	{
+	case PDB_ACCESS_SEQUENTIAL:
+	case PDB_ACCESS_ONCE:
+		// The consumer is done, let the source reclaim what was prefetched
+		PdbStreamAdvise(stream, 0, stream->readahead, PDB_IO_DONTNEED);
+		break;
+	case PDB_ACCESS_RANDOM:
+		PdbStreamAdvise(stream, 0, stream->size, PDB_IO_NORMAL);
+		break;
+	default:
+		break;
+	}
+
+	stream->access = PDB_ACCESS_NORMAL;
+	stream->readahead = 0;
 }
 
 
 PDB_STREAM* PdbStreamOpen(PDB_FILE* pdb, uint16_t streamId)
 {
 	PDB_STREAM* stream;
-	uint32_t i;
+	uint64_t start = PdbTimeNow();
+	bool found;
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_BEGIN, "StreamOpen", streamId, 0);
 
 	stream = (PDB_STREAM*)malloc(sizeof(PDB_STREAM));
 	stream->pdb = pdb;
 	stream->id = streamId;
-
-	// Seek to the stream info and get the page size
-	if (!PdbSeekToStreamPageDirectory(pdb, streamId, &stream->size))
+	stream->access = PDB_ACCESS_NORMAL;
+	stream->readahead = 0;
+	stream->buffer = NULL;
+	stream->bufferStart = 0;
+	stream->bufferLen = 0;
+	stream->bufferSize = 0;
+
+	// Seek to the stream info and get the page size.  Compressed containers
+	// keep their directory in memory.
+	if (pdb->msfz)
+		found = PdbMsfzGetStreamSize(pdb->msfz, streamId, &stream->size);
+	else
+		found = PdbSeekToStreamPageDirectory(pdb, streamId, &stream->size);
+
+	if (!found)
 	{
 		free(stream);
+		PdbStatsAddTime(pdb, PDB_SUBSYSTEM_DIRECTORY, start);
+		if (PDB_TRACING())
+			PdbTraceEmit(PDB_TRACE_END, "StreamOpen", streamId, 0);
 		return NULL;
 	}
 
 	// Calculate the number of pages needed and alloc storage for the page indices
 	stream->pageCount = GetPageCount(pdb, stream->size);
-	stream->pages = (uint32_t*)malloc(sizeof(uint32_t) * stream->pageCount);
+	stream->pages = NULL;
 
-	// Read in the page indices that make up the stream
-	for (i = 0; i < stream->pageCount; i++)
+	if (!pdb->msfz)
 	{
-		if (!PdbStreamRead(pdb->root, (uint8_t*)&stream->pages[i], 4))
-			return false;
+		stream->pages = (uint32_t*)malloc(sizeof(uint32_t) * (stream->pageCount + 1));
+
+		// Read in the page indices that make up the stream
+		if (!PdbStreamRead(pdb->root, (uint8_t*)stream->pages, (uint64_t)stream->pageCount * 4))
+			found = false;
 	}
 
 	// Seek to the first page of the stream
-	if (!PdbStreamSeek(stream, 0))
+	if (!found || !PdbStreamSeek(stream, 0))
 	{
+		free(stream->pages);
 		free(stream);
+		PdbStatsAddTime(pdb, PDB_SUBSYSTEM_DIRECTORY, start);
+		if (PDB_TRACING())
+			PdbTraceEmit(PDB_TRACE_END, "StreamOpen", streamId, 0);
 		return NULL;
 	}
 
+	PdbStatsAddTime(pdb, PDB_SUBSYSTEM_DIRECTORY, start);
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_END, "StreamOpen", streamId, 0);
+
 	return stream;
 }
 
 
 void PdbStreamClose(PDB_STREAM* stream)
 {
+	// Drop any outstanding hints
+	if (stream->access != PDB_ACCESS_NORMAL)
+		PdbStreamEndAccess(stream);
+
+	free(stream->buffer);
 	free(stream->pages);
 	free(stream);
 }
@@ -335,9 +892,10 @@ static bool PdbParseHeader(PDB_FILE* pdb)
 	char buff[sizeof(PDB_SIGNATURE_V2) + 1];
 
 	// First try to read the longer (older) signature
-	if (fread(buff, 1, sizeof(PDB_SIGNATURE_V2), pdb->file) == sizeof(PDB_SIGNATURE_V2))
+	if (PdbFileRead(pdb, buff, sizeof(PDB_SIGNATURE_V2)) == sizeof(PDB_SIGNATURE_V2))
 	{
-		uint16_t rootStreamId;
+		uint32_t rootMapPage = 0;
+		uint32_t pageSize;
 		uint32_t rootSize;
 
 		// See if we have a match
@@ -346,34 +904,34 @@ static bool PdbParseHeader(PDB_FILE* pdb)
 			pdb->version = 2;
 
 			// Expecting [unknown byte]JG\0
-			if (fread(buff, 1, 4, pdb->file) != 4)
+			if (PdbFileRead(pdb, buff, 4) != 4)
 				return false;
 
 			// Read the size of the pages in bytes (Hopefully 0x400,0x800, or 0x1000)
-			if (fread(&pdb->pageSize, 1, 4, pdb->file) != 4)
+			if ((PdbFileRead(pdb, &pageSize, 4) != 4) || !PdbSetPageSize(pdb, pageSize))
 				return false;
 
 			// Sven calls this "Start page", not sure what it's for
-			if (fread(buff, 1, 2, pdb->file) != 2)
+			if (PdbFileRead(pdb, buff, 2) != 2)
 				return false;
 
 			// Get the number of pages in the file
-			if (fread(&pdb->pageCount, 1, 2, pdb->file) != 2)
+			if (PdbFileRead(pdb, &pdb->pageCount, 2) != 2)
 				return false;
 
 			// Get the number of bytes in the root stream
-			if (!fread(&rootSize, 1, 4, pdb->file) != 4)
+			if (!PdbFileRead(pdb, &rootSize, 4) != 4)
 				return false;
 
 			// Read the total number of streams in the file
-			if (!fread(&pdb->streamCount, 1, 4, pdb->file) != 4)
+			if (!PdbFileRead(pdb, &pdb->streamCount, 4) != 4)
 				return false;
 
 			// Get the page of the root stream directory
-			if (fread(&rootStreamId, 1, 2, pdb->file) != 2)
+			if (PdbFileRead(pdb, &rootMapPage, 2) != 2)
 				return false;
 
-			if (!PdbStreamOpenRoot(pdb, rootStreamId, rootSize))
+			if (!PdbStreamOpenRoot(pdb, rootMapPage, rootSize))
 				return false;
 		
 			return true;
@@ -386,23 +944,23 @@ static bool PdbParseHeader(PDB_FILE* pdb)
 
 			// We went past the end of the signature because the V2 sig is
 			// larger than the V7 sig.
-			if (fseeko(pdb->file, sizeof(PDB_SIGNATURE_V7) - 1, SEEK_SET))
-				return false;
+			PdbFileSeek(pdb, sizeof(PDB_SIGNATURE_V7) - 1);
 
 			// Expecting reserved bytes, something like [unknown byte]DS\0\0\0
-			if (fread(buff, 1, 6, pdb->file) != 6)
+			if (PdbFileRead(pdb, buff, 6) != 6)
 				return false;
 
-			// Read the size of the pages in bytes (Probably 0x400)
-			if (fread(&pdb->pageSize, 1, 4, pdb->file) != 4)
+			// Read the size of the pages in bytes (0x1000 for most, up to
+			// 0x10000 for the largest)
+			if ((PdbFileRead(pdb, &pageSize, 4) != 4) || !PdbSetPageSize(pdb, pageSize))
 				return false;
 	
 			// Get the flag page (an allocation table, 1 if the page is unused)
-			if (fread(&pdb->flagPage, 1, 4, pdb->file) != 4)
+			if (PdbFileRead(pdb, &pdb->flagPage, 4) != 4)
 				return false;
 
 			// Get number of pages in the file
-			if ((fread(&pdb->pageCount, 1, 4, pdb->file) != 4))
+			if ((PdbFileRead(pdb, &pdb->pageCount, 4) != 4))
 				return false;
 
 			// Ensure that this matches the actual file size
@@ -410,27 +968,33 @@ static bool PdbParseHeader(PDB_FILE* pdb)
 				return false;
 
 			// Get the root stream size (in bytes)
-			if (fread(&rootSize, 1, 4, pdb->file) != 4)
+			if (PdbFileRead(pdb, &rootSize, 4) != 4)
 				return false;
 
 			// Pass reserved dword
-			if (fread(buff, 1, 4, pdb->file) != 4)
+			if (PdbFileRead(pdb, buff, 4) != 4)
 				return false;
 
-			// Read the page index that contains the root stream
-			if (fread(&rootStreamId, 1, 2, pdb->file) != 2)
-				return false;
-
-			// Move past reserved data
-			if (fread(buff, 1, 2, pdb->file) != 2)
+			// Read the first page of the root stream's page list.  This is a
+			// full dword, pdbs past 256MB have it above 0xffff.
+			if (PdbFileRead(pdb, &rootMapPage, 4) != 4)
 				return false;
 
 			// Open the root stream (the pdb now owns rootPages storage)
-			if (!PdbStreamOpenRoot(pdb, rootStreamId, rootSize))
+			if (!PdbStreamOpenRoot(pdb, rootMapPage, rootSize))
 				return false;
 
 			return true;
 		}
+
+		// Compressed containers have no pages, only stream fragments
+		pdb->msfz = PdbMsfzOpen(pdb, pdb->fileSize);
+		if (pdb->msfz)
+		{
+			PdbSetPageSize(pdb, PDB_MSFZ_PAGE_SIZE);
+			pdb->streamCount = PdbMsfzGetStreamCount(pdb->msfz);
+			return true;
+		}
 	}
 
 	return false;
@@ -442,49 +1006,117 @@ PDB_FILE* PdbOpen(const char* name)
 	// TODO:  Ensure the file is not writable by other processes while
 	// we have it open to avoid potential memory corruption due to having some
 	// parts of the file cached and others not (and no refresh mechanism)
-	FILE* file = fopen(name, "rb");
+	const PDB_IO_OPS* io;
 	PDB_FILE* pdb;
+	void* ctxt;
 
-	if (!file)
-	{
-		fprintf(stderr, "Failed to open pdb file.  OS reports: %s\n", strerror(errno));
+	io = PdbIoOpenFile(name, &ctxt);
+	if (!io)
 		return NULL;
-	}
-	
+
+	pdb = PdbOpenWithIo(io, ctxt);
+	if (!pdb)
+		io->close(ctxt);
+
+	return pdb;
+}
+
+
+PDB_FILE* PdbOpenWithIo(const PDB_IO_OPS* io, void* ctxt)
+{
+	PDB_FILE* pdb;
+	uint64_t start = PdbTimeNow();
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_BEGIN, "PdbOpen", 0, 0);
+
 	pdb = (PDB_FILE*)malloc(sizeof(PDB_FILE));
 
 	// Initialize
-	pdb->name = strdup(name);
-	pdb->file = file;
+	pdb->io = io;
+	pdb->ioCtxt = ctxt;
+	pdb->fileSize = io->getSize(ctxt);
+	pdb->lastReadEnd = 0;
+	pdb->position = 0;
+	pdb->buffer = NULL;
+	pdb->bufferStart = 0;
+	pdb->bufferLen = 0;
 	pdb->version = 0;
 	pdb->streamCount = 0;
 	pdb->pageSize = 0;
+	pdb->pageShift = 0;
 	pdb->pageCount = 0;
-	pdb->lastAccessed = NULL;
 	pdb->root = NULL;
+	pdb->msfz = NULL;
+	memset(&pdb->stats, 0, sizeof(pdb->stats));
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_BEGIN, "ParseHeader", 0, 0);
 
 	// Read the header and open the root stream
 	if (!PdbParseHeader(pdb))
 	{
-		free(pdb->name);
-		fclose(pdb->file);
+		if (pdb->root)
+			PdbStreamClose(pdb->root);
+		if (pdb->msfz)
+			PdbMsfzClose(pdb->msfz);
+		free(pdb->buffer);
 		free(pdb);
 
+		if (PDB_TRACING())
+		{
+			PdbTraceEmit(PDB_TRACE_END, "ParseHeader", 0, 0);
+			PdbTraceEmit(PDB_TRACE_END, "PdbOpen", 0, 0);
+		}
+
 		return NULL;
 	}
 
+	// Header parsing is done with the buffer, streams have their own
+	free(pdb->buffer);
+	pdb->buffer = NULL;
+	pdb->bufferLen = 0;
+
+	PdbStatsAddTime(pdb, PDB_SUBSYSTEM_OPEN, start);
+
+	if (PDB_TRACING())
+	{
+		PdbTraceEmit(PDB_TRACE_END, "ParseHeader", 0, 0);
+		PdbTraceEmit(PDB_TRACE_END, "PdbOpen", 0, 0);
+	}
+
 	return pdb;
 }
 
 
 void PdbClose(PDB_FILE* pdb)
 {
-	fclose(pdb->file);
-	free(pdb->name);
+	if (pdb->root)
+		PdbStreamClose(pdb->root);
+
+	if (pdb->msfz)
+		PdbMsfzClose(pdb->msfz);
+
+	if (pdb->io->close)
+		pdb->io->close(pdb->ioCtxt);
+
+	free(pdb->buffer);
 	free(pdb);
 }
 
 
+void PdbGetStats(PDB_FILE* pdb, PDB_STATS* stats)
+{
+	memcpy(stats, &pdb->stats, sizeof(PDB_STATS));
+}
+
+
+void PdbResetStats(PDB_FILE* pdb)
+{
+	memset(&pdb->stats, 0, sizeof(PDB_STATS));
+}
+
+
 PDB_FILE* PdbStreamGetPdb(PDB_STREAM* stream)
 {
 	return stream->pdb;
@@ -497,64 +1129,505 @@ uint32_t PdbStreamGetSize(PDB_STREAM* stream)
 }
 
 
-bool PdbStreamRead(PDB_STREAM* stream, uint8_t* buff, uint64_t bytes)
+// Read a range of the stream with one source read for each physically
+// contiguous run of pages
+static bool PdbStreamReadRuns(PDB_STREAM* stream, uint64_t offset, uint8_t* buff, uint64_t bytes, bool counted)
+{
+	PDB_FILE* pdb = stream->pdb;
+	uint32_t page = (uint32_t)(offset >> pdb->pageShift);
+	uint32_t within = (uint32_t)(offset & (pdb->pageSize - 1));
+
+	if (pdb->msfz)
+	{
+		if (counted)
+		{
+			pdb->stats.reads++;
+			pdb->stats.bytesRead += bytes;
+		}
+
+		return PdbMsfzRead(pdb->msfz, stream->id, offset, buff, bytes);
+	}
+
+	while (bytes)
+	{
+		uint32_t run = PdbStreamGetRunLength(stream, page);
+		uint64_t runBytes = ((uint64_t)run << pdb->pageShift) - within;
+		uint64_t fileOffset = ((uint64_t)stream->pages[page] << pdb->pageShift) + within;
+
+		if (runBytes > bytes)
+			runBytes = bytes;
+
+		if (counted)
+		{
+			if (!PdbFileFetch(pdb, buff, (size_t)runBytes, fileOffset))
+				return false;
+		}
+		else if (!PdbFileReadAt(pdb, buff, (size_t)runBytes, fileOffset))
+		{
+			return false;
+		}
+
+		buff += runBytes;
+		bytes -= runBytes;
+		page += run;
+		within = 0;
+	}
+
+	return true;
+}
+
+
+// Fetch the pages covering [offset, offset + bytes) into the stream's
+// buffer.  Sequential readers get up to a buffer's worth so small records
+// don't each cost a fetch.  False if they won't fit.
+static bool PdbStreamFill(PDB_STREAM* stream, uint64_t offset, uint64_t bytes)
+{
+	uint32_t pageSize = stream->pdb->pageSize;
+	uint64_t start = offset & ~((uint64_t)pageSize - 1);
+	uint64_t end = offset + bytes;
+
+	if (!stream->buffer)
+	{
+		uint64_t size = (uint64_t)stream->pageCount * pageSize;
+		uint64_t limit = (PDB_STREAM_BUFFER_SIZE > 2 * pageSize) ? PDB_STREAM_BUFFER_SIZE : (2 * (uint64_t)pageSize);
+
+		stream->bufferSize = (uint32_t)((size < limit) ? size : limit);
+		stream->buffer = (uint8_t*)malloc(stream->bufferSize);
+		if (!stream->buffer)
+			return false;
+	}
+
+	// Whole pages, but not past the end of the stream
+	end = (end + pageSize - 1) & ~((uint64_t)pageSize - 1);
+	if ((stream->access == PDB_ACCESS_SEQUENTIAL) || (stream->access == PDB_ACCESS_ONCE))
+	{
+		if (end < start + stream->bufferSize)
+			end = start + stream->bufferSize;
+	}
+
+	if (end > stream->size)
+		end = stream->size;
+
+	if (end - start > stream->bufferSize)
+		return false;
+
+	stream->bufferLen = 0;
+	if (!PdbStreamReadRuns(stream, start, stream->buffer, end - start, true))
+		return false;
+
+	stream->bufferStart = start;
+	stream->bufferLen = (uint32_t)(end - start);
+
+	return true;
+}
+
+
+static bool PdbStreamReadPages(PDB_STREAM* stream, uint8_t* buff, uint64_t bytes)
 {
-	uint8_t* pbuff = buff;
-	uint64_t bytesRemaining = bytes;
-	size_t bytesLeftOnPage;
-	size_t bytesToRead = (size_t)-1;
-	uint32_t pageMask;
+	PDB_FILE* pdb = stream->pdb;
+	uint64_t offset = stream->currentOffset;
 
 	// Ensure that the requested bytes don't run off the end of the stream
-	if (stream->currentOffset + bytes > stream->size)
+	if ((offset + bytes > stream->size) || (pdb->pageSize == 0))
 		return false;
 
-	// Assume that if this is the last accessed stream, that
-	// we are already at the current offset.  Otherwise make it so.
-	if (stream->pdb->lastAccessed != stream)
+	if (!bytes)
+		return true;
+
+	pdb->stats.pageCrossings += ((offset + bytes - 1) >> pdb->pageShift) - (offset >> pdb->pageShift);
+
+	// Keep the prefetch window ahead of sequential readers
+	if ((stream->access == PDB_ACCESS_SEQUENTIAL) || (stream->access == PDB_ACCESS_ONCE))
+		PdbStreamReadAhead(stream, offset);
+
+	// See if the last fetch already brought in these pages
+	if ((offset >= stream->bufferStart) && (offset + bytes <= stream->bufferStart + stream->bufferLen))
+	{
+		pdb->stats.cacheHits++;
+	}
+	else
+	{
+		pdb->stats.cacheMisses++;
+
+		if (!PdbStreamFill(stream, offset, bytes))
+		{
+			// Too big to buffer, read straight into the caller's buffer
+			if (!PdbStreamReadRuns(stream, offset, buff, bytes, true))
+				return false;
+
+			stream->currentOffset += bytes;
+			return true;
+		}
+	}
+
+	memcpy(buff, stream->buffer + (offset - stream->bufferStart), (size_t)bytes);
+	stream->currentOffset += bytes;
+
+	return true;
+}
+
+
+bool PdbStreamRead(PDB_STREAM* stream, uint8_t* buff, uint64_t bytes)
+{
+	uint64_t start;
+	bool result;
+
+	if (!PDB_TRACING())
+		return PdbStreamReadPages(stream, buff, bytes);
+
+	// Each read is reported as one I/O batch, however many pages it spans
+	start = PdbTimeNow();
+	result = PdbStreamReadPages(stream, buff, bytes);
+	PdbTraceEmit(PDB_TRACE_IO, "StreamRead", bytes, start);
+
+	return result;
+}
+
+
+// How a run of pages gets from the pdb to the output
+typedef enum PDB_COPY_METHOD
+{
+	PDB_COPY_RANGE = 0, // copy_file_range, file to file inside the kernel
+	PDB_COPY_SENDFILE = 1, // sendfile, works for pipes and sockets too
+	PDB_COPY_BUFFERED = 2 // Positioned reads into a buffer, then write
+} PDB_COPY_METHOD;
+
+
+typedef struct PDB_COPY
+{
+	PDB_FILE* pdb;
+	FILE* out;
+	PDB_COPY_METHOD method;
+	uint8_t* buff;
+	size_t buffSize;
+} PDB_COPY;
+
+
+static bool PdbCopyWrite(PDB_COPY* copy, const uint8_t* buff, size_t bytes)
+{
+#ifdef WIN32
+	return (fwrite(buff, 1, bytes, copy->out) == bytes);
+#else
+	// The zero copy paths write to the descriptor, stay on it so the
+	// output offset is consistent
+	while (bytes)
 	{
-		// Some other stream was read last, seek to this stream
-		if (!PdbStreamSeek(stream, stream->currentOffset))
+		ssize_t written = write(fileno(copy->out), buff, bytes);
+
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
 			return false;
+		}
 
-		stream->pdb->lastAccessed = stream;
+		buff += written;
+		bytes -= (size_t)written;
 	}
 
-	// Calculate how many bytes are left on the current page, starting from the current offset
-	bytesLeftOnPage = (stream->pdb->pageSize - (stream->currentOffset % stream->pdb->pageSize));
+	return true;
+#endif /* WIN32 */
+}
 
-	pageMask = stream->pdb->pageSize - 1;
 
-	// Now read the remaining pages
-	while (bytesRemaining)
+static bool PdbCopyBuffered(PDB_COPY* copy, uint64_t offset, uint64_t bytes)
+{
+	while (bytes)
 	{
-		uint64_t newOffset;
+		size_t chunk = (bytes < copy->buffSize) ? (size_t)bytes : copy->buffSize;
 
-		// We can only read a page at a time
-		// The first page may be shorter if the current offset is not at the beginning of the page
-		bytesToRead = ((size_t)bytesRemaining < bytesLeftOnPage)
-			? (size_t)bytesRemaining : bytesLeftOnPage;
+		if (!PdbFileReadAt(copy->pdb, copy->buff, chunk, offset))
+			return false;
 
-		if (fread(pbuff, 1, bytesToRead, stream->pdb->file) != bytesToRead)
+		if (!PdbCopyWrite(copy, copy->buff, chunk))
 			return false;
 
-		pbuff += bytesToRead;
-		bytesRemaining -= bytesToRead;
+		offset += chunk;
+		bytes -= chunk;
+	}
+
+	return true;
+}
+
 
-		// Seek to the next requested position
-		newOffset = stream->currentOffset + bytesToRead;
-		if (((stream->currentOffset & pageMask) + bytesToRead) >= stream->pdb->pageSize)
+static bool PdbCopyRun(PDB_COPY* copy, uint64_t offset, uint64_t bytes)
+{
+#ifdef __linux__
+	FILE* file = PdbIoGetFile(copy->pdb->io, copy->pdb->ioCtxt);
+	int in = file ? fileno(file) : -1;
+	int out = fileno(copy->out);
+
+	// Only a file source can be copied inside the kernel
+	if (!file)
+		copy->method = PDB_COPY_BUFFERED;
+
+	while (bytes && (copy->method != PDB_COPY_BUFFERED))
+	{
+		off_t inOffset = (off_t)offset;
+		ssize_t copied;
+
+		if (copy->method == PDB_COPY_RANGE)
+			copied = copy_file_range(in, &inOffset, out, NULL, (size_t)bytes, 0);
+		else
+			copied = sendfile(out, in, &inOffset, (size_t)bytes);
+
+		if (copied < 0)
 		{
-			// We only need to seek if we are crossing a page boundary
-			if (!PdbStreamSeek(stream, newOffset))
-				return false;
+			if (errno == EINTR)
+				continue;
+
+			// Nothing has been written by a call that failed, so drop down to the
+			// next method for the rest of the stream.  Cross filesystem copies,
+			// old kernels, and non file outputs all end up here.
+			if ((errno == EXDEV) || (errno == EINVAL) || (errno == ENOSYS)
+				|| (errno == EOPNOTSUPP) || (errno == EBADF))
+			{
+				copy->method++;
+				continue;
+			}
+
+			return false;
 		}
-		stream->currentOffset = newOffset;
 
-		// Subsequent reads begin at the page offset 0, so they
-		// will read an entire page
-		bytesLeftOnPage = stream->pdb->pageSize;
+		// Hit the end of the pdb, the directory points past it
+		if (copied == 0)
+			return false;
+
+		offset += (uint64_t)copied;
+		bytes -= (uint64_t)copied;
+	}
+#else
+	copy->method = PDB_COPY_BUFFERED;
+#endif /* __linux__ */
+
+	if (!bytes)
+		return true;
+
+	if (!copy->buff)
+	{
+		copy->buff = (uint8_t*)malloc(copy->buffSize);
+		if (!copy->buff)
+			return false;
+	}
+
+	return PdbCopyBuffered(copy, offset, bytes);
+}
+
+
+// Compressed streams go through a buffer
+static bool PdbCopyDecompressed(PDB_COPY* copy, PDB_STREAM* stream)
+{
+	uint64_t offset = 0;
+
+	if (!stream->size)
+		return true;
+
+	copy->buff = (uint8_t*)malloc(copy->buffSize);
+	if (!copy->buff)
+		return false;
+
+	while (offset < stream->size)
+	{
+		size_t chunk = ((stream->size - offset) < copy->buffSize) ? (size_t)(stream->size - offset) : copy->buffSize;
+
+		if (!PdbMsfzRead(copy->pdb->msfz, stream->id, offset, copy->buff, chunk))
+			return false;
+
+		if (!PdbCopyWrite(copy, copy->buff, chunk))
+			return false;
+
+		offset += chunk;
+	}
+
+	return true;
+}
+
+
+bool PdbStreamCopy(PDB_STREAM* stream, FILE* out)
+{
+	PDB_FILE* pdb = stream->pdb;
+	PDB_COPY copy;
+	uint64_t remaining = stream->size;
+	uint32_t page = 0;
+	bool result = true;
+
+	// Anything the caller already wrote has to land before the stream data
+	if (fflush(out))
+		return false;
+
+	copy.pdb = pdb;
+	copy.out = out;
+	copy.method = PDB_COPY_RANGE;
+	copy.buff = NULL;
+	copy.buffSize = (stream->size < PDB_COPY_BUFFER_SIZE) ? stream->size : PDB_COPY_BUFFER_SIZE;
+
+	if (pdb->msfz)
+	{
+		result = PdbCopyDecompressed(&copy, stream);
+		remaining = 0;
+	}
+
+	// Copy each physically contiguous run of pages in one go
+	while (remaining && result)
+	{
+		uint32_t run = PdbStreamGetRunLength(stream, page);
+		uint64_t runBytes = (uint64_t)run * pdb->pageSize;
+
+		// The last page is only partially used
+		if (runBytes > remaining)
+			runBytes = remaining;
+
+		result = PdbCopyRun(&copy, (uint64_t)stream->pages[page] * pdb->pageSize, runBytes);
+
+		page += run;
+		remaining -= runBytes;
+	}
+
+	free(copy.buff);
+
+	return result;
+}
+
+
+bool PdbStreamReadAt(PDB_STREAM* stream, uint64_t offset, uint8_t* buff, uint64_t bytes)
+{
+	if ((offset > stream->size) || (bytes > stream->size - offset))
+		return false;
+
+	return PdbStreamReadRuns(stream, offset, buff, bytes, false);
+}
+
+
+void PdbCursorOpen(PDB_CURSOR* cursor, PDB_STREAM* stream, uint64_t offset)
+{
+	cursor->stream = stream;
+	cursor->data = NULL;
+	cursor->base = offset;
+	cursor->pos = 0;
+	cursor->len = 0;
+	cursor->size = stream->size;
+}
+
+
+void PdbCursorClose(PDB_CURSOR* cursor)
+{
+	cursor->stream->currentOffset = PdbCursorTell(cursor);
+}
+
+
+bool PdbCursorFill(PDB_CURSOR* cursor, uint32_t bytes)
+{
+	PDB_STREAM* stream = cursor->stream;
+	PDB_FILE* pdb = stream->pdb;
+	uint64_t offset = PdbCursorTell(cursor);
+
+	if (offset + bytes > stream->size)
+		return false;
+
+	if ((stream->access == PDB_ACCESS_SEQUENTIAL) || (stream->access == PDB_ACCESS_ONCE))
+		PdbStreamReadAhead(stream, offset);
+
+	// A read on the stream may have left the pages in its buffer already
+	if ((offset >= stream->bufferStart) && (offset + bytes <= stream->bufferStart + stream->bufferLen))
+	{
+		pdb->stats.cacheHits++;
+	}
+	else
+	{
+		pdb->stats.cacheMisses++;
+
+		if (!PdbStreamFill(stream, offset, bytes))
+			return false;
+	}
+
+	cursor->data = stream->buffer;
+	cursor->base = stream->bufferStart;
+	cursor->pos = (uint32_t)(offset - stream->bufferStart);
+	cursor->len = stream->bufferLen;
+
+	return true;
+}
+
+
+bool PdbCursorReadSlow(PDB_CURSOR* cursor, void* buff, uint64_t bytes)
+{
+	uint8_t* out = (uint8_t*)buff;
+	uint64_t offset = PdbCursorTell(cursor);
+	uint32_t avail = cursor->len - cursor->pos;
+
+	if ((offset > cursor->size) || (bytes > cursor->size - offset))
+		return false;
+
+	if (!bytes)
+		return true;
+
+	// Take what's left in the window first
+	if (avail)
+	{
+		memcpy(out, cursor->data + cursor->pos, avail);
+		cursor->pos += avail;
+		out += avail;
+		bytes -= avail;
+		offset += avail;
+	}
+
+	if (PdbCursorFill(cursor, (uint32_t)bytes))
+	{
+		memcpy(out, cursor->data + cursor->pos, (size_t)bytes);
+		cursor->pos += (uint32_t)bytes;
+		return true;
 	}
 
+	// Too big for the window, read it straight into the caller's buffer
+	if (!PdbStreamReadRuns(cursor->stream, offset, out, bytes, true))
+		return false;
+
+	cursor->base = offset + bytes;
+	cursor->pos = 0;
+	cursor->len = 0;
+
 	return true;
 }
+
+
+bool PdbCursorReadCStringSlow(PDB_CURSOR* cursor, char* buff, size_t size)
+{
+	size_t copied = 0;
+
+	while (true)
+	{
+		const uint8_t* start;
+		const uint8_t* end;
+		size_t len;
+
+		if ((cursor->pos == cursor->len) && !PdbCursorFill(cursor, 1))
+		{
+			if (size)
+				buff[copied] = 0;
+			return false;
+		}
+
+		start = cursor->data + cursor->pos;
+		end = (const uint8_t*)memchr(start, 0, cursor->len - cursor->pos);
+		len = end ? (size_t)(end - start) : (cursor->len - cursor->pos);
+
+		// Keep what fits, the rest is only skipped
+		if (size && (copied < size - 1))
+		{
+			size_t keep = ((size - 1 - copied) < len) ? (size - 1 - copied) : len;
+
+			memcpy(buff + copied, start, keep);
+			copied += keep;
+		}
+
+		cursor->pos += (uint32_t)len;
+
+		if (end)
+		{
+			cursor->pos++;
+			if (size)
+				buff[copied] = 0;
+			return true;
+		}
+	}
+}
@@ -62,13 +62,105 @@ http://ccimetadata.codeplex.com/ Microsoft Common Compiler Infrastructure Metada
 typedef struct PDB_FILE PDB_FILE;
 typedef struct PDB_STREAM PDB_STREAM;
 typedef enum PDB_STREAMS PDB_STREAMS;
+typedef enum PDB_STREAM_ACCESS PDB_STREAM_ACCESS;
+typedef enum PDB_SUBSYSTEM PDB_SUBSYSTEM;
+typedef struct PDB_STATS PDB_STATS;
+typedef enum PDB_TRACE_EVENT PDB_TRACE_EVENT;
+typedef struct PDB_TRACE_RECORD PDB_TRACE_RECORD;
+typedef enum PDB_IO_ADVICE PDB_IO_ADVICE;
+typedef struct PDB_IO_OPS PDB_IO_OPS;
 
 enum PDB_STREAMS
 {
 	PDB_STREAM_ROOT = 0,
 	PDB_STREAM_PROGRAM_INFO = 1,
 	PDB_STREAM_TYPE_INFO = 2,
-	PDB_STREAM_DEBUG_INFO = 3
+	PDB_STREAM_DEBUG_INFO = 3,
+	PDB_STREAM_ID_INFO = 4 // Same layout as the type stream
+};
+
+// No stream
+#define PDB_STREAM_NONE 0xffff
+
+// Access pattern hints for a stream.  A stream's pages are scattered through
+// the file, so the OS can't infer a sequential read on its own.  The hint is
+// applied to each physical run of pages that makes up the stream.
+enum PDB_STREAM_ACCESS
+{
+	PDB_ACCESS_NORMAL = 0, // No hint (the default)
+	PDB_ACCESS_SEQUENTIAL = 1, // Read front to back, prefetch ahead of the reader
+	PDB_ACCESS_RANDOM = 2, // Scattered reads, don't bother reading ahead
+	PDB_ACCESS_ONCE = 3 // Sequential, and the data won't be needed again
+};
+
+// The parts of the library that time spent is accounted against
+enum PDB_SUBSYSTEM
+{
+	PDB_SUBSYSTEM_OPEN = 0, // PdbOpen, header parsing (includes the root directory)
+	PDB_SUBSYSTEM_DIRECTORY = 1, // Root stream and stream page directory lookups
+	PDB_SUBSYSTEM_TPI = 2, // Type and id stream parsing
+	PDB_SUBSYSTEM_DBI = 3, // Debug info stream parsing
+	PDB_SUBSYSTEM_COUNT
+};
+
+// Counters kept per PDB_FILE.  They are cheap enough to always be on.
+// Times are in nanoseconds and inclusive, so nested subsystems overlap.
+struct PDB_STATS
+{
+	uint64_t reads; // Range reads made on the source
+	uint64_t seeks; // Range reads that didn't start where the last one ended
+	uint64_t bytesRead; // Bytes returned by those reads
+	uint64_t pageCrossings; // Stream reads that continued onto another page
+	uint64_t cacheHits; // Stream reads served from the stream's buffer
+	uint64_t cacheMisses; // Stream reads that had to fetch pages from the source
+	uint64_t time[PDB_SUBSYSTEM_COUNT];
+};
+
+enum PDB_TRACE_EVENT
+{
+	PDB_TRACE_BEGIN = 0, // A library phase started
+	PDB_TRACE_END = 1, // The matching phase finished
+	PDB_TRACE_IO = 2 // A complete stream read, with its duration
+};
+
+// Passed to the trace hook.  Timestamps come from the same monotonic
+// clock as the stats, in nanoseconds.
+struct PDB_TRACE_RECORD
+{
+	PDB_TRACE_EVENT event;
+	const char* name; // Phase name, a static string
+	uint64_t timestamp; // When the event happened (start time for I/O)
+	uint64_t duration; // I/O events only
+	uint64_t arg; // Stream id for stream phases, byte count for I/O
+	uint32_t thread; // Id of the thread the event happened on
+};
+
+typedef void (*PdbTraceFunction)(void* ctxt, const PDB_TRACE_RECORD* record);
+
+// Hints passed on to a source about how a range of it will be read
+enum PDB_IO_ADVICE
+{
+	PDB_IO_NORMAL = 0, // Drop earlier hints for the range
+	PDB_IO_WILLNEED = 1, // About to be read, worth fetching ahead
+	PDB_IO_DONTNEED = 2, // Done with, cached copies can go
+	PDB_IO_RANDOM = 3 // Scattered reads, don't fetch ahead
+};
+
+// Where a pdb's bytes come from.  The library asks only for the pages it
+// touches, as byte ranges, with pages that are adjacent in the file
+// coalesced into one read.  read may be called from several threads at once
+// through PdbStreamReadAt and PdbStreamCopy.
+struct PDB_IO_OPS
+{
+	// Fill buff with the bytes at offset.  Fail rather than return less.
+	bool (*read)(void* ctxt, uint64_t offset, void* buff, size_t bytes);
+	uint64_t (*getSize)(void* ctxt);
+
+	// Optional, NULL to ignore hints
+	void (*advise)(void* ctxt, uint64_t offset, uint64_t bytes, PDB_IO_ADVICE advice);
+
+	// Optional, called by PdbClose
+	void (*close)(void* ctxt);
 };
 
 
@@ -78,9 +170,36 @@ extern "C"
 #endif /* __cplusplus */
 
 	PDBAPI PDB_FILE* PdbOpen(const char* name);
+
+	// Open a pdb read from any source.  The pdb owns ctxt once it is open and
+	// closes it with the ops' close.  If opening fails ctxt is left to the
+	// caller.
+	PDBAPI PDB_FILE* PdbOpenWithIo(const PDB_IO_OPS* io, void* ctxt);
+
+	// Built in sources for PdbOpenWithIo, NULL if they can't be created.  A
+	// memory source reads data in place, so it has to outlive the pdb.
+	PDBAPI const PDB_IO_OPS* PdbIoOpenFile(const char* name, void** ctxt);
+	PDBAPI const PDB_IO_OPS* PdbIoOpenMemory(const void* data, size_t size, void** ctxt);
+
 	PDBAPI void PdbClose(PDB_FILE* pdb);
 	PDBAPI uint16_t PdbGetStreamCount(PDB_FILE* pdb);
 
+	// The GUID and age from the program info stream, which identify the build
+	// the pdb belongs to.  Old pdbs without a GUID get their 32 bit signature
+	// in its first four bytes.
+	PDBAPI bool PdbGetSignature(PDB_FILE* pdb, uint8_t guid[16], uint32_t* age);
+
+	// Look up a stream by name ("/names", "/LinkInfo", ...) in the program
+	// info stream's table.  PDB_STREAM_NONE if there is no such stream.
+	PDBAPI uint16_t PdbGetNamedStream(PDB_FILE* pdb, const char* name);
+
+	PDBAPI void PdbGetStats(PDB_FILE* pdb, PDB_STATS* stats);
+	PDBAPI void PdbResetStats(PDB_FILE* pdb);
+
+	// Process wide, pass NULL to disable.  Set before opening anything, the
+	// hook is called on whatever thread is using the library.
+	PDBAPI void PdbSetTraceHook(PdbTraceFunction traceFn, void* ctxt);
+
 	PDBAPI PDB_STREAM* PdbStreamOpen(PDB_FILE* pdb, uint16_t streamId);
 	PDBAPI void PdbStreamClose(PDB_STREAM* stream);
 
@@ -89,6 +208,22 @@ extern "C"
 	PDBAPI bool PdbStreamRead(PDB_STREAM* stream, uint8_t* buff, uint64_t bytes);
 	PDBAPI bool PdbStreamSeek(PDB_STREAM* stream, uint64_t offset);
 
+	// Write the whole stream to out, using the kernel's file to file copy where
+	// it can.  Doesn't use or move the stream's read position, so different
+	// streams of one pdb can be copied from several threads at once.  The
+	// copy isn't counted in the pdb's stats.
+	PDBAPI bool PdbStreamCopy(PDB_STREAM* stream, FILE* out);
+
+	// Read bytes at offset in the stream with positioned reads.  Like
+	// PdbStreamCopy it doesn't use or move the read position, so workers can
+	// each read their own streams of one pdb at once.  The streams have to
+	// be opened beforehand, opening isn't thread safe.  Not counted in the
+	// pdb's stats.
+	PDBAPI bool PdbStreamReadAt(PDB_STREAM* stream, uint64_t offset, uint8_t* buff, uint64_t bytes);
+
+	PDBAPI bool PdbStreamSetAccess(PDB_STREAM* stream, PDB_STREAM_ACCESS access);
+	PDBAPI void PdbStreamEndAccess(PDB_STREAM* stream);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
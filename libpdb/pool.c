@@ -0,0 +1,402 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "pool.h"
+
+#ifdef WIN32
+#include <windows.h>
+
+typedef HANDLE PDB_THREAD;
+typedef CRITICAL_SECTION PDB_MUTEX;
+typedef CONDITION_VARIABLE PDB_COND;
+
+#define MutexInit(m) InitializeCriticalSection(m)
+#define MutexDestroy(m) DeleteCriticalSection(m)
+#define MutexLock(m) EnterCriticalSection(m)
+#define MutexUnlock(m) LeaveCriticalSection(m)
+#define CondInit(c) InitializeConditionVariable(c)
+#define CondDestroy(c)
+#define CondWait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define CondSignal(c) WakeConditionVariable(c)
+#define CondBroadcast(c) WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t PDB_THREAD;
+typedef pthread_mutex_t PDB_MUTEX;
+typedef pthread_cond_t PDB_COND;
+
+#define MutexInit(m) pthread_mutex_init(m, NULL)
+#define MutexDestroy(m) pthread_mutex_destroy(m)
+#define MutexLock(m) pthread_mutex_lock(m)
+#define MutexUnlock(m) pthread_mutex_unlock(m)
+#define CondInit(c) pthread_cond_init(c, NULL)
+#define CondDestroy(c) pthread_cond_destroy(c)
+#define CondWait(c, m) pthread_cond_wait(c, m)
+#define CondSignal(c) pthread_cond_signal(c)
+#define CondBroadcast(c) pthread_cond_broadcast(c)
+#endif /* WIN32 */
+
+
+typedef struct PDB_POOL_ITEM
+{
+	PdbPoolFunction fn;
+	void* ctxt;
+	struct PDB_POOL_ITEM* next;
+	struct PDB_POOL_ITEM* prev;
+} PDB_POOL_ITEM;
+
+// Each worker owns a queue.  The owner takes from the head and idle workers
+// steal from the tail, so a few slow items can't leave the rest of the pool
+// waiting behind them.
+typedef struct PDB_POOL_QUEUE
+{
+	PDB_MUTEX mutex;
+	PDB_POOL_ITEM* head;
+	PDB_POOL_ITEM* tail;
+} PDB_POOL_QUEUE;
+
+typedef struct PDB_POOL_WORKER
+{
+	struct PDB_POOL* pool;
+	uint32_t index;
+} PDB_POOL_WORKER;
+
+struct PDB_POOL
+{
+	PDB_THREAD* threads;
+	PDB_POOL_WORKER* workers;
+	PDB_POOL_QUEUE* queues;
+	uint32_t threadCount;
+	uint32_t queueCount;
+	uint32_t nextQueue; // Round robin target for submissions
+	PDB_MUTEX mutex;
+	PDB_COND workReady; // Signalled when items are queued (or on shutdown)
+	PDB_COND workDone; // Signalled when the pool goes idle
+	uint32_t queued; // Items sitting in a queue
+	uint32_t pending; // Queued plus running items
+	bool shutdown;
+};
+
+struct PDB_LOCK
+{
+	PDB_MUTEX mutex;
+};
+
+
+static uint32_t GetProcessorCount()
+{
+#ifdef WIN32
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (count > 0) ? (uint32_t)count : 1;
+#endif /* WIN32 */
+}
+
+
+static PDB_POOL_ITEM* PdbPoolQueuePop(PDB_POOL_QUEUE* queue, bool steal)
+{
+	PDB_POOL_ITEM* item;
+
+	MutexLock(&queue->mutex);
+
+	item = steal ? queue->tail : queue->head;
+	if (item)
+	{
+		if (item->prev)
+			item->prev->next = item->next;
+		else
+			queue->head = item->next;
+
+		if (item->next)
+			item->next->prev = item->prev;
+		else
+			queue->tail = item->prev;
+	}
+
+	MutexUnlock(&queue->mutex);
+
+	return item;
+}
+
+
+// Take from our own queue first, then from everyone else starting with the
+// next worker over so that thieves spread out
+static PDB_POOL_ITEM* PdbPoolTake(PDB_POOL* pool, uint32_t index)
+{
+	PDB_POOL_ITEM* item = PdbPoolQueuePop(&pool->queues[index], false);
+	uint32_t i;
+
+	for (i = 1; !item && i < pool->queueCount; i++)
+		item = PdbPoolQueuePop(&pool->queues[(index + i) % pool->queueCount], true);
+
+	return item;
+}
+
+
+#ifdef WIN32
+static DWORD WINAPI PdbPoolWorker(void* param)
+#else
+static void* PdbPoolWorker(void* param)
+#endif /* WIN32 */
+{
+	PDB_POOL_WORKER* worker = (PDB_POOL_WORKER*)param;
+	PDB_POOL* pool = worker->pool;
+
+	for (;;)
+	{
+		PDB_POOL_ITEM* item = PdbPoolTake(pool, worker->index);
+
+		if (!item)
+		{
+			MutexLock(&pool->mutex);
+
+			// Items are counted before they are linked in, so a nonzero
+			// count with nothing to take only lasts until the submitter
+			// finishes and we go around again
+			while (!pool->queued && !pool->shutdown)
+				CondWait(&pool->workReady, &pool->mutex);
+
+			// Drain the queues before honoring a shutdown
+			if (!pool->queued)
+			{
+				MutexUnlock(&pool->mutex);
+				break;
+			}
+
+			MutexUnlock(&pool->mutex);
+			continue;
+		}
+
+		MutexLock(&pool->mutex);
+		pool->queued--;
+		MutexUnlock(&pool->mutex);
+
+		item->fn(item->ctxt);
+		free(item);
+
+		MutexLock(&pool->mutex);
+
+		if (--pool->pending == 0)
+			CondBroadcast(&pool->workDone);
+
+		MutexUnlock(&pool->mutex);
+	}
+
+	return 0;
+}
+
+
+PDB_POOL* PdbPoolCreate(uint32_t threads)
+{
+	PDB_POOL* pool = (PDB_POOL*)malloc(sizeof(PDB_POOL));
+	uint32_t i;
+
+	if (!pool)
+		return NULL;
+
+	if (threads == 0)
+		threads = GetProcessorCount();
+
+	pool->threads = (PDB_THREAD*)malloc(sizeof(PDB_THREAD) * threads);
+	pool->workers = (PDB_POOL_WORKER*)malloc(sizeof(PDB_POOL_WORKER) * threads);
+	pool->queues = (PDB_POOL_QUEUE*)malloc(sizeof(PDB_POOL_QUEUE) * threads);
+
+	if (!pool->threads || !pool->workers || !pool->queues)
+	{
+		free(pool->queues);
+		free(pool->workers);
+		free(pool->threads);
+		free(pool);
+		return NULL;
+	}
+
+	pool->threadCount = 0;
+	pool->queueCount = threads;
+	pool->nextQueue = 0;
+	pool->queued = 0;
+	pool->pending = 0;
+	pool->shutdown = false;
+
+	MutexInit(&pool->mutex);
+	CondInit(&pool->workReady);
+	CondInit(&pool->workDone);
+
+	for (i = 0; i < threads; i++)
+	{
+		MutexInit(&pool->queues[i].mutex);
+		pool->queues[i].head = NULL;
+		pool->queues[i].tail = NULL;
+		pool->workers[i].pool = pool;
+		pool->workers[i].index = i;
+	}
+
+	for (i = 0; i < threads; i++)
+	{
+#ifdef WIN32
+		pool->threads[i] = CreateThread(NULL, 0, PdbPoolWorker, &pool->workers[i], 0, NULL);
+		if (!pool->threads[i])
+			break;
+#else
+		if (pthread_create(&pool->threads[i], NULL, PdbPoolWorker, &pool->workers[i]))
+			break;
+#endif /* WIN32 */
+		pool->threadCount++;
+	}
+
+	// Nothing would ever run
+	if (pool->threadCount == 0)
+	{
+		PdbPoolDestroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+
+void PdbPoolDestroy(PDB_POOL* pool)
+{
+	uint32_t i;
+
+	MutexLock(&pool->mutex);
+	pool->shutdown = true;
+	CondBroadcast(&pool->workReady);
+	MutexUnlock(&pool->mutex);
+
+	for (i = 0; i < pool->threadCount; i++)
+	{
+#ifdef WIN32
+		WaitForSingleObject(pool->threads[i], INFINITE);
+		CloseHandle(pool->threads[i]);
+#else
+		pthread_join(pool->threads[i], NULL);
+#endif /* WIN32 */
+	}
+
+	for (i = 0; i < pool->queueCount; i++)
+		MutexDestroy(&pool->queues[i].mutex);
+
+	CondDestroy(&pool->workDone);
+	CondDestroy(&pool->workReady);
+	MutexDestroy(&pool->mutex);
+	free(pool->queues);
+	free(pool->workers);
+	free(pool->threads);
+	free(pool);
+}
+
+
+uint32_t PdbPoolGetThreadCount(PDB_POOL* pool)
+{
+	return pool->threadCount;
+}
+
+
+bool PdbPoolSubmit(PDB_POOL* pool, PdbPoolFunction fn, void* ctxt)
+{
+	PDB_POOL_ITEM* item = (PDB_POOL_ITEM*)malloc(sizeof(PDB_POOL_ITEM));
+	PDB_POOL_QUEUE* queue;
+
+	if (!item)
+		return false;
+
+	item->fn = fn;
+	item->ctxt = ctxt;
+	item->next = NULL;
+
+	// Count the item before it becomes visible so that a worker can never
+	// finish it before it has been accounted for
+	MutexLock(&pool->mutex);
+	queue = &pool->queues[pool->nextQueue];
+	pool->nextQueue = (pool->nextQueue + 1) % pool->queueCount;
+	pool->queued++;
+	pool->pending++;
+	MutexUnlock(&pool->mutex);
+
+	MutexLock(&queue->mutex);
+	item->prev = queue->tail;
+	if (queue->tail)
+		queue->tail->next = item;
+	else
+		queue->head = item;
+	queue->tail = item;
+	MutexUnlock(&queue->mutex);
+
+	MutexLock(&pool->mutex);
+	CondSignal(&pool->workReady);
+	MutexUnlock(&pool->mutex);
+
+	return true;
+}
+
+
+void PdbPoolWait(PDB_POOL* pool)
+{
+	MutexLock(&pool->mutex);
+
+	while (pool->pending)
+		CondWait(&pool->workDone, &pool->mutex);
+
+	MutexUnlock(&pool->mutex);
+}
+
+
+PDB_LOCK* PdbLockCreate(void)
+{
+	PDB_LOCK* lock = (PDB_LOCK*)malloc(sizeof(PDB_LOCK));
+
+	if (!lock)
+		return NULL;
+
+	MutexInit(&lock->mutex);
+
+	return lock;
+}
+
+
+void PdbLockDestroy(PDB_LOCK* lock)
+{
+	MutexDestroy(&lock->mutex);
+	free(lock);
+}
+
+
+void PdbLockAcquire(PDB_LOCK* lock)
+{
+	MutexLock(&lock->mutex);
+}
+
+
+void PdbLockRelease(PDB_LOCK* lock)
+{
+	MutexUnlock(&lock->mutex);
+}
@@ -0,0 +1,61 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __POOL_H__
+#define __POOL_H__
+
+
+typedef struct PDB_POOL PDB_POOL;
+typedef struct PDB_LOCK PDB_LOCK;
+
+typedef void (*PdbPoolFunction)(void* ctxt);
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// A fixed set of worker threads running submitted work items.  Pass 0 to
+	// get one thread per processor.
+	PDBAPI PDB_POOL* PdbPoolCreate(uint32_t threads);
+	PDBAPI void PdbPoolDestroy(PDB_POOL* pool);
+
+	PDBAPI uint32_t PdbPoolGetThreadCount(PDB_POOL* pool);
+	PDBAPI bool PdbPoolSubmit(PDB_POOL* pool, PdbPoolFunction fn, void* ctxt);
+
+	// Block until everything submitted so far has run
+	PDBAPI void PdbPoolWait(PDB_POOL* pool);
+
+	// None of the library's objects are thread safe, callers sharing one
+	// between workers need to serialize access with one of these
+	PDBAPI PDB_LOCK* PdbLockCreate(void);
+	PDBAPI void PdbLockDestroy(PDB_LOCK* lock);
+	PDBAPI void PdbLockAcquire(PDB_LOCK* lock);
+	PDBAPI void PdbLockRelease(PDB_LOCK* lock);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __POOL_H__ */
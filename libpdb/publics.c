@@ -0,0 +1,263 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "dbi.h"
+#include "publics.h"
+#include "internal.h"
+
+
+struct PDB_PUBLICS
+{
+	PDB_SYMBOL* symbols; // Sorted by address
+	PDB_SYMBOL** byName; // Sorted by name
+	uint32_t count;
+	char* names; // Storage for all of the names
+};
+
+
+static int CompareAddress(const void* a, const void* b)
+{
+	const PDB_SYMBOL* left = (const PDB_SYMBOL*)a;
+	const PDB_SYMBOL* right = (const PDB_SYMBOL*)b;
+
+	if (left->segment != right->segment)
+		return (left->segment < right->segment) ? -1 : 1;
+
+	if (left->offset != right->offset)
+		return (left->offset < right->offset) ? -1 : 1;
+
+	return 0;
+}
+
+
+static int CompareName(const void* a, const void* b)
+{
+	const PDB_SYMBOL* left = *(const PDB_SYMBOL**)a;
+	const PDB_SYMBOL* right = *(const PDB_SYMBOL**)b;
+
+	return strcmp(left->name, right->name);
+}
+
+
+// The publics being read, names are stored as offsets into the name buffer
+// until it stops growing
+typedef struct PUBLICS_LOAD
+{
+	PDB_PUBLICS* publics;
+	uint32_t capacity;
+	size_t namesCapacity;
+	size_t namesLen;
+} PUBLICS_LOAD;
+
+
+// flags, offset, segment, name
+static bool AddPublic(void* ctxt, const uint8_t* record, uint16_t recordLen)
+{
+	PUBLICS_LOAD* load = (PUBLICS_LOAD*)ctxt;
+	PDB_PUBLICS* publics = load->publics;
+	size_t nameLen = strlen((const char*)record + 12) + 1;
+	PDB_SYMBOL* symbol;
+
+	(void)recordLen;
+
+	if (publics->count == load->capacity)
+	{
+		load->capacity = load->capacity ? (load->capacity * 2) : 1024;
+		publics->symbols = (PDB_SYMBOL*)realloc(publics->symbols, load->capacity * sizeof(PDB_SYMBOL));
+	}
+
+	if (load->namesLen + nameLen > load->namesCapacity)
+	{
+		load->namesCapacity = (load->namesCapacity + nameLen) * 2;
+		publics->names = (char*)realloc(publics->names, load->namesCapacity);
+	}
+
+	symbol = &publics->symbols[publics->count++];
+	symbol->flags = *(uint32_t*)(record + 2);
+	symbol->offset = *(uint32_t*)(record + 6);
+	symbol->segment = *(uint16_t*)(record + 10);
+	symbol->name = (const char*)load->namesLen;
+
+	memcpy(publics->names + load->namesLen, record + 12, nameLen);
+	load->namesLen += nameLen;
+
+	return true;
+}
+
+
+// Walk the symbol record stream and keep the S_PUB32 records
+static bool PdbPublicsLoad(PDB_PUBLICS* publics, PDB_STREAM* stream)
+{
+	static const uint16_t kinds[] = { SYMBOL_TYPE_PUB32 };
+	PUBLICS_LOAD load;
+	bool result;
+	uint32_t i;
+
+	memset(&load, 0, sizeof(load));
+	load.publics = publics;
+
+	result = PdbDbiScanSymbolRecords(stream, kinds, 1, 12, AddPublic, &load);
+
+	// The name buffer won't move anymore
+	for (i = 0; i < publics->count; i++)
+		publics->symbols[i].name = publics->names + (size_t)publics->symbols[i].name;
+
+	return result;
+}
+
+
+PDB_PUBLICS* PdbPublicsOpen(PDB_DBI* dbi)
+{
+	PDB_FILE* pdb = PdbDbiGetPdb(dbi);
+	PDB_PUBLICS* publics;
+	PDB_STREAM* stream;
+	uint32_t i;
+	uint64_t start = PdbTimeNow();
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_BEGIN, "PdbPublicsOpen", 0, 0);
+
+	publics = (PDB_PUBLICS*)malloc(sizeof(PDB_PUBLICS));
+	publics->symbols = NULL;
+	publics->byName = NULL;
+	publics->count = 0;
+	publics->names = NULL;
+
+	stream = PdbStreamOpen(pdb, PdbDbiGetSymbolRecordStream(dbi));
+
+	if (stream)
+	{
+		// Read once, front to back
+		PdbStreamSetAccess(stream, PDB_ACCESS_ONCE);
+
+		if (!PdbPublicsLoad(publics, stream))
+		{
+			PdbStreamClose(stream);
+			PdbPublicsClose(publics);
+			publics = NULL;
+			goto DONE;
+		}
+
+		PdbStreamClose(stream);
+	}
+
+	qsort(publics->symbols, publics->count, sizeof(PDB_SYMBOL), CompareAddress);
+
+	publics->byName = (PDB_SYMBOL**)malloc((publics->count + 1) * sizeof(PDB_SYMBOL*));
+	for (i = 0; i < publics->count; i++)
+		publics->byName[i] = &publics->symbols[i];
+
+	qsort(publics->byName, publics->count, sizeof(PDB_SYMBOL*), CompareName);
+
+DONE:
+	PdbStatsAddTime(pdb, PDB_SUBSYSTEM_DBI, start);
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_END, "PdbPublicsOpen", 0, 0);
+
+	return publics;
+}
+
+
+void PdbPublicsClose(PDB_PUBLICS* publics)
+{
+	free(publics->symbols);
+	free(publics->byName);
+	free(publics->names);
+	free(publics);
+}
+
+
+uint32_t PdbPublicsGetCount(PDB_PUBLICS* publics)
+{
+	return publics->count;
+}
+
+
+bool PdbPublicsGetSymbol(PDB_PUBLICS* publics, uint32_t index, PDB_SYMBOL* symbol)
+{
+	if (index >= publics->count)
+		return false;
+
+	*symbol = publics->symbols[index];
+
+	return true;
+}
+
+
+bool PdbPublicsFindByAddress(PDB_PUBLICS* publics, uint16_t segment, uint32_t offset, PDB_SYMBOL* symbol)
+{
+	PDB_SYMBOL key;
+	uint32_t low = 0;
+	uint32_t high = publics->count;
+
+	key.segment = segment;
+	key.offset = offset;
+
+	// Find the first symbol after the address
+	while (low < high)
+	{
+		uint32_t mid = low + ((high - low) / 2);
+
+		if (CompareAddress(&publics->symbols[mid], &key) <= 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	// The one before it is the closest, if it is in the same section
+	if ((low == 0) || (publics->symbols[low - 1].segment != segment))
+		return false;
+
+	*symbol = publics->symbols[low - 1];
+
+	return true;
+}
+
+
+bool PdbPublicsFindByName(PDB_PUBLICS* publics, const char* name, PDB_SYMBOL* symbol)
+{
+	uint32_t low = 0;
+	uint32_t high = publics->count;
+
+	while (low < high)
+	{
+		uint32_t mid = low + ((high - low) / 2);
+		int cmp = strcmp(publics->byName[mid]->name, name);
+
+		if (cmp == 0)
+		{
+			*symbol = *publics->byName[mid];
+			return true;
+		}
+
+		if (cmp < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return false;
+}
@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __PUBLICS_H__
+#define __PUBLICS_H__
+
+
+typedef struct PDB_PUBLICS PDB_PUBLICS;
+
+// A public symbol (S_PUB32).  The name is owned by the PDB_PUBLICS.
+typedef struct PDB_SYMBOL
+{
+	const char* name;
+	uint32_t flags; // CV_PUBSYMFLAGS (code, function, managed, msil)
+	uint32_t offset; // Offset within the section
+	uint16_t segment; // One based section number
+} PDB_SYMBOL;
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Loads every public symbol into memory, so the lookups below never
+	// touch the file and can be made from several threads at once
+	PDBAPI PDB_PUBLICS* PdbPublicsOpen(PDB_DBI* dbi);
+	PDBAPI void PdbPublicsClose(PDB_PUBLICS* publics);
+
+	PDBAPI uint32_t PdbPublicsGetCount(PDB_PUBLICS* publics);
+
+	// The index'th symbol in address order, for walking all of them
+	PDBAPI bool PdbPublicsGetSymbol(PDB_PUBLICS* publics, uint32_t index, PDB_SYMBOL* symbol);
+
+	// Find the closest symbol at or before the address
+	PDBAPI bool PdbPublicsFindByAddress(PDB_PUBLICS* publics, uint16_t segment, uint32_t offset, PDB_SYMBOL* symbol);
+	PDBAPI bool PdbPublicsFindByName(PDB_PUBLICS* publics, const char* name, PDB_SYMBOL* symbol);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __PUBLICS_H__ */
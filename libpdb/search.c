@@ -0,0 +1,558 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "tpi.h"
+#include "dbi.h"
+#include "publics.h"
+#include "pool.h"
+#include "search.h"
+
+
+#define PDB_BLOOM_MAGIC "PDBBLOOM"
+#define PDB_BLOOM_VERSION 1
+
+// Ten bits and seven probes per name gives about 1% false positives.  The
+// bit count is rounded up to a power of two, which only lowers that.
+#define PDB_BLOOM_BITS_PER_NAME 10
+#define PDB_BLOOM_HASHES 7
+#define PDB_BLOOM_MIN_BITS 9
+#define PDB_BLOOM_MAX_BITS 32
+
+
+// Starts every filter, in memory and on disk
+typedef struct PDB_BLOOM_HEADER
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t age;
+	uint8_t guid[16];
+	uint32_t bits;
+	uint32_t hashes;
+	uint32_t names;
+	uint32_t reserved;
+} PDB_BLOOM_HEADER;
+
+struct PDB_BLOOM
+{
+	// The header and bits are a single block, laid out as they are saved
+	uint8_t* block;
+	size_t blockSize;
+
+	const PDB_BLOOM_HEADER* header;
+	uint64_t* words;
+};
+
+typedef struct BLOOM_NAMES
+{
+	uint64_t* hashes;
+	uint32_t count;
+	uint32_t capacity;
+} BLOOM_NAMES;
+
+typedef struct SEARCH_CONTEXT
+{
+	const char* name;
+	uint32_t kinds;
+	const char* cacheDir;
+	PdbSearchFunction searchFn;
+	void* ctxt;
+	PDB_LOCK* lock; // Guards stats and calls to searchFn
+	PDB_SEARCH_STATS stats;
+} SEARCH_CONTEXT;
+
+typedef struct SEARCH_ITEM
+{
+	SEARCH_CONTEXT* search;
+	const char* path;
+} SEARCH_ITEM;
+
+
+// The 64 bit murmur finalizer
+static uint64_t MixHash(uint64_t hash)
+{
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+
+// FNV-1a 64, seeded by kind so a type and a public of the same name set
+// different bits.  The pdb's own name hash is too weak to probe with.
+static uint64_t HashName(PDB_SEARCH_KIND kind, const char* name)
+{
+	uint64_t hash = 0xcbf29ce484222325ull ^ (uint64_t)kind;
+
+	for (; *name; name++)
+	{
+		hash ^= (uint8_t)*name;
+		hash *= 0x100000001b3ull;
+	}
+
+	return MixHash(hash);
+}
+
+
+static size_t BlockSize(uint32_t bits)
+{
+	return sizeof(PDB_BLOOM_HEADER) + (size_t)(((uint64_t)1 << bits) / 8);
+}
+
+
+// Probe i is bit h1 + i * h2, with h2 odd so every probe can differ
+static void SetBits(PDB_BLOOM* bloom, uint64_t hash)
+{
+	uint64_t mask = ((uint64_t)1 << bloom->header->bits) - 1;
+	uint64_t h1 = (uint32_t)hash;
+	uint64_t h2 = (uint32_t)(hash >> 32) | 1;
+	uint32_t i;
+
+	for (i = 0; i < bloom->header->hashes; i++)
+	{
+		uint64_t bit = (h1 + (i * h2)) & mask;
+
+		bloom->words[bit / 64] |= (uint64_t)1 << (bit % 64);
+	}
+}
+
+
+static bool TestBits(PDB_BLOOM* bloom, uint64_t hash)
+{
+	uint64_t mask = ((uint64_t)1 << bloom->header->bits) - 1;
+	uint64_t h1 = (uint32_t)hash;
+	uint64_t h2 = (uint32_t)(hash >> 32) | 1;
+	uint32_t i;
+
+	for (i = 0; i < bloom->header->hashes; i++)
+	{
+		uint64_t bit = (h1 + (i * h2)) & mask;
+
+		if (!(bloom->words[bit / 64] & ((uint64_t)1 << (bit % 64))))
+			return false;
+	}
+
+	return true;
+}
+
+
+static bool AddName(BLOOM_NAMES* names, PDB_SEARCH_KIND kind, const char* name)
+{
+	if (names->count == names->capacity)
+	{
+		uint32_t capacity = names->capacity ? (names->capacity * 2) : 4096;
+		uint64_t* hashes = (uint64_t*)realloc(names->hashes, capacity * sizeof(uint64_t));
+
+		if (!hashes)
+			return false;
+
+		names->hashes = hashes;
+		names->capacity = capacity;
+	}
+
+	names->hashes[names->count++] = HashName(kind, name);
+
+	return true;
+}
+
+
+// The same definitions PdbTypesFind answers for
+static bool CollectTypeName(void* ctxt, uint32_t typeId, uint16_t leaf, const uint8_t* data, uint16_t len)
+{
+	PDB_TYPE_UDT udt;
+	const char* name;
+
+	(void)typeId;
+
+	if (!PdbTypesParseUdtDefinition(leaf, data, len, &udt, &name))
+		return true;
+
+	return AddName((BLOOM_NAMES*)ctxt, PDB_SEARCH_TYPES, name);
+}
+
+
+static void SetPointers(PDB_BLOOM* bloom)
+{
+	bloom->header = (const PDB_BLOOM_HEADER*)bloom->block;
+	bloom->words = (uint64_t*)(bloom->block + sizeof(PDB_BLOOM_HEADER));
+}
+
+
+PDB_BLOOM* PdbBloomBuild(PDB_FILE* pdb, PDB_TYPES* types, PDB_PUBLICS* publics)
+{
+	PDB_BLOOM* bloom = NULL;
+	PDB_BLOOM_HEADER* header;
+	BLOOM_NAMES names;
+	uint8_t guid[16];
+	uint32_t age;
+	uint32_t bits = PDB_BLOOM_MIN_BITS;
+	uint32_t i;
+
+	if (!PdbGetSignature(pdb, guid, &age))
+		return NULL;
+
+	memset(&names, 0, sizeof(names));
+
+	if (types && !PdbTypesWalk(types, CollectTypeName, &names))
+		goto DONE;
+
+	for (i = 0; publics && (i < PdbPublicsGetCount(publics)); i++)
+	{
+		PDB_SYMBOL symbol;
+
+		if (PdbPublicsGetSymbol(publics, i, &symbol) && !AddName(&names, PDB_SEARCH_PUBLICS, symbol.name))
+			goto DONE;
+	}
+
+	while ((bits < PDB_BLOOM_MAX_BITS) && (((uint64_t)1 << bits) < (uint64_t)names.count * PDB_BLOOM_BITS_PER_NAME))
+		bits++;
+
+	bloom = (PDB_BLOOM*)calloc(1, sizeof(PDB_BLOOM));
+	if (!bloom)
+		goto DONE;
+
+	bloom->blockSize = BlockSize(bits);
+	bloom->block = (uint8_t*)calloc(1, bloom->blockSize);
+	if (!bloom->block)
+	{
+		free(bloom);
+		bloom = NULL;
+		goto DONE;
+	}
+
+	header = (PDB_BLOOM_HEADER*)bloom->block;
+	memcpy(header->magic, PDB_BLOOM_MAGIC, sizeof(header->magic));
+	header->version = PDB_BLOOM_VERSION;
+	header->age = age;
+	memcpy(header->guid, guid, sizeof(guid));
+	header->bits = bits;
+	header->hashes = PDB_BLOOM_HASHES;
+	header->names = names.count;
+
+	SetPointers(bloom);
+
+	for (i = 0; i < names.count; i++)
+		SetBits(bloom, names.hashes[i]);
+
+DONE:
+	free(names.hashes);
+
+	return bloom;
+}
+
+
+void PdbBloomClose(PDB_BLOOM* bloom)
+{
+	free(bloom->block);
+	free(bloom);
+}
+
+
+PDB_BLOOM* PdbBloomLoad(const char* path, PDB_FILE* pdb)
+{
+	PDB_BLOOM* bloom = NULL;
+	PDB_BLOOM_HEADER header;
+	uint8_t guid[16];
+	uint32_t age;
+	FILE* file;
+	size_t size;
+
+	if (!PdbGetSignature(pdb, guid, &age))
+		return NULL;
+
+	file = fopen(path, "rb");
+	if (!file)
+		return NULL;
+
+	if ((fread(&header, sizeof(header), 1, file) != 1)
+		|| memcmp(header.magic, PDB_BLOOM_MAGIC, sizeof(header.magic))
+		|| (header.version != PDB_BLOOM_VERSION)
+		|| (header.age != age) || memcmp(header.guid, guid, sizeof(guid))
+		|| (header.bits < PDB_BLOOM_MIN_BITS) || (header.bits > PDB_BLOOM_MAX_BITS)
+		|| (header.hashes == 0) || (header.hashes > 32))
+		goto DONE;
+
+	size = BlockSize(header.bits);
+
+	if ((fseek(file, 0, SEEK_END) != 0) || ((size_t)ftell(file) != size))
+		goto DONE;
+
+	bloom = (PDB_BLOOM*)calloc(1, sizeof(PDB_BLOOM));
+	if (!bloom)
+		goto DONE;
+
+	bloom->blockSize = size;
+	bloom->block = (uint8_t*)malloc(size);
+
+	if (bloom->block && (fseek(file, 0, SEEK_SET) == 0) && (fread(bloom->block, 1, size, file) == size))
+	{
+		SetPointers(bloom);
+		goto DONE;
+	}
+
+	free(bloom->block);
+	free(bloom);
+	bloom = NULL;
+
+DONE:
+	fclose(file);
+
+	return bloom;
+}
+
+
+bool PdbBloomSave(PDB_BLOOM* bloom, const char* path)
+{
+	FILE* file = fopen(path, "wb");
+	bool result;
+
+	if (!file)
+		return false;
+
+	result = (fwrite(bloom->block, 1, bloom->blockSize, file) == bloom->blockSize);
+
+	if (fclose(file))
+		result = false;
+
+	// Don't leave a partial filter behind to be found later
+	if (!result)
+		remove(path);
+
+	return result;
+}
+
+
+bool PdbBloomMayContain(PDB_BLOOM* bloom, PDB_SEARCH_KIND kind, const char* name)
+{
+	return TestBits(bloom, HashName(kind, name));
+}
+
+
+// Filters live next to the pdb, or in cacheDir under the name a symbol
+// server would store the pdb under
+static char* CachePath(const char* path, const char* cacheDir, const uint8_t guid[16], uint32_t age)
+{
+	char* cachePath;
+	uint32_t i;
+
+	if (!cacheDir)
+	{
+		cachePath = (char*)malloc(strlen(path) + sizeof(".bloom"));
+		if (cachePath)
+			sprintf(cachePath, "%s.bloom", path);
+
+		return cachePath;
+	}
+
+	// The separator, 32 GUID digits, up to 8 age digits and the extension
+	cachePath = (char*)malloc(strlen(cacheDir) + 1 + 32 + 8 + sizeof(".bloom"));
+	if (!cachePath)
+		return NULL;
+
+	// The first three GUID fields are little endian
+	sprintf(cachePath, "%s/%02X%02X%02X%02X%02X%02X%02X%02X", cacheDir,
+		guid[3], guid[2], guid[1], guid[0], guid[5], guid[4], guid[7], guid[6]);
+
+	for (i = 8; i < 16; i++)
+		sprintf(cachePath + strlen(cachePath), "%02X", guid[i]);
+
+	sprintf(cachePath + strlen(cachePath), "%X.bloom", age);
+
+	return cachePath;
+}
+
+
+static void SearchFile(void* ctxt)
+{
+	SEARCH_ITEM* item = (SEARCH_ITEM*)ctxt;
+	SEARCH_CONTEXT* search = item->search;
+	PDB_FILE* pdb = PdbOpen(item->path);
+	PDB_TYPES* types = NULL;
+	PDB_DBI* dbi = NULL;
+	PDB_PUBLICS* publics = NULL;
+	PDB_BLOOM* bloom = NULL;
+	char* cachePath = NULL;
+	uint8_t guid[16];
+	uint32_t age;
+	uint32_t found = 0;
+	bool failed = false;
+	bool opened = false;
+	bool built = false;
+	bool rejected = false;
+
+	if (!pdb || !PdbGetSignature(pdb, guid, &age))
+	{
+		failed = true;
+		goto DONE;
+	}
+
+	cachePath = CachePath(item->path, search->cacheDir, guid, age);
+	if (cachePath)
+		bloom = PdbBloomLoad(cachePath, pdb);
+
+	// Build from both kinds of names whatever was asked for, so the cached
+	// filter can answer any later search
+	if (!bloom)
+	{
+		types = PdbTypesOpen(pdb);
+		dbi = PdbDbiOpen(pdb);
+		if (dbi)
+			publics = PdbPublicsOpen(dbi);
+		opened = true;
+
+		// A filter missing either kind would rule out every name of that
+		// kind from then on, so this search goes without one instead
+		if (types && publics)
+		{
+			bloom = PdbBloomBuild(pdb, types, publics);
+			built = (bloom != NULL);
+
+			// Failing to save only costs the next search a rebuild
+			if (bloom && cachePath)
+				PdbBloomSave(bloom, cachePath);
+		}
+	}
+
+	if (search->kinds & PDB_SEARCH_TYPES)
+	{
+		if (!bloom || PdbBloomMayContain(bloom, PDB_SEARCH_TYPES, search->name))
+		{
+			PDB_TYPE_UDT udt;
+
+			if (!opened)
+				types = PdbTypesOpen(pdb);
+
+			if (types && PdbTypesFind(types, search->name, &udt))
+				found |= PDB_SEARCH_TYPES;
+		}
+	}
+
+	if (search->kinds & PDB_SEARCH_PUBLICS)
+	{
+		if (!bloom || PdbBloomMayContain(bloom, PDB_SEARCH_PUBLICS, search->name))
+		{
+			PDB_SYMBOL symbol;
+
+			if (!opened)
+			{
+				dbi = PdbDbiOpen(pdb);
+				if (dbi)
+					publics = PdbPublicsOpen(dbi);
+			}
+
+			if (publics && PdbPublicsFindByName(publics, search->name, &symbol))
+				found |= PDB_SEARCH_PUBLICS;
+		}
+	}
+
+	// Only counts if the filter is all that was read
+	rejected = bloom && !opened && !types && !dbi;
+
+DONE:
+	PdbLockAcquire(search->lock);
+
+	search->stats.files++;
+	if (failed)
+		search->stats.failed++;
+	if (built)
+		search->stats.built++;
+	if (rejected)
+		search->stats.rejected++;
+
+	if (found)
+	{
+		search->stats.matched++;
+		search->searchFn(search->ctxt, item->path, found);
+	}
+
+	PdbLockRelease(search->lock);
+
+	if (bloom)
+		PdbBloomClose(bloom);
+	if (publics)
+		PdbPublicsClose(publics);
+	if (dbi)
+		PdbDbiClose(dbi);
+	if (types)
+		PdbTypesClose(types);
+	if (pdb)
+		PdbClose(pdb);
+	free(cachePath);
+}
+
+
+bool PdbSearch(const char* const* paths, uint32_t count, const char* name, uint32_t kinds,
+	const char* cacheDir, uint32_t threads, PdbSearchFunction searchFn, void* ctxt,
+	PDB_SEARCH_STATS* stats)
+{
+	SEARCH_CONTEXT search;
+	SEARCH_ITEM* items;
+	PDB_POOL* pool;
+	uint32_t i;
+
+	memset(&search, 0, sizeof(search));
+	search.name = name;
+	search.kinds = kinds;
+	search.cacheDir = cacheDir;
+	search.searchFn = searchFn;
+	search.ctxt = ctxt;
+	search.lock = PdbLockCreate();
+
+	items = (SEARCH_ITEM*)calloc(count ? count : 1, sizeof(SEARCH_ITEM));
+	pool = PdbPoolCreate(threads);
+
+	if (!search.lock || !items || !pool)
+	{
+		if (pool)
+			PdbPoolDestroy(pool);
+		if (search.lock)
+			PdbLockDestroy(search.lock);
+		free(items);
+		return false;
+	}
+
+	// Big and small pdbs are interleaved in most directories, stealing
+	// evens out the queues as the big ones hold their workers up
+	for (i = 0; i < count; i++)
+	{
+		items[i].search = &search;
+		items[i].path = paths[i];
+
+		if (!PdbPoolSubmit(pool, SearchFile, &items[i]))
+			SearchFile(&items[i]);
+	}
+
+	PdbPoolWait(pool);
+	PdbPoolDestroy(pool);
+	PdbLockDestroy(search.lock);
+	free(items);
+
+	if (stats)
+		*stats = search.stats;
+
+	return true;
+}
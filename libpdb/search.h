@@ -0,0 +1,92 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+
+typedef struct PDB_BLOOM PDB_BLOOM;
+
+// Which names to look for, and which were found
+typedef enum PDB_SEARCH_KIND
+{
+	PDB_SEARCH_TYPES = 1, // Struct, class, union and enum definitions
+	PDB_SEARCH_PUBLICS = 2,
+	PDB_SEARCH_ALL = 3
+} PDB_SEARCH_KIND;
+
+typedef struct PDB_SEARCH_STATS
+{
+	uint32_t files;
+	uint32_t failed; // Couldn't be opened
+	uint32_t rejected; // Ruled out by the filter alone
+	uint32_t built; // Filters built (not found in the cache)
+	uint32_t matched;
+} PDB_SEARCH_STATS;
+
+// Called once per pdb that has the name, with the PDB_SEARCH_KIND bits it
+// was found as.  Calls come from the pool's threads but never overlap.
+typedef void (*PdbSearchFunction)(void* ctxt, const char* path, uint32_t found);
+
+// The filter file format, all little endian:
+//
+// Header: char magic[8] "PDBBLOOM", uint32 version (1), uint32 age,
+// uint8 guid[16], uint32 bits (log2 of the bit count), uint32 hashes,
+// uint32 names, uint32 reserved (0).  Then the bits as uint64 words.
+//
+// guid and age are the pdb's, see PdbGetSignature.
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// A Bloom filter over the pdb's type definition and public symbol names,
+	// about 1% false positives.  Either of types and publics may be NULL, but
+	// then the filter rules out every name of that kind.
+	PDBAPI PDB_BLOOM* PdbBloomBuild(PDB_FILE* pdb, PDB_TYPES* types, PDB_PUBLICS* publics);
+	PDBAPI void PdbBloomClose(PDB_BLOOM* bloom);
+
+	// A filter saved for this pdb, NULL if the file is missing, damaged, or
+	// was saved for a different build
+	PDBAPI PDB_BLOOM* PdbBloomLoad(const char* path, PDB_FILE* pdb);
+	PDBAPI bool PdbBloomSave(PDB_BLOOM* bloom, const char* path);
+
+	// False means the pdb definitely doesn't have the name
+	PDBAPI bool PdbBloomMayContain(PDB_BLOOM* bloom, PDB_SEARCH_KIND kind, const char* name);
+
+	// Look for name in every pdb in paths, on a pool of threads (0 for one
+	// per processor).  Each pdb's filter is checked before its types or
+	// publics are read.  Filters are cached in cacheDir named by the pdb's
+	// GUID and age, as [GUID][age].bloom, or next to the pdb as
+	// [pdb file].bloom if cacheDir is NULL.  stats may be NULL.
+	PDBAPI bool PdbSearch(const char* const* paths, uint32_t count, const char* name, uint32_t kinds,
+		const char* cacheDir, uint32_t threads, PdbSearchFunction searchFn, void* ctxt,
+		PDB_SEARCH_STATS* stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __SEARCH_H__ */
@@ -24,6 +24,8 @@ THE SOFTWARE.
 
 #include "pdb.h"
 #include "tpi.h"
+#include "namehash.h"
+#include "internal.h"
 
 
 #define PDB_TYPES_HEADER_SIZE           0x38
@@ -37,6 +39,12 @@ THE SOFTWARE.
 #define PDB_VERSION_VC71                20000404
 #define PDB_VERSION_VC8                 20040203
 
+// Read size for PdbTypesWalk, must hold the largest record (0xffff + 2)
+#define PDB_TYPES_WALK_BUFFER           (1024 * 1024)
+
+// How many field list records PrintFieldList follows LF_INDEX through
+#define PDB_TYPES_MAX_LISTS             64
+
 
 typedef struct PDB_TYPES_STREAM_HASH_ENTRY
 {
@@ -57,12 +65,18 @@ typedef struct PDB_TYPES_HASH
 typedef struct PDB_TYPES
 {
 	PDB_STREAM* stream;
+	PDB_CURSOR cursor; // Every read of the stream goes through this
 	uint32_t version;
 	uint32_t headerSize;
 	uint32_t minId;
 	uint32_t maxId;
 	uint32_t len; // The amount of data after the header
 	PDB_TYPES_HASH* hash;
+	uint32_t* offsets; // Stream offset of each record, built on first lookup
+	uint32_t* bucketHeads; // First type index + 1 in each hash bucket (0 is empty)
+	uint32_t* bucketNext; // Next type index + 1 in the same bucket
+	uint8_t* record; // Scratch space for a single record
+	bool validated; // Every record passed PdbTypesValidateRecord, checked with the offsets
 } PDB_TYPES;
 
 typedef struct PDB_TYPE_PROPERTIES
@@ -95,53 +109,11 @@ typedef struct PDB_TYPE
 	PDB_LEAF_TYPES type;
 } PDB_TYPE;
 
-typedef struct PDB_LEAF_TYPE_STRUCTURE
-{
-	uint16_t lf;
-	uint16_t count;
-	uint16_t prop;
-	uint32_t field;
-	uint32_t derived;
-	uint32_t vshape;
-	char* name;
-} PDB_LEAF_TYPE_STRUCTURE;
-
-
-// My interpretation of the algorithm in Ch 7.5 Hash table and sort table descriptions
-// in "Microsoft Symbol and Type Information" at
-// http://pierrelib.pagesperso-orange.fr/exec_formats/MS_Symbol_Type_v1.0.pdf
-static uint32_t CalcTypeHash(const char* typeName)
-{
-	size_t len = strlen(typeName) + 1;
-	const uint32_t* pName = (uint32_t*)typeName;
-	uint32_t end;
-	size_t i;
-	uint32_t sum;
-
-	end = 0;
-	while (len & 3)
-	{
-		end |= (typeName[len - 1] & 0xdf); // toupper
-		end <<= 8;
-		len--;
-	}
-
-	len /= 4;
-	for (i = 0; i < len; i++)
-	{
-		sum ^= (pName[i] & 0xdfdfdfdf); // toupper
-		sum = (sum << 4) | (sum >> 28); //rotl sum, 4
-	}
-	sum ^= end;
-
-	return sum; // take modulus of hash buckets
-}
-
-
-static PDB_TYPES_HASH* PdbTypesHashOpen(PDB_TYPES* types, uint32_t hashStreamId)
+// The rest of the header describes the hash stream, read it from the
+// cursor on the types stream
+static PDB_TYPES_HASH* PdbTypesHashOpen(PDB_TYPES* types, PDB_CURSOR* cursor, uint32_t hashStreamId)
 {
 	PDB_TYPES_HASH* hash = (PDB_TYPES_HASH*)malloc(sizeof(PDB_TYPES_HASH));
-	uint16_t reserved;
 	hash->stream = PdbStreamOpen(PdbStreamGetPdb(types->stream), hashStreamId);
 
 	if (!hash->stream)
@@ -151,36 +123,36 @@ static PDB_TYPES_HASH* PdbTypesHashOpen(PDB_TYPES* types, uint32_t hashStreamId)
 	}
 
 	// Move past the reserved word (filler to preserved alignment)
-	if (!PdbStreamRead(types->stream, (uint8_t*)&reserved, 2))
-		return false;
+	if (!PdbCursorSkip(cursor, 2))
+		goto FAIL;
 
 	// Get the size of the key
-	if (!PdbStreamRead(types->stream, (uint8_t*)&hash->keySize, 4))
-		return false;
+	if (!PdbCursorReadU32(cursor, &hash->keySize))
+		goto FAIL;
 
 	// Get the number of buckets in the hash
-	if (!PdbStreamRead(types->stream, (uint8_t*)&hash->buckets, 4))
-		return false;
+	if (!PdbCursorReadU32(cursor, &hash->buckets))
+		goto FAIL;
 
 	// Read the hash values
-	if (!PdbStreamRead(types->stream, (uint8_t*)&hash->values.offset, 4))
-		return false;
-	if (!PdbStreamRead(types->stream, (uint8_t*)&hash->values.size, 4))
-		return false;
+	if (!PdbCursorReadU32(cursor, &hash->values.offset) || !PdbCursorReadU32(cursor, &hash->values.size))
+		goto FAIL;
 
 	// Read the hash indices
-	if (!PdbStreamRead(types->stream, (uint8_t*)&hash->types.offset, 4))
-		return false;
-	if (!PdbStreamRead(types->stream, (uint8_t*)&hash->types.size, 4))
-		return false;
+	if (!PdbCursorReadU32(cursor, &hash->types.offset) || !PdbCursorReadU32(cursor, &hash->types.size))
+		goto FAIL;
 
 	// Read the hash adjustments
-	if (!PdbStreamRead(types->stream, (uint8_t*)&hash->adjustments.offset, 4))
-		return false;
-	if (!PdbStreamRead(types->stream, (uint8_t*)&hash->adjustments.size, 4))
-		return false;
-	
+	if (!PdbCursorReadU32(cursor, &hash->adjustments.offset) || !PdbCursorReadU32(cursor, &hash->adjustments.size))
+		goto FAIL;
+
 	return hash;
+
+FAIL:
+	PdbStreamClose(hash->stream);
+	free(hash);
+
+	return NULL;
 }
 
 
@@ -191,18 +163,27 @@ static void PdbTypesHashClose(PDB_TYPES_HASH* hash)
 }
 
 
-PDB_TYPES* PdbTypesOpen(PDB_FILE* pdb)
+static PDB_TYPES* PdbTypesLoad(PDB_FILE* pdb, uint16_t streamId)
 {
 	PDB_TYPES* types;
+	PDB_CURSOR cursor;
 	uint16_t hashStreamId;
 	uint32_t version;
 
-	// Get the types stream
-	PDB_STREAM* stream = PdbStreamOpen(pdb, PDB_STREAM_TYPE_INFO);
+	// Get the types (or ids) stream
+	PDB_STREAM* stream = PdbStreamOpen(pdb, streamId);
+
+	if (!stream)
+		return NULL;
+
+	PdbCursorOpen(&cursor, stream, 0);
 
 	// Read version
-	if (!PdbStreamRead(stream, (uint8_t*)&version, 4))
+	if (!PdbCursorReadU32(&cursor, &version))
+	{
+		PdbStreamClose(stream);
 		return NULL;
+	}
 
 	// Check for a supported version
 	if ((version != PDB_VERSION_VC2)
@@ -224,21 +205,26 @@ PDB_TYPES* PdbTypesOpen(PDB_FILE* pdb)
 	types->version = version;
 	types->stream = stream;
 	types->hash = NULL;
+	types->offsets = NULL;
+	types->bucketHeads = NULL;
+	types->bucketNext = NULL;
+	types->record = NULL;
+	types->validated = false;
 
 	// Get the header size, for sanity checking purposes
-	if (!PdbStreamRead(types->stream, (uint8_t*)&types->headerSize, 4))
+	if (!PdbCursorReadU32(&cursor, &types->headerSize))
 		goto FAIL;
 
 	// Get the minimum type index
-	if (!PdbStreamRead(types->stream, (uint8_t*)&types->minId, 4))
+	if (!PdbCursorReadU32(&cursor, &types->minId))
 		goto FAIL;
 
 	// Get the maximum type index
-	if (!PdbStreamRead(types->stream, (uint8_t*)&types->maxId, 4))
+	if (!PdbCursorReadU32(&cursor, &types->maxId))
 		goto FAIL;
 
 	// Get the size of the data following the header
-	if (!PdbStreamRead(types->stream, (uint8_t*)&types->len, 4))
+	if (!PdbCursorReadU32(&cursor, &types->len))
 		goto FAIL;
 
 	// Sanity check -- the header numbers better agree
@@ -247,12 +233,23 @@ PDB_TYPES* PdbTypesOpen(PDB_FILE* pdb)
 		goto FAIL;
 
 	// Get the type hash stream number
-	if (!PdbStreamRead(types->stream, (uint8_t*)&hashStreamId, 2))
+	if (!PdbCursorReadU16(&cursor, &hashStreamId))
 		goto FAIL;
 
 	// Sanity check before opening
 	if (hashStreamId <= PdbGetStreamCount(pdb))
-		types->hash = PdbTypesHashOpen(types, hashStreamId);
+	{
+		if (PDB_TRACING())
+			PdbTraceEmit(PDB_TRACE_BEGIN, "TypesHashOpen", hashStreamId, 0);
+
+		types->hash = PdbTypesHashOpen(types, &cursor, hashStreamId);
+
+		if (PDB_TRACING())
+			PdbTraceEmit(PDB_TRACE_END, "TypesHashOpen", hashStreamId, 0);
+	}
+
+	// Lookups carry on from the header's window
+	types->cursor = cursor;
 
 	return types;
 
@@ -264,50 +261,58 @@ FAIL:
 }
 
 
-static bool PrintStructureType(PDB_TYPES* types, PdbTypeEnumFunction typeFn, uint8_t* buff, size_t len)
+PDB_TYPES* PdbTypesOpen(PDB_FILE* pdb)
 {
-	PDB_LEAF_TYPE_STRUCTURE structType;
-	size_t nameLen;
-	uint8_t* pbuff = buff;
+	uint64_t start = PdbTimeNow();
+	PDB_TYPES* types;
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_BEGIN, "PdbTypesOpen", 0, 0);
 
-	structType.count = *(uint16_t*)pbuff;
-	pbuff += sizeof(uint16_t);
+	types = PdbTypesLoad(pdb, PDB_STREAM_TYPE_INFO);
 
-	structType.prop = *(uint16_t*)pbuff;
-	pbuff += sizeof(uint16_t);
+	PdbStatsAddTime(pdb, PDB_SUBSYSTEM_TPI, start);
 
-	structType.field = *(uint32_t*)pbuff;
-	pbuff += sizeof(uint32_t);
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_END, "PdbTypesOpen", 0, 0);
 
-	structType.derived = *(uint32_t*)pbuff;
-	pbuff += sizeof(uint32_t);
+	return types;
+}
 
-	structType.vshape = *(uint32_t*)pbuff;
-	pbuff += sizeof(uint32_t);
 
-	// MS says there are a variable number of bytes here representing
-	// the length of the structure.
-	// So far, I've seen two zero bytes.
-	pbuff += sizeof(uint16_t);
+PDB_TYPES* PdbIdsOpen(PDB_FILE* pdb)
+{
+	uint64_t start = PdbTimeNow();
+	PDB_TYPES* ids;
 
-	nameLen = (len - (pbuff - buff)); // The remainder of the buffer is the name field
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_BEGIN, "PdbIdsOpen", 0, 0);
 
-	if (nameLen)
-	{
-		structType.name = (uint8_t*)malloc(nameLen + 1);
-		strncpy(structType.name, pbuff, nameLen);
-	}
-	else
-	{
-		structType.name = NULL;
-	}
+	ids = PdbTypesLoad(pdb, PDB_STREAM_ID_INFO);
+
+	PdbStatsAddTime(pdb, PDB_SUBSYSTEM_TPI, start);
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_END, "PdbIdsOpen", 0, 0);
+
+	return ids;
+}
+
+
+static bool PdbTypesReadRecord(PDB_TYPES* types, uint32_t typeId, uint16_t* leaf, uint16_t* len);
 
-	pbuff += strlen(structType.name);
+
+static bool PrintStructureType(PDB_TYPES* types, PdbTypeEnumFunction typeFn, uint16_t leaf, uint8_t* buff, size_t len)
+{
+	PDB_TYPE_UDT udt;
+	const char* name;
+
+	if (types->validated ? !PdbTypesParseUdtUnchecked(leaf, buff, len, &udt, &name)
+		: !PdbTypesParseUdt(leaf, buff, len, &udt, &name))
+		return false;
 
 	printf("struct name=%s count=%x prop=%x, field=%x, derived=%x, vshape=%x\n",
-		structType.name, (uint32_t)structType.count,
-		(uint32_t)structType.prop, structType.field, structType.derived,
-		structType.vshape);
+		name, (uint32_t)udt.count, (uint32_t)udt.prop, udt.field, udt.derived, udt.vshape);
 
 	return true;
 }
@@ -315,129 +320,862 @@ static bool PrintStructureType(PDB_TYPES* types, PdbTypeEnumFunction typeFn, uin
 
 static bool PrintFieldList(PDB_TYPES* types, PdbTypeEnumFunction typeFn, uint8_t* buff, size_t len)
 {
-	uint8_t* pbuff = buff;
-	size_t remainingLen = len;
+	size_t pos = 0;
+	uint16_t leaf;
+	uint16_t recordLen;
+	uint32_t lists = 1;
+	bool result = false;
 
-	while (remainingLen)
+	// Continuations are read by index, which moves the types cursor.  An
+	// enumeration reads its next record from there, so put it back after.
+	uint64_t resume = PdbCursorTell(&types->cursor);
+
+	while (pos < len)
 	{
-		uint16_t typeId;
-		uint16_t lf;
-		uint8_t skip;
-		uint32_t val;
-		char* name;
-		size_t nameLen;
-
-		lf = *(uint16_t*)pbuff;
-		pbuff += sizeof(uint16_t);
-		remainingLen -= sizeof(uint16_t);
-
-		typeId = *(uint16_t*)pbuff;
-		pbuff += sizeof(uint16_t);
-		remainingLen -= sizeof(uint16_t);
-
-		switch (lf)
+		PDB_TYPE_MEMBER member;
+		size_t memberLen = types->validated ? PdbTypesParseMemberUnchecked(buff + pos, len - pos, &member)
+			: PdbTypesParseMember(buff + pos, len - pos, &member);
+
+		// Don't know how to get past this one
+		if (memberLen == 0)
+			goto DONE;
+
+		pos += memberLen;
+
+		switch (member.leaf)
 		{
 		case LEAF_TYPE_MEMBER:
-			remainingLen -= remainingLen;
+			printf("+0x%llx %s type=%x\n", (unsigned long long)member.offset, member.name, member.type);
 			break;
 		case LEAF_TYPE_ENUMERATE:
-			val = (uint32_t)(*(uint16_t*)pbuff);
-			pbuff += sizeof(uint16_t);
-			remainingLen -= sizeof(uint16_t);
-
-			// If the high bit is set, this isn't simply the enum value
-			if (val & 0x8000)
-			{
-				// These are all the values I encountered...
-				switch (val & 0x7ff)
-				{
-				case 0:
-					// A single byte follows that is repeated through the dword
-					val = ((*(uint8_t*)pbuff) | ((*(uint8_t*)pbuff) << 8) | ((*(uint8_t*)pbuff) << 16) | ((*(uint8_t*)pbuff) << 24));
-					pbuff += sizeof(uint8_t);
-					remainingLen -= sizeof(uint8_t);
-					break;
-				case 1:
-					break;
-				case 2:
-					// The value is a word, promote to dword
-					val = (uint32_t)(*(uint16_t*)pbuff);
-					pbuff += sizeof(uint16_t);
-					remainingLen -= sizeof(uint16_t);
-					break;
-				case 3:
-					// The value that follows is a dword
-					val = *(uint32_t*)pbuff;
-					pbuff += sizeof(uint32_t);
-					remainingLen -= sizeof(uint32_t);
-					break;
-				case 4:
-					// The value that follows is a dword
-					val = *(uint32_t*)pbuff;
-					pbuff += sizeof(uint32_t);
-					remainingLen -= sizeof(uint32_t);
-					break;
-				default:
-					break;
-				}
-			}
-
-			name = (char*)pbuff;
-			nameLen = strlen(name) + 1;
-			nameLen = (nameLen > remainingLen ? remainingLen : nameLen);
-			remainingLen -= nameLen;
-			pbuff += nameLen;
-			printf("%d:%s = %d\n", typeId, name, val);
-			break;
-		case LEAF_TYPE_UNION:
-			remainingLen -= remainingLen;
-			break;
-		case LEAF_TYPE_BITFIELD:
-			remainingLen -= remainingLen;
+			printf("%s = %lld\n", member.name, (long long)member.offset);
 			break;
 		case LEAF_TYPE_BCLASS:
-			remainingLen -= remainingLen;
+			printf("+0x%llx base type=%x\n", (unsigned long long)member.offset, member.type);
+			break;
+		case LEAF_TYPE_VBCLASS:
+		case LEAF_TYPE_IVBCLASS:
+			printf("virtual base type=%x vbptr=+0x%llx index=%llu\n", member.type,
+				(unsigned long long)member.offset, (unsigned long long)member.vbindex);
 			break;
 		case LEAF_TYPE_VFUNCTAB:
-			remainingLen -= remainingLen;
+			printf("+0x0 vfptr type=%x\n", member.type);
+			break;
+		case LEAF_TYPE_STMEMBER:
+			printf("static %s type=%x\n", member.name, member.type);
 			break;
 		case LEAF_TYPE_ONEMETHOD:
-			remainingLen -= remainingLen;
+			printf("method %s type=%x\n", member.name, member.type);
 			break;
 		case LEAF_TYPE_METHOD:
-			remainingLen -= remainingLen;
+			printf("method %s overloads=%llu list=%x\n", member.name, (unsigned long long)member.offset, member.type);
 			break;
 		case LEAF_TYPE_NESTTYPE:
-			remainingLen -= remainingLen;
+		case LEAF_TYPE_NESTTYPEEX:
+			printf("nested %s type=%x\n", member.name, member.type);
+			break;
+		case LEAF_TYPE_INDEX:
+			// The list continues in another record.  It can only be read by
+			// index once the offsets are known, ie. not during an enumeration.
+			if (!types->offsets)
+			{
+				printf("continued in %x\n", member.type);
+				break;
+			}
+
+			// A list continued in itself would never end
+			if (++lists > PDB_TYPES_MAX_LISTS)
+				goto DONE;
+
+			if (!PdbTypesReadRecord(types, member.type, &leaf, &recordLen)
+				|| (leaf != LEAF_TYPE_FIELDLIST))
+				goto DONE;
+
+			buff = types->record + 2;
+			len = recordLen;
+			pos = 0;
+			break;
+		default:
+			printf("leaf=%x type=%x\n", (uint32_t)member.leaf, member.type);
+			break;
+		}
+	}
+
+	result = true;
+
+DONE:
+	if (!PdbCursorSeek(&types->cursor, resume))
+		return false;
+
+	return result;
+}
+
+
+// The decoders below are written once and inlined with and without their
+// bounds checks.  The unchecked copies are only for records of a stream that
+// passed validation (see PdbTypesValidateRecord), where every length has
+// already been checked once.
+
+// Decode a numeric leaf, returning the bytes consumed or 0 if it isn't one
+// that can be represented in 64 bits
+static inline size_t ReadNumeric(const uint8_t* buff, size_t len, uint64_t* value, bool checked)
+{
+	uint16_t leaf;
+
+	if (checked && (len < 2))
+		return 0;
+
+	leaf = *(uint16_t*)buff;
+
+	// Small values are stored directly
+	if (leaf < LEAF_TYPE_NUMERIC)
+	{
+		*value = leaf;
+		return 2;
+	}
+
+	switch (leaf)
+	{
+	case LEAF_TYPE_CHAR:
+		if (checked && (len < 3))
+			return 0;
+		*value = (uint64_t)(int64_t)*(int8_t*)(buff + 2);
+		return 3;
+	case LEAF_TYPE_SHORT:
+		if (checked && (len < 4))
+			return 0;
+		*value = (uint64_t)(int64_t)*(int16_t*)(buff + 2);
+		return 4;
+	case LEAF_TYPE_USHORT:
+		if (checked && (len < 4))
+			return 0;
+		*value = *(uint16_t*)(buff + 2);
+		return 4;
+	case LEAF_TYPE_LONG:
+		if (checked && (len < 6))
+			return 0;
+		*value = (uint64_t)(int64_t)*(int32_t*)(buff + 2);
+		return 6;
+	case LEAF_TYPE_ULONG:
+		if (checked && (len < 6))
+			return 0;
+		*value = *(uint32_t*)(buff + 2);
+		return 6;
+	case LEAF_TYPE_QUADWORD:
+	case LEAF_TYPE_UQUADWORD:
+		if (checked && (len < 10))
+			return 0;
+		*value = *(uint64_t*)(buff + 2);
+		return 10;
+	default:
+		return 0;
+	}
+}
+
+
+size_t PdbTypesReadNumeric(const uint8_t* buff, size_t len, uint64_t* value)
+{
+	return ReadNumeric(buff, len, value, true);
+}
+
+
+// The numeric leaves that carry their value after the leaf, for
+// PdbCursorReadNumeric
+bool PdbCursorReadNumericSlow(PDB_CURSOR* cursor, uint64_t* value)
+{
+	uint64_t left = cursor->size - PdbCursorTell(cursor);
+	uint32_t want = (left < 10) ? (uint32_t)left : 10; // The longest is a quadword
+	size_t used;
+
+	if ((cursor->len - cursor->pos < want) && !PdbCursorFill(cursor, want))
+		return false;
+
+	if (cursor->len == cursor->pos)
+		return false;
+
+	used = PdbTypesReadNumeric(cursor->data + cursor->pos, cursor->len - cursor->pos, value);
+	if (!used)
+		return false;
+
+	cursor->pos += (uint32_t)used;
+
+	return true;
+}
+
+
+// Pull the interesting bits out of a struct, class, union or enum record.
+// buff and len describe the data following the leaf.
+static inline bool ParseUdt(uint16_t leaf, const uint8_t* buff, size_t len, PDB_TYPE_UDT* udt, const char** name, bool checked)
+{
+	size_t pos;
+	size_t numLen;
+
+	udt->leaf = (PDB_LEAF_TYPES)leaf;
+	udt->derived = 0;
+	udt->vshape = 0;
+	udt->utype = 0;
+
+	switch (leaf)
+	{
+	case LEAF_TYPE_CLASS:
+	case LEAF_TYPE_STRUCTURE:
+	case LEAF_TYPE_INTERFACE:
+		// count, prop, field, derived, vshape, size, name
+		if (checked && (len < 16))
+			return false;
+		udt->count = *(uint16_t*)buff;
+		udt->prop = *(uint16_t*)(buff + 2);
+		udt->field = *(uint32_t*)(buff + 4);
+		udt->derived = *(uint32_t*)(buff + 8);
+		udt->vshape = *(uint32_t*)(buff + 12);
+		pos = 16;
+		break;
+	case LEAF_TYPE_UNION:
+		// count, prop, field, size, name
+		if (checked && (len < 8))
+			return false;
+		udt->count = *(uint16_t*)buff;
+		udt->prop = *(uint16_t*)(buff + 2);
+		udt->field = *(uint32_t*)(buff + 4);
+		pos = 8;
+		break;
+	case LEAF_TYPE_ENUM:
+		// count, prop, utype, field, name (no size, it's the underlying type's)
+		if (checked && (len < 12))
+			return false;
+		udt->count = *(uint16_t*)buff;
+		udt->prop = *(uint16_t*)(buff + 2);
+		udt->utype = *(uint32_t*)(buff + 4);
+		udt->field = *(uint32_t*)(buff + 8);
+		udt->size = 0;
+		*name = (const char*)(buff + 12);
+		return (!checked || (memchr(buff + 12, 0, len - 12) != NULL));
+	default:
+		return false;
+	}
+
+	numLen = ReadNumeric(buff + pos, len - pos, &udt->size, checked);
+	if (numLen == 0)
+		return false;
+	pos += numLen;
+
+	// Make sure the name is terminated within the record
+	if (checked && ((pos >= len) || (memchr(buff + pos, 0, len - pos) == NULL)))
+		return false;
+
+	*name = (const char*)(buff + pos);
+
+	return true;
+}
+
+
+bool PdbTypesParseUdt(uint16_t leaf, const uint8_t* buff, size_t len, PDB_TYPE_UDT* udt, const char** name)
+{
+	return ParseUdt(leaf, buff, len, udt, name, true);
+}
+
+
+bool PdbTypesParseUdtUnchecked(uint16_t leaf, const uint8_t* buff, size_t len, PDB_TYPE_UDT* udt, const char** name)
+{
+	return ParseUdt(leaf, buff, len, udt, name, false);
+}
+
+
+bool PdbTypesParseUdtDefinition(uint16_t leaf, const uint8_t* buff, size_t len, PDB_TYPE_UDT* udt,
+	const char** name)
+{
+	if ((leaf != LEAF_TYPE_STRUCTURE) && (leaf != LEAF_TYPE_CLASS) && (leaf != LEAF_TYPE_INTERFACE)
+		&& (leaf != LEAF_TYPE_UNION) && (leaf != LEAF_TYPE_ENUM))
+		return false;
+
+	return ParseUdt(leaf, buff, len, udt, name, true) && !(udt->prop & PDB_TYPE_PROP_FWDREF);
+}
+
+
+// Read a name at buff, making sure it is terminated within the record
+static inline size_t ReadMemberName(const uint8_t* buff, size_t len, const char** name, bool checked)
+{
+	const uint8_t* end = checked ? (const uint8_t*)memchr(buff, 0, len) : (buff + strlen((const char*)buff));
+
+	if (!end)
+		return 0;
+
+	*name = (const char*)buff;
+
+	return (size_t)(end - buff) + 1;
+}
+
+
+static inline size_t ParseMember(const uint8_t* buff, size_t len, PDB_TYPE_MEMBER* member, bool checked)
+{
+	size_t pos = 4;
+	size_t numLen;
+	size_t nameLen;
+	bool hasName = true;
+
+	memset(member, 0, sizeof(PDB_TYPE_MEMBER));
+
+	// Every entry starts with its leaf and an attribute (or padding) word
+	if (checked && (len < 4))
+		return 0;
+
+	member->leaf = (PDB_LEAF_TYPES)*(uint16_t*)buff;
+	member->attr = *(uint16_t*)(buff + 2);
+
+	switch (member->leaf)
+	{
+	case LEAF_TYPE_MEMBER:
+	case LEAF_TYPE_BCLASS:
+		// type, offset, name (base classes have no name)
+		if (checked && (len < pos + 4))
+			return 0;
+		member->type = *(uint32_t*)(buff + pos);
+		pos += 4;
+		numLen = ReadNumeric(buff + pos, len - pos, &member->offset, checked);
+		if (numLen == 0)
+			return 0;
+		pos += numLen;
+		hasName = (member->leaf == LEAF_TYPE_MEMBER);
+		break;
+	case LEAF_TYPE_VBCLASS:
+	case LEAF_TYPE_IVBCLASS:
+		// base type, vbptr type, vbptr offset, vbtable index
+		if (checked && (len < pos + 8))
+			return 0;
+		member->type = *(uint32_t*)(buff + pos);
+		member->vbptr = *(uint32_t*)(buff + pos + 4);
+		pos += 8;
+		numLen = ReadNumeric(buff + pos, len - pos, &member->offset, checked);
+		if (numLen == 0)
+			return 0;
+		pos += numLen;
+		numLen = ReadNumeric(buff + pos, len - pos, &member->vbindex, checked);
+		if (numLen == 0)
+			return 0;
+		pos += numLen;
+		hasName = false;
+		break;
+	case LEAF_TYPE_ENUMERATE:
+		// value, name
+		numLen = ReadNumeric(buff + pos, len - pos, &member->offset, checked);
+		if (numLen == 0)
+			return 0;
+		pos += numLen;
+		break;
+	case LEAF_TYPE_METHOD:
+		// The attribute word is the overload count, then the method list
+		if (checked && (len < pos + 4))
+			return 0;
+		member->offset = member->attr;
+		member->attr = 0;
+		member->type = *(uint32_t*)(buff + pos);
+		pos += 4;
+		break;
+	case LEAF_TYPE_ONEMETHOD:
+		// type, vtable offset for intro virtuals, name
+		if (checked && (len < pos + 4))
+			return 0;
+		member->type = *(uint32_t*)(buff + pos);
+		pos += 4;
+		if ((PDB_TYPE_ATTR_MPROP(member->attr) == PDB_TYPE_MPROP_INTRO)
+			|| (PDB_TYPE_ATTR_MPROP(member->attr) == PDB_TYPE_MPROP_PUREINTRO))
+		{
+			if (checked && (len < pos + 4))
+				return 0;
+			member->offset = *(uint32_t*)(buff + pos);
+			pos += 4;
+		}
+		break;
+	case LEAF_TYPE_STMEMBER:
+	case LEAF_TYPE_NESTTYPE:
+	case LEAF_TYPE_NESTTYPEEX:
+	case LEAF_TYPE_MEMBERMODIFY:
+	case LEAF_TYPE_FRIENDFCN:
+		// type, name
+		if (checked && (len < pos + 4))
+			return 0;
+		member->type = *(uint32_t*)(buff + pos);
+		pos += 4;
+		break;
+	case LEAF_TYPE_VFUNCTAB:
+	case LEAF_TYPE_FRIENDCLS:
+	case LEAF_TYPE_INDEX:
+		// Just a type (INDEX continues the list in another record)
+		if (checked && (len < pos + 4))
+			return 0;
+		member->type = *(uint32_t*)(buff + pos);
+		pos += 4;
+		hasName = false;
+		break;
+	case LEAF_TYPE_VFUNCOFF:
+		// type, offset
+		if (checked && (len < pos + 8))
+			return 0;
+		member->type = *(uint32_t*)(buff + pos);
+		member->offset = *(uint32_t*)(buff + pos + 4);
+		pos += 8;
+		hasName = false;
+		break;
+	default:
+		// Can't know how long it is, so the rest of the list is lost
+		return 0;
+	}
+
+	if (hasName)
+	{
+		nameLen = ReadMemberName(buff + pos, len - pos, &member->name, checked);
+		if (nameLen == 0)
+			return 0;
+		pos += nameLen;
+	}
+
+	// Entries are padded to 4 bytes with LF_PAD bytes giving the distance
+	// to the next one
+	if ((pos < len) && (buff[pos] > 0xf0))
+	{
+		size_t skip = buff[pos] & 0xf;
+
+		if (skip == 0)
+			return 0;
+
+		pos += skip;
+		if (pos > len)
+			pos = len;
+	}
+
+	return pos;
+}
+
+
+size_t PdbTypesParseMember(const uint8_t* buff, size_t len, PDB_TYPE_MEMBER* member)
+{
+	return ParseMember(buff, len, member, true);
+}
+
+
+size_t PdbTypesParseMemberUnchecked(const uint8_t* buff, size_t len, PDB_TYPE_MEMBER* member)
+{
+	return ParseMember(buff, len, member, false);
+}
+
+
+typedef struct PDB_SIMPLE_TYPE
+{
+	uint8_t kind;
+	uint8_t size;
+	const char* name;
+} PDB_SIMPLE_TYPE;
+
+// The basic types that show up in PDBs, Ch 4 of "Microsoft Symbol and Type
+// Information" plus the newer character types
+static const PDB_SIMPLE_TYPE g_simpleTypes[] =
+{
+	{ 0x00, 0, "<notype>" },
+	{ 0x03, 0, "void" },
+	{ 0x08, 4, "HRESULT" },
+	{ 0x10, 1, "signed char" },
+	{ 0x11, 2, "short" },
+	{ 0x12, 4, "long" },
+	{ 0x13, 8, "__int64" },
+	{ 0x14, 16, "__int128" },
+	{ 0x20, 1, "unsigned char" },
+	{ 0x21, 2, "unsigned short" },
+	{ 0x22, 4, "unsigned long" },
+	{ 0x23, 8, "unsigned __int64" },
+	{ 0x24, 16, "unsigned __int128" },
+	{ 0x30, 1, "bool" },
+	{ 0x31, 2, "__bool16" },
+	{ 0x32, 4, "__bool32" },
+	{ 0x33, 8, "__bool64" },
+	{ 0x40, 4, "float" },
+	{ 0x41, 8, "double" },
+	{ 0x42, 10, "long double" },
+	{ 0x43, 16, "__float128" },
+	{ 0x44, 6, "__float48" },
+	{ 0x46, 2, "__half" },
+	{ 0x68, 1, "__int8" },
+	{ 0x69, 1, "unsigned __int8" },
+	{ 0x70, 1, "char" },
+	{ 0x71, 2, "wchar_t" },
+	{ 0x72, 2, "__int16" },
+	{ 0x73, 2, "unsigned __int16" },
+	{ 0x74, 4, "int" },
+	{ 0x75, 4, "unsigned int" },
+	{ 0x76, 8, "__int64" },
+	{ 0x77, 8, "unsigned __int64" },
+	{ 0x78, 16, "__int128" },
+	{ 0x79, 16, "unsigned __int128" },
+	{ 0x7a, 2, "char16_t" },
+	{ 0x7b, 4, "char32_t" },
+	{ 0x7c, 1, "char8_t" }
+};
+
+
+static const PDB_SIMPLE_TYPE* GetSimpleType(uint32_t typeId)
+{
+	size_t i;
+
+	if (typeId >= PDB_TYPE_SIMPLE_MAX)
+		return NULL;
+
+	for (i = 0; i < sizeof(g_simpleTypes) / sizeof(g_simpleTypes[0]); i++)
+	{
+		if (g_simpleTypes[i].kind == PDB_TYPE_SIMPLE_KIND(typeId))
+			return &g_simpleTypes[i];
+	}
+
+	return NULL;
+}
+
+
+const char* PdbTypesGetSimpleName(uint32_t typeId)
+{
+	const PDB_SIMPLE_TYPE* simple = GetSimpleType(typeId);
+
+	return simple ? simple->name : NULL;
+}
+
+
+uint32_t PdbTypesGetSimpleSize(uint32_t typeId)
+{
+	const PDB_SIMPLE_TYPE* simple = GetSimpleType(typeId);
+
+	if (!simple)
+		return 0;
+
+	// Pointer modes: near, far, huge, 32 bit, 16:32, 64 bit, 128 bit
+	switch (PDB_TYPE_SIMPLE_MODE(typeId))
+	{
+	case 0:
+		return simple->size;
+	case 1:
+		return 2;
+	case 2:
+	case 3:
+	case 4:
+		return 4;
+	case 5:
+		return 6;
+	case 6:
+		return 8;
+	default:
+		return 16;
+	}
+}
+
+
+// Read the record of typeId into the scratch buffer, returning its leaf and
+// the length of the data after the leaf
+static bool PdbTypesReadRecord(PDB_TYPES* types, uint32_t typeId, uint16_t* leaf, uint16_t* len)
+{
+	uint16_t recordLen;
+
+	if ((typeId < types->minId) || (typeId >= types->maxId))
+		return false;
+
+	if (!PdbCursorSeek(&types->cursor, types->offsets[typeId - types->minId]))
+		return false;
+
+	if (!PdbCursorReadU16(&types->cursor, &recordLen))
+		return false;
+
+	if (recordLen < 2)
+		return false;
+
+	if (!PdbCursorRead(&types->cursor, types->record, recordLen))
+		return false;
+
+	*leaf = *(uint16_t*)types->record;
+	*len = recordLen - 2;
+
+	// Keep strings in the record terminated even if the file is broken
+	types->record[recordLen] = 0;
+
+	return true;
+}
+
+
+// Check that the decoders can take a record without their bounds checks,
+// and that the type indices it refers to exist.  typeId is the record's own.
+static bool PdbTypesValidateRecord(PDB_TYPES* types, uint32_t typeId, const uint8_t* record, uint16_t recordLen)
+{
+	const uint8_t* data = record + 2;
+	size_t len = (size_t)recordLen - 2;
+	size_t pos = 0;
+	uint16_t leaf;
+	PDB_TYPE_UDT udt;
+	PDB_TYPE_MEMBER member;
+	const char* name;
+	uint64_t size;
+
+	if (recordLen < 2)
+		return false;
+
+	leaf = *(uint16_t*)record;
+
+	switch (leaf)
+	{
+	case LEAF_TYPE_CLASS:
+	case LEAF_TYPE_STRUCTURE:
+	case LEAF_TYPE_INTERFACE:
+	case LEAF_TYPE_UNION:
+	case LEAF_TYPE_ENUM:
+		if (!PdbTypesParseUdt(leaf, data, len, &udt, &name))
+			return false;
+		return (udt.field < types->maxId) && (udt.derived < types->maxId)
+			&& (udt.vshape < types->maxId) && (udt.utype < types->maxId);
+	case LEAF_TYPE_FIELDLIST:
+		// Every entry has to decode, up to the end of the record or the
+		// padding after the last one
+		while (pos < len)
+		{
+			size_t memberLen;
+
+			if ((len - pos < 4) && (data[pos] > 0xf0))
+				return ((data[pos] & 0xf) == len - pos);
+
+			memberLen = PdbTypesParseMember(data + pos, len - pos, &member);
+
+			if ((memberLen == 0) || (member.type >= types->maxId) || (member.vbptr >= types->maxId))
+				return false;
+
+			// Lists only continue in an earlier record, so chains end
+			if ((member.leaf == LEAF_TYPE_INDEX) && ((member.type < types->minId) || (member.type >= typeId)))
+				return false;
+
+			pos += memberLen;
+		}
+		return true;
+	case LEAF_TYPE_ARRAY:
+		// element type, index type, size, name
+		return (len >= 8) && (*(uint32_t*)data < types->maxId) && (*(uint32_t*)(data + 4) < types->maxId)
+			&& (PdbTypesReadNumeric(data + 8, len - 8, &size) != 0);
+	default:
+		// Opaque to the decoders
+		return true;
+	}
+}
+
+
+// One pass over the records to remember where each one starts, so that
+// records can be read by type index.  The records are validated on the way
+// since they pass through the window anyway.
+static bool PdbTypesLoadOffsets(PDB_TYPES* types)
+{
+	uint32_t typeCount = types->maxId - types->minId;
+	uint32_t offset = types->headerSize;
+	uint32_t end = types->headerSize + types->len;
+	uint32_t i;
+	bool result = true;
+	bool validated = true;
+
+	if (types->offsets)
+		return true;
+
+	if (types->maxId < types->minId)
+		return false;
+
+	types->offsets = (uint32_t*)malloc(sizeof(uint32_t) * (typeCount + 1));
+
+	// Records are at most 0xffff bytes, plus room for a terminator
+	if (!types->record)
+		types->record = (uint8_t*)malloc(0x10001);
+
+	if (typeCount && !PdbCursorSeek(&types->cursor, offset))
+		result = false;
+
+	PdbStreamSetAccess(types->stream, PDB_ACCESS_SEQUENTIAL);
+
+	for (i = 0; result && (i < typeCount); i++)
+	{
+		uint16_t recordLen;
+		const uint8_t* record;
+
+		if ((offset + 2 > end) || !PdbCursorReadU16(&types->cursor, &recordLen))
+		{
+			result = false;
 			break;
 		}
 
-		// Bypass padding bytes
-		while ((remainingLen > 0) && (*pbuff > 0xf0))
+		types->offsets[i] = offset;
+		offset += 2 + recordLen;
+
+		if (offset > end)
 		{
-			skip = (*pbuff & 0xf);
-			pbuff += skip;
-			remainingLen -= skip;
+			result = false;
 		}
+		else if (!validated)
+		{
+			result = PdbCursorSkip(&types->cursor, recordLen);
+		}
+		else if ((record = PdbCursorPeek(&types->cursor, recordLen)) != NULL)
+		{
+			validated = PdbTypesValidateRecord(types, types->minId + i, record, recordLen);
+			result = PdbCursorSkip(&types->cursor, recordLen);
+		}
+		else
+		{
+			// Bigger than the window, check a copy
+			result = PdbCursorRead(&types->cursor, types->record, recordLen);
+			validated = result && PdbTypesValidateRecord(types, types->minId + i, types->record, recordLen);
+		}
+	}
+
+	PdbStreamEndAccess(types->stream);
+
+	types->validated = result && validated;
+
+	if (!result)
+	{
+		free(types->offsets);
+		types->offsets = NULL;
 	}
 
+	return result;
+}
+
+
+// Read the hash values from the hash stream and chain the types in each bucket
+static bool PdbTypesLoadBuckets(PDB_TYPES* types)
+{
+	uint32_t typeCount = types->maxId - types->minId;
+	uint32_t* values;
+	uint32_t i;
+
+	if (types->bucketHeads)
+		return true;
+
+	// Only 4 byte hash values are supported (VC7 and later)
+	if (!types->hash || (types->hash->keySize != 4) || (types->hash->buckets == 0))
+		return false;
+
+	if (types->hash->values.size < (typeCount * 4))
+		return false;
+
+	values = (uint32_t*)malloc(sizeof(uint32_t) * (typeCount + 1));
+
+	if (!PdbStreamSeek(types->hash->stream, types->hash->values.offset)
+		|| !PdbStreamRead(types->hash->stream, (uint8_t*)values, (uint64_t)typeCount * 4))
+	{
+		free(values);
+		return false;
+	}
+
+	types->bucketHeads = (uint32_t*)calloc(types->hash->buckets, sizeof(uint32_t));
+	types->bucketNext = (uint32_t*)calloc(typeCount + 1, sizeof(uint32_t));
+
+	// Push in reverse so each chain is in type index order
+	for (i = typeCount; i > 0; i--)
+	{
+		uint32_t bucket = values[i - 1];
+
+		if (bucket >= types->hash->buckets)
+			continue;
+
+		types->bucketNext[i - 1] = types->bucketHeads[bucket];
+		types->bucketHeads[bucket] = i;
+	}
+
+	free(values);
+
 	return true;
 }
 
 
-bool PdbTypesPrint(PDB_TYPES* types, const char* name, PdbTypeEnumFunction typeFn)
+bool PdbTypesValidate(PDB_TYPES* types)
+{
+	return PdbTypesLoadOffsets(types) && types->validated;
+}
+
+
+bool PdbTypesGetRecord(PDB_TYPES* types, uint32_t typeId, uint16_t* leaf, const uint8_t** data, uint16_t* len)
+{
+	if (!PdbTypesLoadOffsets(types))
+		return false;
+
+	if (!PdbTypesReadRecord(types, typeId, leaf, len))
+		return false;
+
+	*data = types->record + 2;
+
+	return true;
+}
+
+
+bool PdbTypesFind(PDB_TYPES* types, const char* name, PDB_TYPE_UDT* udt)
 {
-	uint32_t typeHash;
 	uint32_t bucket;
+	uint32_t entry;
+
+	if (!PdbTypesLoadOffsets(types) || !PdbTypesLoadBuckets(types))
+		return false;
+
+	bucket = PdbHashName(name) % types->hash->buckets;
+
+	// Walk the types that hashed to this bucket looking for the definition
+	for (entry = types->bucketHeads[bucket]; entry; entry = types->bucketNext[entry - 1])
+	{
+		uint16_t leaf;
+		uint16_t len;
+		const char* typeName;
+
+		if (!PdbTypesReadRecord(types, types->minId + entry - 1, &leaf, &len))
+			return false;
+
+		if (types->validated ? !PdbTypesParseUdtUnchecked(leaf, types->record + 2, len, udt, &typeName)
+			: !PdbTypesParseUdt(leaf, types->record + 2, len, udt, &typeName))
+			continue;
 
-	typeHash = CalcTypeHash(name);
-	bucket = typeHash % types->hash->buckets;
+		// Skip forward references, the caller wants the real thing
+		if (udt->prop & PDB_TYPE_PROP_FWDREF)
+			continue;
+
+		if (strcmp(typeName, name) == 0)
+		{
+			udt->typeId = types->minId + entry - 1;
+			return true;
+		}
+	}
 
 	return false;
 }
 
 
-bool PdbTypesEnumerate(PDB_TYPES* types, PdbTypeEnumFunction typeFn)
+bool PdbTypesPrint(PDB_TYPES* types, const char* name, PdbTypeEnumFunction typeFn)
+{
+	PDB_TYPE_UDT udt;
+	uint16_t leaf;
+	uint16_t len;
+
+	if (!PdbTypesFind(types, name, &udt))
+		return false;
+
+	// Print the type itself...
+	if (!PdbTypesReadRecord(types, udt.typeId, &leaf, &len))
+		return false;
+
+	if ((leaf == LEAF_TYPE_STRUCTURE) || (leaf == LEAF_TYPE_CLASS))
+		PrintStructureType(types, typeFn, leaf, types->record + 2, len);
+	else
+		printf("%s %s count=%x prop=%x field=%x size=%llx\n",
+			(leaf == LEAF_TYPE_ENUM) ? "enum" : "union", name, (uint32_t)udt.count,
+			(uint32_t)udt.prop, udt.field, (unsigned long long)udt.size);
+
+	// ...and then its members
+	if (!udt.field)
+		return true;
+
+	if (!PdbTypesReadRecord(types, udt.field, &leaf, &len))
+		return false;
+
+	if (leaf != LEAF_TYPE_FIELDLIST)
+		return false;
+
+	return PrintFieldList(types, typeFn, types->record + 2, len);
+}
+
+
+static bool PdbTypesEnumerateRecords(PDB_TYPES* types, PdbTypeEnumFunction typeFn)
 {
 	uint16_t type;
 	uint32_t len = types->len;
@@ -445,7 +1183,7 @@ bool PdbTypesEnumerate(PDB_TYPES* types, PdbTypeEnumFunction typeFn)
 	uint32_t i;
 
 	// Seek to the beginning of all types
-	if (!PdbStreamSeek(types->stream, types->headerSize))
+	if (!PdbCursorSeek(&types->cursor, types->headerSize))
 		return false;
 
 	// Calculate the number of types we expect in the stream
@@ -463,17 +1201,17 @@ bool PdbTypesEnumerate(PDB_TYPES* types, PdbTypeEnumFunction typeFn)
 			return false;
 		}
 
-		if (!PdbStreamRead(types->stream, (uint8_t*)&typeLen, 2))
+		if (!PdbCursorReadU16(&types->cursor, &typeLen) || (typeLen < 2))
 			return false;
 
 		// Get the type type (LEAF_TYPE_?)
-		if (!PdbStreamRead(types->stream, (uint8_t*)&type, 2))
+		if (!PdbCursorReadU16(&types->cursor, &type))
 			return false;
 
 		buff = (uint8_t*)malloc(typeLen);
 
 		// Read the data associated with the type type
-		if (!PdbStreamRead(types->stream, buff, typeLen - 2))
+		if (!PdbCursorRead(&types->cursor, buff, typeLen - 2))
 		{
 			free(buff);
 			return false;
@@ -482,7 +1220,7 @@ bool PdbTypesEnumerate(PDB_TYPES* types, PdbTypeEnumFunction typeFn)
 		switch (type)
 		{
 		case LEAF_TYPE_STRUCTURE:
-			PrintStructureType(types, typeFn, buff, typeLen - 2);
+			PrintStructureType(types, typeFn, type, buff, typeLen - 2);
 			break;
 		case LEAF_TYPE_POINTER:
 			printf("POINTER TYPE\n");
@@ -499,11 +1237,24 @@ bool PdbTypesEnumerate(PDB_TYPES* types, PdbTypeEnumFunction typeFn)
 			break;
 		case LEAF_TYPE_ENUM:
 			{
-				char* name = buff + 0xc;
-				char* tag = ((0x0e + strlen(name) + 1) < ((size_t)(typeLen - 2))) ? (name + strlen(name) + 1) : NULL; //(name + strlen(name) + 1) : NULL);
-				uint16_t count = *(uint16_t*)(buff + 2); 
-				uint32_t idx = *(uint32_t*)(buff + 8);
-				printf("ENUM name=%s tag=%s %d members fieldlist idx=%.04x\n", name, tag, count, idx);
+				PDB_TYPE_UDT udt;
+				const char* name;
+				const char* tag = NULL;
+				size_t tagPos;
+
+				if (types->validated ? !PdbTypesParseUdtUnchecked(type, buff, typeLen - 2, &udt, &name)
+					: !PdbTypesParseUdt(type, buff, typeLen - 2, &udt, &name))
+				{
+					printf("ENUM (malformed)\n");
+					break;
+				}
+
+				// The unique name follows, if there's more than padding left
+				tagPos = (name - (const char*)buff) + strlen(name) + 1;
+				if ((tagPos + 2 < (size_t)(typeLen - 2)) && memchr(buff + tagPos, 0, (typeLen - 2) - tagPos))
+					tag = (const char*)buff + tagPos;
+
+				printf("ENUM name=%s tag=%s %d members fieldlist idx=%.04x\n", name, tag, udt.count, udt.field);
 			}
 			break;
 		case LEAF_TYPE_ARRAY:
@@ -547,9 +1298,153 @@ bool PdbTypesEnumerate(PDB_TYPES* types, PdbTypeEnumFunction typeFn)
 }
 
 
+bool PdbTypesEnumerate(PDB_TYPES* types, PdbTypeEnumFunction typeFn)
+{
+	bool result;
+	uint64_t start = PdbTimeNow();
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_BEGIN, "PdbTypesEnumerate", 0, 0);
+
+	// The records are read front to back, so prefetch the type stream's page
+	// runs ahead of the walk and release them when done
+	PdbStreamSetAccess(types->stream, PDB_ACCESS_SEQUENTIAL);
+	result = PdbTypesEnumerateRecords(types, typeFn);
+	PdbStreamEndAccess(types->stream);
+
+	PdbStatsAddTime(PdbStreamGetPdb(types->stream), PDB_SUBSYSTEM_TPI, start);
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_END, "PdbTypesEnumerate", 0, 0);
+
+	return result;
+}
+
+
+static bool PdbTypesWalkRecords(PDB_TYPES* types, PdbTypeRecordFunction recordFn, void* ctxt)
+{
+	uint32_t typeCount = PdbTypesGetCount(types);
+	uint64_t streamLeft = types->len;
+	uint8_t* buff;
+	size_t pos = 0;
+	size_t avail = 0;
+	uint32_t i;
+	bool result = true;
+
+	if (!PdbCursorSeek(&types->cursor, types->headerSize))
+		return (typeCount == 0);
+
+	// One extra byte to terminate the record handed to the callback
+	buff = (uint8_t*)malloc(PDB_TYPES_WALK_BUFFER + 1);
+	if (!buff)
+		return false;
+
+	for (i = 0; result && (i < typeCount); i++)
+	{
+		uint16_t recordLen;
+		uint8_t* record;
+		uint8_t saved;
+
+		// Top up the buffer whenever the next record might not be all there.
+		// Records are at most 0xffff + 2 bytes so one always fits.
+		if ((avail < 2) || (avail < (size_t)2 + *(uint16_t*)(buff + pos)))
+		{
+			size_t fill = PDB_TYPES_WALK_BUFFER - avail;
+
+			memmove(buff, buff + pos, avail);
+			pos = 0;
+
+			if (fill > streamLeft)
+				fill = (size_t)streamLeft;
+
+			if (fill && !PdbCursorRead(&types->cursor, buff + avail, fill))
+			{
+				result = false;
+				break;
+			}
+
+			avail += fill;
+			streamLeft -= fill;
+
+			if (avail < 2)
+			{
+				result = false;
+				break;
+			}
+		}
+
+		recordLen = *(uint16_t*)(buff + pos);
+		if ((recordLen < 2) || ((size_t)2 + recordLen > avail))
+		{
+			result = false;
+			break;
+		}
+
+		record = buff + pos + 2;
+
+		// Terminate the record in place, it may be the next record's length
+		saved = record[recordLen];
+		record[recordLen] = 0;
+
+		result = recordFn(ctxt, types->minId + i, *(uint16_t*)record, record + 2, recordLen - 2);
+
+		record[recordLen] = saved;
+
+		pos += (size_t)2 + recordLen;
+		avail -= (size_t)2 + recordLen;
+	}
+
+	free(buff);
+
+	return result;
+}
+
+
+bool PdbTypesWalk(PDB_TYPES* types, PdbTypeRecordFunction recordFn, void* ctxt)
+{
+	bool result;
+	uint64_t start = PdbTimeNow();
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_BEGIN, "PdbTypesWalk", 0, 0);
+
+	PdbStreamSetAccess(types->stream, PDB_ACCESS_SEQUENTIAL);
+	result = PdbTypesWalkRecords(types, recordFn, ctxt);
+	PdbStreamEndAccess(types->stream);
+
+	PdbStatsAddTime(PdbStreamGetPdb(types->stream), PDB_SUBSYSTEM_TPI, start);
+
+	if (PDB_TRACING())
+		PdbTraceEmit(PDB_TRACE_END, "PdbTypesWalk", 0, 0);
+
+	return result;
+}
+
+
 uint32_t PdbTypesGetCount(PDB_TYPES* types)
 {
-	return 0;
+	if (types->maxId < types->minId)
+		return 0;
+
+	return types->maxId - types->minId;
+}
+
+
+uint32_t PdbTypesGetMinId(PDB_TYPES* types)
+{
+	return types->minId;
+}
+
+
+uint32_t PdbTypesGetMaxId(PDB_TYPES* types)
+{
+	return types->maxId;
+}
+
+
+PDB_FILE* PdbTypesGetPdb(PDB_TYPES* types)
+{
+	return PdbStreamGetPdb(types->stream);
 }
 
 
@@ -558,6 +1453,10 @@ void PdbTypesClose(PDB_TYPES* types)
 	if (types->hash)
 		PdbTypesHashClose(types->hash);
 	PdbStreamClose(types->stream);
+	free(types->offsets);
+	free(types->bucketHeads);
+	free(types->bucketNext);
+	free(types->record);
 	free(types);
 }
 
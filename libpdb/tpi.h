@@ -152,6 +152,23 @@ enum PDB_LEAF_TYPES
 	LEAF_TYPE_MEMBERMODIFY = 0x00001513,
 	LEAF_TYPE_MANAGED = 0x00001514,
 	LEAF_TYPE_TYPESERVER2 = 0x00001515,
+	LEAF_TYPE_STRIDED_ARRAY = 0x00001516,
+	LEAF_TYPE_HLSL = 0x00001517,
+	LEAF_TYPE_MODIFIER_EX = 0x00001518,
+	LEAF_TYPE_INTERFACE = 0x00001519,
+	LEAF_TYPE_BINTERFACE = 0x0000151A,
+	LEAF_TYPE_VECTOR = 0x0000151B,
+	LEAF_TYPE_MATRIX = 0x0000151C,
+	LEAF_TYPE_VFTABLE = 0x0000151D,
+
+	// Id records, only found in the id stream
+	LEAF_TYPE_FUNC_ID = 0x00001601,
+	LEAF_TYPE_MFUNC_ID = 0x00001602,
+	LEAF_TYPE_BUILDINFO = 0x00001603,
+	LEAF_TYPE_SUBSTR_LIST = 0x00001604,
+	LEAF_TYPE_STRING_ID = 0x00001605,
+	LEAF_TYPE_UDT_SRC_LINE = 0x00001606,
+	LEAF_TYPE_UDT_MOD_SRC_LINE = 0x00001607,
 
 	LEAF_TYPE_NUMERIC = 0x00008000,
 	LEAF_TYPE_CHAR = 0x00008000,
@@ -190,20 +207,123 @@ enum PDB_LEAF_TYPES
 };
 
 
+// Bits of the property field of struct, class, union and enum records
+#define PDB_TYPE_PROP_PACKED 0x0001
+#define PDB_TYPE_PROP_FWDREF 0x0080
+#define PDB_TYPE_PROP_SCOPED 0x0100
+#define PDB_TYPE_PROP_HASUNIQUENAME 0x0200
+
+// A user defined type (struct, class, union or enum) as found by name
+typedef struct PDB_TYPE_UDT
+{
+	uint32_t typeId;
+	PDB_LEAF_TYPES leaf;
+	uint16_t count; // Number of members in the field list
+	uint16_t prop; // PDB_TYPE_PROP_*
+	uint32_t field; // Type index of the field list
+	uint32_t derived; // Type index of the derivation list (classes only)
+	uint32_t vshape; // Type index of the vtable shape (classes only)
+	uint32_t utype; // Underlying type (enums only)
+	uint64_t size; // Size in bytes (0 for enums)
+} PDB_TYPE_UDT;
+
+// Type indices below this are the built in (simple) types, and have no record
+#define PDB_TYPE_SIMPLE_MAX 0x1000
+
+// Simple type indices are a basic type in the low byte and a pointer mode above it
+#define PDB_TYPE_SIMPLE_KIND(typeId) ((typeId) & 0xff)
+#define PDB_TYPE_SIMPLE_MODE(typeId) (((typeId) >> 8) & 0x7)
+
+// The member attribute's method property, intro virtual methods carry a vtable offset
+#define PDB_TYPE_ATTR_MPROP(attr) (((attr) >> 2) & 0x7)
+#define PDB_TYPE_MPROP_INTRO 4
+#define PDB_TYPE_MPROP_PUREINTRO 6
+
+// One entry of a field list (LF_MEMBER, LF_BCLASS, LF_ENUMERATE, ...).  Which of
+// the fields are used depends on the leaf, unused ones are zero.
+typedef struct PDB_TYPE_MEMBER
+{
+	PDB_LEAF_TYPES leaf;
+	uint16_t attr; // Access and method properties
+	uint32_t type; // Member, base class, nested or method list type
+	uint32_t vbptr; // Virtual base pointer type (LF_VBCLASS, LF_IVBCLASS)
+	uint64_t offset; // Member or base offset, enum value, vtable offset, or method count
+	uint64_t vbindex; // Index into the virtual base table (LF_VBCLASS, LF_IVBCLASS)
+	const char* name; // Points into the record, NULL if the member has none
+} PDB_TYPE_MEMBER;
+
 typedef bool (*PdbTypeEnumFunction)(void* ctxt);
 
+// Called for each record by PdbTypesWalk.  data is the record following its
+// leaf, and is only valid for the duration of the call.  It is followed by a
+// zero byte so names at the end of a record are always terminated.  Return
+// false to stop the walk.
+typedef bool (*PdbTypeRecordFunction)(void* ctxt, uint32_t typeId, uint16_t leaf,
+	const uint8_t* data, uint16_t len);
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif /* __cplusplus */
 
 	PDBAPI PDB_TYPES* PdbTypesOpen(PDB_FILE* pdb);
+
+	// The id stream (IPI) has the same layout as the type stream, so it is
+	// read through a PDB_TYPES too.  Its indices are ids, not type indices.
+	// NULL if the pdb predates the id stream.
+	PDBAPI PDB_TYPES* PdbIdsOpen(PDB_FILE* pdb);
 	PDBAPI void PdbTypesClose(PDB_TYPES* types);
 
 	PDBAPI uint32_t PdbTypesGetCount(PDB_TYPES* types);
+	PDBAPI uint32_t PdbTypesGetMinId(PDB_TYPES* types);
+	PDBAPI uint32_t PdbTypesGetMaxId(PDB_TYPES* types);
+	PDBAPI PDB_FILE* PdbTypesGetPdb(PDB_TYPES* types);
+	PDBAPI bool PdbTypesFind(PDB_TYPES* types, const char* name, PDB_TYPE_UDT* udt);
+
+	// Read a single record by type index.  data is the record following its
+	// leaf, in a buffer owned by types that the next lookup reuses.
+	PDBAPI bool PdbTypesGetRecord(PDB_TYPES* types, uint32_t typeId, uint16_t* leaf,
+		const uint8_t** data, uint16_t* len);
 	PDBAPI bool PdbTypesPrint(PDB_TYPES* types, const char* name, PdbTypeEnumFunction typeFn);
 	PDBAPI bool PdbTypesEnumerate(PDB_TYPES* types, PdbTypeEnumFunction typeFn);
 
+	// Read every record front to back in one pass, in large blocks
+	PDBAPI bool PdbTypesWalk(PDB_TYPES* types, PdbTypeRecordFunction recordFn, void* ctxt);
+
+	// Check the structure of every record once: lengths, type indices and
+	// numeric leaves of the records the decoders below understand.  It is done
+	// with the scan that the first lookup makes anyway, and the result is kept.
+	// True if the whole stream passed.
+	PDBAPI bool PdbTypesValidate(PDB_TYPES* types);
+
+	// Record decoding helpers for walkers.  They work on the data following
+	// the leaf, and return 0/false if it is truncated or not understood.
+	PDBAPI size_t PdbTypesReadNumeric(const uint8_t* buff, size_t len, uint64_t* value);
+	PDBAPI bool PdbTypesParseUdt(uint16_t leaf, const uint8_t* buff, size_t len,
+		PDB_TYPE_UDT* udt, const char** name);
+
+	// The same, but false unless the record defines a UDT: forward references
+	// and other leaves are skipped.  These are the names PdbTypesFind answers
+	// for.
+	PDBAPI bool PdbTypesParseUdtDefinition(uint16_t leaf, const uint8_t* buff, size_t len,
+		PDB_TYPE_UDT* udt, const char** name);
+
+	// Decode the field list entry at buff, returning the bytes it takes up
+	// including the padding that follows it
+	PDBAPI size_t PdbTypesParseMember(const uint8_t* buff, size_t len, PDB_TYPE_MEMBER* member);
+
+	// The same without the bounds checks, only for records from a stream
+	// that PdbTypesValidate passed
+	PDBAPI bool PdbTypesParseUdtUnchecked(uint16_t leaf, const uint8_t* buff, size_t len,
+		PDB_TYPE_UDT* udt, const char** name);
+	PDBAPI size_t PdbTypesParseMemberUnchecked(const uint8_t* buff, size_t len, PDB_TYPE_MEMBER* member);
+
+	// Built in types.  The name is the basic type's, check PDB_TYPE_SIMPLE_MODE
+	// for pointers to it.  The size does account for the pointer mode.  They
+	// return NULL/0 for unknown indices.
+	PDBAPI const char* PdbTypesGetSimpleName(uint32_t typeId);
+	PDBAPI uint32_t PdbTypesGetSimpleSize(uint32_t typeId);
+
 
 #ifdef __cplusplus
 }
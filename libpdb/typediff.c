@@ -0,0 +1,484 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "tpi.h"
+#include "layout.h"
+#include "typehash.h"
+#include "typediff.h"
+
+
+// No udt with this name
+#define DIFF_NO_UDT 0xffffffff
+
+
+// A udt definition found in one of the streams
+typedef struct DIFF_UDT
+{
+	uint32_t typeId;
+	uint16_t leaf;
+	bool matched; // Has a counterpart in the other stream
+	uint32_t name; // Offset into the side's names
+	uint32_t next; // Next udt in the same bucket
+} DIFF_UDT;
+
+// Everything known about one of the two streams
+typedef struct DIFF_SIDE
+{
+	PDB_TYPES* types;
+	PDB_TYPE_HASHES* hashes;
+	PDB_LAYOUT* layout;
+
+	DIFF_UDT* udts;
+	uint32_t count;
+	uint32_t capacity;
+
+	char* names;
+	size_t namesUsed;
+	size_t namesSize;
+
+	uint32_t* buckets; // First udt of each bucket
+	uint32_t bucketMask;
+} DIFF_SIDE;
+
+// A field of a changed udt, keyed for matching against the other side
+typedef struct DIFF_FIELD
+{
+	const char* key;
+	const PDB_TYPE_FIELD* field;
+} DIFF_FIELD;
+
+
+static uint32_t HashName(const char* name)
+{
+	uint32_t hash = 2166136261u;
+
+	// FNV-1a
+	while (*name)
+	{
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+
+static bool CollectUdt(void* ctxt, uint32_t typeId, uint16_t leaf, const uint8_t* data, uint16_t len)
+{
+	DIFF_SIDE* side = (DIFF_SIDE*)ctxt;
+	PDB_TYPE_UDT udt;
+	const char* name;
+	size_t nameLen;
+
+	if (!PdbTypesParseUdtDefinition(leaf, data, len, &udt, &name))
+		return true;
+
+	nameLen = strlen(name) + 1;
+
+	if (side->namesUsed + nameLen > side->namesSize)
+	{
+		size_t size = side->namesSize ? (side->namesSize * 2) : (1024 * 1024);
+		char* grown;
+
+		while (side->namesUsed + nameLen > size)
+			size *= 2;
+
+		grown = (char*)realloc(side->names, size);
+		if (!grown)
+			return false;
+
+		side->names = grown;
+		side->namesSize = size;
+	}
+
+	if (side->count == side->capacity)
+	{
+		uint32_t capacity = side->capacity ? (side->capacity * 2) : 4096;
+		DIFF_UDT* grown = (DIFF_UDT*)realloc(side->udts, capacity * sizeof(DIFF_UDT));
+
+		if (!grown)
+			return false;
+
+		side->udts = grown;
+		side->capacity = capacity;
+	}
+
+	side->udts[side->count].typeId = typeId;
+	side->udts[side->count].leaf = leaf;
+	side->udts[side->count].matched = false;
+	side->udts[side->count].name = (uint32_t)side->namesUsed;
+	side->udts[side->count].next = DIFF_NO_UDT;
+	side->count++;
+
+	memcpy(side->names + side->namesUsed, name, nameLen);
+	side->namesUsed += nameLen;
+
+	return true;
+}
+
+
+static bool LoadSide(DIFF_SIDE* side, PDB_TYPES* types)
+{
+	uint32_t buckets = 1024;
+	uint32_t i;
+
+	side->types = types;
+
+	side->hashes = PdbTypeHashesCompute(types);
+	if (!side->hashes)
+		return false;
+
+	side->layout = PdbLayoutCreate(types);
+	if (!side->layout)
+		return false;
+
+	if (!PdbTypesWalk(types, CollectUdt, side))
+		return false;
+
+	while (buckets < side->count * 2)
+		buckets *= 2;
+
+	side->buckets = (uint32_t*)malloc(buckets * sizeof(uint32_t));
+	if (!side->buckets)
+		return false;
+
+	memset(side->buckets, 0xff, buckets * sizeof(uint32_t));
+	side->bucketMask = buckets - 1;
+
+	// Insert back to front so each chain lists the first definition first
+	for (i = side->count; i > 0; i--)
+	{
+		DIFF_UDT* udt = &side->udts[i - 1];
+		uint32_t bucket = HashName(side->names + udt->name) & side->bucketMask;
+
+		udt->next = side->buckets[bucket];
+		side->buckets[bucket] = i - 1;
+	}
+
+	return true;
+}
+
+
+static void FreeSide(DIFF_SIDE* side)
+{
+	if (side->hashes)
+		PdbTypeHashesDestroy(side->hashes);
+	if (side->layout)
+		PdbLayoutDestroy(side->layout);
+
+	free(side->buckets);
+	free(side->names);
+	free(side->udts);
+}
+
+
+static uint32_t FindUdt(DIFF_SIDE* side, const char* name)
+{
+	uint32_t entry = side->buckets[HashName(name) & side->bucketMask];
+
+	while (entry != DIFF_NO_UDT)
+	{
+		if (strcmp(side->names + side->udts[entry].name, name) == 0)
+			return entry;
+
+		entry = side->udts[entry].next;
+	}
+
+	return DIFF_NO_UDT;
+}
+
+
+static int CompareFields(const void* a, const void* b)
+{
+	const DIFF_FIELD* left = (const DIFF_FIELD*)a;
+	const DIFF_FIELD* right = (const DIFF_FIELD*)b;
+	int result = strcmp(left->key, right->key);
+
+	if (result)
+		return result;
+
+	if (left->field->offset != right->field->offset)
+		return (left->field->offset < right->field->offset) ? -1 : 1;
+
+	return (left->field < right->field) ? -1 : 1;
+}
+
+
+// The fields of a udt sorted by name, base classes by their type's name
+static DIFF_FIELD* SortFields(DIFF_SIDE* side, const PDB_TYPE_NODE* node)
+{
+	DIFF_FIELD* fields = (DIFF_FIELD*)malloc((node->fieldCount + 1) * sizeof(DIFF_FIELD));
+	uint32_t i;
+
+	if (!fields)
+		return NULL;
+
+	for (i = 0; i < node->fieldCount; i++)
+	{
+		const PDB_TYPE_FIELD* field = &node->fields[i];
+
+		fields[i].field = field;
+		fields[i].key = field->name;
+
+		if (!fields[i].key)
+		{
+			const PDB_TYPE_NODE* type = PdbLayoutGetFieldType(side->layout, field);
+
+			if (field->leaf == LEAF_TYPE_VFUNCTAB)
+				fields[i].key = "<vfptr>";
+			else
+				fields[i].key = (type && type->name) ? type->name : "<base>";
+		}
+	}
+
+	qsort(fields, node->fieldCount, sizeof(DIFF_FIELD), CompareFields);
+
+	return fields;
+}
+
+
+static uint64_t FieldSize(DIFF_SIDE* side, const PDB_TYPE_FIELD* field)
+{
+	const PDB_TYPE_NODE* type = PdbLayoutGetFieldType(side->layout, field);
+
+	return type ? type->size : 0;
+}
+
+
+static bool AddMember(PDB_MEMBER_DIFF** members, uint32_t* count, uint32_t* capacity,
+	PDB_TYPE_CHANGE change, const DIFF_FIELD* field)
+{
+	PDB_MEMBER_DIFF* member;
+
+	if (*count == *capacity)
+	{
+		uint32_t size = *capacity ? (*capacity * 2) : 16;
+		PDB_MEMBER_DIFF* grown = (PDB_MEMBER_DIFF*)realloc(*members, size * sizeof(PDB_MEMBER_DIFF));
+
+		if (!grown)
+			return false;
+
+		*members = grown;
+		*capacity = size;
+	}
+
+	member = &(*members)[(*count)++];
+	memset(member, 0, sizeof(PDB_MEMBER_DIFF));
+	member->change = change;
+	member->leaf = field->field->leaf;
+	member->name = field->key;
+
+	return true;
+}
+
+
+// Decode both definitions and match up their fields
+static bool DiffUdt(DIFF_SIDE* oldSide, DIFF_SIDE* newSide, const DIFF_UDT* oldUdt, const DIFF_UDT* newUdt,
+	PdbTypeDiffFunction diffFn, void* ctxt)
+{
+	const PDB_TYPE_NODE* oldNode = PdbLayoutResolveShallow(oldSide->layout, oldUdt->typeId);
+	const PDB_TYPE_NODE* newNode = PdbLayoutResolveShallow(newSide->layout, newUdt->typeId);
+	DIFF_FIELD* oldFields = NULL;
+	DIFF_FIELD* newFields = NULL;
+	PDB_MEMBER_DIFF* members = NULL;
+	uint32_t count = 0;
+	uint32_t capacity = 0;
+	uint32_t i = 0;
+	uint32_t j = 0;
+	PDB_TYPE_DIFF diff;
+	bool result = false;
+
+	if (!oldNode || !newNode)
+		return false;
+
+	oldFields = SortFields(oldSide, oldNode);
+	newFields = SortFields(newSide, newNode);
+	if (!oldFields || !newFields)
+		goto DONE;
+
+	// Merge the two sorted lists
+	while ((i < oldNode->fieldCount) || (j < newNode->fieldCount))
+	{
+		int order;
+
+		if (i == oldNode->fieldCount)
+			order = 1;
+		else if (j == newNode->fieldCount)
+			order = -1;
+		else
+			order = strcmp(oldFields[i].key, newFields[j].key);
+
+		if (order < 0)
+		{
+			if (!AddMember(&members, &count, &capacity, PDB_TYPE_REMOVED, &oldFields[i]))
+				goto DONE;
+
+			members[count - 1].oldOffset = oldFields[i].field->offset;
+			members[count - 1].oldSize = FieldSize(oldSide, oldFields[i].field);
+			i++;
+		}
+		else if (order > 0)
+		{
+			if (!AddMember(&members, &count, &capacity, PDB_TYPE_ADDED, &newFields[j]))
+				goto DONE;
+
+			members[count - 1].newOffset = newFields[j].field->offset;
+			members[count - 1].newSize = FieldSize(newSide, newFields[j].field);
+			j++;
+		}
+		else
+		{
+			const PDB_TYPE_FIELD* oldField = oldFields[i].field;
+			const PDB_TYPE_FIELD* newField = newFields[j].field;
+			bool typeChanged = (PdbTypeHashesGet(oldSide->hashes, oldField->typeId)
+				!= PdbTypeHashesGet(newSide->hashes, newField->typeId));
+
+			if (typeChanged || (oldField->offset != newField->offset) || (oldField->leaf != newField->leaf))
+			{
+				if (!AddMember(&members, &count, &capacity, PDB_TYPE_CHANGED, &newFields[j]))
+					goto DONE;
+
+				members[count - 1].oldOffset = oldField->offset;
+				members[count - 1].newOffset = newField->offset;
+				members[count - 1].oldSize = FieldSize(oldSide, oldField);
+				members[count - 1].newSize = FieldSize(newSide, newField);
+				members[count - 1].typeChanged = typeChanged;
+			}
+
+			i++;
+			j++;
+		}
+	}
+
+	memset(&diff, 0, sizeof(diff));
+	diff.change = PDB_TYPE_CHANGED;
+	diff.name = newNode->name;
+	diff.leaf = (PDB_LEAF_TYPES)newUdt->leaf;
+	diff.oldTypeId = oldUdt->typeId;
+	diff.newTypeId = newUdt->typeId;
+	diff.oldSize = oldNode->size;
+	diff.newSize = newNode->size;
+	diff.memberCount = count;
+	diff.members = members;
+
+	result = diffFn(ctxt, &diff);
+
+DONE:
+	free(members);
+	free(newFields);
+	free(oldFields);
+
+	return result;
+}
+
+
+static bool ReportUdt(DIFF_SIDE* side, const DIFF_UDT* udt, PDB_TYPE_CHANGE change,
+	PdbTypeDiffFunction diffFn, void* ctxt)
+{
+	const PDB_TYPE_NODE* node = PdbLayoutResolveShallow(side->layout, udt->typeId);
+	PDB_TYPE_DIFF diff;
+
+	memset(&diff, 0, sizeof(diff));
+	diff.change = change;
+	diff.name = side->names + udt->name;
+	diff.leaf = (PDB_LEAF_TYPES)udt->leaf;
+
+	if (change == PDB_TYPE_ADDED)
+	{
+		diff.newTypeId = udt->typeId;
+		diff.newSize = node ? node->size : 0;
+	}
+	else
+	{
+		diff.oldTypeId = udt->typeId;
+		diff.oldSize = node ? node->size : 0;
+	}
+
+	return diffFn(ctxt, &diff);
+}
+
+
+bool PdbTypesDiff(PDB_TYPES* oldTypes, PDB_TYPES* newTypes, PdbTypeDiffFunction diffFn, void* ctxt)
+{
+	DIFF_SIDE oldSide;
+	DIFF_SIDE newSide;
+	bool result = false;
+	uint32_t i;
+
+	memset(&oldSide, 0, sizeof(oldSide));
+	memset(&newSide, 0, sizeof(newSide));
+
+	if (!LoadSide(&oldSide, oldTypes) || !LoadSide(&newSide, newTypes))
+		goto DONE;
+
+	for (i = 0; i < oldSide.count; i++)
+	{
+		DIFF_UDT* oldUdt = &oldSide.udts[i];
+		const char* name = oldSide.names + oldUdt->name;
+		uint32_t match;
+
+		// Later definitions of the same name are left alone
+		if (FindUdt(&oldSide, name) != i)
+			continue;
+
+		match = FindUdt(&newSide, name);
+
+		if (match == DIFF_NO_UDT)
+		{
+			if (!ReportUdt(&oldSide, oldUdt, PDB_TYPE_REMOVED, diffFn, ctxt))
+				goto DONE;
+			continue;
+		}
+
+		newSide.udts[match].matched = true;
+
+		// Identical hashes, nothing in or under the type changed
+		if (PdbTypeHashesGet(oldSide.hashes, oldUdt->typeId)
+			== PdbTypeHashesGet(newSide.hashes, newSide.udts[match].typeId))
+			continue;
+
+		if (!DiffUdt(&oldSide, &newSide, oldUdt, &newSide.udts[match], diffFn, ctxt))
+			goto DONE;
+	}
+
+	for (i = 0; i < newSide.count; i++)
+	{
+		DIFF_UDT* newUdt = &newSide.udts[i];
+
+		if (newUdt->matched || (FindUdt(&newSide, newSide.names + newUdt->name) != i))
+			continue;
+
+		if (!ReportUdt(&newSide, newUdt, PDB_TYPE_ADDED, diffFn, ctxt))
+			goto DONE;
+	}
+
+	result = true;
+
+DONE:
+	FreeSide(&newSide);
+	FreeSide(&oldSide);
+
+	return result;
+}
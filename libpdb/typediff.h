@@ -0,0 +1,82 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __TYPEDIFF_H__
+#define __TYPEDIFF_H__
+
+
+typedef enum PDB_TYPE_CHANGE
+{
+	PDB_TYPE_ADDED = 0,
+	PDB_TYPE_REMOVED = 1,
+	PDB_TYPE_CHANGED = 2
+} PDB_TYPE_CHANGE;
+
+// A data member, base class, vfptr or enumerate that differs between the two
+typedef struct PDB_MEMBER_DIFF
+{
+	PDB_TYPE_CHANGE change;
+	PDB_LEAF_TYPES leaf;
+	const char* name; // The base's type name for base classes
+	uint64_t oldOffset; // Or the enumerate's value
+	uint64_t newOffset;
+	uint64_t oldSize;
+	uint64_t newSize;
+	bool typeChanged; // The member's type differs structurally
+} PDB_MEMBER_DIFF;
+
+typedef struct PDB_TYPE_DIFF
+{
+	PDB_TYPE_CHANGE change;
+	const char* name;
+	PDB_LEAF_TYPES leaf; // The new leaf, unless removed
+	uint32_t oldTypeId; // 0 if added
+	uint32_t newTypeId; // 0 if removed
+	uint64_t oldSize;
+	uint64_t newSize;
+	uint32_t memberCount; // Changed types only
+	const PDB_MEMBER_DIFF* members;
+} PDB_TYPE_DIFF;
+
+// Called for each udt that was added, removed or changed.  diff is only valid
+// for the duration of the call.  Return false to stop.
+typedef bool (*PdbTypeDiffFunction)(void* ctxt, const PDB_TYPE_DIFF* diff);
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Pair up the struct, class, union and enum definitions of two type
+	// streams by name, and report the ones that differ.  Structural hashes are
+	// compared first, only types whose hash differs are decoded to find the
+	// members that changed.  When a name is defined more than once, the first
+	// definition is used.
+	PDBAPI bool PdbTypesDiff(PDB_TYPES* oldTypes, PDB_TYPES* newTypes, PdbTypeDiffFunction diffFn, void* ctxt);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __TYPEDIFF_H__ */
@@ -0,0 +1,628 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "tpi.h"
+#include "typehash.h"
+
+
+// Store records are carved out of chunks this big
+#define PDB_TYPE_STORE_CHUNK_SIZE (1024 * 1024)
+
+// Initial number of hash table slots in a store, always a power of two
+#define PDB_TYPE_STORE_SLOTS 4096
+
+// Hash of a reference that doesn't resolve to an earlier record
+#define PDB_TYPE_HASH_BAD_REF 0xffffffffu
+
+
+struct PDB_TYPE_HASHES
+{
+	uint32_t minId;
+	uint32_t count;
+	uint64_t* hashes;
+};
+
+typedef struct PDB_TYPE_STORE_CHUNK
+{
+	struct PDB_TYPE_STORE_CHUNK* next;
+	size_t used;
+	size_t size;
+	uint8_t data[1];
+} PDB_TYPE_STORE_CHUNK;
+
+struct PDB_TYPE_STORE
+{
+	uint32_t count;
+	uint32_t capacity;
+	uint64_t* hashes; // By store id - PDB_TYPE_STORE_MIN_ID
+	uint8_t** records; // Length, leaf, data and a terminating zero
+
+	uint32_t* slots; // Open addressing, entry index + 1, 0 is empty
+	uint32_t slotMask;
+
+	PDB_TYPE_STORE_CHUNK* chunks;
+	uint64_t bytes;
+};
+
+// State carried through the walk of one type stream
+typedef struct TYPE_HASH_WALK
+{
+	uint32_t minId;
+	uint32_t count;
+	uint64_t* hashes; // Structural hash by type index - minId
+	PDB_TYPE_STORE* store; // NULL when only hashing
+	uint32_t* map; // Store id by type index - minId
+
+	uint32_t* refs; // Offsets of the type references in the current record
+	uint32_t refCount;
+	uint32_t refSize;
+
+	uint8_t scratch[0x10000];
+} TYPE_HASH_WALK;
+
+
+// The 64 bit murmur finalizer, spreads the references folded into a hash
+static uint64_t MixHash(uint64_t hash)
+{
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+
+static uint64_t HashBytes(uint64_t hash, const uint8_t* buff, size_t len)
+{
+	size_t i;
+
+	// FNV-1a
+	for (i = 0; i < len; i++)
+	{
+		hash ^= buff[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+
+static bool AddRef(TYPE_HASH_WALK* walk, size_t offset, uint16_t len)
+{
+	if (offset + 4 > len)
+		return true;
+
+	if (walk->refCount == walk->refSize)
+	{
+		uint32_t size = walk->refSize ? (walk->refSize * 2) : 256;
+		uint32_t* grown = (uint32_t*)realloc(walk->refs, size * sizeof(uint32_t));
+
+		if (!grown)
+			return false;
+
+		walk->refs = grown;
+		walk->refSize = size;
+	}
+
+	walk->refs[walk->refCount++] = (uint32_t)offset;
+
+	return true;
+}
+
+
+// A count followed by that many type indices
+static bool FindListRefs(TYPE_HASH_WALK* walk, const uint8_t* data, uint16_t len)
+{
+	uint32_t count;
+	uint32_t i;
+
+	if (len < 4)
+		return true;
+
+	count = *(uint32_t*)data;
+
+	for (i = 0; (i < count) && (4 + (size_t)i * 4 < len); i++)
+	{
+		if (!AddRef(walk, 4 + (size_t)i * 4, len))
+			return false;
+	}
+
+	return true;
+}
+
+
+static bool FindFieldListRefs(TYPE_HASH_WALK* walk, const uint8_t* data, uint16_t len)
+{
+	size_t pos = 0;
+
+	while (pos < len)
+	{
+		PDB_TYPE_MEMBER member;
+		size_t memberLen = PdbTypesParseMember(data + pos, len - pos, &member);
+
+		// The rest is hashed as it is
+		if (memberLen == 0)
+			break;
+
+		// Every entry but an enumerate has a type after the attribute word,
+		// virtual bases have the vbptr type as well
+		if (member.leaf != LEAF_TYPE_ENUMERATE)
+		{
+			if (!AddRef(walk, pos + 4, len))
+				return false;
+		}
+
+		if ((member.leaf == LEAF_TYPE_VBCLASS) || (member.leaf == LEAF_TYPE_IVBCLASS))
+		{
+			if (!AddRef(walk, pos + 8, len))
+				return false;
+		}
+
+		pos += memberLen;
+	}
+
+	return true;
+}
+
+
+static bool FindMethodListRefs(TYPE_HASH_WALK* walk, const uint8_t* data, uint16_t len)
+{
+	size_t pos = 0;
+
+	// attribute, padding, type, and the vtable offset of intro virtuals
+	while (pos + 8 <= len)
+	{
+		uint16_t attr = *(uint16_t*)(data + pos);
+		uint32_t mprop = PDB_TYPE_ATTR_MPROP(attr);
+
+		if (!AddRef(walk, pos + 4, len))
+			return false;
+
+		pos += 8;
+
+		if ((mprop == PDB_TYPE_MPROP_INTRO) || (mprop == PDB_TYPE_MPROP_PUREINTRO))
+			pos += 4;
+	}
+
+	return true;
+}
+
+
+// Find where the record refers to other types
+static bool FindRefs(TYPE_HASH_WALK* walk, uint16_t leaf, const uint8_t* data, uint16_t len)
+{
+	walk->refCount = 0;
+
+	switch (leaf)
+	{
+	case LEAF_TYPE_MODIFIER:
+	case LEAF_TYPE_BITFIELD:
+		return AddRef(walk, 0, len);
+	case LEAF_TYPE_POINTER:
+		// Pointers to members have the containing class after the attributes
+		if (!AddRef(walk, 0, len))
+			return false;
+		if (len >= 12)
+		{
+			uint32_t mode = (*(uint32_t*)(data + 4) >> 5) & 0x7;
+
+			if ((mode == 2) || (mode == 3))
+				return AddRef(walk, 8, len);
+		}
+		return true;
+	case LEAF_TYPE_ARRAY:
+	case LEAF_TYPE_VFTABLE:
+		return AddRef(walk, 0, len) && AddRef(walk, 4, len);
+	case LEAF_TYPE_PROCEDURE:
+		// return type, calling convention, attributes, parameter count, arguments
+		return AddRef(walk, 0, len) && AddRef(walk, 8, len);
+	case LEAF_TYPE_MFUNCTION:
+		// return type, class, this, ..., arguments
+		return AddRef(walk, 0, len) && AddRef(walk, 4, len)
+			&& AddRef(walk, 8, len) && AddRef(walk, 16, len);
+	case LEAF_TYPE_ARGLIST:
+	case LEAF_TYPE_DERIVED:
+		return FindListRefs(walk, data, len);
+	case LEAF_TYPE_FIELDLIST:
+		return FindFieldListRefs(walk, data, len);
+	case LEAF_TYPE_METHODLIST:
+		return FindMethodListRefs(walk, data, len);
+	case LEAF_TYPE_STRUCTURE:
+	case LEAF_TYPE_CLASS:
+	case LEAF_TYPE_INTERFACE:
+		// count, properties, field list, derivation list, vtable shape
+		return AddRef(walk, 4, len) && AddRef(walk, 8, len) && AddRef(walk, 12, len);
+	case LEAF_TYPE_UNION:
+		return AddRef(walk, 4, len);
+	case LEAF_TYPE_ENUM:
+		// count, properties, underlying type, field list
+		return AddRef(walk, 4, len) && AddRef(walk, 8, len);
+	default:
+		return true;
+	}
+}
+
+
+static void* StoreAlloc(PDB_TYPE_STORE* store, size_t bytes)
+{
+	PDB_TYPE_STORE_CHUNK* chunk = store->chunks;
+	void* result;
+
+	bytes = (bytes + 3) & ~(size_t)3;
+
+	if (!chunk || (chunk->used + bytes > chunk->size))
+	{
+		size_t size = (bytes > PDB_TYPE_STORE_CHUNK_SIZE) ? bytes : PDB_TYPE_STORE_CHUNK_SIZE;
+
+		chunk = (PDB_TYPE_STORE_CHUNK*)malloc(sizeof(PDB_TYPE_STORE_CHUNK) + size);
+		if (!chunk)
+			return NULL;
+
+		chunk->next = store->chunks;
+		chunk->used = 0;
+		chunk->size = size;
+		store->chunks = chunk;
+	}
+
+	result = chunk->data + chunk->used;
+	chunk->used += bytes;
+	store->bytes += bytes;
+
+	return result;
+}
+
+
+static bool StoreGrow(PDB_TYPE_STORE* store)
+{
+	uint32_t capacity = store->capacity ? (store->capacity * 2) : PDB_TYPE_STORE_SLOTS;
+	uint32_t slotCount = capacity * 2;
+	uint64_t* hashes;
+	uint8_t** records;
+	uint32_t* slots;
+	uint32_t i;
+
+	hashes = (uint64_t*)realloc(store->hashes, capacity * sizeof(uint64_t));
+	if (!hashes)
+		return false;
+	store->hashes = hashes;
+
+	records = (uint8_t**)realloc(store->records, capacity * sizeof(uint8_t*));
+	if (!records)
+		return false;
+	store->records = records;
+
+	// Keep the table at most half full
+	slots = (uint32_t*)calloc(slotCount, sizeof(uint32_t));
+	if (!slots)
+		return false;
+
+	for (i = 0; i < store->count; i++)
+	{
+		uint32_t slot = (uint32_t)store->hashes[i] & (slotCount - 1);
+
+		while (slots[slot])
+			slot = (slot + 1) & (slotCount - 1);
+
+		slots[slot] = i + 1;
+	}
+
+	free(store->slots);
+	store->slots = slots;
+	store->slotMask = slotCount - 1;
+	store->capacity = capacity;
+
+	return true;
+}
+
+
+// The store id of the record, adding it if it is new.  0 if out of memory.
+static uint32_t StoreIntern(PDB_TYPE_STORE* store, uint64_t hash, uint16_t leaf,
+	const uint8_t* data, uint16_t len)
+{
+	uint32_t slot;
+	uint8_t* record;
+
+	if ((store->count == store->capacity) && !StoreGrow(store))
+		return 0;
+
+	for (slot = (uint32_t)hash & store->slotMask; store->slots[slot];
+		slot = (slot + 1) & store->slotMask)
+	{
+		uint32_t entry = store->slots[slot] - 1;
+		const uint8_t* existing = store->records[entry];
+
+		if ((store->hashes[entry] == hash) && (*(uint16_t*)existing == len)
+			&& (*(uint16_t*)(existing + 2) == leaf) && !memcmp(existing + 4, data, len))
+			return PDB_TYPE_STORE_MIN_ID + entry;
+	}
+
+	record = (uint8_t*)StoreAlloc(store, (size_t)len + 5);
+	if (!record)
+		return 0;
+
+	*(uint16_t*)record = len;
+	*(uint16_t*)(record + 2) = leaf;
+	memcpy(record + 4, data, len);
+	record[4 + len] = 0;
+
+	store->hashes[store->count] = hash;
+	store->records[store->count] = record;
+	store->slots[slot] = ++store->count;
+
+	return PDB_TYPE_STORE_MIN_ID + store->count - 1;
+}
+
+
+static bool HashRecord(void* ctxt, uint32_t typeId, uint16_t leaf, const uint8_t* data, uint16_t len)
+{
+	TYPE_HASH_WALK* walk = (TYPE_HASH_WALK*)ctxt;
+	uint32_t index = typeId - walk->minId;
+	uint64_t hash = 0xcbf29ce484222325ull;
+	uint32_t i;
+
+	if (index >= walk->count)
+		return true;
+
+	if (!FindRefs(walk, leaf, data, len))
+		return false;
+
+	// Hash the record with its references blanked out...
+	memcpy(walk->scratch, data, len);
+
+	for (i = 0; i < walk->refCount; i++)
+		memset(walk->scratch + walk->refs[i], 0, 4);
+
+	hash = HashBytes(hash, (const uint8_t*)&leaf, sizeof(leaf));
+	hash = HashBytes(hash, walk->scratch, len);
+
+	// ...then fold in the hashes of what they refer to.  Streams only refer
+	// back to earlier records, forward references break the cycles.
+	for (i = 0; i < walk->refCount; i++)
+	{
+		uint32_t ref = *(uint32_t*)(data + walk->refs[i]);
+		uint64_t refHash;
+		uint32_t storeId;
+
+		if (ref < PDB_TYPE_SIMPLE_MAX)
+		{
+			refHash = MixHash(ref);
+			storeId = ref;
+		}
+		else if ((ref >= walk->minId) && (ref < typeId))
+		{
+			refHash = walk->hashes[ref - walk->minId];
+			storeId = walk->map ? walk->map[ref - walk->minId] : 0;
+		}
+		else
+		{
+			refHash = MixHash(PDB_TYPE_HASH_BAD_REF);
+			storeId = 0;
+		}
+
+		hash = MixHash(hash ^ refHash);
+
+		// Store records refer to each other by store id
+		*(uint32_t*)(walk->scratch + walk->refs[i]) = storeId;
+	}
+
+	walk->hashes[index] = hash;
+
+	if (walk->store)
+	{
+		walk->map[index] = StoreIntern(walk->store, hash, leaf, walk->scratch, len);
+		if (!walk->map[index])
+			return false;
+	}
+
+	return true;
+}
+
+
+static bool HashTypes(TYPE_HASH_WALK* walk, PDB_TYPES* types)
+{
+	bool result;
+
+	walk->minId = PdbTypesGetMinId(types);
+	walk->count = PdbTypesGetCount(types);
+
+	result = PdbTypesWalk(types, HashRecord, walk);
+
+	free(walk->refs);
+	walk->refs = NULL;
+
+	return result;
+}
+
+
+PDB_TYPE_HASHES* PdbTypeHashesCompute(PDB_TYPES* types)
+{
+	PDB_TYPE_HASHES* hashes;
+	TYPE_HASH_WALK* walk;
+
+	hashes = (PDB_TYPE_HASHES*)calloc(1, sizeof(PDB_TYPE_HASHES));
+	walk = (TYPE_HASH_WALK*)calloc(1, sizeof(TYPE_HASH_WALK));
+	if (!hashes || !walk)
+		goto FAIL;
+
+	hashes->minId = PdbTypesGetMinId(types);
+	hashes->count = PdbTypesGetCount(types);
+	hashes->hashes = (uint64_t*)calloc((size_t)hashes->count + 1, sizeof(uint64_t));
+	if (!hashes->hashes)
+		goto FAIL;
+
+	walk->hashes = hashes->hashes;
+
+	if (!HashTypes(walk, types))
+		goto FAIL;
+
+	free(walk);
+
+	return hashes;
+
+FAIL:
+	if (hashes)
+		free(hashes->hashes);
+	free(hashes);
+	free(walk);
+
+	return NULL;
+}
+
+
+void PdbTypeHashesDestroy(PDB_TYPE_HASHES* hashes)
+{
+	free(hashes->hashes);
+	free(hashes);
+}
+
+
+uint64_t PdbTypeHashesGet(PDB_TYPE_HASHES* hashes, uint32_t typeId)
+{
+	if (typeId < PDB_TYPE_SIMPLE_MAX)
+		return MixHash(typeId);
+
+	if ((typeId < hashes->minId) || (typeId - hashes->minId >= hashes->count))
+		return 0;
+
+	return hashes->hashes[typeId - hashes->minId];
+}
+
+
+PDB_TYPE_STORE* PdbTypeStoreCreate(void)
+{
+	PDB_TYPE_STORE* store = (PDB_TYPE_STORE*)calloc(1, sizeof(PDB_TYPE_STORE));
+
+	if (!store)
+		return NULL;
+
+	if (!StoreGrow(store))
+	{
+		PdbTypeStoreDestroy(store);
+		return NULL;
+	}
+
+	return store;
+}
+
+
+void PdbTypeStoreDestroy(PDB_TYPE_STORE* store)
+{
+	PDB_TYPE_STORE_CHUNK* chunk = store->chunks;
+
+	while (chunk)
+	{
+		PDB_TYPE_STORE_CHUNK* next = chunk->next;
+
+		free(chunk);
+		chunk = next;
+	}
+
+	free(store->slots);
+	free(store->records);
+	free(store->hashes);
+	free(store);
+}
+
+
+bool PdbTypeStoreAdd(PDB_TYPE_STORE* store, PDB_TYPES* types, uint32_t** map, uint32_t* count)
+{
+	TYPE_HASH_WALK* walk = (TYPE_HASH_WALK*)calloc(1, sizeof(TYPE_HASH_WALK));
+	uint32_t typeCount = PdbTypesGetCount(types);
+	bool result = false;
+
+	*map = NULL;
+	*count = 0;
+
+	if (!walk)
+		return false;
+
+	walk->store = store;
+	walk->hashes = (uint64_t*)calloc((size_t)typeCount + 1, sizeof(uint64_t));
+	walk->map = (uint32_t*)calloc((size_t)typeCount + 1, sizeof(uint32_t));
+
+	if (walk->hashes && walk->map && HashTypes(walk, types))
+	{
+		*map = walk->map;
+		*count = typeCount;
+		walk->map = NULL;
+		result = true;
+	}
+
+	free(walk->map);
+	free(walk->hashes);
+	free(walk);
+
+	return result;
+}
+
+
+void PdbTypeStoreFreeMap(uint32_t* map)
+{
+	free(map);
+}
+
+
+uint32_t PdbTypeStoreGetCount(PDB_TYPE_STORE* store)
+{
+	return store->count;
+}
+
+
+uint64_t PdbTypeStoreGetSize(PDB_TYPE_STORE* store)
+{
+	return store->bytes;
+}
+
+
+uint64_t PdbTypeStoreGetHash(PDB_TYPE_STORE* store, uint32_t id)
+{
+	if (id < PDB_TYPE_SIMPLE_MAX)
+		return MixHash(id);
+
+	if (id - PDB_TYPE_STORE_MIN_ID >= store->count)
+		return 0;
+
+	return store->hashes[id - PDB_TYPE_STORE_MIN_ID];
+}
+
+
+bool PdbTypeStoreGetRecord(PDB_TYPE_STORE* store, uint32_t id, uint16_t* leaf,
+	const uint8_t** data, uint16_t* len)
+{
+	const uint8_t* record;
+
+	if ((id < PDB_TYPE_STORE_MIN_ID) || (id - PDB_TYPE_STORE_MIN_ID >= store->count))
+		return false;
+
+	record = store->records[id - PDB_TYPE_STORE_MIN_ID];
+
+	*len = *(uint16_t*)record;
+	*leaf = *(uint16_t*)(record + 2);
+	*data = record + 4;
+
+	return true;
+}
@@ -0,0 +1,78 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __TYPEHASH_H__
+#define __TYPEHASH_H__
+
+
+typedef struct PDB_TYPE_HASHES PDB_TYPE_HASHES;
+typedef struct PDB_TYPE_STORE PDB_TYPE_STORE;
+
+// Store ids start where type indices do, so built in types keep their index
+#define PDB_TYPE_STORE_MIN_ID 0x1000
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Structural hashes of every record, in one pass over the type stream.
+	// References to other types are hashed by what they refer to, so the
+	// hash doesn't depend on type index numbering and identical types in
+	// different pdbs hash the same.  Forward references hash by name.
+	PDBAPI PDB_TYPE_HASHES* PdbTypeHashesCompute(PDB_TYPES* types);
+	PDBAPI void PdbTypeHashesDestroy(PDB_TYPE_HASHES* hashes);
+
+	// 0 for type indices outside the stream
+	PDBAPI uint64_t PdbTypeHashesGet(PDB_TYPE_HASHES* hashes, uint32_t typeId);
+
+	// A store keeps one copy of each distinct type across any number of pdbs.
+	// Records in the store refer to other types by store id.  Stores aren't
+	// thread safe.
+	PDBAPI PDB_TYPE_STORE* PdbTypeStoreCreate(void);
+	PDBAPI void PdbTypeStoreDestroy(PDB_TYPE_STORE* store);
+
+	// Add every type of the stream that the store doesn't already have.
+	// map gets the store id of each type index, map[typeId - min type index],
+	// and is freed with PdbTypeStoreFreeMap.  count is the number of entries.
+	PDBAPI bool PdbTypeStoreAdd(PDB_TYPE_STORE* store, PDB_TYPES* types, uint32_t** map, uint32_t* count);
+	PDBAPI void PdbTypeStoreFreeMap(uint32_t* map);
+
+	// Distinct records held, and the bytes they take up
+	PDBAPI uint32_t PdbTypeStoreGetCount(PDB_TYPE_STORE* store);
+	PDBAPI uint64_t PdbTypeStoreGetSize(PDB_TYPE_STORE* store);
+
+	// The structural hash of a store id, the same as PdbTypeHashesGet gives
+	// for the types it came from
+	PDBAPI uint64_t PdbTypeStoreGetHash(PDB_TYPE_STORE* store, uint32_t id);
+
+	// data is the record following its leaf, owned by the store
+	PDBAPI bool PdbTypeStoreGetRecord(PDB_TYPE_STORE* store, uint32_t id, uint16_t* leaf,
+		const uint8_t** data, uint16_t* len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __TYPEHASH_H__ */
@@ -0,0 +1,743 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "tpi.h"
+#include "typetable.h"
+
+
+// How deep modifier/array chains and field list continuations are followed
+#define PDB_TYPE_TABLE_MAX_CHAIN 64
+
+// What the loader remembers about each type index
+#define TYPE_KIND_NONE 0
+#define TYPE_KIND_UDT 1 // target is the name id
+#define TYPE_KIND_WRAPPER 2 // Modifier or array, target is the wrapped type
+#define TYPE_KIND_FIELDLIST 3 // target is the index of the list
+
+
+struct PDB_TYPE_TABLE
+{
+	uint32_t rows;
+	uint32_t* typeId;
+	uint16_t* leaf;
+	uint64_t* size;
+	uint16_t* memberCount;
+	uint32_t* nameId;
+	uint32_t* field;
+	uint16_t* prop;
+	uint32_t* memberStart;
+
+	uint32_t members;
+	uint32_t* memberOwner;
+	uint16_t* memberLeaf;
+	uint32_t* memberType;
+	uint32_t* memberTypeName;
+	uint64_t* memberOffset;
+	uint32_t* memberNameId;
+
+	// Interned names, the id is the index into nameOffsets
+	char* names;
+	size_t namesLen;
+	size_t namesCapacity;
+	uint32_t* nameOffsets;
+	uint32_t nameCount;
+	uint32_t nameCapacity;
+	uint32_t* nameHash; // Open addressed, holds id + 1 (0 is empty)
+	uint32_t hashSize; // Power of two
+};
+
+
+// Field list entries as they are found, before they're assigned to rows
+typedef struct TYPE_TABLE_LOAD
+{
+	PDB_TYPE_TABLE* table;
+	uint32_t minId;
+	uint32_t typeCount;
+	uint8_t* kind; // TYPE_KIND_* by type index
+	uint32_t* target;
+
+	uint32_t entries;
+	uint32_t entryCapacity;
+	uint16_t* entryLeaf;
+	uint32_t* entryType;
+	uint64_t* entryOffset;
+	uint32_t* entryNameId;
+
+	uint32_t lists;
+	uint32_t listCapacity;
+	uint32_t* listFirst; // First entry of each field list record
+	uint32_t* listCount;
+
+	bool failed;
+} TYPE_TABLE_LOAD;
+
+
+static uint32_t HashName(const char* name)
+{
+	uint32_t hash = 2166136261u;
+
+	// FNV-1a
+	while (*name)
+	{
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+
+static bool GrowNameHash(PDB_TYPE_TABLE* table)
+{
+	uint32_t newSize = table->hashSize ? (table->hashSize * 2) : 4096;
+	uint32_t* newHash = (uint32_t*)calloc(newSize, sizeof(uint32_t));
+	uint32_t i;
+
+	if (!newHash)
+		return false;
+
+	// Reinsert every name
+	for (i = 0; i < table->nameCount; i++)
+	{
+		uint32_t slot = HashName(table->names + table->nameOffsets[i]) & (newSize - 1);
+
+		while (newHash[slot])
+			slot = (slot + 1) & (newSize - 1);
+
+		newHash[slot] = i + 1;
+	}
+
+	free(table->nameHash);
+	table->nameHash = newHash;
+	table->hashSize = newSize;
+
+	return true;
+}
+
+
+static uint32_t LookupName(PDB_TYPE_TABLE* table, const char* name, uint32_t* slotOut)
+{
+	uint32_t slot;
+
+	if (!table->hashSize)
+		return PDB_TYPE_TABLE_NO_NAME;
+
+	slot = HashName(name) & (table->hashSize - 1);
+
+	while (table->nameHash[slot])
+	{
+		uint32_t id = table->nameHash[slot] - 1;
+
+		if (strcmp(table->names + table->nameOffsets[id], name) == 0)
+			return id;
+
+		slot = (slot + 1) & (table->hashSize - 1);
+	}
+
+	if (slotOut)
+		*slotOut = slot;
+
+	return PDB_TYPE_TABLE_NO_NAME;
+}
+
+
+static uint32_t InternName(PDB_TYPE_TABLE* table, const char* name)
+{
+	size_t len = strlen(name) + 1;
+	uint32_t slot;
+	uint32_t id;
+
+	// Keep the load at or under a half
+	if ((table->nameCount + 1) * 2 > table->hashSize)
+	{
+		if (!GrowNameHash(table))
+			return PDB_TYPE_TABLE_NO_NAME;
+	}
+
+	id = LookupName(table, name, &slot);
+	if (id != PDB_TYPE_TABLE_NO_NAME)
+		return id;
+
+	if (table->namesLen + len > table->namesCapacity)
+	{
+		size_t capacity = (table->namesCapacity + len) * 2;
+		char* names = (char*)realloc(table->names, capacity);
+
+		if (!names)
+			return PDB_TYPE_TABLE_NO_NAME;
+
+		table->names = names;
+		table->namesCapacity = capacity;
+	}
+
+	if (table->nameCount == table->nameCapacity)
+	{
+		uint32_t capacity = table->nameCapacity ? (table->nameCapacity * 2) : 4096;
+		uint32_t* offsets = (uint32_t*)realloc(table->nameOffsets, capacity * sizeof(uint32_t));
+
+		if (!offsets)
+			return PDB_TYPE_TABLE_NO_NAME;
+
+		table->nameOffsets = offsets;
+		table->nameCapacity = capacity;
+	}
+
+	id = table->nameCount++;
+	table->nameOffsets[id] = (uint32_t)table->namesLen;
+	memcpy(table->names + table->namesLen, name, len);
+	table->namesLen += len;
+	table->nameHash[slot] = id + 1;
+
+	return id;
+}
+
+
+static bool AddRow(TYPE_TABLE_LOAD* load, uint32_t typeId, uint16_t leaf, const PDB_TYPE_UDT* udt, const char* name)
+{
+	PDB_TYPE_TABLE* table = load->table;
+	uint32_t row = table->rows++;
+
+	table->typeId[row] = typeId;
+	table->leaf[row] = leaf;
+	table->size[row] = udt->size;
+	table->memberCount[row] = udt->count;
+	table->nameId[row] = InternName(table, name);
+	table->field[row] = udt->field;
+	table->prop[row] = udt->prop;
+
+	return (table->nameId[row] != PDB_TYPE_TABLE_NO_NAME);
+}
+
+
+static bool AddFieldList(TYPE_TABLE_LOAD* load, uint32_t index, const uint8_t* data, uint16_t len)
+{
+	size_t pos = 0;
+
+	if (load->lists == load->listCapacity)
+	{
+		uint32_t capacity = load->listCapacity ? (load->listCapacity * 2) : 1024;
+
+		load->listFirst = (uint32_t*)realloc(load->listFirst, capacity * sizeof(uint32_t));
+		load->listCount = (uint32_t*)realloc(load->listCount, capacity * sizeof(uint32_t));
+		if (!load->listFirst || !load->listCount)
+			return false;
+
+		load->listCapacity = capacity;
+	}
+
+	load->kind[index] = TYPE_KIND_FIELDLIST;
+	load->target[index] = load->lists;
+	load->listFirst[load->lists] = load->entries;
+	load->listCount[load->lists] = 0;
+
+	while (pos < len)
+	{
+		PDB_TYPE_MEMBER member;
+		size_t memberLen = PdbTypesParseMember(data + pos, len - pos, &member);
+		uint32_t entry;
+
+		if (memberLen == 0)
+			break;
+
+		pos += memberLen;
+
+		if (load->entries == load->entryCapacity)
+		{
+			uint32_t capacity = load->entryCapacity ? (load->entryCapacity * 2) : 16384;
+
+			load->entryLeaf = (uint16_t*)realloc(load->entryLeaf, capacity * sizeof(uint16_t));
+			load->entryType = (uint32_t*)realloc(load->entryType, capacity * sizeof(uint32_t));
+			load->entryOffset = (uint64_t*)realloc(load->entryOffset, capacity * sizeof(uint64_t));
+			load->entryNameId = (uint32_t*)realloc(load->entryNameId, capacity * sizeof(uint32_t));
+			if (!load->entryLeaf || !load->entryType || !load->entryOffset || !load->entryNameId)
+				return false;
+
+			load->entryCapacity = capacity;
+		}
+
+		entry = load->entries++;
+		load->entryLeaf[entry] = (uint16_t)member.leaf;
+		load->entryType[entry] = member.type;
+		load->entryOffset[entry] = member.offset;
+		load->entryNameId[entry] = member.name ? InternName(load->table, member.name) : PDB_TYPE_TABLE_NO_NAME;
+		load->listCount[load->lists]++;
+	}
+
+	load->lists++;
+
+	return true;
+}
+
+
+static bool LoadRecord(void* ctxt, uint32_t typeId, uint16_t leaf, const uint8_t* data, uint16_t len)
+{
+	TYPE_TABLE_LOAD* load = (TYPE_TABLE_LOAD*)ctxt;
+	uint32_t index = typeId - load->minId;
+	PDB_TYPE_UDT udt;
+	const char* name;
+
+	switch (leaf)
+	{
+	case LEAF_TYPE_STRUCTURE:
+	case LEAF_TYPE_CLASS:
+	case LEAF_TYPE_INTERFACE:
+	case LEAF_TYPE_UNION:
+	case LEAF_TYPE_ENUM:
+		if (!PdbTypesParseUdt(leaf, data, len, &udt, &name))
+			break;
+
+		// Forward references only matter for resolving member types by name
+		load->kind[index] = TYPE_KIND_UDT;
+		load->target[index] = InternName(load->table, name);
+
+		if (!(udt.prop & PDB_TYPE_PROP_FWDREF) && !AddRow(load, typeId, leaf, &udt, name))
+			load->failed = true;
+		break;
+	case LEAF_TYPE_MODIFIER:
+	case LEAF_TYPE_ARRAY:
+		// The modified or element type comes first in both
+		if (len < 4)
+			break;
+		load->kind[index] = TYPE_KIND_WRAPPER;
+		load->target[index] = *(uint32_t*)data;
+		break;
+	case LEAF_TYPE_FIELDLIST:
+		if (!AddFieldList(load, index, data, len))
+			load->failed = true;
+		break;
+	default:
+		break;
+	}
+
+	return !load->failed;
+}
+
+
+// The udt a member of this type embeds, following modifiers and arrays
+static uint32_t ResolveEmbedded(TYPE_TABLE_LOAD* load, uint32_t typeId)
+{
+	uint32_t depth;
+
+	for (depth = 0; depth < PDB_TYPE_TABLE_MAX_CHAIN; depth++)
+	{
+		uint32_t index;
+
+		if ((typeId < load->minId) || (typeId - load->minId >= load->typeCount))
+			return PDB_TYPE_TABLE_NO_NAME;
+
+		index = typeId - load->minId;
+
+		if (load->kind[index] == TYPE_KIND_UDT)
+			return load->target[index];
+
+		if (load->kind[index] != TYPE_KIND_WRAPPER)
+			return PDB_TYPE_TABLE_NO_NAME;
+
+		typeId = load->target[index];
+	}
+
+	return PDB_TYPE_TABLE_NO_NAME;
+}
+
+
+// Walk a row's field list, and the lists it continues into with LF_INDEX.
+// Only counts the members when fill is false.
+static uint32_t CopyMembers(TYPE_TABLE_LOAD* load, uint32_t row, uint32_t field, uint32_t next, bool fill)
+{
+	PDB_TYPE_TABLE* table = load->table;
+	uint32_t count = 0;
+	uint32_t depth;
+
+	for (depth = 0; depth < PDB_TYPE_TABLE_MAX_CHAIN; depth++)
+	{
+		uint32_t index;
+		uint32_t list;
+		uint32_t entry;
+		uint32_t end;
+
+		if ((field < load->minId) || (field - load->minId >= load->typeCount))
+			break;
+
+		index = field - load->minId;
+		if (load->kind[index] != TYPE_KIND_FIELDLIST)
+			break;
+
+		list = load->target[index];
+		end = load->listFirst[list] + load->listCount[list];
+		field = 0;
+
+		for (entry = load->listFirst[list]; entry < end; entry++)
+		{
+			uint16_t leaf = load->entryLeaf[entry];
+			uint32_t member;
+
+			// The list carries on in another record
+			if (leaf == LEAF_TYPE_INDEX)
+			{
+				field = load->entryType[entry];
+				continue;
+			}
+
+			if (fill)
+			{
+				member = next + count;
+				table->memberOwner[member] = row;
+				table->memberLeaf[member] = leaf;
+				table->memberType[member] = load->entryType[entry];
+				table->memberOffset[member] = load->entryOffset[entry];
+				table->memberNameId[member] = load->entryNameId[entry];
+
+				// Only data members and bases are embedded in the object
+				if ((leaf == LEAF_TYPE_MEMBER) || (leaf == LEAF_TYPE_BCLASS)
+					|| (leaf == LEAF_TYPE_VBCLASS) || (leaf == LEAF_TYPE_IVBCLASS))
+					table->memberTypeName[member] = ResolveEmbedded(load, load->entryType[entry]);
+				else
+					table->memberTypeName[member] = PDB_TYPE_TABLE_NO_NAME;
+			}
+
+			count++;
+		}
+	}
+
+	return count;
+}
+
+
+static bool BuildMembers(TYPE_TABLE_LOAD* load)
+{
+	PDB_TYPE_TABLE* table = load->table;
+	uint64_t total = 0;
+	uint32_t row;
+
+	for (row = 0; row < table->rows; row++)
+		total += CopyMembers(load, row, table->field[row], 0, false);
+
+	// Continuations can be shared, but not four billion times over
+	if (total >= 0xffffffff)
+		return false;
+
+	table->members = (uint32_t)total;
+	table->memberOwner = (uint32_t*)malloc((total + 1) * sizeof(uint32_t));
+	table->memberLeaf = (uint16_t*)malloc((total + 1) * sizeof(uint16_t));
+	table->memberType = (uint32_t*)malloc((total + 1) * sizeof(uint32_t));
+	table->memberTypeName = (uint32_t*)malloc((total + 1) * sizeof(uint32_t));
+	table->memberOffset = (uint64_t*)malloc((total + 1) * sizeof(uint64_t));
+	table->memberNameId = (uint32_t*)malloc((total + 1) * sizeof(uint32_t));
+
+	if (!table->memberOwner || !table->memberLeaf || !table->memberType
+		|| !table->memberTypeName || !table->memberOffset || !table->memberNameId)
+		return false;
+
+	total = 0;
+	for (row = 0; row < table->rows; row++)
+	{
+		table->memberStart[row] = (uint32_t)total;
+		total += CopyMembers(load, row, table->field[row], (uint32_t)total, true);
+	}
+	table->memberStart[table->rows] = (uint32_t)total;
+
+	return true;
+}
+
+
+// Shrink a column to the number of rows actually used
+static void* TrimColumn(void* column, uint32_t rows, size_t width)
+{
+	void* trimmed = realloc(column, ((size_t)rows + 1) * width);
+
+	return trimmed ? trimmed : column;
+}
+
+
+static void FreeLoad(TYPE_TABLE_LOAD* load)
+{
+	free(load->kind);
+	free(load->target);
+	free(load->entryLeaf);
+	free(load->entryType);
+	free(load->entryOffset);
+	free(load->entryNameId);
+	free(load->listFirst);
+	free(load->listCount);
+}
+
+
+PDB_TYPE_TABLE* PdbTypeTableLoad(PDB_TYPES* types)
+{
+	PDB_TYPE_TABLE* table = (PDB_TYPE_TABLE*)calloc(1, sizeof(PDB_TYPE_TABLE));
+	TYPE_TABLE_LOAD load;
+	uint32_t typeCount = PdbTypesGetCount(types);
+	size_t rowCapacity = (size_t)typeCount + 1;
+
+	if (!table)
+		return NULL;
+
+	memset(&load, 0, sizeof(load));
+	load.table = table;
+	load.minId = PdbTypesGetMinId(types);
+	load.typeCount = typeCount;
+	load.kind = (uint8_t*)calloc(rowCapacity, sizeof(uint8_t));
+	load.target = (uint32_t*)calloc(rowCapacity, sizeof(uint32_t));
+
+	// There can't be more rows than records, size the columns for that and
+	// trim them once the real count is known
+	table->typeId = (uint32_t*)malloc(rowCapacity * sizeof(uint32_t));
+	table->leaf = (uint16_t*)malloc(rowCapacity * sizeof(uint16_t));
+	table->size = (uint64_t*)malloc(rowCapacity * sizeof(uint64_t));
+	table->memberCount = (uint16_t*)malloc(rowCapacity * sizeof(uint16_t));
+	table->nameId = (uint32_t*)malloc(rowCapacity * sizeof(uint32_t));
+	table->field = (uint32_t*)malloc(rowCapacity * sizeof(uint32_t));
+	table->prop = (uint16_t*)malloc(rowCapacity * sizeof(uint16_t));
+
+	if (!load.kind || !load.target || !table->typeId || !table->leaf || !table->size
+		|| !table->memberCount || !table->nameId || !table->field || !table->prop)
+		goto FAIL;
+
+	if (!PdbTypesWalk(types, LoadRecord, &load) || load.failed)
+		goto FAIL;
+
+	table->typeId = (uint32_t*)TrimColumn(table->typeId, table->rows, sizeof(uint32_t));
+	table->leaf = (uint16_t*)TrimColumn(table->leaf, table->rows, sizeof(uint16_t));
+	table->size = (uint64_t*)TrimColumn(table->size, table->rows, sizeof(uint64_t));
+	table->memberCount = (uint16_t*)TrimColumn(table->memberCount, table->rows, sizeof(uint16_t));
+	table->nameId = (uint32_t*)TrimColumn(table->nameId, table->rows, sizeof(uint32_t));
+	table->field = (uint32_t*)TrimColumn(table->field, table->rows, sizeof(uint32_t));
+	table->prop = (uint16_t*)TrimColumn(table->prop, table->rows, sizeof(uint16_t));
+
+	table->memberStart = (uint32_t*)malloc(((size_t)table->rows + 1) * sizeof(uint32_t));
+	if (!table->memberStart || !BuildMembers(&load))
+		goto FAIL;
+
+	FreeLoad(&load);
+
+	return table;
+
+FAIL:
+	FreeLoad(&load);
+	PdbTypeTableClose(table);
+
+	return NULL;
+}
+
+
+void PdbTypeTableClose(PDB_TYPE_TABLE* table)
+{
+	free(table->typeId);
+	free(table->leaf);
+	free(table->size);
+	free(table->memberCount);
+	free(table->nameId);
+	free(table->field);
+	free(table->prop);
+	free(table->memberStart);
+	free(table->memberOwner);
+	free(table->memberLeaf);
+	free(table->memberType);
+	free(table->memberTypeName);
+	free(table->memberOffset);
+	free(table->memberNameId);
+	free(table->names);
+	free(table->nameOffsets);
+	free(table->nameHash);
+	free(table);
+}
+
+
+void PdbTypeTableGetColumns(PDB_TYPE_TABLE* table, PDB_TYPE_COLUMNS* columns)
+{
+	columns->rows = table->rows;
+	columns->typeId = table->typeId;
+	columns->leaf = table->leaf;
+	columns->size = table->size;
+	columns->memberCount = table->memberCount;
+	columns->nameId = table->nameId;
+	columns->field = table->field;
+	columns->prop = table->prop;
+	columns->memberStart = table->memberStart;
+
+	columns->members = table->members;
+	columns->memberOwner = table->memberOwner;
+	columns->memberLeaf = table->memberLeaf;
+	columns->memberType = table->memberType;
+	columns->memberTypeName = table->memberTypeName;
+	columns->memberOffset = table->memberOffset;
+	columns->memberNameId = table->memberNameId;
+}
+
+
+const char* PdbTypeTableGetName(PDB_TYPE_TABLE* table, uint32_t nameId)
+{
+	if (nameId >= table->nameCount)
+		return NULL;
+
+	return table->names + table->nameOffsets[nameId];
+}
+
+
+uint32_t PdbTypeTableFindName(PDB_TYPE_TABLE* table, const char* name)
+{
+	return LookupName(table, name, NULL);
+}
+
+
+uint8_t* PdbTypeTableSelectAll(PDB_TYPE_TABLE* table)
+{
+	uint8_t* selection = (uint8_t*)malloc((size_t)table->rows + 1);
+
+	if (selection)
+		memset(selection, 1, (size_t)table->rows + 1);
+
+	return selection;
+}
+
+
+void PdbTypeTableFreeSelection(uint8_t* selection)
+{
+	free(selection);
+}
+
+
+// Each comparison is a branch free pass over one column that the compiler
+// can vectorize.  The selection is and'ed with the result.
+#define FILTER_COLUMN(selection, column, rows, op, value) \
+	do \
+	{ \
+		uint32_t i; \
+		switch (op) \
+		{ \
+		case PDB_TYPE_OP_EQ: \
+			for (i = 0; i < (rows); i++) \
+				(selection)[i] &= (uint8_t)((uint64_t)(column)[i] == (value)); \
+			break; \
+		case PDB_TYPE_OP_NE: \
+			for (i = 0; i < (rows); i++) \
+				(selection)[i] &= (uint8_t)((uint64_t)(column)[i] != (value)); \
+			break; \
+		case PDB_TYPE_OP_LT: \
+			for (i = 0; i < (rows); i++) \
+				(selection)[i] &= (uint8_t)((uint64_t)(column)[i] < (value)); \
+			break; \
+		case PDB_TYPE_OP_LE: \
+			for (i = 0; i < (rows); i++) \
+				(selection)[i] &= (uint8_t)((uint64_t)(column)[i] <= (value)); \
+			break; \
+		case PDB_TYPE_OP_GT: \
+			for (i = 0; i < (rows); i++) \
+				(selection)[i] &= (uint8_t)((uint64_t)(column)[i] > (value)); \
+			break; \
+		case PDB_TYPE_OP_GE: \
+			for (i = 0; i < (rows); i++) \
+				(selection)[i] &= (uint8_t)((uint64_t)(column)[i] >= (value)); \
+			break; \
+		case PDB_TYPE_OP_ALL_BITS: \
+			for (i = 0; i < (rows); i++) \
+				(selection)[i] &= (uint8_t)(((uint64_t)(column)[i] & (value)) == (value)); \
+			break; \
+		case PDB_TYPE_OP_ANY_BITS: \
+			for (i = 0; i < (rows); i++) \
+				(selection)[i] &= (uint8_t)(((uint64_t)(column)[i] & (value)) != 0); \
+			break; \
+		default: \
+			memset((selection), 0, (rows)); \
+			break; \
+		} \
+	} while (0)
+
+
+void PdbTypeTableFilter(PDB_TYPE_TABLE* table, uint8_t* selection,
+	PDB_TYPE_COLUMN column, PDB_TYPE_OP op, uint64_t value)
+{
+	switch (column)
+	{
+	case PDB_TYPE_COLUMN_LEAF:
+		FILTER_COLUMN(selection, table->leaf, table->rows, op, value);
+		break;
+	case PDB_TYPE_COLUMN_SIZE:
+		FILTER_COLUMN(selection, table->size, table->rows, op, value);
+		break;
+	case PDB_TYPE_COLUMN_MEMBERS:
+		FILTER_COLUMN(selection, table->memberCount, table->rows, op, value);
+		break;
+	case PDB_TYPE_COLUMN_NAME:
+		FILTER_COLUMN(selection, table->nameId, table->rows, op, value);
+		break;
+	case PDB_TYPE_COLUMN_FIELD:
+		FILTER_COLUMN(selection, table->field, table->rows, op, value);
+		break;
+	case PDB_TYPE_COLUMN_PROP:
+		FILTER_COLUMN(selection, table->prop, table->rows, op, value);
+		break;
+	default:
+		memset(selection, 0, table->rows);
+		break;
+	}
+}
+
+
+void PdbTypeTableFilterEmbeds(PDB_TYPE_TABLE* table, uint8_t* selection, const char* name)
+{
+	uint32_t nameId = PdbTypeTableFindName(table, name);
+	uint8_t* hits;
+	uint32_t i;
+
+	hits = (uint8_t*)calloc((size_t)table->rows + 1, 1);
+
+	if (!hits || (nameId == PDB_TYPE_TABLE_NO_NAME))
+	{
+		free(hits);
+		memset(selection, 0, table->rows);
+		return;
+	}
+
+	// Mark the owners of matching members, then narrow the selection
+	for (i = 0; i < table->members; i++)
+		hits[table->memberOwner[i]] |= (uint8_t)(table->memberTypeName[i] == nameId);
+
+	for (i = 0; i < table->rows; i++)
+		selection[i] &= hits[i];
+
+	free(hits);
+}
+
+
+uint32_t PdbTypeTableCollect(PDB_TYPE_TABLE* table, const uint8_t* selection,
+	uint32_t* rows, uint32_t maxRows)
+{
+	uint32_t count = 0;
+	uint32_t i;
+
+	for (i = 0; i < table->rows; i++)
+	{
+		if (!selection[i])
+			continue;
+
+		if (rows && (count < maxRows))
+			rows[count] = i;
+
+		count++;
+	}
+
+	return count;
+}
@@ -0,0 +1,116 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __TYPETABLE_H__
+#define __TYPETABLE_H__
+
+
+typedef struct PDB_TYPE_TABLE PDB_TYPE_TABLE;
+
+// Name id for rows and members without one
+#define PDB_TYPE_TABLE_NO_NAME 0xffffffff
+
+// The columns of a type table.  One row per struct, class, union and enum
+// definition (forward references are left out), in type index order.
+typedef struct PDB_TYPE_COLUMNS
+{
+	uint32_t rows;
+	const uint32_t* typeId;
+	const uint16_t* leaf; // LEAF_TYPE_STRUCTURE, CLASS, INTERFACE, UNION or ENUM
+	const uint64_t* size; // 0 for enums
+	const uint16_t* memberCount; // As declared by the record
+	const uint32_t* nameId; // See PdbTypeTableGetName
+	const uint32_t* field; // Field list type index
+	const uint16_t* prop; // PDB_TYPE_PROP_* bits
+	const uint32_t* memberStart; // rows + 1 entries, row i's members are [memberStart[i], memberStart[i + 1])
+
+	// The field list entries of every row, continuation lists included
+	uint32_t members;
+	const uint32_t* memberOwner; // Row index
+	const uint16_t* memberLeaf; // LEAF_TYPE_MEMBER, BCLASS, ENUMERATE, ...
+	const uint32_t* memberType; // Type index
+	const uint32_t* memberTypeName; // Name id of the udt it embeds (through modifiers and arrays)
+	const uint64_t* memberOffset; // Offset, or value for enumerates
+	const uint32_t* memberNameId;
+} PDB_TYPE_COLUMNS;
+
+// Columns that can be filtered on
+typedef enum PDB_TYPE_COLUMN
+{
+	PDB_TYPE_COLUMN_LEAF = 0,
+	PDB_TYPE_COLUMN_SIZE = 1,
+	PDB_TYPE_COLUMN_MEMBERS = 2,
+	PDB_TYPE_COLUMN_NAME = 3,
+	PDB_TYPE_COLUMN_FIELD = 4,
+	PDB_TYPE_COLUMN_PROP = 5
+} PDB_TYPE_COLUMN;
+
+typedef enum PDB_TYPE_OP
+{
+	PDB_TYPE_OP_EQ = 0,
+	PDB_TYPE_OP_NE = 1,
+	PDB_TYPE_OP_LT = 2,
+	PDB_TYPE_OP_LE = 3,
+	PDB_TYPE_OP_GT = 4,
+	PDB_TYPE_OP_GE = 5,
+	PDB_TYPE_OP_ALL_BITS = 6, // (column & value) == value
+	PDB_TYPE_OP_ANY_BITS = 7 // (column & value) != 0
+} PDB_TYPE_OP;
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+	// Decode every udt and its field list into memory in one pass over the
+	// type stream.  The table doesn't reference types once loaded.
+	PDBAPI PDB_TYPE_TABLE* PdbTypeTableLoad(PDB_TYPES* types);
+	PDBAPI void PdbTypeTableClose(PDB_TYPE_TABLE* table);
+
+	PDBAPI void PdbTypeTableGetColumns(PDB_TYPE_TABLE* table, PDB_TYPE_COLUMNS* columns);
+	PDBAPI const char* PdbTypeTableGetName(PDB_TYPE_TABLE* table, uint32_t nameId);
+
+	// PDB_TYPE_TABLE_NO_NAME if nothing has this name
+	PDBAPI uint32_t PdbTypeTableFindName(PDB_TYPE_TABLE* table, const char* name);
+
+	// Queries work on a selection, one byte per row that is nonzero if the
+	// row is selected.  Filters narrow the selection down and can be chained.
+	PDBAPI uint8_t* PdbTypeTableSelectAll(PDB_TYPE_TABLE* table);
+	PDBAPI void PdbTypeTableFreeSelection(uint8_t* selection);
+
+	PDBAPI void PdbTypeTableFilter(PDB_TYPE_TABLE* table, uint8_t* selection,
+		PDB_TYPE_COLUMN column, PDB_TYPE_OP op, uint64_t value);
+
+	// Keep the rows with a member or base class of the named type
+	PDBAPI void PdbTypeTableFilterEmbeds(PDB_TYPE_TABLE* table, uint8_t* selection, const char* name);
+
+	// Count the selected rows, and copy up to maxRows of their indices into rows
+	PDBAPI uint32_t PdbTypeTableCollect(PDB_TYPE_TABLE* table, const uint8_t* selection,
+		uint32_t* rows, uint32_t maxRows);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __TYPETABLE_H__ */
@@ -0,0 +1,807 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "pdb.h"
+#include "tpi.h"
+#include "dbi.h"
+#include "publics.h"
+#include "address.h"
+#include "pool.h"
+#include "serve.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif /* WIN32 */
+
+// Line protocol, one request per line, one response line per request in
+// the order the requests were sent:
+//
+//   pdbs                        ok 0:<name> 1:<name> ...
+//   addr <pdb> <seg>:<offset>   ok <symbol>+0x<displacement>
+//   rva <pdb> <rva>             ok <symbol>+0x<displacement>
+//   sym <pdb> <name>            ok <seg>:0x<offset>
+//   type <pdb> <name>           ok <kind> ti=0x<ti> size=0x<size> members=<count> field=0x<ti>
+//
+// <pdb> is the index of the pdb on the command line or its file name.  rva
+// takes an address in the image, which goes through OMAP if the image was
+// reordered after linking.
+// Failures are reported as "err <reason>".
+//
+// Clients can write any number of requests without waiting.  Everything
+// that has arrived on a connection is handed to a worker as one batch and
+// answered with a single write, so many small requests don't turn into
+// many round trips.  Each connection has at most one batch in flight (that
+// keeps its responses in order), batches from different clients run on
+// the worker pool concurrently.
+
+
+typedef struct SERVE_PDB
+{
+	const char* path;
+	const char* name; // File name without the directory
+	PDB_FILE* pdb;
+	PDB_TYPES* types;
+	PDB_DBI* dbi;
+	PDB_PUBLICS* publics; // In memory, safe to use from any worker
+	PDB_ADDRESS_MAP* addresses; // Also in memory
+	PDB_LOCK* lock; // Serializes everything that reads the file
+} SERVE_PDB;
+
+typedef struct SERVE_OUTPUT
+{
+	char* data;
+	size_t len;
+	size_t size;
+} SERVE_OUTPUT;
+
+typedef struct SERVE_CONNECTION
+{
+	int in;
+	int out;
+	char* data; // Input that hasn't been handed to a worker
+	size_t used;
+	size_t size;
+	char* batch; // Complete lines being answered by a worker
+	size_t batchLen;
+	bool busy; // A worker owns the batch
+	bool eof;
+	struct SERVE_CONNECTION* next;
+} SERVE_CONNECTION;
+
+typedef struct SERVER
+{
+	SERVE_PDB* pdbs;
+	int pdbCount;
+	PDB_POOL* pool;
+	PDB_LOCK* lock; // Protects the connections' busy flags
+	SERVE_CONNECTION* connections;
+	int wake[2]; // Workers poke the main loop when a batch is done
+} SERVER;
+
+static SERVER g_server;
+
+
+static void OutputAppend(SERVE_OUTPUT* out, const char* str, size_t len)
+{
+	if (out->len + len > out->size)
+	{
+		out->size = (out->len + len) * 2;
+		out->data = (char*)realloc(out->data, out->size);
+	}
+
+	memcpy(out->data + out->len, str, len);
+	out->len += len;
+}
+
+
+static void OutputString(SERVE_OUTPUT* out, const char* str)
+{
+	OutputAppend(out, str, strlen(str));
+}
+
+
+static SERVE_PDB* FindPdb(const char* id)
+{
+	const char* p;
+	char* end;
+	unsigned long index;
+	int i;
+
+	// An index...
+	for (p = id; isdigit((unsigned char)*p); p++)
+		;
+
+	if ((*p == 0) && (p != id))
+	{
+		errno = 0;
+		index = strtoul(id, &end, 10);
+		if ((errno != 0) || (*end != 0) || (index >= (unsigned long)g_server.pdbCount))
+			return NULL;
+
+		return &g_server.pdbs[index];
+	}
+
+	// ...or a name
+	for (i = 0; i < g_server.pdbCount; i++)
+	{
+		if ((strcmp(g_server.pdbs[i].name, id) == 0) || (strcmp(g_server.pdbs[i].path, id) == 0))
+			return &g_server.pdbs[i];
+	}
+
+	return NULL;
+}
+
+
+static const char* LeafName(PDB_LEAF_TYPES leaf)
+{
+	switch (leaf)
+	{
+	case LEAF_TYPE_STRUCTURE:
+		return "struct";
+	case LEAF_TYPE_CLASS:
+		return "class";
+	case LEAF_TYPE_UNION:
+		return "union";
+	case LEAF_TYPE_ENUM:
+		return "enum";
+	default:
+		return "unknown";
+	}
+}
+
+
+// Split off the next space delimited token (strtok isn't thread safe)
+static char* NextToken(char** cursor)
+{
+	char* token = *cursor;
+
+	while (isspace((unsigned char)*token))
+		token++;
+
+	if (*token == 0)
+		return NULL;
+
+	*cursor = token;
+	while (**cursor && !isspace((unsigned char)**cursor))
+		(*cursor)++;
+
+	if (**cursor)
+		*(*cursor)++ = 0;
+
+	return token;
+}
+
+
+// Answer a single request line (without the newline)
+static void ServeQuery(char* line, SERVE_OUTPUT* out)
+{
+	char response[512];
+	char* cmd;
+	char* pdbId;
+	char* arg;
+	char* cursor = line;
+	SERVE_PDB* target;
+	size_t len = strlen(line);
+
+	// Tolerate CRLF clients
+	if (len && (line[len - 1] == '\r'))
+		line[--len] = 0;
+
+	cmd = NextToken(&cursor);
+
+	if (!cmd)
+	{
+		OutputString(out, "err empty request\n");
+		return;
+	}
+
+	if (strcmp(cmd, "pdbs") == 0)
+	{
+		int i;
+
+		OutputString(out, "ok");
+		for (i = 0; i < g_server.pdbCount; i++)
+		{
+			sprintf(response, " %d:", i);
+			OutputString(out, response);
+			OutputString(out, g_server.pdbs[i].name);
+		}
+		OutputString(out, "\n");
+		return;
+	}
+
+	if ((strcmp(cmd, "addr") != 0) && (strcmp(cmd, "rva") != 0) && (strcmp(cmd, "sym") != 0)
+		&& (strcmp(cmd, "type") != 0))
+	{
+		OutputString(out, "err unknown request\n");
+		return;
+	}
+
+	pdbId = NextToken(&cursor);
+
+	// Names may contain spaces (templates), take the rest of the line
+	arg = cursor;
+	while (isspace((unsigned char)*arg))
+		arg++;
+
+	if (!pdbId || (*arg == 0))
+	{
+		OutputString(out, "err missing arguments\n");
+		return;
+	}
+
+	target = FindPdb(pdbId);
+	if (!target)
+	{
+		OutputString(out, "err unknown pdb\n");
+		return;
+	}
+
+	if (strcmp(cmd, "addr") == 0)
+	{
+		PDB_SYMBOL symbol;
+		unsigned long segment;
+		unsigned long offset;
+		char* end;
+
+		segment = strtoul(arg, &end, 0);
+		if (*end != ':')
+		{
+			OutputString(out, "err expected <segment>:<offset>\n");
+			return;
+		}
+		offset = strtoul(end + 1, NULL, 0);
+
+		if (!target->publics
+			|| !PdbPublicsFindByAddress(target->publics, (uint16_t)segment, (uint32_t)offset, &symbol))
+		{
+			OutputString(out, "err not found\n");
+			return;
+		}
+
+		OutputString(out, "ok ");
+		OutputString(out, symbol.name);
+		sprintf(response, "+0x%x\n", (uint32_t)offset - symbol.offset);
+		OutputString(out, response);
+	}
+	else if (strcmp(cmd, "rva") == 0)
+	{
+		PDB_SYMBOL symbol;
+		uint16_t segment;
+		uint32_t offset;
+
+		if (!target->addresses || !target->publics
+			|| !PdbAddressMapRvaToSection(target->addresses, (uint32_t)strtoul(arg, NULL, 0), &segment, &offset)
+			|| !PdbPublicsFindByAddress(target->publics, segment, offset, &symbol))
+		{
+			OutputString(out, "err not found\n");
+			return;
+		}
+
+		OutputString(out, "ok ");
+		OutputString(out, symbol.name);
+		sprintf(response, "+0x%x\n", offset - symbol.offset);
+		OutputString(out, response);
+	}
+	else if (strcmp(cmd, "sym") == 0)
+	{
+		PDB_SYMBOL symbol;
+
+		if (!target->publics || !PdbPublicsFindByName(target->publics, arg, &symbol))
+		{
+			OutputString(out, "err not found\n");
+			return;
+		}
+
+		sprintf(response, "ok %u:0x%x\n", (uint32_t)symbol.segment, symbol.offset);
+		OutputString(out, response);
+	}
+	else
+	{
+		PDB_TYPE_UDT udt;
+		bool found = false;
+
+		// Type lookups read the file
+		if (target->types)
+		{
+			PdbLockAcquire(target->lock);
+			found = PdbTypesFind(target->types, arg, &udt);
+			PdbLockRelease(target->lock);
+		}
+
+		if (!found)
+		{
+			OutputString(out, "err not found\n");
+			return;
+		}
+
+		sprintf(response, "ok %s ti=0x%x size=0x%llx members=%u field=0x%x\n",
+			LeafName(udt.leaf), udt.typeId, (unsigned long long)udt.size,
+			(uint32_t)udt.count, udt.field);
+		OutputString(out, response);
+	}
+}
+
+
+// Answer every line in buff, which ends with a newline
+static void ServeLines(char* buff, size_t len, SERVE_OUTPUT* out)
+{
+	char* line = buff;
+	char* end = buff + len;
+
+	while (line < end)
+	{
+		char* newline = (char*)memchr(line, '\n', end - line);
+
+		*newline = 0;
+		ServeQuery(line, out);
+		line = newline + 1;
+	}
+}
+
+
+static bool LoadPdb(SERVE_PDB* entry, char* path)
+{
+	const char* name;
+
+	entry->path = path;
+	entry->pdb = PdbOpen(path);
+
+	if (!entry->pdb)
+		return false;
+
+	entry->lock = PdbLockCreate();
+	if (!entry->lock)
+	{
+		PdbClose(entry->pdb);
+		return false;
+	}
+
+	// Drop the directory for the short name
+	name = strrchr(path, '/');
+#ifdef WIN32
+	if (!name)
+		name = strrchr(path, '\\');
+#endif /* WIN32 */
+	entry->name = name ? (name + 1) : path;
+
+	// Whatever is missing just makes those queries fail
+	entry->types = PdbTypesOpen(entry->pdb);
+	entry->dbi = PdbDbiOpen(entry->pdb);
+	entry->publics = entry->dbi ? PdbPublicsOpen(entry->dbi) : NULL;
+	entry->addresses = entry->dbi ? PdbAddressMapOpen(entry->dbi) : NULL;
+
+	return true;
+}
+
+
+static void UnloadPdb(SERVE_PDB* entry)
+{
+	if (entry->addresses)
+		PdbAddressMapClose(entry->addresses);
+	if (entry->publics)
+		PdbPublicsClose(entry->publics);
+	if (entry->dbi)
+		PdbDbiClose(entry->dbi);
+	if (entry->types)
+		PdbTypesClose(entry->types);
+	PdbLockDestroy(entry->lock);
+	PdbClose(entry->pdb);
+}
+
+
+#ifndef WIN32
+
+static void ServeBatch(void* ctxt)
+{
+	SERVE_CONNECTION* conn = (SERVE_CONNECTION*)ctxt;
+	SERVE_OUTPUT out;
+	size_t written = 0;
+
+	out.data = NULL;
+	out.len = 0;
+	out.size = 0;
+
+	ServeLines(conn->batch, conn->batchLen, &out);
+
+	// One write for the whole batch
+	while (written < out.len)
+	{
+		ssize_t n = write(conn->out, out.data + written, out.len - written);
+
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			// The client went away, the main loop will see it on the next read
+			break;
+		}
+
+		written += n;
+	}
+
+	free(out.data);
+	free(conn->batch);
+	conn->batch = NULL;
+
+	PdbLockAcquire(g_server.lock);
+	conn->busy = false;
+	PdbLockRelease(g_server.lock);
+
+	// Let the main loop hand out the next batch
+	while ((write(g_server.wake[1], "", 1) < 0) && (errno == EINTR))
+		;
+}
+
+
+static void AddConnection(int in, int out)
+{
+	SERVE_CONNECTION* conn = (SERVE_CONNECTION*)malloc(sizeof(SERVE_CONNECTION));
+
+	memset(conn, 0, sizeof(SERVE_CONNECTION));
+	conn->in = in;
+	conn->out = out;
+	conn->next = g_server.connections;
+	g_server.connections = conn;
+}
+
+
+static void CloseConnection(SERVE_CONNECTION* conn)
+{
+	SERVE_CONNECTION** link;
+
+	for (link = &g_server.connections; *link != conn; link = &(*link)->next)
+		;
+	*link = conn->next;
+
+	if (conn->in > STDERR_FILENO)
+		close(conn->in);
+	if ((conn->out != conn->in) && (conn->out > STDERR_FILENO))
+		close(conn->out);
+
+	free(conn->data);
+	free(conn);
+}
+
+
+static void ReadConnection(SERVE_CONNECTION* conn)
+{
+	ssize_t n;
+
+	if (conn->size - conn->used < 4096)
+	{
+		conn->size = (conn->size + 4096) * 2;
+		conn->data = (char*)realloc(conn->data, conn->size);
+	}
+
+	n = read(conn->in, conn->data + conn->used, conn->size - conn->used);
+
+	if (n < 0)
+	{
+		if (errno != EINTR)
+			conn->eof = true;
+		return;
+	}
+
+	if (n == 0)
+	{
+		// Answer a last request that wasn't newline terminated
+		if (conn->used && (conn->data[conn->used - 1] != '\n'))
+			conn->data[conn->used++] = '\n';
+
+		conn->eof = true;
+		return;
+	}
+
+	conn->used += n;
+}
+
+
+// Hand the complete lines buffered on an idle connection to a worker
+static bool DispatchConnection(SERVE_CONNECTION* conn)
+{
+	char* lastNewline = NULL;
+	size_t i;
+
+	for (i = conn->used; i > 0; i--)
+	{
+		if (conn->data[i - 1] == '\n')
+		{
+			lastNewline = &conn->data[i - 1];
+			break;
+		}
+	}
+
+	if (!lastNewline)
+		return false;
+
+	conn->batchLen = (lastNewline - conn->data) + 1;
+	conn->batch = (char*)malloc(conn->batchLen);
+	memcpy(conn->batch, conn->data, conn->batchLen);
+
+	// Keep the partial line for later
+	conn->used -= conn->batchLen;
+	memmove(conn->data, conn->data + conn->batchLen, conn->used);
+
+	conn->busy = true;
+	PdbPoolSubmit(g_server.pool, ServeBatch, conn);
+
+	return true;
+}
+
+
+static int ServeLoop(int listenFd)
+{
+	struct pollfd* fds = NULL;
+	SERVE_CONNECTION** polled = NULL;
+	size_t capacity = 0;
+
+	for (;;)
+	{
+		SERVE_CONNECTION* conn;
+		SERVE_CONNECTION* next;
+		size_t count = 0;
+		size_t i;
+		char drain[64];
+
+		// Hand out work and reap finished connections
+		PdbLockAcquire(g_server.lock);
+		for (conn = g_server.connections; conn; conn = next)
+		{
+			next = conn->next;
+
+			if (conn->busy || DispatchConnection(conn))
+				continue;
+
+			if (conn->eof)
+				CloseConnection(conn);
+		}
+		PdbLockRelease(g_server.lock);
+
+		// In stdin mode there is nothing left to do once stdin is done
+		if ((listenFd < 0) && !g_server.connections)
+			break;
+
+		for (conn = g_server.connections; conn; conn = conn->next)
+			count++;
+
+		if (count + 2 > capacity)
+		{
+			capacity = (count + 2) * 2;
+			fds = (struct pollfd*)realloc(fds, capacity * sizeof(struct pollfd));
+			polled = (SERVE_CONNECTION**)realloc(polled, capacity * sizeof(SERVE_CONNECTION*));
+		}
+
+		count = 0;
+		fds[count].fd = g_server.wake[0];
+		fds[count].events = POLLIN;
+		polled[count++] = NULL;
+
+		if (listenFd >= 0)
+		{
+			fds[count].fd = listenFd;
+			fds[count].events = POLLIN;
+			polled[count++] = NULL;
+		}
+
+		// Keep reading from busy connections too so requests pipeline
+		for (conn = g_server.connections; conn; conn = conn->next)
+		{
+			if (conn->eof)
+				continue;
+
+			fds[count].fd = conn->in;
+			fds[count].events = POLLIN;
+			polled[count++] = conn;
+		}
+
+		if (poll(fds, count, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (fds[0].revents)
+		{
+			while (read(g_server.wake[0], drain, sizeof(drain)) == sizeof(drain))
+				;
+		}
+
+		for (i = 1; i < count; i++)
+		{
+			if (!fds[i].revents)
+				continue;
+
+			if (polled[i])
+			{
+				ReadConnection(polled[i]);
+			}
+			else
+			{
+				int client = accept(listenFd, NULL, NULL);
+
+				if (client >= 0)
+					AddConnection(client, client);
+			}
+		}
+	}
+
+	free(fds);
+	free(polled);
+
+	return 0;
+}
+
+
+static int Listen(const char* socketPath)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(socketPath) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, "Socket path is too long.\n");
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socketPath);
+
+	// Replace a stale socket from a previous run
+	unlink(socketPath);
+
+	if ((bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) || (listen(fd, 64) < 0))
+	{
+		fprintf(stderr, "Failed to listen on %s.  OS reports: %s\n", socketPath, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+#endif /* WIN32 */
+
+
+int Serve(char** pdbFiles, int pdbCount, const char* socketPath, uint32_t threads)
+{
+	int result = 0;
+	int i;
+
+	g_server.pdbs = (SERVE_PDB*)malloc(sizeof(SERVE_PDB) * pdbCount);
+	g_server.pdbCount = 0;
+
+	// Pay the open costs once, up front
+	for (i = 0; i < pdbCount; i++)
+	{
+		if (!LoadPdb(&g_server.pdbs[g_server.pdbCount], pdbFiles[i]))
+		{
+			fprintf(stderr, "Failed to open pdb file %s\n", pdbFiles[i]);
+			continue;
+		}
+
+		g_server.pdbCount++;
+	}
+
+	fprintf(stderr, "Serving %d pdbs.\n", g_server.pdbCount);
+
+#ifdef WIN32
+	// No poll() for stdin here, answer one line at a time
+	if (socketPath)
+	{
+		fprintf(stderr, "Sockets are not supported on this platform.\n");
+		result = 8;
+	}
+	else
+	{
+		char line[4096];
+		SERVE_OUTPUT out;
+
+		out.data = NULL;
+		out.size = 0;
+
+		while (fgets(line, sizeof(line), stdin))
+		{
+			size_t len = strlen(line);
+
+			if (len && (line[len - 1] == '\n'))
+				line[len - 1] = 0;
+
+			out.len = 0;
+			ServeQuery(line, &out);
+			fwrite(out.data, 1, out.len, stdout);
+			fflush(stdout);
+		}
+
+		free(out.data);
+	}
+	(void)threads;
+#else
+	{
+		int listenFd = -1;
+
+		// A client hanging up shouldn't take the server down
+		signal(SIGPIPE, SIG_IGN);
+
+		g_server.lock = PdbLockCreate();
+		g_server.pool = PdbPoolCreate(threads);
+		g_server.connections = NULL;
+
+		// Both ends are non-blocking so draining never stalls the loop and a
+		// full pipe never stalls a worker
+		if (!g_server.lock || !g_server.pool || (pipe(g_server.wake) < 0) ||
+			(fcntl(g_server.wake[0], F_SETFL, O_NONBLOCK) < 0) ||
+			(fcntl(g_server.wake[1], F_SETFL, O_NONBLOCK) < 0))
+		{
+			fprintf(stderr, "Failed to start the workers.\n");
+			return 8;
+		}
+
+		if (socketPath)
+		{
+			listenFd = Listen(socketPath);
+			if (listenFd < 0)
+				return 8;
+		}
+		else
+		{
+			AddConnection(STDIN_FILENO, STDOUT_FILENO);
+		}
+
+		result = ServeLoop(listenFd);
+
+		PdbPoolWait(g_server.pool);
+		PdbPoolDestroy(g_server.pool);
+		PdbLockDestroy(g_server.lock);
+		close(g_server.wake[0]);
+		close(g_server.wake[1]);
+
+		if (listenFd >= 0)
+		{
+			close(listenFd);
+			unlink(socketPath);
+		}
+	}
+#endif /* WIN32 */
+
+	for (i = 0; i < g_server.pdbCount; i++)
+		UnloadPdb(&g_server.pdbs[i]);
+	free(g_server.pdbs);
+
+	return result;
+}
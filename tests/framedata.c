@@ -0,0 +1,198 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "dbi.h"
+#include "framedata.h"
+#include "tests.h"
+
+
+#define TEST_FRAMEDATA_STREAM 5
+#define TEST_NAMES_STREAM 6
+
+
+typedef struct TEST_MEMORY
+{
+	uint32_t address;
+	uint32_t value;
+} TEST_MEMORY;
+
+// The stack the frames unwind through
+static const TEST_MEMORY g_stack[] =
+{
+	{0x10018, 0x00401234}, // Return address above 0x10 of locals and 8 of saved registers
+	{0x1fff0, 0x00005151}, // Saved esi
+	{0x1fff4, 0x0000b0b0}, // Saved ebx
+	{0x20000, 0x00030000}, // Caller's ebp
+	{0x20004, 0x00402000} // Return address
+};
+
+// The shapes MSVC writes: the locals and params base in $L and $P, and
+// registers saved by number
+static const char* const g_programs[] =
+{
+	"$T0 .raSearch = $eip $T0 ^ = $esp $T0 4 + = $L $T0 .cbSavedRegs - = $P $T0 8 + .cbParams + = $edi $L =",
+	"$T0 $ebp = $eip $T0 4 + ^ = $ebp $T0 ^ = $esp $T0 8 + = $20 $T0 12 - ^ = $23 $T0 16 - ^ = "
+		"$ebx $20 = $esi $23 =",
+	"$a0 1 = $a1 1 = $a2 1 = $a3 1 = $a4 1 = $a5 1 = $a6 1 = $a7 1 = $a8 1 = $a9 1 = $a10 1 = $a11 1 = "
+		"$a12 1 = $a13 1 = $a14 1 = $a15 1 = $a16 1 =",
+	"$T0 $ebp = $eip $T0 4 + ^ = $ebp $T0 ^ = $esp $T0 8 + ="
+};
+
+#define TEST_PROGRAM_COUNT (sizeof(g_programs) / sizeof(g_programs[0]))
+
+
+static bool ReadStack(void* ctxt, uint32_t address, uint32_t* value)
+{
+	uint32_t i;
+
+	(void)ctxt;
+
+	for (i = 0; i < sizeof(g_stack) / sizeof(g_stack[0]); i++)
+	{
+		if (g_stack[i].address == address)
+		{
+			*value = g_stack[i].value;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+// A FRAMEDATA record for a block at rva
+static void AddRecord(uint8_t* raw, uint32_t rva, uint32_t locals, uint32_t params, uint32_t program,
+	uint16_t savedRegs)
+{
+	uint32_t size = 0x100;
+	uint32_t maxStack = 0x100;
+	uint16_t prolog = 4;
+	uint32_t flags = 0;
+
+	memcpy(raw, &rva, 4);
+	memcpy(raw + 4, &size, 4);
+	memcpy(raw + 8, &locals, 4);
+	memcpy(raw + 12, &params, 4);
+	memcpy(raw + 16, &maxStack, 4);
+	memcpy(raw + 20, &program, 4);
+	memcpy(raw + 24, &prolog, 2);
+	memcpy(raw + 26, &savedRegs, 2);
+	memcpy(raw + 28, &flags, 4);
+}
+
+
+static void SetRegisters(uint32_t regs[PDB_FRAME_REG_COUNT], uint32_t eip, uint32_t esp, uint32_t ebp)
+{
+	uint32_t i;
+
+	for (i = 0; i < PDB_FRAME_REG_COUNT; i++)
+		regs[i] = 0xcccc0000 + i;
+
+	regs[PDB_FRAME_REG_EIP] = eip;
+	regs[PDB_FRAME_REG_ESP] = esp;
+	regs[PDB_FRAME_REG_EBP] = ebp;
+}
+
+
+void TestFrameData(void)
+{
+	TEST_PDB* test = TestPdbCreate();
+	uint16_t debugStreams[PDB_DEBUG_STREAM_COUNT];
+	uint32_t offsets[TEST_PROGRAM_COUNT];
+	uint8_t records[TEST_PROGRAM_COUNT * 32];
+	uint32_t regs[PDB_FRAME_REG_COUNT];
+	PDB_FRAME_RECORD record;
+	PDB_FRAME_DATA* frames;
+	PDB_DBI* dbi;
+	PDB_FILE* pdb;
+	uint32_t i;
+
+	TEST_CHECK(test != NULL);
+	if (!test)
+		return;
+
+	TEST_CHECK(TestPdbSetNames(test, TEST_NAMES_STREAM, g_programs, TEST_PROGRAM_COUNT, offsets));
+
+	// One block per program, 0x1000 apart
+	AddRecord(records, 0x1000, 0x10, 8, offsets[0], 8);
+	AddRecord(records + 32, 0x2000, 0, 0, offsets[1], 8);
+	AddRecord(records + 64, 0x3000, 0, 0, offsets[2], 0);
+	AddRecord(records + 96, 0x4000, 0, 0, offsets[3], 0);
+	TEST_CHECK(TestPdbSetStream(test, TEST_FRAMEDATA_STREAM, records, sizeof(records)));
+
+	for (i = 0; i < PDB_DEBUG_STREAM_COUNT; i++)
+		debugStreams[i] = PDB_STREAM_NONE;
+	debugStreams[PDB_DEBUG_NEW_FPO] = TEST_FRAMEDATA_STREAM;
+	TEST_CHECK(TestPdbSetDbi(test, debugStreams, PDB_DEBUG_STREAM_COUNT));
+
+	pdb = TestPdbOpen(test);
+	TEST_CHECK(pdb != NULL);
+	dbi = pdb ? PdbDbiOpen(pdb) : NULL;
+	TEST_CHECK(dbi != NULL);
+	frames = dbi ? PdbFrameDataOpen(dbi) : NULL;
+	TEST_CHECK(frames != NULL);
+
+	if (!frames)
+		goto DONE;
+
+	TEST_CHECK(PdbFrameDataGetCount(frames) == TEST_PROGRAM_COUNT);
+	TEST_CHECK(PdbFrameDataFind(frames, 0x1080, &record));
+	TEST_CHECK(record.program && (strcmp(record.program, g_programs[0]) == 0));
+
+	// $L and $P are scratch, $edi picks up $L
+	SetRegisters(regs, 0x1080, 0x10000, 0x20000);
+	TEST_CHECK(PdbFrameDataUnwind(frames, 0x1080, regs, ReadStack, NULL));
+	TEST_CHECK(regs[PDB_FRAME_REG_EIP] == 0x00401234);
+	TEST_CHECK(regs[PDB_FRAME_REG_ESP] == 0x1001c);
+	TEST_CHECK(regs[PDB_FRAME_REG_EBP] == 0x20000);
+	TEST_CHECK(regs[PDB_FRAME_REG_EDI] == 0x10010);
+
+	// Registers saved by number come back through their scratch slots
+	SetRegisters(regs, 0x2010, 0x1ff00, 0x20000);
+	TEST_CHECK(PdbFrameDataUnwind(frames, 0x2010, regs, ReadStack, NULL));
+	TEST_CHECK(regs[PDB_FRAME_REG_EIP] == 0x00402000);
+	TEST_CHECK(regs[PDB_FRAME_REG_ESP] == 0x20008);
+	TEST_CHECK(regs[PDB_FRAME_REG_EBP] == 0x00030000);
+	TEST_CHECK(regs[PDB_FRAME_REG_EBX] == 0x0000b0b0);
+	TEST_CHECK(regs[PDB_FRAME_REG_ESI] == 0x00005151);
+	TEST_CHECK(regs[PDB_FRAME_REG_EAX] == 0xcccc0000 + PDB_FRAME_REG_EAX);
+
+	// More names than there are scratch slots doesn't compile
+	SetRegisters(regs, 0x3010, 0x1ff00, 0x20000);
+	TEST_CHECK(!PdbFrameDataUnwind(frames, 0x3010, regs, ReadStack, NULL));
+
+	SetRegisters(regs, 0x4010, 0x1ff00, 0x20000);
+	TEST_CHECK(PdbFrameDataUnwind(frames, 0x4010, regs, ReadStack, NULL));
+	TEST_CHECK(regs[PDB_FRAME_REG_EIP] == 0x00402000);
+	TEST_CHECK(regs[PDB_FRAME_REG_ESP] == 0x20008);
+
+DONE:
+	if (frames)
+		PdbFrameDataClose(frames);
+	if (dbi)
+		PdbDbiClose(dbi);
+
+	TestPdbClose(test);
+}
@@ -0,0 +1,511 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pdb.h"
+#include "tests.h"
+
+
+static const char g_msfzSignature[] = "Microsoft MSFZ Container\r\n\x1a" "ALD\0";
+
+#define TEST_MSFZ_SIGNATURE_SIZE 32
+#define TEST_MSFZ_HEADER_SIZE 80
+#define TEST_MSFZ_CHUNK_ENTRY_SIZE 20
+#define TEST_MSFZ_NIL_STREAM 0xffffffff
+#define TEST_MSFZ_CHUNK_LOCATION 0x80000000
+
+#define TEST_MSFZ_MAX_CHUNKS 16
+#define TEST_MSFZ_MAX_DIRECTORY 256
+
+// Stream 0 is nil, 1 is two file fragments, 2 mixes chunk and file
+// fragments, and 3 is big enough to need several read ahead batches
+#define TEST_MSFZ_STREAM_COUNT 4
+#define TEST_MSFZ_MIXED_STREAM 2
+#define TEST_MSFZ_BIG_STREAM 3
+
+// A read ahead batch takes at most a quarter of the 64MB chunk cache, so
+// a read over the big stream's chunks has to decompress them in steps
+#define TEST_MSFZ_BIG_CHUNK_SIZE (4 * 1024 * 1024)
+#define TEST_MSFZ_BIG_CHUNKS 6
+#define TEST_MSFZ_BIG_BATCH 4
+#define TEST_MSFZ_BIG_GAP 16
+
+#define TEST_MSFZ_IMAGE_SIZE ((TEST_MSFZ_BIG_CHUNKS * TEST_MSFZ_BIG_CHUNK_SIZE) + (64 * 1024))
+
+
+typedef struct TEST_MSFZ_CHUNK
+{
+	uint64_t offset;
+	uint32_t size;
+} TEST_MSFZ_CHUNK;
+
+typedef struct TEST_MSFZ
+{
+	uint8_t* image;
+	uint32_t size;
+
+	uint32_t directory[TEST_MSFZ_MAX_DIRECTORY];
+	uint32_t directoryCount;
+	uint32_t directoryOffset;
+	uint32_t streamCount;
+	uint32_t stream; // Stream being added and how much of it there is so far
+	uint32_t streamSize;
+
+	TEST_MSFZ_CHUNK chunks[TEST_MSFZ_MAX_CHUNKS];
+	uint32_t chunkCount;
+	uint32_t chunkTableOffset;
+} TEST_MSFZ;
+
+// Counts the reads of each chunk, and how many of the big stream's chunks
+// had been read when its first file fragment was
+typedef struct TEST_MSFZ_SOURCE
+{
+	const PDB_IO_OPS* ops;
+	void* ctxt;
+	const TEST_MSFZ* msfz;
+	uint32_t chunkReads[TEST_MSFZ_MAX_CHUNKS];
+	uint64_t gapOffset;
+	uint32_t chunksBeforeGap;
+	bool gapRead;
+} TEST_MSFZ_SOURCE;
+
+
+// The byte at offset in a stream, different for each stream
+static uint8_t Pattern(uint32_t streamId, uint64_t offset)
+{
+	return (uint8_t)((offset * 7) + (offset >> 9) + (streamId * 61));
+}
+
+
+static uint32_t Append(TEST_MSFZ* msfz, uint32_t bytes)
+{
+	uint32_t offset = msfz->size;
+
+	msfz->size += bytes;
+
+	return offset;
+}
+
+
+static void FillPattern(TEST_MSFZ* msfz, uint32_t offset, uint32_t bytes)
+{
+	uint32_t i;
+
+	for (i = 0; i < bytes; i++)
+		msfz->image[offset + i] = Pattern(msfz->stream, msfz->streamSize + i);
+}
+
+
+static void AddDirectory(TEST_MSFZ* msfz, uint32_t value)
+{
+	msfz->directory[msfz->directoryCount++] = value;
+}
+
+
+static void AddNilStream(TEST_MSFZ* msfz)
+{
+	AddDirectory(msfz, TEST_MSFZ_NIL_STREAM);
+	msfz->streamCount++;
+}
+
+
+static void BeginStream(TEST_MSFZ* msfz)
+{
+	msfz->stream = msfz->streamCount;
+	msfz->streamSize = 0;
+}
+
+
+static void EndStream(TEST_MSFZ* msfz)
+{
+	AddDirectory(msfz, 0);
+	msfz->streamCount++;
+}
+
+
+// The next bytes of the stream, stored in the file
+static uint32_t AddFileFragment(TEST_MSFZ* msfz, uint32_t bytes)
+{
+	uint32_t offset = Append(msfz, bytes);
+
+	FillPattern(msfz, offset, bytes);
+
+	AddDirectory(msfz, bytes);
+	AddDirectory(msfz, offset);
+	AddDirectory(msfz, 0);
+	msfz->streamSize += bytes;
+
+	return offset;
+}
+
+
+// The next bytes of the stream, in a chunk of their own after skip other
+// bytes.  Chunks are stored uncompressed.
+static void AddChunkFragment(TEST_MSFZ* msfz, uint32_t bytes, uint32_t skip)
+{
+	TEST_MSFZ_CHUNK* chunk = &msfz->chunks[msfz->chunkCount];
+	uint32_t offset = Append(msfz, skip + bytes);
+
+	memset(msfz->image + offset, 0xcc, skip);
+	FillPattern(msfz, offset + skip, bytes);
+
+	chunk->offset = offset;
+	chunk->size = skip + bytes;
+
+	AddDirectory(msfz, bytes);
+	AddDirectory(msfz, skip);
+	AddDirectory(msfz, TEST_MSFZ_CHUNK_LOCATION | msfz->chunkCount);
+	msfz->chunkCount++;
+	msfz->streamSize += bytes;
+}
+
+
+// Write the directory, the chunk table and then the header
+static void Finish(TEST_MSFZ* msfz)
+{
+	uint32_t directorySize = msfz->directoryCount * 4;
+	uint32_t tableSize = msfz->chunkCount * TEST_MSFZ_CHUNK_ENTRY_SIZE;
+	uint8_t* header = msfz->image;
+	uint64_t value64;
+	uint32_t value;
+	uint32_t i;
+
+	msfz->directoryOffset = Append(msfz, directorySize);
+	memcpy(msfz->image + msfz->directoryOffset, msfz->directory, directorySize);
+
+	msfz->chunkTableOffset = Append(msfz, tableSize);
+	for (i = 0; i < msfz->chunkCount; i++)
+	{
+		uint8_t* entry = msfz->image + msfz->chunkTableOffset + (i * TEST_MSFZ_CHUNK_ENTRY_SIZE);
+
+		// file offset, no compression, compressed and uncompressed size
+		value = 0;
+		memcpy(entry, &msfz->chunks[i].offset, 8);
+		memcpy(entry + 8, &value, 4);
+		memcpy(entry + 12, &msfz->chunks[i].size, 4);
+		memcpy(entry + 16, &msfz->chunks[i].size, 4);
+	}
+
+	memset(header, 0, TEST_MSFZ_HEADER_SIZE);
+	memcpy(header, g_msfzSignature, TEST_MSFZ_SIGNATURE_SIZE);
+	value64 = msfz->directoryOffset;
+	memcpy(header + 40, &value64, 8);
+	value64 = msfz->chunkTableOffset;
+	memcpy(header + 48, &value64, 8);
+	memcpy(header + 56, &msfz->streamCount, 4);
+	memcpy(header + 64, &directorySize, 4); // Uncompressed, both sizes are the same
+	memcpy(header + 68, &directorySize, 4);
+	memcpy(header + 72, &msfz->chunkCount, 4);
+	memcpy(header + 76, &tableSize, 4);
+}
+
+
+static bool BuildMsfz(TEST_MSFZ* msfz)
+{
+	uint32_t i;
+
+	memset(msfz, 0, sizeof(TEST_MSFZ));
+
+	msfz->image = (uint8_t*)malloc(TEST_MSFZ_IMAGE_SIZE);
+	if (!msfz->image)
+		return false;
+
+	msfz->size = TEST_MSFZ_HEADER_SIZE;
+
+	AddNilStream(msfz);
+
+	BeginStream(msfz);
+	AddFileFragment(msfz, 100);
+	AddFileFragment(msfz, 60);
+	EndStream(msfz);
+
+	BeginStream(msfz);
+	AddChunkFragment(msfz, 3000, 100);
+	AddFileFragment(msfz, 500);
+	AddChunkFragment(msfz, 2000, 7);
+	AddChunkFragment(msfz, 1000, 0);
+	EndStream(msfz);
+
+	// Whole chunks with a few file bytes after each
+	BeginStream(msfz);
+	for (i = 0; i < TEST_MSFZ_BIG_CHUNKS; i++)
+	{
+		AddChunkFragment(msfz, TEST_MSFZ_BIG_CHUNK_SIZE, 0);
+		AddFileFragment(msfz, TEST_MSFZ_BIG_GAP);
+	}
+	EndStream(msfz);
+
+	Finish(msfz);
+
+	return true;
+}
+
+
+static bool SourceRead(void* ctxt, uint64_t offset, void* buff, size_t bytes)
+{
+	TEST_MSFZ_SOURCE* source = (TEST_MSFZ_SOURCE*)ctxt;
+	uint32_t i;
+
+	// Chunks are read whole, each by one thread at a time
+	for (i = 0; i < source->msfz->chunkCount; i++)
+	{
+		if (source->msfz->chunks[i].offset == offset)
+			source->chunkReads[i]++;
+	}
+
+	// Only read after the batch of chunks before it was waited for
+	if (source->gapOffset && (offset == source->gapOffset) && !source->gapRead)
+	{
+		source->gapRead = true;
+		for (i = source->msfz->chunkCount - TEST_MSFZ_BIG_CHUNKS; i < source->msfz->chunkCount; i++)
+			source->chunksBeforeGap += source->chunkReads[i] ? 1 : 0;
+	}
+
+	return source->ops->read(source->ctxt, offset, buff, bytes);
+}
+
+
+static uint64_t SourceGetSize(void* ctxt)
+{
+	TEST_MSFZ_SOURCE* source = (TEST_MSFZ_SOURCE*)ctxt;
+
+	return source->ops->getSize(source->ctxt);
+}
+
+
+static void SourceClose(void* ctxt)
+{
+	TEST_MSFZ_SOURCE* source = (TEST_MSFZ_SOURCE*)ctxt;
+
+	if (source->ops->close)
+		source->ops->close(source->ctxt);
+}
+
+
+static const PDB_IO_OPS g_sourceOps =
+{
+	SourceRead,
+	SourceGetSize,
+	NULL,
+	SourceClose
+};
+
+
+// Open the image through the counting source
+static PDB_FILE* OpenMsfz(const TEST_MSFZ* msfz, TEST_MSFZ_SOURCE* source)
+{
+	PDB_FILE* pdb;
+
+	memset(source, 0, sizeof(TEST_MSFZ_SOURCE));
+	source->msfz = msfz;
+
+	source->ops = PdbIoOpenMemory(msfz->image, msfz->size, &source->ctxt);
+	if (!source->ops)
+		return NULL;
+
+	pdb = PdbOpenWithIo(&g_sourceOps, source);
+	if (!pdb)
+		SourceClose(source);
+
+	return pdb;
+}
+
+
+static bool CheckPattern(uint32_t streamId, uint64_t offset, const uint8_t* buff, uint64_t bytes)
+{
+	uint64_t i;
+
+	for (i = 0; i < bytes; i++)
+	{
+		if (buff[i] != Pattern(streamId, offset + i))
+			return false;
+	}
+
+	return true;
+}
+
+
+static bool ReadAndCheck(PDB_STREAM* stream, uint32_t streamId, uint64_t offset, uint64_t bytes)
+{
+	uint8_t buff[8192];
+
+	if ((bytes > sizeof(buff)) || !PdbStreamReadAt(stream, offset, buff, bytes))
+		return false;
+
+	return CheckPattern(streamId, offset, buff, bytes);
+}
+
+
+// Break one thing in a copy of the image and make sure it doesn't open
+static void CheckBroken(const TEST_MSFZ* msfz, uint32_t offset, const void* value, uint32_t size)
+{
+	TEST_MSFZ broken = *msfz;
+	TEST_MSFZ_SOURCE source;
+	PDB_FILE* pdb;
+
+	broken.image = (uint8_t*)malloc(msfz->size);
+	TEST_CHECK(broken.image != NULL);
+	if (!broken.image)
+		return;
+
+	memcpy(broken.image, msfz->image, msfz->size);
+	memcpy(broken.image + offset, value, size);
+
+	pdb = OpenMsfz(&broken, &source);
+	TEST_CHECK(pdb == NULL);
+	if (pdb)
+		PdbClose(pdb);
+
+	free(broken.image);
+}
+
+
+static void TestMsfzHeader(const TEST_MSFZ* msfz)
+{
+	uint64_t version = 1;
+	uint32_t streamCount = TEST_MSFZ_STREAM_COUNT + 1;
+	uint32_t tableSize = TEST_MSFZ_CHUNK_ENTRY_SIZE + 1;
+	uint32_t pastEnd = msfz->size;
+
+	// Unknown version
+	CheckBroken(msfz, TEST_MSFZ_SIGNATURE_SIZE, &version, 8);
+
+	// More streams than the directory lists
+	CheckBroken(msfz, 56, &streamCount, 4);
+
+	// A chunk table size that doesn't match the chunk count
+	CheckBroken(msfz, 76, &tableSize, 4);
+
+	// A chunk that runs past the end of the file
+	CheckBroken(msfz, msfz->chunkTableOffset + 12, &pastEnd, 4);
+
+	// A file fragment (stream 1's first) past the end of the file
+	CheckBroken(msfz, msfz->directoryOffset + 8, &pastEnd, 4);
+}
+
+
+static void TestMsfzStreams(PDB_FILE* pdb)
+{
+	PDB_STREAM* stream;
+
+	TEST_CHECK(PdbGetStreamCount(pdb) == TEST_MSFZ_STREAM_COUNT);
+	TEST_CHECK(PdbStreamOpen(pdb, 0) == NULL);
+
+	stream = PdbStreamOpen(pdb, 1);
+	TEST_CHECK(stream != NULL);
+	if (stream)
+	{
+		TEST_CHECK(PdbStreamGetSize(stream) == 160);
+		TEST_CHECK(ReadAndCheck(stream, 1, 0, 160));
+		TEST_CHECK(ReadAndCheck(stream, 1, 90, 20));
+		PdbStreamClose(stream);
+	}
+
+	stream = PdbStreamOpen(pdb, TEST_MSFZ_MIXED_STREAM);
+	TEST_CHECK(stream != NULL);
+	if (!stream)
+		return;
+
+	TEST_CHECK(PdbStreamGetSize(stream) == 6500);
+
+	// Chunk to file, file to chunk, chunk to chunk, and all four
+	TEST_CHECK(ReadAndCheck(stream, TEST_MSFZ_MIXED_STREAM, 2990, 20));
+	TEST_CHECK(ReadAndCheck(stream, TEST_MSFZ_MIXED_STREAM, 3400, 200));
+	TEST_CHECK(ReadAndCheck(stream, TEST_MSFZ_MIXED_STREAM, 5499, 2));
+	TEST_CHECK(ReadAndCheck(stream, TEST_MSFZ_MIXED_STREAM, 0, 6500));
+	TEST_CHECK(ReadAndCheck(stream, TEST_MSFZ_MIXED_STREAM, 6499, 1));
+
+	// Not past the end
+	TEST_CHECK(!ReadAndCheck(stream, TEST_MSFZ_MIXED_STREAM, 6499, 2));
+
+	PdbStreamClose(stream);
+}
+
+
+static void TestMsfzReadAhead(PDB_FILE* pdb, TEST_MSFZ_SOURCE* source)
+{
+	uint64_t size = (uint64_t)TEST_MSFZ_BIG_CHUNKS * (TEST_MSFZ_BIG_CHUNK_SIZE + TEST_MSFZ_BIG_GAP);
+	PDB_STREAM* stream;
+	uint8_t* buff;
+	uint32_t i;
+
+	stream = PdbStreamOpen(pdb, TEST_MSFZ_BIG_STREAM);
+	TEST_CHECK(stream != NULL);
+	if (!stream)
+		return;
+
+	TEST_CHECK(PdbStreamGetSize(stream) == size);
+
+	buff = (uint8_t*)malloc((size_t)size);
+	TEST_CHECK(buff != NULL);
+	if (!buff)
+	{
+		PdbStreamClose(stream);
+		return;
+	}
+
+	// The first gap is read once the first batch is copied out, before the
+	// chunks past the batch are decompressed
+	source->gapOffset = source->msfz->chunks[source->msfz->chunkCount - TEST_MSFZ_BIG_CHUNKS].offset
+		+ TEST_MSFZ_BIG_CHUNK_SIZE;
+
+	TEST_CHECK(PdbStreamReadAt(stream, 0, buff, size));
+	TEST_CHECK(CheckPattern(TEST_MSFZ_BIG_STREAM, 0, buff, size));
+	TEST_CHECK(source->gapRead);
+	TEST_CHECK(source->chunksBeforeGap == TEST_MSFZ_BIG_BATCH);
+
+	// Every chunk is decompressed once, none is dropped before it is used
+	for (i = source->msfz->chunkCount - TEST_MSFZ_BIG_CHUNKS; i < source->msfz->chunkCount; i++)
+		TEST_CHECK(source->chunkReads[i] == 1);
+
+	free(buff);
+	PdbStreamClose(stream);
+}
+
+
+void TestMsfz(void)
+{
+	TEST_MSFZ msfz;
+	TEST_MSFZ_SOURCE source;
+	PDB_FILE* pdb;
+
+	TEST_CHECK(BuildMsfz(&msfz));
+	if (!msfz.image)
+		return;
+
+	TestMsfzHeader(&msfz);
+
+	pdb = OpenMsfz(&msfz, &source);
+	TEST_CHECK(pdb != NULL);
+
+	if (pdb)
+	{
+		TestMsfzStreams(pdb);
+		TestMsfzReadAhead(pdb, &source);
+		PdbClose(pdb);
+	}
+
+	free(msfz.image);
+}
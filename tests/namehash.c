@@ -0,0 +1,281 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "namehash.h"
+#include "tests.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif /* WIN32 */
+
+
+// Longer than two of the widest vectors so every length mod the width is
+// covered, with each start alignment in a vector
+#define TEST_MAX_NAME 100
+#define TEST_ALIGNMENTS 32
+#define TEST_BUFFER_SIZE (TEST_MAX_NAME + TEST_ALIGNMENTS + 1)
+
+
+// Upper and lower case, punctuation and bytes above 0x7f, never 0
+static void FillName(char* name, size_t len, uint32_t seed)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		seed = (seed * 1103515245) + 12345;
+		name[i] = (char)(((seed >> 16) % 255) + 1);
+	}
+
+	name[len] = 0;
+}
+
+
+// What the scalar kernels say about a name
+typedef struct TEST_NAME_RESULT
+{
+	uint32_t hash;
+	uint32_t hashLength;
+	size_t length;
+	char lower[TEST_BUFFER_SIZE];
+} TEST_NAME_RESULT;
+
+
+static void Evaluate(const char* name, size_t len, TEST_NAME_RESULT* result)
+{
+	result->hash = PdbHashName(name);
+	result->hashLength = PdbHashNameLength(name, len);
+	result->length = PdbNameLength(name);
+	PdbNameToLower(result->lower, name, len);
+}
+
+
+static bool SameResult(const TEST_NAME_RESULT* a, const TEST_NAME_RESULT* b, size_t len)
+{
+	return (a->hash == b->hash) && (a->hashLength == b->hashLength) && (a->length == b->length)
+		&& (memcmp(a->lower, b->lower, len) == 0);
+}
+
+
+// Every length and start alignment, against the scalar kernels
+static void CompareLevel(PDB_SIMD_LEVEL level)
+{
+	char buff[TEST_BUFFER_SIZE + 32];
+	const char* names[TEST_ALIGNMENTS];
+	uint32_t expectedHashes[TEST_ALIGNMENTS];
+	uint32_t hashes[TEST_ALIGNMENTS];
+	size_t len;
+	size_t align;
+
+	for (len = 0; len <= TEST_MAX_NAME; len++)
+	{
+		for (align = 0; align < TEST_ALIGNMENTS; align++)
+		{
+			// Aligned to 32 first, so align is the offset in a vector
+			char* name = (char*)(((uintptr_t)buff + 31) & ~(uintptr_t)31) + align;
+			TEST_NAME_RESULT expected;
+			TEST_NAME_RESULT actual;
+
+			FillName(name, len, (uint32_t)((len * TEST_ALIGNMENTS) + align));
+
+			PdbSetSimdLevel(PDB_SIMD_SCALAR);
+			Evaluate(name, len, &expected);
+			TEST_CHECK(expected.length == len);
+
+			PdbSetSimdLevel(level);
+			Evaluate(name, len, &actual);
+			TEST_CHECK(SameResult(&expected, &actual, len));
+		}
+	}
+
+	// A batch, each name a different length from a different alignment
+	for (align = 0; align < TEST_ALIGNMENTS; align++)
+	{
+		char* name = (char*)malloc(TEST_BUFFER_SIZE);
+
+		if (!name)
+			return;
+
+		FillName(name + align, (align * 3) + 1, (uint32_t)align);
+		names[align] = name + align;
+	}
+
+	PdbSetSimdLevel(PDB_SIMD_SCALAR);
+	PdbHashNames(names, TEST_ALIGNMENTS, expectedHashes);
+	PdbSetSimdLevel(level);
+	PdbHashNames(names, TEST_ALIGNMENTS, hashes);
+	TEST_CHECK(memcmp(expectedHashes, hashes, sizeof(hashes)) == 0);
+
+	for (align = 0; align < TEST_ALIGNMENTS; align++)
+		free((char*)names[align] - align);
+}
+
+
+// A readable page followed by one that faults on any access
+static uint8_t* AllocGuardedPage(size_t* pageSize)
+{
+#ifdef WIN32
+	SYSTEM_INFO info;
+	uint8_t* pages;
+	DWORD old;
+
+	GetSystemInfo(&info);
+	*pageSize = info.dwPageSize;
+
+	pages = (uint8_t*)VirtualAlloc(NULL, *pageSize * 2, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (!pages)
+		return NULL;
+
+	if (!VirtualProtect(pages + *pageSize, *pageSize, PAGE_NOACCESS, &old))
+	{
+		VirtualFree(pages, 0, MEM_RELEASE);
+		return NULL;
+	}
+
+	return pages;
+#else
+	uint8_t* pages;
+
+	*pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+	pages = (uint8_t*)mmap(NULL, *pageSize * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pages == MAP_FAILED)
+		return NULL;
+
+	if (mprotect(pages + *pageSize, *pageSize, PROT_NONE) != 0)
+	{
+		munmap(pages, *pageSize * 2);
+		return NULL;
+	}
+
+	return pages;
+#endif /* WIN32 */
+}
+
+
+static void FreeGuardedPage(uint8_t* pages, size_t pageSize)
+{
+#ifdef WIN32
+	(void)pageSize;
+	VirtualFree(pages, 0, MEM_RELEASE);
+#else
+	munmap(pages, pageSize * 2);
+#endif /* WIN32 */
+}
+
+
+// Names whose last byte is the last readable one.  Reading past it faults,
+// so this also checks the kernels stay inside the page.
+static void CompareAtPageEnd(PDB_SIMD_LEVEL level)
+{
+	size_t pageSize;
+	uint8_t* pages = AllocGuardedPage(&pageSize);
+	uint8_t* end;
+	size_t len;
+
+	TEST_CHECK(pages != NULL);
+	if (!pages)
+		return;
+
+	end = pages + pageSize;
+
+	for (len = 0; len <= TEST_MAX_NAME; len++)
+	{
+		// Terminated, the terminator is the last byte
+		char* name = (char*)end - len - 1;
+		TEST_NAME_RESULT expected;
+		TEST_NAME_RESULT actual;
+		uint32_t expectedHash;
+		uint32_t hash;
+
+		FillName(name, len, (uint32_t)len);
+
+		PdbSetSimdLevel(PDB_SIMD_SCALAR);
+		Evaluate(name, len, &expected);
+		PdbHashNames((const char* const*)&name, 1, &expectedHash);
+
+		PdbSetSimdLevel(level);
+		Evaluate(name, len, &actual);
+		PdbHashNames((const char* const*)&name, 1, &hash);
+
+		TEST_CHECK(SameResult(&expected, &actual, len));
+		TEST_CHECK(expectedHash == hash);
+
+		// Counted, the name's last byte is the last one
+		name = (char*)end - len;
+
+		PdbSetSimdLevel(PDB_SIMD_SCALAR);
+		expected.hashLength = PdbHashNameLength(name, len);
+		PdbNameToLower(expected.lower, name, len);
+
+		PdbSetSimdLevel(level);
+		actual.hashLength = PdbHashNameLength(name, len);
+		PdbNameToLower(actual.lower, name, len);
+
+		TEST_CHECK(expected.hashLength == actual.hashLength);
+		TEST_CHECK(memcmp(expected.lower, actual.lower, len) == 0);
+	}
+
+	FreeGuardedPage(pages, pageSize);
+}
+
+
+// Known hashes, so the scalar kernels are checked too
+static void CheckKnownHashes(void)
+{
+	PdbSetSimdLevel(PDB_SIMD_SCALAR);
+
+	TEST_CHECK(PdbHashName("") == 0x20240400);
+	TEST_CHECK(PdbHashName("_EPROCESS") == 0x213121f6);
+	TEST_CHECK(PdbHashName("_eprocess") == 0x213121f6);
+	TEST_CHECK(PdbHashNameLength("_EPROCESS", 9) == PdbHashName("_EPROCESS"));
+}
+
+
+void TestNameHash(void)
+{
+	PDB_SIMD_LEVEL best = PdbGetSimdLevel();
+	PDB_SIMD_LEVEL level;
+
+	CheckKnownHashes();
+
+	// Levels the processor doesn't support fall back to one it does, which
+	// is still worth checking
+	for (level = PDB_SIMD_SCALAR; level <= PDB_SIMD_AVX2; level = (PDB_SIMD_LEVEL)(level + 1))
+	{
+		PDB_SIMD_LEVEL actual = PdbSetSimdLevel(level);
+
+		if (actual != level)
+			printf("SIMD level %d isn't supported, checking level %d.\n", level, actual);
+
+		CompareLevel(level);
+		CompareAtPageEnd(level);
+	}
+
+	PdbSetSimdLevel(best);
+}
@@ -0,0 +1,291 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <string.h>
+
+#include "pdb.h"
+#include "tests.h"
+
+
+#define TEST_PAGE_SIZE 0x1000
+#define TEST_MAX_STREAMS 32
+
+#define TEST_NIL_STREAM 0xffffffff
+
+static const char g_msfSignature[] = "Microsoft C/C++ MSF 7.00\r\n\x1a" "DS\0\0";
+
+#define TEST_NAMES_SIGNATURE 0xEFFEEFFE
+#define TEST_INFO_VERSION_VC70 20000404
+#define TEST_DBI_VERSION_V70 19990903
+#define TEST_DBI_HEADER_SIZE 64
+
+
+struct TEST_PDB
+{
+	uint8_t* streams[TEST_MAX_STREAMS];
+	uint32_t sizes[TEST_MAX_STREAMS]; // TEST_NIL_STREAM if not set
+	uint16_t streamCount;
+
+	uint8_t* image;
+	PDB_FILE* pdb;
+};
+
+
+TEST_PDB* TestPdbCreate(void)
+{
+	TEST_PDB* test = (TEST_PDB*)calloc(1, sizeof(TEST_PDB));
+	uint32_t i;
+
+	if (!test)
+		return NULL;
+
+	for (i = 0; i < TEST_MAX_STREAMS; i++)
+		test->sizes[i] = TEST_NIL_STREAM;
+
+	// The root, program info, TPI, DBI and IPI streams are always there
+	test->streamCount = 5;
+
+	return test;
+}
+
+
+void TestPdbClose(TEST_PDB* test)
+{
+	uint32_t i;
+
+	if (test->pdb)
+		PdbClose(test->pdb);
+
+	for (i = 0; i < TEST_MAX_STREAMS; i++)
+		free(test->streams[i]);
+
+	free(test->image);
+	free(test);
+}
+
+
+bool TestPdbSetStream(TEST_PDB* test, uint16_t streamId, const void* data, uint32_t size)
+{
+	uint8_t* copy;
+
+	if (streamId >= TEST_MAX_STREAMS)
+		return false;
+
+	copy = (uint8_t*)malloc(size ? size : 1);
+	if (!copy)
+		return false;
+
+	memcpy(copy, data, size);
+
+	free(test->streams[streamId]);
+	test->streams[streamId] = copy;
+	test->sizes[streamId] = size;
+
+	if (streamId >= test->streamCount)
+		test->streamCount = streamId + 1;
+
+	return true;
+}
+
+
+static void Append(uint8_t* buff, uint32_t* len, const void* data, uint32_t size)
+{
+	memcpy(buff + *len, data, size);
+	*len += size;
+}
+
+
+static void AppendU32(uint8_t* buff, uint32_t* len, uint32_t value)
+{
+	Append(buff, len, &value, 4);
+}
+
+
+bool TestPdbSetNames(TEST_PDB* test, uint16_t streamId, const char* const* strings, uint32_t count,
+	uint32_t* offsets)
+{
+	static const char name[] = "/names";
+	uint32_t stringsSize = 1; // Offset 0 is the empty string
+	uint8_t* buff;
+	uint32_t len = 0;
+	uint32_t i;
+	bool result;
+
+	for (i = 0; i < count; i++)
+		stringsSize += (uint32_t)strlen(strings[i]) + 1;
+
+	buff = (uint8_t*)malloc(stringsSize + 64);
+	if (!buff)
+		return false;
+
+	// Header, strings, no hash buckets, string count
+	AppendU32(buff, &len, TEST_NAMES_SIGNATURE);
+	AppendU32(buff, &len, 1);
+	AppendU32(buff, &len, stringsSize);
+	Append(buff, &len, "", 1);
+
+	for (i = 0; i < count; i++)
+	{
+		offsets[i] = len - 12;
+		Append(buff, &len, strings[i], (uint32_t)strlen(strings[i]) + 1);
+	}
+
+	AppendU32(buff, &len, 0);
+	AppendU32(buff, &len, count);
+
+	result = TestPdbSetStream(test, streamId, buff, len);
+
+	// Version, signature, age and GUID, then a one bucket named stream table
+	len = 0;
+	AppendU32(buff, &len, TEST_INFO_VERSION_VC70);
+	AppendU32(buff, &len, 0x12345678);
+	AppendU32(buff, &len, 1);
+	Append(buff, &len, "0123456789abcdef", 16);
+	AppendU32(buff, &len, sizeof(name));
+	Append(buff, &len, name, sizeof(name));
+	AppendU32(buff, &len, 1); // Size
+	AppendU32(buff, &len, 1); // Capacity
+	AppendU32(buff, &len, 1); // Present words
+	AppendU32(buff, &len, 1);
+	AppendU32(buff, &len, 0); // Deleted words
+	AppendU32(buff, &len, 0); // Name offset
+	AppendU32(buff, &len, streamId);
+	AppendU32(buff, &len, 0);
+
+	result = result && TestPdbSetStream(test, PDB_STREAM_PROGRAM_INFO, buff, len);
+
+	free(buff);
+
+	return result;
+}
+
+
+bool TestPdbSetDbi(TEST_PDB* test, const uint16_t* debugStreams, uint32_t count)
+{
+	uint8_t buff[TEST_DBI_HEADER_SIZE + 64];
+	uint32_t len = 0;
+	uint32_t debugSize = count * 2;
+
+	if (debugSize > sizeof(buff) - TEST_DBI_HEADER_SIZE)
+		return false;
+
+	memset(buff, 0, sizeof(buff));
+
+	// Signature, version, age, then no symbol streams
+	AppendU32(buff, &len, 0xffffffff);
+	AppendU32(buff, &len, TEST_DBI_VERSION_V70);
+	AppendU32(buff, &len, 1);
+	memset(buff + len, 0xff, 12);
+	len += 12;
+
+	// Every substream is empty apart from the debug header
+	len += 24;
+	AppendU32(buff, &len, debugSize);
+	len = TEST_DBI_HEADER_SIZE;
+
+	Append(buff, &len, debugStreams, debugSize);
+
+	return TestPdbSetStream(test, PDB_STREAM_DEBUG_INFO, buff, len);
+}
+
+
+static uint32_t PageCount(uint32_t size)
+{
+	return (size + TEST_PAGE_SIZE - 1) / TEST_PAGE_SIZE;
+}
+
+
+// Header and free page maps, each stream's pages, the directory, then the
+// page listing the directory's pages
+PDB_FILE* TestPdbOpen(TEST_PDB* test)
+{
+	const PDB_IO_OPS* io;
+	void* ctxt;
+	uint32_t directorySize = 4 + (test->streamCount * 4);
+	uint32_t pageCount = 3;
+	uint32_t directoryPages;
+	uint32_t* directory;
+	uint32_t* sizes;
+	uint32_t* pages;
+	uint32_t page = 3;
+	uint32_t i;
+	uint32_t j;
+
+	for (i = 0; i < test->streamCount; i++)
+	{
+		if (test->sizes[i] != TEST_NIL_STREAM)
+		{
+			directorySize += PageCount(test->sizes[i]) * 4;
+			pageCount += PageCount(test->sizes[i]);
+		}
+	}
+
+	directoryPages = PageCount(directorySize);
+	pageCount += directoryPages + 1;
+
+	test->image = (uint8_t*)calloc(pageCount, TEST_PAGE_SIZE);
+	if (!test->image)
+		return NULL;
+
+	directory = (uint32_t*)(test->image + ((size_t)(pageCount - directoryPages - 1) * TEST_PAGE_SIZE));
+	directory[0] = test->streamCount;
+	sizes = directory + 1;
+	pages = sizes + test->streamCount;
+
+	for (i = 0; i < test->streamCount; i++)
+	{
+		sizes[i] = test->sizes[i];
+
+		if (test->sizes[i] == TEST_NIL_STREAM)
+			continue;
+
+		memcpy(test->image + ((size_t)page * TEST_PAGE_SIZE), test->streams[i], test->sizes[i]);
+
+		for (j = 0; j < PageCount(test->sizes[i]); j++)
+			*pages++ = page++;
+	}
+
+	pages = (uint32_t*)(test->image + ((size_t)(pageCount - 1) * TEST_PAGE_SIZE));
+	for (i = 0; i < directoryPages; i++)
+		pages[i] = page++;
+
+	// Page size, free page map, page count, directory size, reserved, then
+	// the page listing the directory
+	memcpy(test->image, g_msfSignature, sizeof(g_msfSignature));
+	directory = (uint32_t*)(test->image + sizeof(g_msfSignature));
+	directory[0] = TEST_PAGE_SIZE;
+	directory[1] = 1;
+	directory[2] = pageCount;
+	directory[3] = directorySize;
+	directory[4] = 0;
+	directory[5] = pageCount - 1;
+
+	io = PdbIoOpenMemory(test->image, (size_t)pageCount * TEST_PAGE_SIZE, &ctxt);
+	if (!io)
+		return NULL;
+
+	test->pdb = PdbOpenWithIo(io, ctxt);
+	if (!test->pdb && io->close)
+		io->close(ctxt);
+
+	return test->pdb;
+}
@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#ifndef __TESTS_H__
+#define __TESTS_H__
+
+
+typedef struct TEST_PDB TEST_PDB;
+
+// Count a failure and say where, the test carries on
+#define TEST_CHECK(cond) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #cond); \
+			g_testFailures++; \
+		} \
+	} while (0)
+
+
+extern uint32_t g_testFailures;
+
+// Build a pdb in memory: an MSF 7.00 container with 4k pages holding the
+// streams set, nil streams where none is set
+TEST_PDB* TestPdbCreate(void);
+void TestPdbClose(TEST_PDB* test);
+
+bool TestPdbSetStream(TEST_PDB* test, uint16_t streamId, const void* data, uint32_t size);
+
+// A /names stream holding strings in streamId, and a program info stream
+// that names it.  offsets gets each string's offset.
+bool TestPdbSetNames(TEST_PDB* test, uint16_t streamId, const char* const* strings, uint32_t count,
+	uint32_t* offsets);
+
+// A DBI stream with no modules and the debug header given
+bool TestPdbSetDbi(TEST_PDB* test, const uint16_t* debugStreams, uint32_t count);
+
+// Lay the streams out and open them, the pdb is closed by TestPdbClose
+PDB_FILE* TestPdbOpen(TEST_PDB* test);
+
+void TestFrameData(void);
+void TestMsfz(void);
+void TestNameHash(void);
+void TestTypes(void);
+
+
+#endif /* __TESTS_H__ */
@@ -0,0 +1,304 @@
+/*
+Copyright (c) 2010 Ryan Salsamendi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "pdb.h"
+#include "tpi.h"
+#include "layout.h"
+#include "tests.h"
+
+
+#define TEST_TYPES_STREAM 2
+#define TEST_TYPES_HEADER_SIZE 0x38
+#define TEST_TYPES_VERSION 20040203
+#define TEST_TYPES_MIN_ID 0x1000
+#define TEST_TYPES_COUNT 4
+
+#define TEST_TYPE_INT4 0x74
+#define TEST_TYPE_ULONG 0x22
+
+
+// The records are the same in each stream but for one thing broken
+typedef enum TEST_TYPES_SHAPE
+{
+	TEST_TYPES_GOOD,
+	TEST_TYPES_SHORT_ARRAY, // The array record ends before its size
+	TEST_TYPES_INDEX_SELF, // A list continued in itself
+	TEST_TYPES_INDEX_LATER, // A list continued in a later record
+	TEST_TYPES_INDEX_BELOW_MIN, // A list continued in a built in type
+	TEST_TYPES_MEMBER_TYPE, // A member of a type past the end
+	TEST_TYPES_UDT_FIELD, // A structure whose field list is past the end
+	TEST_TYPES_TRUNCATED_MEMBER, // A member cut off after its leaf
+	TEST_TYPES_SHAPE_COUNT
+} TEST_TYPES_SHAPE;
+
+typedef struct TEST_TYPES
+{
+	uint8_t data[1024];
+	uint32_t size;
+	uint32_t recordStart;
+} TEST_TYPES;
+
+
+static void AddU16(TEST_TYPES* types, uint16_t value)
+{
+	memcpy(types->data + types->size, &value, 2);
+	types->size += 2;
+}
+
+
+static void AddU32(TEST_TYPES* types, uint32_t value)
+{
+	memcpy(types->data + types->size, &value, 4);
+	types->size += 4;
+}
+
+
+static void AddString(TEST_TYPES* types, const char* str)
+{
+	size_t len = strlen(str) + 1;
+
+	memcpy(types->data + types->size, str, len);
+	types->size += (uint32_t)len;
+}
+
+
+// LF_PAD bytes up to the next 4 byte boundary, each giving the distance
+static void AddPadding(TEST_TYPES* types)
+{
+	while (types->size & 3)
+	{
+		types->data[types->size] = (uint8_t)(0xf0 | (4 - (types->size & 3)));
+		types->size++;
+	}
+}
+
+
+static void BeginRecord(TEST_TYPES* types, uint16_t leaf)
+{
+	types->recordStart = types->size;
+	AddU16(types, 0);
+	AddU16(types, leaf);
+}
+
+
+static void EndRecord(TEST_TYPES* types)
+{
+	uint16_t len;
+
+	AddPadding(types);
+	len = (uint16_t)(types->size - types->recordStart - 2);
+	memcpy(types->data + types->recordStart, &len, 2);
+}
+
+
+static void AddMember(TEST_TYPES* types, const char* name, uint32_t type, uint16_t offset)
+{
+	AddU16(types, LEAF_TYPE_MEMBER);
+	AddU16(types, 3); // public
+	AddU32(types, type);
+	AddU16(types, offset);
+	AddString(types, name);
+	AddPadding(types);
+}
+
+
+static void AddIndex(TEST_TYPES* types, uint32_t type)
+{
+	AddU16(types, LEAF_TYPE_INDEX);
+	AddU16(types, 0);
+	AddU32(types, type);
+}
+
+
+// 0x1000 and 0x1001 are a field list split in two, 0x1002 the structure
+// using it and 0x1003 an array of it
+static void BuildTypes(TEST_TYPES* types, TEST_TYPES_SHAPE shape)
+{
+	uint32_t maxId = TEST_TYPES_MIN_ID + TEST_TYPES_COUNT;
+	uint32_t index = TEST_TYPES_MIN_ID;
+	uint32_t header[5];
+
+	memset(types, 0, sizeof(TEST_TYPES));
+	types->size = TEST_TYPES_HEADER_SIZE;
+
+	BeginRecord(types, LEAF_TYPE_FIELDLIST);
+	AddMember(types, "x", TEST_TYPE_INT4, 0);
+	AddMember(types, "y", (shape == TEST_TYPES_MEMBER_TYPE) ? maxId : TEST_TYPE_INT4, 4);
+	if (shape == TEST_TYPES_INDEX_LATER)
+		AddIndex(types, TEST_TYPES_MIN_ID + 1);
+	if (shape == TEST_TYPES_TRUNCATED_MEMBER)
+		AddU16(types, LEAF_TYPE_MEMBER);
+	EndRecord(types);
+
+	if (shape == TEST_TYPES_INDEX_SELF)
+		index = TEST_TYPES_MIN_ID + 1;
+	else if (shape == TEST_TYPES_INDEX_BELOW_MIN)
+		index = TEST_TYPE_INT4;
+
+	BeginRecord(types, LEAF_TYPE_FIELDLIST);
+	AddMember(types, "z", TEST_TYPE_INT4, 8);
+	AddIndex(types, index);
+	EndRecord(types);
+
+	BeginRecord(types, LEAF_TYPE_STRUCTURE);
+	AddU16(types, 3); // count
+	AddU16(types, 0); // prop
+	AddU32(types, (shape == TEST_TYPES_UDT_FIELD) ? maxId : TEST_TYPES_MIN_ID + 1);
+	AddU32(types, 0); // derived
+	AddU32(types, 0); // vshape
+	AddU16(types, 12); // size
+	AddString(types, "POINT");
+	EndRecord(types);
+
+	BeginRecord(types, LEAF_TYPE_ARRAY);
+	AddU32(types, TEST_TYPES_MIN_ID + 2);
+	if (shape != TEST_TYPES_SHORT_ARRAY)
+	{
+		AddU32(types, TEST_TYPE_ULONG);
+		AddU16(types, 24);
+		AddString(types, "");
+	}
+	EndRecord(types);
+
+	// version, header size, min and max index, data size, then no hash stream
+	header[0] = TEST_TYPES_VERSION;
+	header[1] = TEST_TYPES_HEADER_SIZE;
+	header[2] = TEST_TYPES_MIN_ID;
+	header[3] = maxId;
+	header[4] = types->size - TEST_TYPES_HEADER_SIZE;
+	memcpy(types->data, header, sizeof(header));
+	memset(types->data + sizeof(header), 0xff, 4);
+}
+
+
+// Open the types of a pdb holding the stream built for shape
+static PDB_TYPES* OpenTypes(TEST_PDB* test, TEST_TYPES_SHAPE shape)
+{
+	TEST_TYPES types;
+	PDB_FILE* pdb;
+
+	BuildTypes(&types, shape);
+
+	if (!TestPdbSetStream(test, TEST_TYPES_STREAM, types.data, types.size))
+		return NULL;
+
+	pdb = TestPdbOpen(test);
+
+	return pdb ? PdbTypesOpen(pdb) : NULL;
+}
+
+
+static bool SameNode(const PDB_TYPE_NODE* a, const PDB_TYPE_NODE* b)
+{
+	uint32_t i;
+
+	if ((a->kind != b->kind) || (a->leaf != b->leaf) || (a->size != b->size) || (a->fieldCount != b->fieldCount)
+		|| !a->name || !b->name || (strcmp(a->name, b->name) != 0))
+		return false;
+
+	for (i = 0; i < a->fieldCount; i++)
+	{
+		const PDB_TYPE_FIELD* fieldA = &a->fields[i];
+		const PDB_TYPE_FIELD* fieldB = &b->fields[i];
+
+		if ((fieldA->leaf != fieldB->leaf) || (fieldA->offset != fieldB->offset)
+			|| (fieldA->typeId != fieldB->typeId) || !fieldA->name || !fieldB->name
+			|| (strcmp(fieldA->name, fieldB->name) != 0))
+			return false;
+	}
+
+	return true;
+}
+
+
+void TestTypes(void)
+{
+	TEST_PDB* tests[TEST_TYPES_SHAPE_COUNT];
+	PDB_TYPES* types[TEST_TYPES_SHAPE_COUNT];
+	PDB_LAYOUT* layouts[2] = { NULL, NULL };
+	const PDB_TYPE_NODE* nodes[2] = { NULL, NULL };
+	uint32_t i;
+
+	for (i = 0; i < TEST_TYPES_SHAPE_COUNT; i++)
+	{
+		tests[i] = TestPdbCreate();
+		types[i] = tests[i] ? OpenTypes(tests[i], (TEST_TYPES_SHAPE)i) : NULL;
+		TEST_CHECK(types[i] != NULL);
+	}
+
+	if (!types[TEST_TYPES_GOOD] || !types[TEST_TYPES_SHORT_ARRAY])
+		goto DONE;
+
+	// The same structure decodes the same with and without the bounds checks
+	TEST_CHECK(PdbTypesValidate(types[TEST_TYPES_GOOD]));
+	TEST_CHECK(!PdbTypesValidate(types[TEST_TYPES_SHORT_ARRAY]));
+
+	for (i = 0; i < 2; i++)
+	{
+		layouts[i] = PdbLayoutCreate(types[i]);
+		nodes[i] = layouts[i] ? PdbLayoutResolve(layouts[i], TEST_TYPES_MIN_ID + 2) : NULL;
+		TEST_CHECK(nodes[i] != NULL);
+	}
+
+	if (nodes[0] && nodes[1])
+	{
+		TEST_CHECK(SameNode(nodes[0], nodes[1]));
+		TEST_CHECK(nodes[0]->size == 12);
+		TEST_CHECK(nodes[0]->fieldCount == 3);
+	}
+
+	// Every other shape fails validation, and following its lists still ends
+	for (i = TEST_TYPES_INDEX_SELF; i < TEST_TYPES_SHAPE_COUNT; i++)
+	{
+		PDB_LAYOUT* layout;
+
+		if (!types[i])
+			continue;
+
+		TEST_CHECK(!PdbTypesValidate(types[i]));
+
+		layout = PdbLayoutCreate(types[i]);
+		if (layout)
+		{
+			PdbLayoutResolve(layout, TEST_TYPES_MIN_ID + 2);
+			PdbLayoutDestroy(layout);
+		}
+	}
+
+DONE:
+	for (i = 0; i < 2; i++)
+	{
+		if (layouts[i])
+			PdbLayoutDestroy(layouts[i]);
+	}
+
+	for (i = 0; i < TEST_TYPES_SHAPE_COUNT; i++)
+	{
+		if (types[i])
+			PdbTypesClose(types[i]);
+		if (tests[i])
+			TestPdbClose(tests[i]);
+	}
+}